@@ -0,0 +1,223 @@
+/**
+ * @file copy_bench.cpp
+ * @brief Compares event-export copy throughput of std::filesystem::copy and
+ * the CopyEngine backends
+ *
+ * Usage:
+ *   copy_bench [--dir DIR] [--files N] [--size-mb MB] [--inflight-mb MB]
+ *              [--chunk-kb KB] [--direct] [--rounds N]
+ *
+ * Creates N source files of the given size in DIR (on the filesystem to
+ * measure, e.g. the SD card or USB drive holding the event directory) and
+ * copies all of them with each method. Before every round the sources are
+ * dropped from the page cache with posix_fadvise, and the timing includes
+ * a final syncfs(), so the numbers reflect the storage device rather than
+ * memory bandwidth.
+ *
+ * Example: one minute of 8 Mbit/s video per file, 10 files
+ *   make bench && bench/copy_bench --dir /media/usb/bench --size-mb 60
+ */
+
+#include "CopyEngine.hpp"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::string dir = "/tmp/dacl_copy_bench";
+  int files = 10;
+  int sizeMB = 60;
+  int inflightMB = 8;
+  int chunkKB = 512;
+  bool direct = false;
+  int rounds = 3;
+};
+
+void usage() {
+  std::cerr << "Usage: copy_bench [--dir DIR] [--files N] [--size-mb MB]"
+               " [--inflight-mb MB]\n"
+               "                  [--chunk-kb KB] [--direct] [--rounds N]\n";
+}
+
+Options parseArgs(int argc, char *argv[]) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+    if (arg == "--dir") {
+      o.dir = value();
+    } else if (arg == "--files") {
+      o.files = std::stoi(value());
+    } else if (arg == "--size-mb") {
+      o.sizeMB = std::stoi(value());
+    } else if (arg == "--inflight-mb") {
+      o.inflightMB = std::stoi(value());
+    } else if (arg == "--chunk-kb") {
+      o.chunkKB = std::stoi(value());
+    } else if (arg == "--direct") {
+      o.direct = true;
+    } else if (arg == "--rounds") {
+      o.rounds = std::stoi(value());
+    } else {
+      throw std::invalid_argument("Unknown option: " + arg);
+    }
+  }
+  if (o.files <= 0 || o.sizeMB <= 0 || o.rounds <= 0) {
+    throw std::invalid_argument("--files, --size-mb and --rounds must be "
+                                "positive");
+  }
+  return o;
+}
+
+void createSource(const std::string &path, size_t bytes) {
+  std::vector<char> block(1 << 20);
+  std::mt19937 rng(static_cast<unsigned>(bytes));
+  for (auto &c : block) {
+    c = static_cast<char>(rng());
+  }
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot create " + path + ": " +
+                             std::strerror(errno));
+  }
+  for (size_t done = 0; done < bytes;) {
+    const size_t n = std::min(block.size(), bytes - done);
+    if (::write(fd, block.data(), n) != static_cast<ssize_t>(n)) {
+      ::close(fd);
+      throw std::runtime_error("Cannot write " + path);
+    }
+    done += n;
+  }
+  ::fdatasync(fd);
+  ::close(fd);
+}
+
+/// Drops files from the page cache so the next read hits the device
+void dropCache(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+}
+
+using CopyFn = std::function<void(
+    const std::vector<std::pair<std::string, std::string>> &)>;
+
+double measure(const Options &o, const std::string &name,
+               const std::vector<std::pair<std::string, std::string>> &files,
+               const CopyFn &copy, double baseline = 0.0) {
+  double best = 0.0;
+  for (int round = 0; round < o.rounds; ++round) {
+    for (const auto &file : files) {
+      std::error_code ec;
+      std::filesystem::remove(file.second, ec);
+      dropCache(file.first);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    copy(files);
+    const int dirFd = ::open(o.dir.c_str(), O_RDONLY | O_DIRECTORY);
+    ::syncfs(dirFd);
+    ::close(dirFd);
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    const double mbps = static_cast<double>(o.files) * o.sizeMB / seconds;
+    best = std::max(best, mbps);
+  }
+  std::cout << std::left << std::setw(32) << name << std::right
+            << std::setw(8) << std::fixed << std::setprecision(1) << best
+            << " MB/s";
+  if (baseline > 0.0) {
+    std::cout << std::setw(8) << std::setprecision(2) << best / baseline
+              << "x";
+  }
+  std::cout << std::endl;
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options o;
+  try {
+    o = parseArgs(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    usage();
+    return 2;
+  }
+
+  try {
+    std::filesystem::create_directories(o.dir);
+    std::vector<std::pair<std::string, std::string>> files;
+    for (int i = 0; i < o.files; ++i) {
+      const std::string source = o.dir + "/src_" + std::to_string(i);
+      createSource(source, static_cast<size_t>(o.sizeMB) << 20);
+      files.emplace_back(source, o.dir + "/dst_" + std::to_string(i));
+    }
+
+    std::cout << o.files << " files x " << o.sizeMB << " MB, best of "
+              << o.rounds << " rounds" << std::endl;
+    const double baseline = measure(
+        o, "std::filesystem::copy", files, [](const auto &list) {
+          for (const auto &file : list) {
+            std::filesystem::copy(
+                file.first, file.second,
+                std::filesystem::copy_options::overwrite_existing);
+          }
+        });
+
+    CopyOptions options;
+    options.inFlightBytes = static_cast<size_t>(o.inflightMB) << 20;
+    options.chunkBytes = static_cast<size_t>(o.chunkKB) << 10;
+    options.directIo = o.direct;
+    for (const char *backend : {"uring", "threads"}) {
+      options.backend = backend;
+      try {
+        CopyEngine engine(options);
+        const std::string name = std::string("CopyEngine ") + backend +
+                                 (o.direct ? " (O_DIRECT)" : "");
+        measure(
+            o, name, files,
+            [&engine](const auto &list) {
+              for (int error : engine.copyAll(list)) {
+                if (error != 0) {
+                  throw std::runtime_error(std::strerror(error));
+                }
+              }
+            },
+            baseline);
+      } catch (const std::runtime_error &e) {
+        std::cout << "CopyEngine " << backend << ": " << e.what()
+                  << std::endl;
+      }
+    }
+
+    for (const auto &file : files) {
+      std::filesystem::remove(file.first);
+      std::filesystem::remove(file.second);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file motion_bench.cpp
+ * @brief Measures the motion detector's per-frame cost
+ *
+ * Usage:
+ *   motion_bench [--width W] [--height H] [--fps N] [--frames N]
+ *
+ * Times the grayscale reduction and the block SAD kernel on synthetic
+ * frame-tap frames (640x360 by default) and compares the SIMD kernel with
+ * the portable loop, after checking that both produce the same sums. The
+ * result is reported per frame and as the share of one core used at the
+ * given frame rate.
+ *
+ * Example: check the 5% budget on the target
+ *   make bench && bench/motion_bench --fps 10
+ */
+
+#include "MotionDetector.hpp"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+  int width = 640;
+  int height = 360;
+  int fps = 10;
+  int frames = 2000;
+};
+
+void usage() {
+  std::cerr << "Usage: motion_bench [--width W] [--height H] [--fps N]"
+               " [--frames N]\n";
+}
+
+Options parseArgs(int argc, char *argv[]) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> int {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("Missing value for " + arg);
+      }
+      return std::stoi(argv[++i]);
+    };
+    if (arg == "--width") {
+      o.width = value();
+    } else if (arg == "--height") {
+      o.height = value();
+    } else if (arg == "--fps") {
+      o.fps = value();
+    } else if (arg == "--frames") {
+      o.frames = value();
+    } else {
+      throw std::invalid_argument("Unknown option: " + arg);
+    }
+  }
+  if (o.width <= 0 || o.height <= 0 || o.width % 2 != 0 ||
+      o.height % 2 != 0 || o.fps <= 0 || o.frames <= 0) {
+    throw std::invalid_argument("Sizes must be positive and even, --fps and "
+                                "--frames positive");
+  }
+  return o;
+}
+
+using Clock = std::chrono::steady_clock;
+
+/// Runs fn frames times and returns the mean time per call in microseconds
+template <typename Fn> double timePerCall(int frames, Fn fn) {
+  const auto start = Clock::now();
+  for (int i = 0; i < frames; ++i) {
+    fn(i);
+  }
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+             .count() /
+         frames;
+}
+
+void report(const std::string &name, double micros, int fps,
+            double baseline = 0.0) {
+  std::cout << std::left << std::setw(28) << name << std::right
+            << std::setw(9) << std::fixed << std::setprecision(1) << micros
+            << " us/frame" << std::setw(8) << std::setprecision(2)
+            << micros * fps / 1e4 << " % core";
+  if (baseline > 0.0) {
+    std::cout << std::setw(8) << std::setprecision(1) << baseline / micros
+              << "x";
+  }
+  std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options o;
+  try {
+    o = parseArgs(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    usage();
+    return 2;
+  }
+
+  // Two noisy frames with a moving square, alternated so every comparison
+  // sees a difference
+  const size_t bgrBytes = static_cast<size_t>(o.width) * o.height * 3;
+  std::vector<std::vector<uint8_t>> bgr(2, std::vector<uint8_t>(bgrBytes));
+  std::mt19937 rng(1);
+  for (auto &frame : bgr) {
+    for (auto &byte : frame) {
+      byte = static_cast<uint8_t>(96 + rng() % 16);
+    }
+  }
+  for (int y = o.height / 4; y < o.height / 2; ++y) {
+    for (int x = o.width / 4; x < o.width / 2; ++x) {
+      std::memset(&bgr[1][(static_cast<size_t>(y) * o.width + x) * 3], 255, 3);
+    }
+  }
+
+  const int grayWidth = o.width / 2;
+  const int grayHeight = o.height / 2;
+  const size_t blocks = static_cast<size_t>(grayWidth / MOTION_BLOCK_SIZE) *
+                        (grayHeight / MOTION_BLOCK_SIZE);
+  std::vector<std::vector<uint8_t>> gray(
+      2, std::vector<uint8_t>(static_cast<size_t>(grayWidth) * grayHeight));
+  bgrToGrayHalf(bgr[0].data(), o.width, o.height, gray[0].data());
+  bgrToGrayHalf(bgr[1].data(), o.width, o.height, gray[1].data());
+
+  std::vector<uint32_t> simd(blocks);
+  std::vector<uint32_t> scalar(blocks);
+  blockSad(gray[0].data(), gray[1].data(), grayWidth, grayHeight,
+           simd.data());
+  blockSadScalar(gray[0].data(), gray[1].data(), grayWidth, grayHeight,
+                 scalar.data());
+  if (simd != scalar) {
+    std::cerr << "Error: " << blockSadKernel()
+              << " kernel disagrees with the scalar kernel" << std::endl;
+    return 1;
+  }
+
+  std::cout << o.width << "x" << o.height << " BGR frames, " << grayWidth
+            << "x" << grayHeight << " gray, " << blocks << " blocks, "
+            << o.frames << " frames at " << o.fps << " fps" << std::endl;
+
+  volatile uint32_t sink = 0;
+  const double scalarUs = timePerCall(o.frames, [&](int i) {
+    blockSadScalar(gray[i & 1].data(), gray[(i + 1) & 1].data(), grayWidth,
+                   grayHeight, scalar.data());
+    sink = sink + scalar[0];
+  });
+  const double simdUs = timePerCall(o.frames, [&](int i) {
+    blockSad(gray[i & 1].data(), gray[(i + 1) & 1].data(), grayWidth,
+             grayHeight, simd.data());
+    sink = sink + simd[0];
+  });
+  const double grayUs = timePerCall(o.frames, [&](int i) {
+    bgrToGrayHalf(bgr[i & 1].data(), o.width, o.height, gray[i & 1].data());
+    sink = sink + gray[i & 1][0];
+  });
+
+  report("block SAD scalar", scalarUs, o.fps);
+  report(std::string("block SAD ") + blockSadKernel(), simdUs, o.fps,
+         scalarUs);
+  report("BGR to half-size gray", grayUs, o.fps);
+  report("per frame total", grayUs + simdUs, o.fps);
+  return 0;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file replay_bench.cpp
+ * @brief Measures how trace reprocessing scales with worker threads
+ *
+ * Usage:
+ *   replay_bench [--frames N] [--max-threads N]
+ *
+ * A synthetic candump trace of N frames is generated in memory: a drive at
+ * 2000 frames/s with speed, odometer and clock frames plus other
+ * traffic, and a warning frame every 45 s. It is then replayed with
+ * TraceReplay (the engine of dacl-reprocess) on 1, 2, 4, ... threads up to
+ * --max-threads (default: all cores). For each thread count the decoding
+ * rate in frames per second and the speedup over one thread are reported,
+ * and the events are checked to be identical to the single-thread run.
+ *
+ * Example: the scaling on a workstation
+ *   make bench && bench/replay_bench --frames 20000000
+ */
+
+#include "CanFrameRing.hpp"
+#include "TraceReplay.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+  long long frames = 10000000;
+  unsigned maxThreads = std::max(1U, std::thread::hardware_concurrency());
+};
+
+void usage() {
+  std::cerr << "Usage: replay_bench [--frames N] [--max-threads N]\n";
+}
+
+Options parseArgs(int argc, char *argv[]) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> long long {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("Missing value for " + arg);
+      }
+      return std::stoll(argv[++i]);
+    };
+    if (arg == "--frames") {
+      o.frames = value();
+    } else if (arg == "--max-threads") {
+      o.maxThreads = static_cast<unsigned>(value());
+    } else {
+      throw std::invalid_argument("Unknown option: " + arg);
+    }
+  }
+  if (o.frames <= 0 || o.maxThreads == 0) {
+    throw std::invalid_argument("--frames and --max-threads must be positive");
+  }
+  return o;
+}
+
+/// Generates the trace, one frame every 500 us
+std::string makeTrace(long long frames) {
+  static constexpr uint32_t OTHER_IDS[] = {0x0C4, 0x130, 0x1F5, 0x3C0, 0x520};
+  std::vector<CanFrameRecord> batch;
+  std::string text;
+  text.reserve(static_cast<size_t>(frames) * 40);
+  const int64_t startUs = 1726402800LL * 1000000; // 2024-09-15 12:20 UTC
+  uint32_t odometer = 123456000;
+  for (long long n = 0; n < frames; ++n) {
+    CanFrameRecord frame;
+    frame.rxUs = startUs + n * 500;
+    frame.dlc = 8;
+    const long long ms = n / 2;
+    if (n % 90000 == 0 && n > 0) { // Warning every 45 s of trace
+      frame.id = n % 180000 == 0 ? 0x488 : 0x481;
+    } else if (n % 40 == 0) { // ESC_V_VEH every 20 ms
+      frame.id = 0x1A1;
+      const uint16_t raw = static_cast<uint16_t>((80 + ms / 1000 % 50) * 64);
+      frame.data[2] = static_cast<uint8_t>(raw);
+      frame.data[3] = static_cast<uint8_t>(raw >> 8);
+    } else if (n % 2000 == 1) { // Clock and odometer every second
+      frame.id = 0x2F8;
+      const long long s = 12 * 3600 + 20 * 60 + ms / 1000;
+      frame.data[0] = static_cast<uint8_t>(s / 3600 % 24);
+      frame.data[1] = static_cast<uint8_t>(s / 60 % 60);
+      frame.data[2] = static_cast<uint8_t>(s % 60);
+      frame.data[3] = 15;
+      frame.data[4] = 9 << 4;
+      frame.data[5] = 2024 & 0xFF;
+      frame.data[6] = 2024 >> 8;
+    } else if (n % 2000 == 2) {
+      frame.id = 0x19D;
+      odometer += 33;
+      std::memcpy(frame.data, &odometer, sizeof(odometer));
+    } else {
+      frame.id = OTHER_IDS[n % 5];
+      std::memset(frame.data, static_cast<int>(n & 0xFF), 8);
+    }
+    batch.push_back(frame);
+    if (batch.size() == 65536) {
+      text += formatCandump(batch, "can0", 0);
+      batch.clear();
+    }
+  }
+  text += formatCandump(batch, "can0", 0);
+  return text;
+}
+
+bool sameEvents(const std::vector<ReplayEvent> &a,
+                const std::vector<ReplayEvent> &b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                    [](const ReplayEvent &x, const ReplayEvent &y) {
+                      return x.timestamp == y.timestamp &&
+                             x.warning == y.warning && x.speed == y.speed &&
+                             x.triggerUs == y.triggerUs;
+                    });
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options o;
+  try {
+    o = parseArgs(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    usage();
+    return 2;
+  }
+
+  const std::string trace = makeTrace(o.frames);
+  std::cout << o.frames << " frames, " << trace.size() / (1 << 20)
+            << " MB of candump text" << std::endl;
+  const TraceReplay replay(
+      {{0x488, "WarningMsg_ACM"}, {0x481, "WarningMsg_BCM"}}, 1);
+
+  std::vector<ReplayEvent> reference;
+  double singleRate = 0.0;
+  for (unsigned threads = 1;; threads = std::min(threads * 2, o.maxThreads)) {
+    // The slicing of dacl-reprocess: eight slices per thread
+    std::vector<TraceSlice> slices;
+    TraceReplay::split({trace.data(), trace.data() + trace.size()},
+                       std::max<size_t>(trace.size() / (threads * 8), 1),
+                       slices);
+    const auto start = std::chrono::steady_clock::now();
+    const auto partitions = replay.decodeAll(slices, threads);
+    const auto events = replay.merge(partitions);
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    const double rate = o.frames / seconds;
+    if (threads == 1) {
+      reference = events;
+      singleRate = rate;
+    }
+    std::cout << std::setw(3) << threads << " threads" << std::setw(14)
+              << std::fixed << std::setprecision(0) << rate << " frames/s"
+              << std::setw(8) << std::setprecision(2) << rate / singleRate
+              << "x" << std::setw(8) << events.size() << " events"
+              << (sameEvents(events, reference) ? "" : "  MISMATCH")
+              << std::endl;
+    if (threads == o.maxThreads) {
+      break;
+    }
+  }
+  return 0;
+}
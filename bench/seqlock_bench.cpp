@@ -0,0 +1,213 @@
+/**
+ * @file seqlock_bench.cpp
+ * @brief Measures vehicle-state reads while the CAN thread writes flat out
+ *
+ * Usage:
+ *   seqlock_bench [--readers N] [--reads N]
+ *
+ * One writer thread publishes a VehicleState in a tight loop, far faster
+ * than any CAN bus delivers frames, while N reader threads take snapshots.
+ * Three publication schemes are compared:
+ * - nine separate std::atomic<int> fields (the former CANListener layout)
+ * - a mutex around the struct
+ * - Seqlock<VehicleState> (the current CANListener)
+ *
+ * The writer sets every field to the same counter value, so a snapshot with
+ * differing fields is torn. For each scheme the mean time per read, the
+ * writes completed during the run and the torn snapshots are reported.
+ *
+ * Example: run on the target with one reader per spare core
+ *   make bench && bench/seqlock_bench --readers 3
+ */
+
+#include "CANListener.hpp"
+#include "Seqlock.hpp"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+  int readers = 2;
+  int reads = 2000000;
+};
+
+void usage() {
+  std::cerr << "Usage: seqlock_bench [--readers N] [--reads N]\n";
+}
+
+Options parseArgs(int argc, char *argv[]) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> int {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("Missing value for " + arg);
+      }
+      return std::stoi(argv[++i]);
+    };
+    if (arg == "--readers") {
+      o.readers = value();
+    } else if (arg == "--reads") {
+      o.reads = value();
+    } else {
+      throw std::invalid_argument("Unknown option: " + arg);
+    }
+  }
+  if (o.readers <= 0 || o.reads <= 0) {
+    throw std::invalid_argument("--readers and --reads must be positive");
+  }
+  return o;
+}
+
+VehicleState stateOf(int value) {
+  VehicleState s;
+  s.speed = s.tripMileage = s.totalMileage = value;
+  s.year = s.month = s.day = value;
+  s.hour = s.minute = s.second = value;
+  return s;
+}
+
+bool torn(const VehicleState &s) {
+  return s.tripMileage != s.speed || s.totalMileage != s.speed ||
+         s.year != s.speed || s.month != s.speed || s.day != s.speed ||
+         s.hour != s.speed || s.minute != s.speed || s.second != s.speed;
+}
+
+/// The former CANListener layout: one atomic per field
+struct SeparateAtomics {
+  std::atomic<int> speed{0}, tripMileage{0}, totalMileage{0};
+  std::atomic<int> year{0}, month{0}, day{0}, hour{0}, minute{0}, second{0};
+
+  void write(const VehicleState &s) {
+    speed = s.speed;
+    tripMileage = s.tripMileage;
+    totalMileage = s.totalMileage;
+    year = s.year;
+    month = s.month;
+    day = s.day;
+    hour = s.hour;
+    minute = s.minute;
+    second = s.second;
+  }
+  VehicleState read() const {
+    VehicleState s;
+    s.speed = speed;
+    s.tripMileage = tripMileage;
+    s.totalMileage = totalMileage;
+    s.year = year;
+    s.month = month;
+    s.day = day;
+    s.hour = hour;
+    s.minute = minute;
+    s.second = second;
+    return s;
+  }
+};
+
+struct Locked {
+  mutable std::mutex mtx;
+  VehicleState state = stateOf(0);
+
+  void write(const VehicleState &s) {
+    std::lock_guard<std::mutex> lk(mtx);
+    state = s;
+  }
+  VehicleState read() const {
+    std::lock_guard<std::mutex> lk(mtx);
+    return state;
+  }
+};
+
+struct Result {
+  double nsPerRead = 0.0;
+  long long writes = 0;
+  long long torn = 0;
+};
+
+/// Runs the readers against a writer looping on store.write()
+template <typename Store> Result run(Store &store, const Options &o) {
+  std::atomic<bool> stop{false};
+  std::atomic<long long> writes{0};
+  std::thread writer([&] {
+    long long n = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+      store.write(stateOf(static_cast<int>(++n)));
+    }
+    writes = n;
+  });
+
+  std::atomic<long long> tornTotal{0};
+  std::atomic<long long> nsTotal{0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < o.readers; ++r) {
+    readers.emplace_back([&] {
+      long long tornCount = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < o.reads; ++i) {
+        if (torn(store.read())) {
+          ++tornCount;
+        }
+      }
+      nsTotal += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+      tornTotal += tornCount;
+    });
+  }
+  for (auto &t : readers) {
+    t.join();
+  }
+  stop = true;
+  writer.join();
+
+  Result result;
+  result.nsPerRead = static_cast<double>(nsTotal) / o.readers / o.reads;
+  result.writes = writes;
+  result.torn = tornTotal;
+  return result;
+}
+
+void report(const std::string &name, const Result &r) {
+  std::cout << std::left << std::setw(22) << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(1)
+            << r.nsPerRead << " ns/read" << std::setw(14) << r.writes
+            << " writes" << std::setw(12) << r.torn << " torn" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options o;
+  try {
+    o = parseArgs(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    usage();
+    return 2;
+  }
+
+  std::cout << o.readers << " readers x " << o.reads
+            << " reads against one writer looping flat out" << std::endl;
+
+  SeparateAtomics atomics;
+  report("9 x std::atomic<int>", run(atomics, o));
+  Locked locked;
+  report("std::mutex", run(locked, o));
+  Seqlock<VehicleState> seqlock(stateOf(0));
+  const Result seqlockResult = run(seqlock, o);
+  report("Seqlock", seqlockResult);
+
+  if (seqlockResult.torn != 0) {
+    std::cerr << "Error: Seqlock returned torn snapshots" << std::endl;
+    return 1;
+  }
+  return 0;
+}
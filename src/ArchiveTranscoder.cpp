@@ -0,0 +1,234 @@
+#include "ArchiveTranscoder.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+bool endsWith(const std::string &name, const std::string &suffix) {
+  return name.size() > suffix.size() &&
+         name.compare(name.size() - suffix.size(), suffix.size(), suffix) ==
+             0;
+}
+
+} // namespace
+
+ArchiveTranscoder::ArchiveTranscoder(const std::string &eventDir,
+                                     const ArchiveSettings &settings,
+                                     const SpeedSource &vehicleSpeed,
+                                     ProcessSupervisor *supervisor,
+                                     const BusyCheck &exportsBusy)
+    : eventDir_(eventDir), journalPath_(eventDir + "/archive.journal"),
+      settings_(settings), vehicleSpeed_(vehicleSpeed),
+      supervisor_(supervisor), exportsBusy_(exportsBusy),
+      busyAt_(std::chrono::steady_clock::now()) {
+  // Input validation
+  if (eventDir.empty()) {
+    throw std::invalid_argument("Event directory path cannot be empty");
+  }
+  if (!vehicleSpeed || supervisor == nullptr) {
+    throw std::invalid_argument("ArchiveTranscoder needs a speed source and "
+                                "a ProcessSupervisor");
+  }
+  if (settings.afterDays < 0 || settings.bitrate <= 0 ||
+      settings.height < 0 || settings.encoder.empty()) {
+    throw std::invalid_argument("Invalid archive settings");
+  }
+
+  // Lines are "<file name>\t<bytes before>\t<bytes after>"
+  std::ifstream in(journalPath_);
+  std::string line;
+  std::vector<std::string> kept;
+  bool stale = false;
+  while (std::getline(in, line)) {
+    const auto last = line.rfind('\t');
+    const auto first = last == std::string::npos || last == 0
+                           ? std::string::npos
+                           : line.rfind('\t', last - 1);
+    if (first == std::string::npos) {
+      stale = true; // Torn last line
+      continue;
+    }
+    const std::string name = line.substr(0, first);
+    std::error_code ec;
+    if (!std::filesystem::exists(eventDir_ + "/" + name, ec)) {
+      stale = true; // Evicted by retention meanwhile
+      continue;
+    }
+    processed_[name] = std::strtoull(line.c_str() + last + 1, nullptr, 10);
+    kept.push_back(line);
+  }
+  in.close();
+  if (stale) {
+    const std::string tmpPath = journalPath_ + ".tmp";
+    {
+      std::ofstream out(tmpPath, std::ios::trunc);
+      for (const auto &keptLine : kept) {
+        out << keptLine << "\n";
+      }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, journalPath_, ec);
+  }
+}
+
+uint64_t ArchiveTranscoder::reclaimedBytes() const { return reclaimed_; }
+
+bool ArchiveTranscoder::idle() {
+  const auto now = std::chrono::steady_clock::now();
+  if (vehicleSpeed_() > 0 ||
+      (exportsBusy_ && exportsBusy_())) {
+    busyAt_ = now;
+    return false;
+  }
+  return now - busyAt_ >= std::chrono::seconds(IDLE_SECONDS);
+}
+
+std::vector<std::string> ArchiveTranscoder::dueFiles() const {
+  const auto cutoff = std::filesystem::file_time_type::clock::now() -
+                      std::chrono::hours(24 * settings_.afterDays);
+  std::vector<std::pair<std::filesystem::file_time_type, std::string>> due;
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(eventDir_, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (!entry.is_regular_file(ec) || !endsWith(name, ".mp4") ||
+        endsWith(name, "_temp.mp4") || processed_.count(name)) {
+      continue;
+    }
+    const auto mtime = entry.last_write_time(ec);
+    if (!ec && mtime < cutoff) {
+      due.emplace_back(mtime, entry.path().string());
+    }
+  }
+  std::sort(due.begin(), due.end());
+  std::vector<std::string> paths;
+  for (auto &file : due) {
+    paths.push_back(std::move(file.second));
+  }
+  return paths;
+}
+
+void ArchiveTranscoder::run() {
+  if (settings_.afterDays == 0) {
+    return;
+  }
+  auto &pending = Metrics::instance().value("dacl_archive_pending_files");
+  while (true) {
+    try {
+      const std::vector<std::string> due = dueFiles();
+      pending = static_cast<int64_t>(due.size());
+      for (const auto &path : due) {
+        while (!idle()) {
+          std::this_thread::sleep_for(
+              std::chrono::milliseconds(POLL_INTERVAL_MS));
+        }
+        transcode(path);
+        --pending;
+      }
+    } catch (const std::exception &e) {
+      std::cerr << "Warning: Archive pass failed: " << e.what() << std::endl;
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(SCAN_INTERVAL_SECONDS));
+  }
+}
+
+void ArchiveTranscoder::transcode(const std::string &path) {
+  Metrics &metrics = Metrics::instance();
+  const std::string name = std::filesystem::path(path).filename().string();
+  std::error_code ec;
+  const uint64_t bytesBefore = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return; // Evicted since the scan
+  }
+  const auto mtime = std::filesystem::last_write_time(path, ec);
+
+  // The ".tmp" suffix keeps retention away from the unfinished output
+  const std::string tmpPath = path + ".archive.tmp";
+  std::vector<std::string> argv = {"ffmpeg", "-hide_banner", "-loglevel",
+                                   "error",  "-y",           "-i",
+                                   path,     "-c:v",         settings_.encoder,
+                                   "-b:v",   std::to_string(settings_.bitrate)};
+  if (settings_.encoder == "libx264") {
+    argv.insert(argv.end(), {"-preset", "veryfast"});
+  }
+  if (settings_.height > 0) {
+    argv.insert(argv.end(),
+                {"-vf", "scale=-2:" + std::to_string(settings_.height)});
+  }
+  argv.insert(argv.end(),
+              {"-c:a", "copy", "-movflags", "+faststart", "-f", "mp4",
+               tmpPath});
+  SpawnOptions options;
+  options.job = JOB;
+  ChildProcess child = supervisor_->spawn(argv, options);
+  if (!child) {
+    ++metrics.value("dacl_archive_failures_total");
+    processed_[name] = bytesBefore;
+    return;
+  }
+
+  // Stopped at once when the vehicle moves or an export starts
+  bool paused = false;
+  while (!supervisor_->exited(child)) {
+    const bool idleNow = idle();
+    if (!idleNow && !paused) {
+      supervisor_->pauseJob(JOB);
+      paused = true;
+      ++metrics.value("dacl_archive_pauses_total");
+    } else if (idleNow && paused) {
+      supervisor_->resumeJob(JOB);
+      paused = false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+  }
+  const ProcessResult result = supervisor_->wait(child);
+  const auto cpuMs = static_cast<int64_t>(
+      (result.userSeconds + result.systemSeconds) * 1000);
+  metrics.value("dacl_archive_cpu_ms_total") += cpuMs;
+  const uint64_t bytesAfter = std::filesystem::file_size(tmpPath, ec);
+  bool replaced = false;
+  // Retention may have evicted the event while it was being re-encoded
+  if (result.ok() && !ec && bytesAfter < bytesBefore &&
+      std::filesystem::exists(path, ec)) {
+    std::filesystem::last_write_time(tmpPath, mtime, ec);
+    std::filesystem::rename(tmpPath, path, ec);
+    replaced = !ec;
+  }
+  std::filesystem::remove(tmpPath, ec);
+  if (!result.ok()) {
+    std::cerr << "Warning: Archive transcode failed for " << path
+              << " (exit code: " << result.exitCode << ")" << std::endl;
+    ++metrics.value("dacl_archive_failures_total");
+    processed_[name] = bytesBefore; // Retried after a restart only
+    return;
+  }
+  if (!replaced) {
+    journal(name, bytesBefore, bytesBefore); // Already compact
+    return;
+  }
+  const uint64_t saved = bytesBefore - bytesAfter;
+  reclaimed_ += saved;
+  metrics.value("dacl_archive_reclaimed_bytes_total") +=
+      static_cast<int64_t>(saved);
+  ++metrics.value("dacl_archive_files_total");
+  journal(name, bytesBefore, bytesAfter);
+  std::cerr << "Archived " << path << ": " << bytesBefore / 1024 << " -> "
+            << bytesAfter / 1024 << " KiB, " << cpuMs / 1000 << " s CPU"
+            << std::endl;
+}
+
+void ArchiveTranscoder::journal(const std::string &name, uint64_t bytesBefore,
+                                uint64_t bytesAfter) {
+  processed_[name] = bytesAfter;
+  std::ofstream out(journalPath_, std::ios::app);
+  out << name << "\t" << bytesBefore << "\t" << bytesAfter << "\n";
+  if (!out) {
+    std::cerr << "Warning: Cannot write " << journalPath_ << std::endl;
+  }
+}
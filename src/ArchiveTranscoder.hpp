@@ -0,0 +1,125 @@
+/**
+ * @file ArchiveTranscoder.hpp
+ * @brief Idle-time re-encoding of old event videos to a lower bitrate
+ */
+
+#pragma once
+#include "ProcessSupervisor.hpp"
+#include "utils.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @struct ArchiveSettings
+ * @brief Which event videos are re-encoded, and how
+ */
+struct ArchiveSettings {
+  int afterDays = 0;            ///< Minimum age of a video (0 = disabled)
+  int bitrate = 1500000;        ///< Target video bitrate in bits per second
+  int height = 0;               ///< Output height in pixels (0 = unchanged)
+  std::string encoder = "libx264"; ///< ffmpeg video encoder
+};
+
+/**
+ * @class ArchiveTranscoder
+ * @brief Re-encodes event videos older than a given age while the vehicle is
+ * parked
+ *
+ * This class runs as a background job to:
+ * - Find exported event videos (MP4 files in eventDir) older than afterDays
+ * - Re-encode them one at a time with a supervised ffmpeg job ("archive"),
+ *   replacing the original only if the result is smaller; the modification
+ *   time is kept, so retention still sees the event's age
+ * - Run only while the vehicle has stood still (speed 0) for IDLE_SECONDS
+ *   and no event export is in progress; as soon as either changes, the
+ *   ffmpeg job is stopped (SIGSTOP) within POLL_INTERVAL_MS and continued
+ *   when the vehicle is idle again
+ * - Record every processed file in `<eventDir>/archive.journal`, so files
+ *   are re-encoded only once; failed files are retried after a restart
+ * - Report reclaimed bytes, CPU time, files and pauses in Metrics
+ *
+ * Event bundles are left alone: they keep the original stream and frame
+ * indexes that point into it.
+ *
+ * The thread should run with an idle profile (DEFAULT_THREAD_PROFILE);
+ * ffmpeg inherits its CPU and I/O priority.
+ *
+ * @note Thread Safety: run() owns all state; reclaimedBytes() may be called
+ * from any thread.
+ */
+class ArchiveTranscoder final {
+public:
+  /**
+   * @brief Constructs the transcoder and loads its journal
+   * @param eventDir Directory of exported event videos
+   * @param settings Age limit and encoder settings
+   * @param vehicleSpeed Source of the vehicle speed
+   * @param supervisor Runs, pauses and resumes the ffmpeg jobs
+   * @param exportsBusy Optional predicate reporting running exports
+   * @throws std::invalid_argument if eventDir is empty, vehicleSpeed or
+   * supervisor is missing or a setting is out of range
+   */
+  explicit ArchiveTranscoder(const std::string &eventDir,
+                             const ArchiveSettings &settings,
+                             const SpeedSource &vehicleSpeed,
+                             ProcessSupervisor *supervisor,
+                             const BusyCheck &exportsBusy = nullptr);
+
+  /**
+   * @brief Main loop: scans for due videos and re-encodes them when idle
+   * @note Runs indefinitely; should be executed in a dedicated thread
+   */
+  void run();
+
+  /** @brief Bytes saved by re-encoding since construction */
+  uint64_t reclaimedBytes() const;
+
+  /// Thread profile used for the archive role unless thread_archive is set
+  static constexpr const char *DEFAULT_THREAD_PROFILE =
+      "idle,nice=19,io=idle";
+
+private:
+  /**
+   * @brief True if the vehicle has been parked for IDLE_SECONDS and no
+   * export runs
+   * @note Called by run() only; restarts the idle period when busy
+   */
+  bool idle();
+
+  /** @brief Event videos old enough and not yet processed, oldest first */
+  std::vector<std::string> dueFiles() const;
+
+  /**
+   * @brief Re-encodes one video, pausing the job while the vehicle is busy
+   * @param path Event video to re-encode
+   */
+  void transcode(const std::string &path);
+
+  /** @brief Appends a processed file to the journal */
+  void journal(const std::string &name, uint64_t bytesBefore,
+               uint64_t bytesAfter);
+
+  const std::string eventDir_;        ///< Directory of event videos
+  const std::string journalPath_;     ///< Processed files journal
+  const ArchiveSettings settings_;    ///< Age limit and encoder settings
+  const SpeedSource vehicleSpeed_;      ///< Vehicle speed source
+  ProcessSupervisor *const supervisor_; ///< Runs the ffmpeg jobs
+  const BusyCheck exportsBusy_;         ///< Reports running exports
+  std::map<std::string, uint64_t>
+      processed_; ///< File name -> size after re-encoding or failure
+                  ///< (run() only)
+  std::chrono::steady_clock::time_point
+      busyAt_; ///< Last time the vehicle moved or an export ran
+  std::atomic<uint64_t> reclaimed_{0}; ///< Bytes saved since construction
+
+  static constexpr const char *JOB = "archive"; ///< Supervisor job name
+  static constexpr int IDLE_SECONDS = 60; ///< Standstill before work starts
+  static constexpr int POLL_INTERVAL_MS =
+      50; ///< Speed/export check period while a job runs
+  static constexpr int SCAN_INTERVAL_SECONDS =
+      300; ///< Period of event directory scans
+};
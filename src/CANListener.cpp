@@ -1,33 +1,33 @@
 #include "CANListener.hpp"
+#include "CanFrameRing.hpp"
+#include "Metrics.hpp"
+#include "SignalAccumulator.hpp"
+#include "TimeSync.hpp"
+#include "Tracer.hpp"
 #include "utils.hpp"
 #include <cstring>
+#include <ctime>
 #include <linux/can.h>
 #include <linux/can/raw.h>
 #include <net/if.h>
 #include <stdexcept>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <thread>
 #include <unistd.h>
 
 CANListener::CANListener(const std::string &canIface,
-                         const std::map<int, std::string> &idToWarning)
-    : canIface_(canIface), idToWarning_(idToWarning), newWarning_(false) {
+                         const std::map<int, std::string> &idToWarning,
+                         SignalAccumulator *signals, TimeSync *timeSync,
+                         CanFrameRing *frames)
+    : canIface_(canIface), idToWarning_(idToWarning), newWarning_(false),
+      signals_(signals), timeSync_(timeSync), frames_(frames) {
   // Input validation
   if (canIface.empty()) {
     throw std::invalid_argument("CAN interface name cannot be empty");
   }
 
-  // Initialize atomic variables with default values
-  vehicleSpeed_ = 0;
-  tripMileage_ = 0;
-  totalMileage_ = 0;
-  hour_ = 0;
-  minute_ = 0;
-  second_ = 0;
-  day_ = 1;
-  month_ = 1;
-  year_ = 2024;
 }
 
 void CANListener::run() {
@@ -52,53 +52,155 @@ void CANListener::run() {
     return;
   }
 
+  // Have the kernel report frames dropped because the socket queue was full
+  const int enable = 1;
+  if (setsockopt(s, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) < 0) {
+    perror("setsockopt SO_RXQ_OVFL");
+  }
+  // ...and when each frame arrived, before any scheduling delay
+  if (setsockopt(s, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0) {
+    perror("setsockopt SO_TIMESTAMPNS");
+  }
+  auto &framesReceived = Metrics::instance().value("dacl_can_frames_total");
+  auto &framesDropped = Metrics::instance().value("dacl_can_rx_dropped_total");
+  auto &rxLatency = Metrics::instance().value("dacl_can_rx_latency_us");
+  auto &warnings = Metrics::instance().value("dacl_can_warnings_total");
+  auto &warningsCoalesced =
+      Metrics::instance().value("dacl_can_warnings_coalesced_total");
+  // Working copy; every decoded frame publishes it as a whole
+  VehicleState state = state_.read();
+
   while (true) {
     struct can_frame frame;
-    int nbytes = read(s, &frame, sizeof(frame));
-    if (nbytes > 0) {
-      auto it = idToWarning_.find(frame.can_id);
-      if (it != idToWarning_.end()) {
+    char control[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(timespec))];
+    struct iovec iov = {&frame, sizeof(frame)};
+    struct msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    // Blocks until the next frame; the thread never sleeps with frames queued
+    int nbytes = recvmsg(s, &msg, 0);
+    if (nbytes <= 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      continue;
+    }
+    ++framesReceived;
+    const int64_t nowUs = TimeSync::monotonicMicros();
+    int64_t rxUs = nowUs; // Without a kernel timestamp, the time read
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+        uint32_t dropped = 0;
+        std::memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+        framesDropped = dropped; // Cumulative count kept by the kernel
+      } else if (cmsg->cmsg_level == SOL_SOCKET &&
+                 cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+        timespec ts{};
+        std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+        rxUs = TimeSync::monotonicFromKernel(ts);
+        rxLatency = nowUs - rxUs;
+      }
+    }
+    if (frames_ != nullptr) {
+      frames_->push(frame.can_id, frame.can_dlc, frame.data, rxUs);
+    }
+    auto it = idToWarning_.find(frame.can_id);
+    if (it != idToWarning_.end()) {
+      ++warnings;
+      {
+        TraceScope span("can", "publish_warning");
         std::lock_guard<std::mutex> lk(mtx_);
+        if (newWarning_) {
+          ++warningsCoalesced; // Replaces one not yet taken by a trigger
+        }
         lastWarningType_ = it->second;
+        lastWarningRxUs_ = rxUs;
         newWarning_ = true;
       }
+      if (signals_ != nullptr) {
+        signals_->onWarning(it->second);
+      }
+    }
 
-      // Parse specific signals
-      switch (frame.can_id) {
-      case 0x1A1: // ESC_V_VEH
-        vehicleSpeed_ = extractSignal(frame.data, 16, 16, true, 0.015625,
-                                      0); // Speed in km/h
-        break;
-
-      case 0x3F3: // IC_BORD_COMP_TRIP_A
-        tripMileage_ = extractSignal(frame.data, 32, 17, true, 0.1,
-                                     0); // Trip Mileage in km
-        break;
+    if (!decodeFrame(frame.can_id, frame.data, state)) {
+      continue;
+    }
+    // Date and time, like all other values, become visible together
+    state_.write(state);
+    switch (frame.can_id) {
+    case 0x1A1: // ESC_V_VEH
+      if (signals_ != nullptr) {
+        signals_->onSpeed(state.speed);
+      }
+      break;
 
-      case 0x19D: // IC_Kilometerstand_2
-        totalMileage_ = extractSignal(frame.data, 0, 32, true, 0.001,
-                                      0); // Total Mileage in km
-        break;
+    case 0x19D: // IC_Kilometerstand_2
+      if (signals_ != nullptr) {
+        signals_->onOdometer(state.totalMileage);
+      }
+      break;
 
-      case 0x2F8: // IC_UHRZEIT_DATUM
-        hour_ = extractSignal(frame.data, 0, 8, true, 1.0, 0);    // Hour
-        minute_ = extractSignal(frame.data, 8, 8, true, 1.0, 0);  // Minute
-        second_ = extractSignal(frame.data, 16, 8, true, 1.0, 0); // Second
-        day_ = extractSignal(frame.data, 24, 8, true, 1.0, 0);    // Day
-        month_ = extractSignal(frame.data, 36, 4, true, 1.0, 0);  // Month
-        year_ = extractSignal(frame.data, 40, 16, true, 1.0, 0);  // Year
-        break;
+    case 0x2F8: // IC_UHRZEIT_DATUM
+      if (timeSync_ != nullptr) {
+        std::tm tm{};
+        tm.tm_year = state.year - 1900;
+        tm.tm_mon = state.month - 1;
+        tm.tm_mday = state.day;
+        tm.tm_hour = state.hour;
+        tm.tm_min = state.minute;
+        tm.tm_sec = state.second;
+        // The CAN clock is its own time scale; timegm() just numbers it
+        timeSync_->onCanClock(static_cast<int64_t>(::timegm(&tm)) * 1000000,
+                              rxUs);
       }
+      break;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
   }
   close(s);
 }
 
+bool CANListener::decodeFrame(uint32_t id, const uint8_t *data,
+                              VehicleState &state) {
+  switch (id) {
+  case 0x1A1: // ESC_V_VEH
+    state.speed = extractSignal(data, 16, 16, true, 0.015625,
+                                0); // Speed in km/h
+    return true;
+
+  case 0x3F3: // IC_BORD_COMP_TRIP_A
+    state.tripMileage = extractSignal(data, 32, 17, true, 0.1,
+                                      0); // Trip Mileage in km
+    return true;
+
+  case 0x19D: // IC_Kilometerstand_2
+    state.totalMileage = extractSignal(data, 0, 32, true, 0.001,
+                                       0); // Total Mileage in km
+    return true;
+
+  case 0x2F8: // IC_UHRZEIT_DATUM
+    state.hour = extractSignal(data, 0, 8, true, 1.0, 0);    // Hour
+    state.minute = extractSignal(data, 8, 8, true, 1.0, 0);  // Minute
+    state.second = extractSignal(data, 16, 8, true, 1.0, 0); // Second
+    state.day = extractSignal(data, 24, 8, true, 1.0, 0);    // Day
+    state.month = extractSignal(data, 36, 4, true, 1.0, 0);  // Month
+    state.year = extractSignal(data, 40, 16, true, 1.0, 0);  // Year
+    return true;
+  }
+  return false;
+}
+
 bool CANListener::getLatestWarning(std::string &warningType) {
+  int64_t rxMonotonicUs = 0;
+  return getLatestWarning(warningType, rxMonotonicUs);
+}
+
+bool CANListener::getLatestWarning(std::string &warningType,
+                                   int64_t &rxMonotonicUs) {
   std::lock_guard<std::mutex> lk(mtx_);
   if (newWarning_) {
     warningType = lastWarningType_;
+    rxMonotonicUs = lastWarningRxUs_;
     newWarning_ = false;
     return true;
   }
@@ -106,9 +208,9 @@ bool CANListener::getLatestWarning(std::string &warningType) {
 }
 
 std::string CANListener::getCANBasedTimestamp() const {
+  const VehicleState state = state_.read();
   char buf[32];
-  snprintf(buf, sizeof(buf), "%04d%02d%02d_%02d%02d%02d", year_.load(),
-           month_.load(), day_.load(), hour_.load(), minute_.load(),
-           second_.load());
+  snprintf(buf, sizeof(buf), "%04d%02d%02d_%02d%02d%02d", state.year,
+           state.month, state.day, state.hour, state.minute, state.second);
   return std::string(buf);
 }
\ No newline at end of file
@@ -4,11 +4,34 @@
  */
 
 #pragma once
+#include "Seqlock.hpp"
 #include <atomic>
+#include <cstdint>
 #include <map>
 #include <mutex>
 #include <string>
 
+class CanFrameRing;
+class SignalAccumulator;
+class TimeSync;
+
+/**
+ * @struct VehicleState
+ * @brief Vehicle data and CAN date/time decoded from the bus, published as
+ * one consistent snapshot
+ */
+struct VehicleState {
+  int speed = 0;        ///< Vehicle speed from ESC_V_VEH (0x1A1)
+  int tripMileage = 0;  ///< Trip mileage from Trip_A (0x3F3)
+  int totalMileage = 0; ///< Total mileage from kilometerstand (0x19D)
+  int year = 2024;      ///< Date/time from Uhrzeit_datum (0x2F8)
+  int month = 1;        ///< Month of the CAN date
+  int day = 1;          ///< Day of the CAN date
+  int hour = 0;         ///< Hour of the CAN time
+  int minute = 0;       ///< Minute of the CAN time
+  int second = 0;       ///< Second of the CAN time
+};
+
 /**
  * @class CANListener
  * @brief Handles CAN bus communication for receiving vehicle data and warning
@@ -19,10 +42,17 @@
  * - Listening for warning messages from various vehicle ECUs
  * - Extracting vehicle speed, mileage, and timestamp data
  * - Parsing bit fields from CAN message payloads
- * - Thread-safe access to latest received data
+ * - Thread-safe access to latest received data: the CAN thread publishes
+ *   all decoded values as one VehicleState through a Seqlock, so readers
+ *   never see a date from one frame combined with a time from another
+ * - Feeding decoded signals to a SignalAccumulator for segment summaries
+ * - Kernel receive timestamps (SO_TIMESTAMPNS) for every frame: the CAN
+ *   clock frames feed the TimeSync, and warnings keep the instant they
+ *   arrived rather than when a trigger thread polled them
+ * - Keeping every raw frame in a CanFrameRing for event bundles
  *
- * @note Thread Safety: All getter methods are thread-safe using atomic
- * variables. The run() method should be executed in a separate thread.
+ * @note Thread Safety: All getter methods are thread-safe and lock-free.
+ * The run() method should be executed in a separate thread.
  */
 class CANListener final {
 public:
@@ -31,10 +61,29 @@ public:
    * mappings
    * @param canIface CAN interface name (e.g., "can0")
    * @param idToWarning Map of CAN message IDs to warning type strings
+   * @param signals Optional accumulator receiving speed, odometer and
+   * warning updates (non-owning)
+   * @param timeSync Optional time base receiving the CAN clock frames
+   * (non-owning)
+   * @param frames Optional ring receiving every raw frame (non-owning)
    * @throws std::invalid_argument if canIface is empty
    */
   explicit CANListener(const std::string &canIface,
-                       const std::map<int, std::string> &idToWarning);
+                       const std::map<int, std::string> &idToWarning,
+                       SignalAccumulator *signals = nullptr,
+                       TimeSync *timeSync = nullptr,
+                       CanFrameRing *frames = nullptr);
+
+  /**
+   * @brief Decodes the vehicle signals carried by one frame
+   * @param id CAN identifier
+   * @param data Frame payload (8 bytes)
+   * @param[in,out] state Updated with the decoded values
+   * @return true if the frame carries decoded signals
+   * @note Also used to decode recorded frames, e.g. for event bundles
+   */
+  static bool decodeFrame(uint32_t id, const uint8_t *data,
+                          VehicleState &state);
 
   /**
    * @brief Main loop for CAN message processing
@@ -51,34 +100,39 @@ public:
    */
   bool getLatestWarning(std::string &warningType);
 
+  /**
+   * @brief Retrieves the latest warning message and when it was received
+   * @param[out] warningType The type of warning received
+   * @param[out] rxMonotonicUs CLOCK_MONOTONIC receive time of the frame
+   * @return true if a new warning was available, false otherwise
+   * @note Thread-safe: Can be called from any thread
+   */
+  bool getLatestWarning(std::string &warningType, int64_t &rxMonotonicUs);
+
   /**
    * @brief Generates a timestamp string based on CAN-received time data
    * @return Formatted timestamp string (YYYYMMDD_HHMMSS)
-   * @note Thread-safe: Uses atomic time variables
+   * @note Thread-safe: Formats one consistent snapshot
    */
   std::string getCANBasedTimestamp() const;
 
-  // Time getter methods - all thread-safe using atomic variables
-  /** @brief Get current year from CAN timestamp data */
-  int getYear() const { return year_; }
-  /** @brief Get current month from CAN timestamp data */
-  int getMonth() const { return month_; }
-  /** @brief Get current day from CAN timestamp data */
-  int getDay() const { return day_; }
-  /** @brief Get current hour from CAN timestamp data */
-  int getHour() const { return hour_; }
-  /** @brief Get current minute from CAN timestamp data */
-  int getMinute() const { return minute_; }
-  /** @brief Get current second from CAN timestamp data */
-  int getSecond() const { return second_; }
+  /**
+   * @brief Returns all decoded values as one consistent snapshot
+   * @note Thread-safe and lock-free; use this rather than several getters
+   * when values must belong together (e.g. date and time)
+   */
+  VehicleState getVehicleState() const { return state_.read(); }
 
-  // Vehicle data getter methods - all thread-safe using atomic variables
+  // Single-value getters - each reads its own snapshot
   /** @brief Get current vehicle speed in appropriate units from ESC_V_VEH */
-  int getVehicleSpeed() const { return vehicleSpeed_; }
+  int getVehicleSpeed() const { return state_.read().speed; }
   /** @brief Get trip mileage from Trip_A */
-  int getTripMileage() const { return tripMileage_; }
+  int getTripMileage() const { return state_.read().tripMileage; }
   /** @brief Get total odometer reading from kilometerstand */
-  int getTotalMileage() const { return totalMileage_; }
+  int getTotalMileage() const { return state_.read().totalMileage; }
+
+  /** @brief CAN interface name */
+  const std::string &canInterface() const { return canIface_; }
 
 private:
   std::string canIface_; ///< CAN interface name
@@ -88,13 +142,10 @@ private:
   std::atomic<bool> newWarning_; ///< Flag indicating new warning available
   std::string
       lastWarningType_; ///< Most recent warning type (protected by mtx_)
+  int64_t lastWarningRxUs_ = 0; ///< Its receive time (protected by mtx_)
+  SignalAccumulator *const signals_; ///< Segment summary sink, or nullptr
+  TimeSync *const timeSync_;         ///< CAN clock sink, or nullptr
+  CanFrameRing *const frames_;       ///< Raw frame history, or nullptr
 
-  // Vehicle data - atomic for thread-safe access
-  std::atomic<int> vehicleSpeed_; ///< Vehicle speed from ESC_V_VEH (0x1A1)
-  std::atomic<int> tripMileage_;  ///< Trip mileage from Trip_A (0x3F4)
-  std::atomic<int> totalMileage_; ///< Total mileage from kilometerstand (0x19D)
-
-  // Time data - atomic for thread-safe access
-  std::atomic<int> hour_, minute_, second_, day_, month_,
-      year_; ///< Time/date from Uhrzeit_datum (0x2F8)
+  Seqlock<VehicleState> state_; ///< Decoded values, written by run() only
 };
\ No newline at end of file
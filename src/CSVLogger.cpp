@@ -1,22 +1,197 @@
 #include "CSVLogger.hpp"
-#include <fstream>
+#include "Tracer.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
 
-CSVLogger::CSVLogger(const std::string &csvFile) : csvFile_(csvFile) {}
+namespace {
+
+/// Quotes a CSV field if it contains a separator, quote or newline
+std::string csvField(const std::string &value) {
+  if (value.find_first_of(",\"\n") == std::string::npos) {
+    return value;
+  }
+  std::string quoted = "\"";
+  for (char c : value) {
+    if (c == '"') {
+      quoted += '"';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+bool writeAll(int fd, const std::string &data) {
+  size_t done = 0;
+  while (done < data.size()) {
+    const ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+} // namespace
+
+CSVLogger::CSVLogger(const std::string &csvFile, const std::string &indexFile)
+    : csvFile_(csvFile), index_(indexFile) {
+  if (csvFile.empty()) {
+    throw std::invalid_argument("CSV log path cannot be empty");
+  }
+  csvFd_ = ::open(csvFile.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                  0644);
+  if (csvFd_ < 0) {
+    throw std::runtime_error("Cannot open event log " + csvFile + ": " +
+                             std::strerror(errno));
+  }
+  try {
+    ensureHeaderExists();
+  } catch (...) {
+    ::close(csvFd_);
+    throw;
+  }
+  writer_ = std::thread(&CSVLogger::writerLoop, this);
+}
+
+CSVLogger::~CSVLogger() {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    stopping_ = true;
+  }
+  queued_.notify_one();
+  writer_.join();
+  ::close(csvFd_);
+}
+
+void CSVLogger::ensureHeaderExists() {
+  struct stat st {};
+  if (::fstat(csvFd_, &st) != 0) {
+    throw std::runtime_error("Cannot stat event log " + csvFile_);
+  }
+  csvSize_ = static_cast<uint64_t>(st.st_size);
+  if (csvSize_ > 0) {
+    return;
+  }
+  const std::string header = "Timestamp,TriggerType,WarningType,Speed,"
+                             "PreTriggerFiles,PostTriggerFile\n";
+  if (!writeAll(csvFd_, header) || ::fdatasync(csvFd_) != 0) {
+    throw std::runtime_error("Cannot write event log header to " + csvFile_);
+  }
+  csvSize_ = header.size();
+}
 
 void CSVLogger::logEvent(const std::string &timestamp,
                          const std::string &triggerType,
                          const std::string &warningType, int speed,
-                         const std::vector<std::string> &preFiles,
+                         const std::vector<SegmentHandle> &preFiles,
                          const std::string &postFile) {
-  std::ofstream csv(csvFile_, std::ios::app);
-  if (!csv.is_open()) {
-    return;
+  TraceScope span("csv", "log_event");
+  std::string pre;
+  for (const auto &f : preFiles) {
+    pre += (pre.empty() ? "" : ",") + f.path();
+  }
+  std::ostringstream line;
+  line << csvField(timestamp) << "," << csvField(triggerType) << ","
+       << csvField(warningType) << "," << speed << "," << csvField(pre) << ","
+       << csvField(postFile) << "\n";
+
+  PendingEvent event{line.str(), EventRecord{}};
+  event.record.time = packTimestamp(timestamp);
+  event.record.speed = speed;
+  setRecordText(event.record.trigger, sizeof(event.record.trigger),
+                triggerType);
+  setRecordText(event.record.warning, sizeof(event.record.warning),
+                warningType);
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    queue_.push_back(std::move(event));
+    ++enqueued_;
+  }
+  queued_.notify_one();
+}
+
+bool CSVLogger::flush() {
+  TraceScope span("csv", "flush");
+  std::unique_lock<std::mutex> lk(mtx_);
+  const uint64_t target = enqueued_;
+  durable_.wait(lk, [&] { return committed_ >= target; });
+  const bool ok = !failed_;
+  failed_ = false;
+  return ok;
+}
+
+void CSVLogger::writerLoop() {
+  std::unique_lock<std::mutex> lk(mtx_);
+  while (true) {
+    queued_.wait(lk, [this] { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return; // Stopping with nothing left to write
+    }
+    // Give concurrent triggers a moment to join this batch
+    if (!stopping_) {
+      queued_.wait_for(lk, std::chrono::milliseconds(GROUP_COMMIT_MS),
+                       [this] {
+                         return stopping_ || queue_.size() >= MAX_BATCH;
+                       });
+    }
+
+    std::vector<PendingEvent> batch;
+    while (!queue_.empty() && batch.size() < MAX_BATCH) {
+      batch.push_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+    lk.unlock();
+    const bool ok = commit(batch);
+    lk.lock();
+
+    if (!ok) {
+      failed_ = true;
+      std::cerr << "Error: Failed to commit " << batch.size()
+                << " events to " << csvFile_ << std::endl;
+    }
+    committed_ += batch.size();
+    durable_.notify_all();
   }
+}
 
-  csv << timestamp << "," << triggerType << "," << warningType << "," << speed
-      << ",";
-  for (const auto &f : preFiles)
-    csv << f << ";";
-  csv << "," << postFile << "\n";
-}
\ No newline at end of file
+bool CSVLogger::commit(std::vector<PendingEvent> &batch) {
+  TraceScope span("csv", "commit"); // Two fdatasync() calls
+  std::string lines;
+  std::vector<EventRecord> records;
+  records.reserve(batch.size());
+  for (auto &event : batch) {
+    event.record.csvOffset = csvSize_ + lines.size();
+    event.record.csvLength = static_cast<uint32_t>(event.line.size());
+    lines += event.line;
+    records.push_back(event.record);
+  }
+
+  // The CSV is synced first so the index never points past its end
+  if (!writeAll(csvFd_, lines) || ::fdatasync(csvFd_) != 0) {
+    std::perror("write event log");
+    // Resynchronize the line offsets after a short write
+    struct stat st {};
+    if (::fstat(csvFd_, &st) == 0) {
+      csvSize_ = static_cast<uint64_t>(st.st_size);
+    }
+    return false;
+  }
+  csvSize_ += lines.size();
+  if (!index_.append(records) || !index_.sync()) {
+    std::perror("write event index");
+    return false;
+  }
+  return true;
+}
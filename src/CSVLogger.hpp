@@ -4,7 +4,14 @@
  */
 
 #pragma once
+#include "EventIndex.hpp"
+#include "Segment.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 /**
@@ -16,19 +23,33 @@
  * - Maintains CSV format for easy analysis and processing
  * - Thread-safe logging operations for concurrent access
  * - Automatic header generation and file management
+ * - A binary EventIndex next to the CSV file for fast queries (dacl-query)
  *
  * CSV format includes: timestamp, trigger type, warning type, speed,
  * pre-trigger files, post-trigger files, and additional metadata.
+ *
+ * logEvent() only queues the event. A writer thread keeps the log open,
+ * gathers everything queued within GROUP_COMMIT_MS into one batch and makes
+ * it durable with a single fdatasync() per file (group commit).
  */
 class CSVLogger final {
 public:
   /**
    * @brief Constructs a CSVLogger for the specified CSV file
    * @param csvFile Path to CSV log file (will be created if it doesn't exist)
-   * @throws std::invalid_argument if csvFile path is empty
-   * @throws std::runtime_error if file cannot be opened for writing
+   * @param indexFile Path to the binary event index (will be created if it
+   * doesn't exist)
+   * @throws std::invalid_argument if csvFile or indexFile path is empty
+   * @throws std::runtime_error if a file cannot be opened for writing
    */
-  explicit CSVLogger(const std::string &csvFile);
+  explicit CSVLogger(const std::string &csvFile,
+                     const std::string &indexFile);
+
+  /** @brief Flushes all queued events and stops the writer thread */
+  ~CSVLogger();
+
+  CSVLogger(const CSVLogger &) = delete;
+  CSVLogger &operator=(const CSVLogger &) = delete;
 
   /**
    * @brief Logs a trigger event with comprehensive metadata
@@ -36,23 +57,61 @@ public:
    * @param triggerType Source of trigger ("CAN", "GPIO", "Console")
    * @param warningType Type of warning or event
    * @param speed Vehicle speed at time of event
-   * @param preFiles List of pre-trigger video files saved
+   * @param preFiles Handles of the pre-trigger video files saved
    * @param postFile Post-trigger video file saved
-   * @throws std::runtime_error if logging operation fails
    *
-   * @note This method is thread-safe and can be called concurrently
+   * @note This method is thread-safe and can be called concurrently. It
+   * returns once the event is queued; use flush() to wait for durability.
    */
   void logEvent(const std::string &timestamp, const std::string &triggerType,
                 const std::string &warningType, int speed,
-                const std::vector<std::string> &preFiles,
+                const std::vector<SegmentHandle> &preFiles,
                 const std::string &postFile);
 
+  /**
+   * @brief Blocks until every event queued so far is on stable storage
+   * @return true if all of them were written and synced
+   */
+  bool flush();
+
 private:
+  /// Event formatted by logEvent(), waiting for the writer thread
+  struct PendingEvent {
+    std::string line;   ///< CSV line including the newline
+    EventRecord record; ///< Index record (CSV offset filled in on write)
+  };
+
   const std::string csvFile_; ///< Path to CSV log file
+  int csvFd_ = -1;            ///< CSV log opened for appending
+  uint64_t csvSize_ = 0;      ///< Current CSV size, i.e. next line offset
+  EventIndexWriter index_;    ///< Binary index of the CSV lines
+
+  std::mutex mtx_;                  ///< Guards the queue and counters
+  std::condition_variable queued_;  ///< Signals the writer thread
+  std::condition_variable durable_; ///< Signals flush() callers
+  std::deque<PendingEvent> queue_;  ///< Events not yet written
+  uint64_t enqueued_ = 0;           ///< Events ever queued
+  uint64_t committed_ = 0;          ///< Events written and synced
+  bool failed_ = false;             ///< A batch failed since the last flush
+  bool stopping_ = false;           ///< Destructor requested shutdown
+  std::thread writer_;              ///< Group-commit writer thread
 
   /**
    * @brief Ensures CSV file exists with proper header
    * @throws std::runtime_error if file operations fail
    */
   void ensureHeaderExists();
-};
\ No newline at end of file
+
+  /** @brief Writer thread: batches queued events and commits them */
+  void writerLoop();
+
+  /**
+   * @brief Appends a batch to the CSV file and index and syncs both
+   * @return true on success
+   */
+  bool commit(std::vector<PendingEvent> &batch);
+
+  static constexpr int GROUP_COMMIT_MS =
+      100; ///< Time to gather further events into a batch
+  static constexpr size_t MAX_BATCH = 256; ///< Events per batch at most
+};
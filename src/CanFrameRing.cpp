@@ -0,0 +1,224 @@
+#include "CanFrameRing.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <linux/can.h>
+#include <new>
+#include <stdexcept>
+
+// A ring in shared memory is read by another process
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "CAN frame ring atomics must be address-free");
+
+CanFrameRing::CanFrameRing(size_t capacity)
+    : CanFrameRing(capacity, nullptr, false) {}
+
+CanFrameRing::CanFrameRing(size_t capacity, void *storage, bool existing)
+    : capacity_(capacity), pushed_(nullptr), slots_(nullptr) {
+  if (capacity == 0) {
+    throw std::invalid_argument("CAN frame ring capacity must be positive");
+  }
+  if (storage == nullptr) {
+    if (existing) {
+      throw std::invalid_argument("CAN frame ring storage cannot be null");
+    }
+    owned_.reset(new uint64_t[storageBytes(capacity) / sizeof(uint64_t)]);
+    storage = owned_.get();
+  }
+  auto *base = static_cast<unsigned char *>(storage);
+  if (existing) {
+    pushed_ = reinterpret_cast<std::atomic<uint64_t> *>(base);
+    slots_ = reinterpret_cast<Seqlock<CanFrameRecord> *>(base + SLOTS_OFFSET);
+    return;
+  }
+  pushed_ = new (base) std::atomic<uint64_t>(0);
+  slots_ = reinterpret_cast<Seqlock<CanFrameRecord> *>(base + SLOTS_OFFSET);
+  for (size_t i = 0; i < capacity; ++i) {
+    new (&slots_[i]) Seqlock<CanFrameRecord>();
+  }
+}
+
+size_t CanFrameRing::storageBytes(size_t capacity) {
+  return SLOTS_OFFSET + capacity * sizeof(Seqlock<CanFrameRecord>);
+}
+
+void CanFrameRing::push(uint32_t id, uint8_t dlc, const uint8_t *data,
+                        int64_t rxUs) {
+  CanFrameRecord record;
+  record.sequence = pushed_->load(std::memory_order_relaxed) + 1;
+  record.rxUs = rxUs;
+  record.id = id;
+  record.dlc = std::min<uint8_t>(dlc, sizeof(record.data));
+  std::memcpy(record.data, data, record.dlc);
+  slots_[(record.sequence - 1) % capacity_].write(record);
+  pushed_->store(record.sequence, std::memory_order_release);
+}
+
+std::vector<CanFrameRecord> CanFrameRing::snapshot(int64_t fromUs,
+                                                   int64_t toUs) const {
+  std::vector<CanFrameRecord> frames;
+  const uint64_t last = pushed_->load(std::memory_order_acquire);
+  const uint64_t first = last > capacity_ ? last - capacity_ + 1 : 1;
+  for (uint64_t sequence = first; sequence <= last; ++sequence) {
+    const CanFrameRecord record = slots_[(sequence - 1) % capacity_].read();
+    // A newer frame took the slot while we were copying
+    if (record.sequence != sequence) {
+      continue;
+    }
+    if (record.rxUs >= fromUs && record.rxUs <= toUs) {
+      frames.push_back(record);
+    }
+  }
+  return frames;
+}
+
+uint64_t CanFrameRing::readSince(uint64_t afterSequence,
+                                 std::vector<CanFrameRecord> &frames) const {
+  const uint64_t last = pushed_->load(std::memory_order_acquire);
+  const uint64_t oldest = last > capacity_ ? last - capacity_ + 1 : 1;
+  uint64_t lost = 0;
+  uint64_t first = afterSequence + 1;
+  if (first < oldest) {
+    lost = oldest - first;
+    first = oldest;
+  }
+  for (uint64_t sequence = first; sequence <= last; ++sequence) {
+    const CanFrameRecord record = slots_[(sequence - 1) % capacity_].read();
+    if (record.sequence != sequence) {
+      ++lost; // Overwritten while we were copying
+      continue;
+    }
+    frames.push_back(record);
+  }
+  return lost;
+}
+
+std::string formatCandump(const std::vector<CanFrameRecord> &frames,
+                          const std::string &iface, int64_t systemOffsetUs) {
+  std::string out;
+  out.reserve(frames.size() * 48);
+  char line[96];
+  for (const auto &frame : frames) {
+    const int64_t us = frame.rxUs + systemOffsetUs;
+    const bool extended = (frame.id & CAN_EFF_FLAG) != 0;
+    const char *format =
+        extended ? "(%lld.%06lld) %s %08X#" : "(%lld.%06lld) %s %03X#";
+    int n = std::snprintf(line, sizeof(line), format,
+                          static_cast<long long>(us / 1000000),
+                          static_cast<long long>(us % 1000000), iface.c_str(),
+                          frame.id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK));
+    if (n < 0) {
+      continue;
+    }
+    if (frame.id & CAN_RTR_FLAG) {
+      line[n++] = 'R';
+    } else {
+      for (uint8_t i = 0; i < frame.dlc; ++i) {
+        n += std::snprintf(line + n, sizeof(line) - n, "%02X", frame.data[i]);
+      }
+    }
+    line[n++] = '\n';
+    out.append(line, static_cast<size_t>(n));
+  }
+  return out;
+}
+
+namespace {
+
+int hexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+} // namespace
+
+bool parseCandump(const char *&cursor, const char *end,
+                  CanFrameRecord &frame) {
+  const char *p = cursor;
+  const char *eol = static_cast<const char *>(
+      std::memchr(p, '\n', static_cast<size_t>(end - p)));
+  if (eol == nullptr) {
+    eol = end;
+  }
+  cursor = eol < end ? eol + 1 : end;
+
+  // "(seconds.micros)"
+  if (p == eol || *p++ != '(') {
+    return false;
+  }
+  int64_t seconds = 0;
+  const char *digits = p;
+  while (p < eol && *p >= '0' && *p <= '9') {
+    seconds = seconds * 10 + (*p++ - '0');
+  }
+  if (p == digits || p == eol || *p++ != '.') {
+    return false;
+  }
+  int64_t micros = 0;
+  int fractionDigits = 0;
+  while (p < eol && *p >= '0' && *p <= '9') {
+    if (fractionDigits++ < 6) {
+      micros = micros * 10 + (*p - '0');
+    }
+    ++p;
+  }
+  for (int i = fractionDigits; i < 6; ++i) {
+    micros *= 10;
+  }
+  if (p == eol || *p++ != ')') {
+    return false;
+  }
+  frame.rxUs = seconds * 1000000 + micros;
+
+  // " iface "
+  while (p < eol && *p == ' ') {
+    ++p;
+  }
+  while (p < eol && *p != ' ') {
+    ++p;
+  }
+  while (p < eol && *p == ' ') {
+    ++p;
+  }
+
+  // "id#" - eight digits make an extended identifier
+  uint32_t id = 0;
+  const char *idStart = p;
+  int digit = 0;
+  while (p < eol && (digit = hexDigit(*p)) >= 0) {
+    id = (id << 4) | static_cast<uint32_t>(digit);
+    ++p;
+  }
+  const ptrdiff_t idDigits = p - idStart;
+  if (idDigits == 0 || idDigits > 8 || p == eol || *p++ != '#') {
+    return false;
+  }
+  frame.id = idDigits == 8 ? (id & CAN_EFF_MASK) | CAN_EFF_FLAG : id;
+
+  // "data", "R" (remote frame) or "#flags data" (CAN FD)
+  frame.dlc = 0;
+  std::memset(frame.data, 0, sizeof(frame.data));
+  if (p < eol && *p == 'R') {
+    frame.id |= CAN_RTR_FLAG;
+    return true;
+  }
+  if (p < eol && *p == '#') {
+    p += 2; // '#' and the flags nibble
+  }
+  while (p + 1 < eol && hexDigit(p[0]) >= 0 && hexDigit(p[1]) >= 0) {
+    if (frame.dlc < sizeof(frame.data)) {
+      frame.data[frame.dlc++] =
+          static_cast<uint8_t>(hexDigit(p[0]) << 4 | hexDigit(p[1]));
+    }
+    p += 2;
+  }
+  return p >= eol || *p == ' ' || *p == '\r';
+}
@@ -0,0 +1,138 @@
+/**
+ * @file CanFrameRing.hpp
+ * @brief In-memory history of raw CAN frames for event export
+ */
+
+#pragma once
+#include "Seqlock.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @struct CanFrameRecord
+ * @brief One received CAN frame with its receive time
+ */
+struct CanFrameRecord {
+  uint64_t sequence = 0; ///< Number of the frame since startup, from 1
+  int64_t rxUs = 0;      ///< CLOCK_MONOTONIC receive time
+  uint32_t id = 0;       ///< CAN identifier including the EFF/RTR/ERR flags
+  uint8_t dlc = 0;       ///< Payload length
+  uint8_t data[8] = {};  ///< Payload
+};
+
+/**
+ * @class CanFrameRing
+ * @brief Fixed-capacity ring of the most recently received CAN frames
+ *
+ * The CAN thread appends every frame; event export copies out the frames of
+ * a time window. Each slot is a Seqlock, so appending never blocks or
+ * allocates, and a reader skips slots that were overwritten while it was
+ * copying.
+ *
+ * The ring can also be laid out in memory provided by the caller; the
+ * capture daemon places it in the pipeline's shared memory, so that the
+ * event processor can read the frames of an event window from its own
+ * process.
+ *
+ * @note Thread Safety: push() must only be called from one thread (the CAN
+ * thread); snapshot() can be called from any thread.
+ */
+class CanFrameRing final {
+public:
+  /**
+   * @brief Allocates the ring
+   * @param capacity Number of frames kept
+   * @throws std::invalid_argument if capacity is 0
+   */
+  explicit CanFrameRing(size_t capacity);
+
+  /**
+   * @brief Lays the ring out in memory owned by the caller
+   * @param capacity Number of frames kept
+   * @param storage storageBytes(capacity) bytes, 8-byte aligned, e.g. a
+   * shared-memory mapping; must outlive the ring
+   * @param existing Use the ring another process has laid out in storage
+   * instead of initializing it; such a ring must only be read
+   * @throws std::invalid_argument if capacity is 0 or storage is nullptr
+   */
+  CanFrameRing(size_t capacity, void *storage, bool existing);
+
+  CanFrameRing(const CanFrameRing &) = delete;
+  CanFrameRing &operator=(const CanFrameRing &) = delete;
+
+  /**
+   * @brief Appends a frame, overwriting the oldest one when full
+   * @param id CAN identifier
+   * @param dlc Payload length (at most 8)
+   * @param data Payload
+   * @param rxUs CLOCK_MONOTONIC receive time
+   */
+  void push(uint32_t id, uint8_t dlc, const uint8_t *data, int64_t rxUs);
+
+  /**
+   * @brief Copies the frames received in a time window
+   * @param fromUs First CLOCK_MONOTONIC receive time included
+   * @param toUs Last CLOCK_MONOTONIC receive time included
+   * @return Frames in receive order; frames already overwritten are missing
+   */
+  std::vector<CanFrameRecord> snapshot(int64_t fromUs, int64_t toUs) const;
+
+  /**
+   * @brief Copies the frames appended after a given one
+   * @param afterSequence Sequence number of the last frame already read
+   * @param[out] frames Receives the newer frames in receive order
+   * @return Number of newer frames that were overwritten before they could
+   * be copied
+   * @note Only visits the new slots, so it suits periodic draining
+   */
+  uint64_t readSince(uint64_t afterSequence,
+                     std::vector<CanFrameRecord> &frames) const;
+
+  /** @brief Sequence number of the newest frame (0 = none yet) */
+  uint64_t lastSequence() const {
+    return pushed_->load(std::memory_order_acquire);
+  }
+
+  /** @brief Number of frames kept */
+  size_t capacity() const { return capacity_; }
+
+  /** @brief Bytes of storage a ring of capacity frames occupies */
+  static size_t storageBytes(size_t capacity);
+
+private:
+  /// Offset of the slots in the storage, after the append counter
+  static constexpr size_t SLOTS_OFFSET = 64;
+
+  const size_t capacity_;            ///< Number of slots
+  std::unique_ptr<uint64_t[]> owned_; ///< Storage allocated by the ring, or
+                                      ///< nullptr if provided by the caller
+  std::atomic<uint64_t> *pushed_;    ///< Frames appended so far
+  Seqlock<CanFrameRecord> *slots_;   ///< Frame n at n % size
+};
+
+/**
+ * @brief Formats frames in the candump log format ("(time) iface id#data")
+ * @param frames Frames to format
+ * @param iface Interface name written on every line
+ * @param systemOffsetUs System time minus CLOCK_MONOTONIC, added to the
+ * receive times
+ * @return One line per frame; can-utils' canplayer replays it
+ */
+std::string formatCandump(const std::vector<CanFrameRecord> &frames,
+                          const std::string &iface, int64_t systemOffsetUs);
+
+/**
+ * @brief Parses one line of a candump log ("(time) iface id#data")
+ * @param[in,out] cursor Start of the line; advanced past its newline
+ * @param end End of the log text
+ * @param[out] frame The frame; rxUs is the logged time in microseconds
+ * @return false if the line is not a CAN frame (cursor is still advanced)
+ * @note Accepts formatCandump() output and candump -l logs, including
+ * remote frames and CAN FD frames (whose first 8 bytes are kept)
+ */
+bool parseCandump(const char *&cursor, const char *end,
+                  CanFrameRecord &frame);
@@ -0,0 +1,124 @@
+#include "CanTraceWriter.hpp"
+#include "Metrics.hpp"
+#include "TimeSync.hpp"
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+CanTraceWriter::CanTraceWriter(const std::string &traceDir,
+                               const CanFrameRing *frames,
+                               const std::string &iface, int rotateMinutes,
+                               int keepDays)
+    : traceDir_(traceDir), frames_(frames), iface_(iface),
+      rotateMinutes_(rotateMinutes), keepDays_(keepDays) {
+  // Input validation
+  if (traceDir.empty()) {
+    throw std::invalid_argument("CAN trace directory cannot be empty");
+  }
+  if (frames == nullptr) {
+    throw std::invalid_argument("CAN trace writer needs a frame ring");
+  }
+  if (rotateMinutes <= 0) {
+    throw std::invalid_argument("CAN trace rotation must be positive");
+  }
+  if (keepDays < 0) {
+    throw std::invalid_argument("CAN trace retention cannot be negative");
+  }
+}
+
+CanTraceWriter::~CanTraceWriter() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+  }
+}
+
+void CanTraceWriter::run() {
+  Metrics &metrics = Metrics::instance();
+  auto &framesWritten = metrics.value("dacl_can_trace_frames_total");
+  auto &framesLost = metrics.value("dacl_can_trace_lost_total");
+  auto &bytesWritten = metrics.value("dacl_can_trace_bytes_total");
+
+  std::error_code ec;
+  std::filesystem::create_directories(traceDir_, ec);
+  if (ec) {
+    std::cerr << "Warning: Cannot create " << traceDir_ << ": "
+              << ec.message() << std::endl;
+  }
+
+  // Frames from before startup are not part of the trace
+  uint64_t lastSequence = frames_->lastSequence();
+  std::vector<CanFrameRecord> frames;
+  rotate();
+
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+    if (std::chrono::steady_clock::now() - opened_ >=
+        std::chrono::minutes(rotateMinutes_)) {
+      rotate();
+    }
+
+    framesLost +=
+        static_cast<int64_t>(frames_->readSince(lastSequence, frames));
+    if (frames.empty()) {
+      continue;
+    }
+    lastSequence = frames.back().sequence;
+    if (file_ != nullptr) {
+      const std::string text =
+          formatCandump(frames, iface_, TimeSync::systemFromMonotonic(0));
+      if (std::fwrite(text.data(), 1, text.size(), file_) != text.size() ||
+          std::fflush(file_) != 0) {
+        std::cerr << "Warning: CAN trace write failed" << std::endl;
+        std::fclose(file_);
+        file_ = nullptr; // Retried with a new file at the next rotation
+      } else {
+        framesWritten += static_cast<int64_t>(frames.size());
+        bytesWritten += static_cast<int64_t>(text.size());
+      }
+    }
+    frames.clear();
+  }
+}
+
+void CanTraceWriter::rotate() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+  opened_ = std::chrono::steady_clock::now();
+  removeExpired();
+
+  const std::time_t now = std::time(nullptr);
+  std::tm tm{};
+  localtime_r(&now, &tm);
+  char name[40];
+  std::strftime(name, sizeof(name), "can_%Y%m%d_%H%M%S.log", &tm);
+  const std::string path = traceDir_ + "/" + name;
+  file_ = std::fopen(path.c_str(), "ae");
+  if (file_ == nullptr) {
+    std::cerr << "Warning: Cannot open CAN trace " << path << std::endl;
+  }
+}
+
+void CanTraceWriter::removeExpired() const {
+  if (keepDays_ == 0) {
+    return;
+  }
+  const auto limit = std::filesystem::file_time_type::clock::now() -
+                     std::chrono::hours(24) * keepDays_;
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(traceDir_, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (!entry.is_regular_file(ec) || name.compare(0, 4, "can_") != 0 ||
+        entry.path().extension() != ".log") {
+      continue;
+    }
+    if (entry.last_write_time(ec) < limit && !ec) {
+      std::filesystem::remove(entry.path(), ec);
+    }
+  }
+}
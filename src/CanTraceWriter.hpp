@@ -0,0 +1,73 @@
+/**
+ * @file CanTraceWriter.hpp
+ * @brief Continuous candump log of all CAN traffic for offline reprocessing
+ */
+
+#pragma once
+#include "CanFrameRing.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * @class CanTraceWriter
+ * @brief Drains the CanFrameRing into rotating candump log files
+ *
+ * This class runs as a background job to:
+ * - Append every frame received since the last flush to
+ *   `<traceDir>/can_YYYYMMDD_HHMMSS.log` once per FLUSH_INTERVAL_MS, in the
+ *   candump log format that dacl-reprocess and canplayer read
+ * - Start a new file every rotateMinutes, named by its local start time
+ * - Delete trace files older than keepDays after each rotation
+ * - Count frames overwritten in the ring before they were written, which
+ *   happens only if the ring holds less than a flush interval of traffic
+ *
+ * Reading the ring never blocks the CAN thread.
+ *
+ * @note Thread Safety: run() owns all state.
+ */
+class CanTraceWriter final {
+public:
+  /**
+   * @brief Constructs the writer
+   * @param traceDir Directory of the trace files (created if missing)
+   * @param frames Ring filled by the CANListener (non-owning)
+   * @param iface CAN interface name written on every line
+   * @param rotateMinutes Minutes per trace file
+   * @param keepDays Days trace files are kept (0 = forever)
+   * @throws std::invalid_argument if traceDir is empty, frames is nullptr or
+   * a limit is out of range
+   */
+  explicit CanTraceWriter(const std::string &traceDir,
+                          const CanFrameRing *frames, const std::string &iface,
+                          int rotateMinutes, int keepDays);
+  ~CanTraceWriter();
+
+  CanTraceWriter(const CanTraceWriter &) = delete;
+  CanTraceWriter &operator=(const CanTraceWriter &) = delete;
+
+  /**
+   * @brief Main loop writing the trace
+   * @note Runs indefinitely; should be executed in a dedicated thread
+   */
+  void run();
+
+private:
+  /** @brief Closes the current file and opens a new one */
+  void rotate();
+
+  /** @brief Deletes trace files older than keepDays */
+  void removeExpired() const;
+
+  const std::string traceDir_;       ///< Directory of the trace files
+  const CanFrameRing *const frames_; ///< Frame source
+  const std::string iface_;          ///< Interface name in the log
+  const int rotateMinutes_;          ///< Minutes per file
+  const int keepDays_;               ///< Retention in days (0 = forever)
+  std::FILE *file_ = nullptr;        ///< Current trace file
+  std::chrono::steady_clock::time_point opened_; ///< When file_ was opened
+
+  static constexpr int FLUSH_INTERVAL_MS =
+      1000; ///< Period of draining the ring
+};
@@ -0,0 +1,628 @@
+#include "CopyEngine.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/io_uring.h>
+#include <memory>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+size_t roundUp(size_t value, size_t align) {
+  return (value + align - 1) / align * align;
+}
+
+/// Source and destination descriptors of one copy
+struct OpenFiles {
+  int in = -1;           ///< Source descriptor
+  int out = -1;          ///< Destination descriptor
+  uint64_t size = 0;     ///< Source size when opened
+  bool outDirect = false; ///< Destination opened with O_DIRECT
+};
+
+/// Opens both ends of a copy; O_DIRECT is dropped where unsupported
+int openFiles(const std::string &source, const std::string &dest,
+              bool direct, OpenFiles &files) {
+  const int directFlag = direct ? O_DIRECT : 0;
+  files.in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC | directFlag);
+  if (files.in < 0 && errno == EINVAL && direct) {
+    files.in = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+  if (files.in < 0) {
+    return errno;
+  }
+  struct stat st {};
+  if (::fstat(files.in, &st) != 0) {
+    const int err = errno;
+    ::close(files.in);
+    return err;
+  }
+  files.size = static_cast<uint64_t>(st.st_size);
+  const int outFlags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  const mode_t mode = st.st_mode & 0777;
+  files.out = ::open(dest.c_str(), outFlags | directFlag, mode);
+  files.outDirect = files.out >= 0 && direct;
+  if (files.out < 0 && errno == EINVAL && direct) {
+    files.out = ::open(dest.c_str(), outFlags, mode);
+  }
+  if (files.out < 0) {
+    const int err = errno;
+    ::close(files.in);
+    return err;
+  }
+  return 0;
+}
+
+/// Closes a finished copy; a failed destination is removed
+int closeFiles(const std::string &dest, OpenFiles &files, int error) {
+  // Whole-block O_DIRECT writes may overshoot the end of the file
+  if (error == 0 && files.outDirect &&
+      ::ftruncate(files.out, static_cast<off_t>(files.size)) != 0) {
+    error = errno;
+  }
+  ::close(files.in);
+  if (::close(files.out) != 0 && error == 0) {
+    error = errno;
+  }
+  if (error != 0) {
+    ::unlink(dest.c_str());
+  }
+  Metrics &metrics = Metrics::instance();
+  ++metrics.value(error == 0 ? "dacl_copy_files_total"
+                             : "dacl_copy_errors_total");
+  return error;
+}
+
+} // namespace
+
+/**
+ * @brief Raw io_uring instance with registered buffers
+ *
+ * Uses the system calls directly, so no liburing is needed. The engine
+ * thread is the only submitter and reaper.
+ */
+class CopyEngine::Uring {
+public:
+  Uring(unsigned entries, size_t bufferCount, size_t bufferBytes) {
+    io_uring_params params{};
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+      throw std::runtime_error(std::string("io_uring_setup: ") +
+                               std::strerror(errno));
+    }
+    sqRingBytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingBytes_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    singleMmap_ = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap_) {
+      sqRingBytes_ = cqRingBytes_ = std::max(sqRingBytes_, cqRingBytes_);
+    }
+    sqRing_ = map(sqRingBytes_, IORING_OFF_SQ_RING);
+    cqRing_ = singleMmap_ ? sqRing_ : map(cqRingBytes_, IORING_OFF_CQ_RING);
+    sqesBytes_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(map(sqesBytes_, IORING_OFF_SQES));
+
+    auto *sq = static_cast<char *>(sqRing_);
+    auto *cq = static_cast<char *>(cqRing_);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    void *memory = nullptr;
+    if (::posix_memalign(&memory, DIRECT_ALIGN, bufferCount * bufferBytes) !=
+        0) {
+      release();
+      throw std::runtime_error("Cannot allocate copy buffers");
+    }
+    memory_ = static_cast<uint8_t *>(memory);
+    std::vector<iovec> iovs(bufferCount);
+    for (size_t i = 0; i < bufferCount; ++i) {
+      iovs[i].iov_base = memory_ + i * bufferBytes;
+      iovs[i].iov_len = bufferBytes;
+    }
+    // Registered buffers are pinned once instead of on every request; an
+    // exceeded memlock limit only costs that optimization
+    fixed_ = ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+                       iovs.data(), static_cast<unsigned>(bufferCount)) == 0;
+    if (!fixed_) {
+      std::cerr << "Warning: Cannot register copy buffers ("
+                << std::strerror(errno) << "), using unregistered I/O"
+                << std::endl;
+    }
+  }
+
+  ~Uring() { release(); }
+
+  Uring(const Uring &) = delete;
+  Uring &operator=(const Uring &) = delete;
+
+  uint8_t *buffer(size_t index, size_t bufferBytes) const {
+    return memory_ + index * bufferBytes;
+  }
+
+  bool fixed() const { return fixed_; }
+
+  /** @brief Queues a read or write of buffer bufferIndex */
+  void prepare(bool write, int fd, uint64_t offset, uint8_t *data,
+               unsigned length, size_t bufferIndex) {
+    const unsigned tail = *sqTail_;
+    const unsigned index = tail & sqMask_;
+    io_uring_sqe &sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    if (fixed_) {
+      sqe.opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+      sqe.buf_index = static_cast<uint16_t>(bufferIndex);
+    } else {
+      sqe.opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.addr = reinterpret_cast<uint64_t>(data);
+    sqe.len = length;
+    sqe.user_data = bufferIndex;
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    ++unsubmitted_;
+  }
+
+  /** @brief Submits queued requests and waits for at least one completion */
+  int submitAndWait() {
+    while (true) {
+      const long ret = ::syscall(__NR_io_uring_enter, fd_, unsubmitted_, 1,
+                                 IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (ret >= 0) {
+        unsubmitted_ -= static_cast<unsigned>(ret);
+        return 0;
+      }
+      if (errno != EINTR) {
+        return errno;
+      }
+    }
+  }
+
+  /** @brief Calls fn(bufferIndex, result) for every available completion */
+  template <typename Fn> void reap(Fn &&fn) {
+    unsigned head = *cqHead_;
+    const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const io_uring_cqe &cqe = cqes_[head & cqMask_];
+      fn(static_cast<size_t>(cqe.user_data), cqe.res);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  }
+
+private:
+  void *map(size_t bytes, off_t offset) {
+    void *ptr = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd_, offset);
+    if (ptr == MAP_FAILED) {
+      const int err = errno;
+      release();
+      throw std::runtime_error(std::string("io_uring mmap: ") +
+                               std::strerror(err));
+    }
+    return ptr;
+  }
+
+  void release() {
+    if (sqes_ != nullptr) {
+      ::munmap(sqes_, sqesBytes_);
+      sqes_ = nullptr;
+    }
+    if (cqRing_ != nullptr && cqRing_ != sqRing_) {
+      ::munmap(cqRing_, cqRingBytes_);
+    }
+    cqRing_ = nullptr;
+    if (sqRing_ != nullptr) {
+      ::munmap(sqRing_, sqRingBytes_);
+      sqRing_ = nullptr;
+    }
+    if (fd_ >= 0) {
+      ::close(fd_); // Also unregisters the buffers
+      fd_ = -1;
+    }
+    std::free(memory_);
+    memory_ = nullptr;
+  }
+
+  int fd_ = -1;
+  bool singleMmap_ = false;
+  bool fixed_ = false;
+  void *sqRing_ = nullptr;
+  void *cqRing_ = nullptr;
+  io_uring_sqe *sqes_ = nullptr;
+  size_t sqRingBytes_ = 0;
+  size_t cqRingBytes_ = 0;
+  size_t sqesBytes_ = 0;
+  unsigned *sqTail_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned *sqArray_ = nullptr;
+  unsigned *cqHead_ = nullptr;
+  unsigned *cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe *cqes_ = nullptr;
+  unsigned unsubmitted_ = 0;
+  uint8_t *memory_ = nullptr;
+};
+
+CopyEngine::CopyEngine(const CopyOptions &options,
+                       const ThreadProfile &profile, ExportThrottle *throttle)
+    : options_(options), profile_(profile), throttle_(throttle) {
+  if (options.chunkBytes == 0 || options.chunkBytes % DIRECT_ALIGN != 0) {
+    throw std::invalid_argument("Copy chunk size must be a positive "
+                                "multiple of 4096");
+  }
+  if (options.inFlightBytes < options.chunkBytes) {
+    throw std::invalid_argument("Copy in-flight limit must hold one chunk");
+  }
+  if (options.backend != "auto" && options.backend != "uring" &&
+      options.backend != "threads") {
+    throw std::invalid_argument("Unknown copy backend: " + options.backend);
+  }
+
+  const size_t buffers = options.inFlightBytes / options.chunkBytes;
+  if (options.backend != "threads") {
+    try {
+      // Every buffer has at most one request in flight
+      unsigned entries = 1;
+      while (entries < buffers) {
+        entries <<= 1;
+      }
+      uring_ = new Uring(entries, buffers, options.chunkBytes);
+      backend_ = "uring";
+    } catch (const std::runtime_error &e) {
+      if (options.backend == "uring") {
+        throw;
+      }
+      std::cerr << "Warning: " << e.what()
+                << "; copying with a thread pool instead" << std::endl;
+    }
+  }
+
+  if (uring_ != nullptr) {
+    threads_.emplace_back(&CopyEngine::uringLoop, this);
+  } else {
+    backend_ = "threads";
+    const size_t workers = std::min(buffers, MAX_WORKERS);
+    for (size_t i = 0; i < workers; ++i) {
+      threads_.emplace_back(&CopyEngine::workerLoop, this);
+    }
+  }
+  Metrics::instance().setInfo(
+      "dacl_copy_engine_info", "copy",
+      {{"backend", backend_},
+       {"registered_buffers",
+        uring_ != nullptr && uring_->fixed() ? "1" : "0"},
+       {"direct_io", options.directIo ? "1" : "0"},
+       {"inflight_bytes",
+        std::to_string(buffers * options.chunkBytes)}});
+}
+
+CopyEngine::~CopyEngine() {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  delete uring_;
+}
+
+void CopyEngine::submit(const std::string &source, const std::string &dest,
+                        CopyCallback done) {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    jobs_.push_back(Job{source, dest, std::move(done)});
+  }
+  cv_.notify_one();
+}
+
+std::vector<int> CopyEngine::copyAll(
+    const std::vector<std::pair<std::string, std::string>> &files) {
+  std::vector<int> errors(files.size(), 0);
+  std::mutex doneMtx;
+  std::condition_variable doneCv;
+  size_t remaining = files.size();
+  for (size_t i = 0; i < files.size(); ++i) {
+    submit(files[i].first, files[i].second, [&, i](int error) {
+      std::lock_guard<std::mutex> lk(doneMtx);
+      errors[i] = error;
+      if (--remaining == 0) {
+        doneCv.notify_one();
+      }
+    });
+  }
+  std::unique_lock<std::mutex> lk(doneMtx);
+  doneCv.wait(lk, [&] { return remaining == 0; });
+  return errors;
+}
+
+bool CopyEngine::nextJob(Job &job, bool wait) {
+  std::unique_lock<std::mutex> lk(mtx_);
+  if (wait) {
+    cv_.wait(lk, [this] { return stop_ || !jobs_.empty(); });
+  }
+  if (jobs_.empty()) {
+    return false;
+  }
+  job = std::move(jobs_.front());
+  jobs_.pop_front();
+  return true;
+}
+
+void CopyEngine::uringLoop() {
+  applyThreadProfile("copy", profile_);
+
+  /// A file being copied
+  struct Active {
+    Job job;
+    OpenFiles files;
+    uint64_t nextOffset = 0; ///< Next chunk to read
+    int pending = 0;         ///< Buffers in use by this file
+    int error = 0;           ///< First error
+  };
+  /// One registered buffer and the chunk it carries
+  struct Slot {
+    Active *file = nullptr; ///< Owner, nullptr if free
+    uint64_t offset = 0;    ///< File offset of the chunk
+    size_t length = 0;      ///< Valid bytes of the chunk
+    size_t done = 0;        ///< Bytes completed in the current phase
+    bool writing = false;   ///< Write phase (after the read completed)
+  };
+
+  const size_t chunk = options_.chunkBytes;
+  std::vector<Slot> slots(options_.inFlightBytes / chunk);
+  std::vector<std::unique_ptr<Active>> active;
+  size_t nextFile = 0;
+  size_t inFlight = 0;
+  std::atomic<int64_t> &inFlightGauge =
+      Metrics::instance().value("dacl_copy_inflight_bytes");
+  std::atomic<int64_t> &bytesTotal =
+      Metrics::instance().value("dacl_copy_bytes_total");
+
+  auto issueRead = [&](size_t index) {
+    Slot &slot = slots[index];
+    uint8_t *data = uring_->buffer(index, chunk) + slot.done;
+    // Reads are whole blocks so they also work on O_DIRECT descriptors;
+    // at the end of the file they return short
+    const size_t length = std::min(roundUp(slot.length - slot.done,
+                                           DIRECT_ALIGN),
+                                   chunk - slot.done);
+    uring_->prepare(false, slot.file->files.in, slot.offset + slot.done, data,
+                    static_cast<unsigned>(length), index);
+  };
+  auto issueWrite = [&](size_t index) {
+    Slot &slot = slots[index];
+    uint8_t *data = uring_->buffer(index, chunk) + slot.done;
+    const size_t length = slot.file->files.outDirect
+                              ? roundUp(slot.length, DIRECT_ALIGN) - slot.done
+                              : slot.length - slot.done;
+    uring_->prepare(true, slot.file->files.out, slot.offset + slot.done, data,
+                    static_cast<unsigned>(length), index);
+  };
+  auto releaseSlot = [&](Slot &slot) {
+    --slot.file->pending;
+    slot.file = nullptr;
+    --inFlight;
+    inFlightGauge -= static_cast<int64_t>(chunk);
+  };
+
+  while (true) {
+    // Admit queued copies up to the open-file limit
+    while (active.size() < MAX_OPEN_FILES) {
+      Job job;
+      if (!nextJob(job, active.empty())) {
+        break;
+      }
+      auto file = std::make_unique<Active>();
+      file->job = std::move(job);
+      const int err = openFiles(file->job.source, file->job.dest,
+                                options_.directIo, file->files);
+      if (err != 0) {
+        ++Metrics::instance().value("dacl_copy_errors_total");
+        file->job.done(err);
+        continue;
+      }
+      active.push_back(std::move(file));
+    }
+    if (active.empty()) {
+      std::lock_guard<std::mutex> lk(mtx_);
+      if (stop_ && jobs_.empty()) {
+        return;
+      }
+      continue;
+    }
+
+    // Hand free buffers to the active files in turn
+    for (size_t index = 0; index < slots.size(); ++index) {
+      if (slots[index].file != nullptr) {
+        continue;
+      }
+      Active *file = nullptr;
+      for (size_t tried = 0; tried < active.size() && file == nullptr;
+           ++tried) {
+        Active *candidate = active[nextFile++ % active.size()].get();
+        if (candidate->error == 0 &&
+            candidate->nextOffset < candidate->files.size) {
+          file = candidate;
+        }
+      }
+      if (file == nullptr) {
+        break;
+      }
+      const size_t length = static_cast<size_t>(
+          std::min<uint64_t>(chunk, file->files.size - file->nextOffset));
+      if (throttle_ != nullptr) {
+        // With nothing in flight the engine may as well wait for tokens;
+        // otherwise completions are reaped meanwhile
+        if (inFlight >= throttle_->concurrency()) {
+          break;
+        }
+        if (inFlight == 0) {
+          throttle_->acquire(length);
+        } else if (!throttle_->tryAcquire(length)) {
+          break;
+        }
+      }
+      Slot &slot = slots[index];
+      slot.file = file;
+      slot.offset = file->nextOffset;
+      slot.length = length;
+      slot.done = 0;
+      slot.writing = false;
+      file->nextOffset += slot.length;
+      ++file->pending;
+      ++inFlight;
+      inFlightGauge += static_cast<int64_t>(chunk);
+      issueRead(index);
+    }
+
+    if (inFlight > 0) {
+      const int err = uring_->submitAndWait();
+      if (err != 0) {
+        std::cerr << "Error: io_uring_enter: " << std::strerror(err)
+                  << std::endl;
+        // Requests already in the kernel still complete below
+      }
+      uring_->reap([&](size_t index, int res) {
+        Slot &slot = slots[index];
+        Active &file = *slot.file;
+        if (res < 0 || file.error != 0) {
+          if (file.error == 0) {
+            file.error = -res;
+          }
+          releaseSlot(slot);
+          return;
+        }
+        if (!slot.writing) {
+          slot.done += static_cast<size_t>(res);
+          if (res > 0 && slot.done < slot.length) {
+            issueRead(index); // Short read, continue the chunk
+            return;
+          }
+          if (slot.done < slot.length) {
+            file.error = EIO; // Source shrank during the copy
+            releaseSlot(slot);
+            return;
+          }
+          slot.writing = true;
+          slot.done = 0;
+          issueWrite(index);
+          return;
+        }
+        slot.done += static_cast<size_t>(res);
+        if (slot.done < slot.length) {
+          if (res == 0) {
+            file.error = EIO;
+            releaseSlot(slot);
+          } else {
+            issueWrite(index); // Short write, continue the chunk
+          }
+          return;
+        }
+        bytesTotal += static_cast<int64_t>(slot.length);
+        releaseSlot(slot);
+      });
+    }
+
+    // Complete files with nothing left to read or write
+    for (auto it = active.begin(); it != active.end();) {
+      Active &file = **it;
+      const bool finished =
+          file.pending == 0 &&
+          (file.error != 0 || file.nextOffset >= file.files.size);
+      if (!finished) {
+        ++it;
+        continue;
+      }
+      const int err = closeFiles(file.job.dest, file.files, file.error);
+      file.job.done(err);
+      it = active.erase(it);
+    }
+  }
+}
+
+void CopyEngine::workerLoop() {
+  applyThreadProfile("copy", profile_);
+  const size_t chunk = options_.chunkBytes;
+  void *memory = nullptr;
+  if (::posix_memalign(&memory, DIRECT_ALIGN, chunk) != 0) {
+    std::cerr << "Error: Cannot allocate copy buffer" << std::endl;
+    return;
+  }
+  std::unique_ptr<uint8_t, decltype(&std::free)> buffer(
+      static_cast<uint8_t *>(memory), &std::free);
+  std::atomic<int64_t> &bytesTotal =
+      Metrics::instance().value("dacl_copy_bytes_total");
+
+  Job job;
+  while (nextJob(job, true)) {
+    OpenFiles files;
+    int err = openFiles(job.source, job.dest, options_.directIo, files);
+    if (err != 0) {
+      ++Metrics::instance().value("dacl_copy_errors_total");
+      job.done(err);
+      continue;
+    }
+    for (uint64_t offset = 0; err == 0 && offset < files.size;) {
+      const size_t length = static_cast<size_t>(
+          std::min<uint64_t>(chunk, files.size - offset));
+      if (throttle_ != nullptr) {
+        throttle_->acquire(length);
+      }
+      // Fill the whole chunk so every write starts block-aligned; reads are
+      // whole blocks as in the io_uring path
+      for (size_t done = 0; done < length;) {
+        const size_t want =
+            std::min(roundUp(length - done, DIRECT_ALIGN), chunk - done);
+        const ssize_t got = ::pread(files.in, buffer.get() + done, want,
+                                    static_cast<off_t>(offset + done));
+        if (got < 0 && errno == EINTR) {
+          continue;
+        }
+        if (got <= 0) {
+          err = got < 0 ? errno : EIO; // EIO: source shrank during the copy
+          break;
+        }
+        done += static_cast<size_t>(got);
+      }
+      if (err != 0) {
+        break;
+      }
+      const size_t writeLength =
+          files.outDirect ? roundUp(length, DIRECT_ALIGN) : length;
+      for (size_t written = 0; written < writeLength;) {
+        const ssize_t n =
+            ::pwrite(files.out, buffer.get() + written, writeLength - written,
+                     static_cast<off_t>(offset + written));
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          err = n < 0 ? errno : EIO;
+          break;
+        }
+        written += static_cast<size_t>(n);
+      }
+      offset += length;
+      bytesTotal += static_cast<int64_t>(length);
+    }
+    job.done(closeFiles(job.dest, files, err));
+  }
+}
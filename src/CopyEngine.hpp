@@ -0,0 +1,137 @@
+/**
+ * @file CopyEngine.hpp
+ * @brief Asynchronous bulk file copies on io_uring with a thread-pool fallback
+ */
+
+#pragma once
+#include "ExportThrottle.hpp"
+#include "ThreadProfile.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct CopyOptions
+ * @brief Backend and resource limits of a CopyEngine
+ */
+struct CopyOptions {
+  std::string backend = "auto"; ///< "auto", "uring" or "threads"
+  size_t inFlightBytes = 8u << 20; ///< Upper bound of bytes being copied
+  size_t chunkBytes = 512u << 10;  ///< Size of one read/write; multiple of
+                                   ///< 4096
+  bool directIo = false; ///< Open files with O_DIRECT where supported
+};
+
+/// Completion callback; receives 0 or an errno value
+using CopyCallback = std::function<void(int error)>;
+
+/**
+ * @class CopyEngine
+ * @brief Copies files in the background, many at a time
+ *
+ * The io_uring backend runs one engine thread that keeps reads and writes of
+ * several files in flight at once, using a fixed pool of registered buffers
+ * of chunkBytes each: the pool size (inFlightBytes / chunkBytes) bounds both
+ * memory use and the queue depth presented to the storage device. With
+ * directIo the page cache is bypassed, so large exports do not evict the
+ * recording's working set; files on filesystems without O_DIRECT support
+ * are copied buffered. If io_uring is unavailable (old kernel, seccomp),
+ * the "auto" backend falls back to a small thread pool doing pread/pwrite.
+ *
+ * An optional ExportThrottle limits the bandwidth (token bucket per chunk)
+ * and, for io_uring, the number of chunks in flight while live recording
+ * is under I/O pressure.
+ *
+ * Bytes, files and errors are reported in Metrics (`dacl_copy_*`).
+ *
+ * @note Thread Safety: submit() and copyAll() may be called from any
+ * thread. Callbacks run on an engine thread and must not block for long.
+ */
+class CopyEngine final {
+public:
+  /**
+   * @brief Starts the engine threads
+   * @param options Backend and limits
+   * @param profile Scheduling profile applied to the engine threads (role
+   * "copy")
+   * @param throttle Back-pressure limits applied to every chunk (nullptr =
+   * unthrottled)
+   * @throws std::invalid_argument if the limits are invalid or the backend
+   * is unknown
+   * @throws std::runtime_error if the "uring" backend was requested but
+   * io_uring is unavailable
+   */
+  explicit CopyEngine(const CopyOptions &options,
+                      const ThreadProfile &profile = ThreadProfile(),
+                      ExportThrottle *throttle = nullptr);
+
+  /** @brief Finishes all queued copies and stops the engine threads */
+  ~CopyEngine();
+
+  CopyEngine(const CopyEngine &) = delete;
+  CopyEngine &operator=(const CopyEngine &) = delete;
+
+  /**
+   * @brief Queues a copy without waiting for it
+   * @param source File to copy
+   * @param dest Destination path; replaced if it exists
+   * @param done Called with 0 or an errno value once dest is complete (or
+   * removed after a failure)
+   */
+  void submit(const std::string &source, const std::string &dest,
+              CopyCallback done);
+
+  /**
+   * @brief Copies files concurrently and waits for all of them
+   * @param files Source and destination paths
+   * @return 0 or an errno value per file, in input order
+   */
+  std::vector<int>
+  copyAll(const std::vector<std::pair<std::string, std::string>> &files);
+
+  /** @brief Name of the backend in use ("uring" or "threads") */
+  const std::string &backend() const { return backend_; }
+
+private:
+  /// A queued copy
+  struct Job {
+    std::string source; ///< File to copy
+    std::string dest;   ///< Destination path
+    CopyCallback done;  ///< Completion callback
+  };
+
+  class Uring;
+
+  /** @brief Takes the next job; blocks until one arrives or stop */
+  bool nextJob(Job &job, bool wait);
+
+  /** @brief io_uring engine thread */
+  void uringLoop();
+
+  /** @brief Thread-pool worker copying one file at a time */
+  void workerLoop();
+
+  const CopyOptions options_;    ///< Limits and O_DIRECT setting
+  const ThreadProfile profile_;  ///< Applied to every engine thread
+  ExportThrottle *const throttle_; ///< Back-pressure limits, or nullptr
+  std::string backend_;          ///< Backend in use
+  Uring *uring_ = nullptr;       ///< io_uring state (uring backend only)
+
+  std::mutex mtx_;               ///< Guards jobs_ and stop_
+  std::condition_variable cv_;   ///< Signals new jobs and stop_
+  std::deque<Job> jobs_;         ///< Copies not yet started
+  bool stop_ = false;            ///< Set by the destructor
+  std::vector<std::thread> threads_; ///< Engine thread or worker pool
+
+  static constexpr size_t DIRECT_ALIGN = 4096; ///< O_DIRECT alignment
+  static constexpr size_t MAX_OPEN_FILES =
+      8; ///< Files copied concurrently by the io_uring backend
+  static constexpr size_t MAX_WORKERS =
+      4; ///< Threads of the fallback backend
+};
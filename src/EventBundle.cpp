@@ -0,0 +1,242 @@
+#include "EventBundle.hpp"
+#include "ExportThrottle.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/// File header, followed by the first component at COMPONENT_ALIGNMENT
+struct BundleHeader {
+  char magic[8];    ///< BUNDLE_MAGIC
+  uint16_t version; ///< BUNDLE_VERSION
+  uint8_t reserved[6];
+};
+static_assert(sizeof(BundleHeader) == 16, "BundleHeader must stay 16 bytes");
+
+/// File trailer; readers start from the last 32 bytes of the file
+struct BundleTrailer {
+  uint64_t indexOffset; ///< Byte offset of the first BundleEntry
+  uint32_t count;       ///< Number of entries
+  uint32_t entrySize;   ///< sizeof(BundleEntry)
+  uint64_t reserved;
+  char magic[8];        ///< TRAILER_MAGIC
+};
+static_assert(sizeof(BundleTrailer) == 32, "BundleTrailer must stay 32 bytes");
+
+constexpr char BUNDLE_MAGIC[8] = {'D', 'A', 'C', 'L', 'B', 'N', 'D', 'L'};
+constexpr char TRAILER_MAGIC[8] = {'D', 'A', 'C', 'L', 'E', 'N', 'D', '\0'};
+constexpr uint16_t BUNDLE_VERSION = 1;
+constexpr uint64_t COMPONENT_ALIGNMENT = 4096; ///< Components are page aligned
+constexpr size_t COPY_CHUNK_BYTES = 1 << 20;   ///< Read/write unit
+
+/// Sequential writer keeping track of the file position
+class BundleFile {
+public:
+  BundleFile(int fd, ExportThrottle *throttle)
+      : fd_(fd), throttle_(throttle) {}
+
+  void write(const void *data, size_t size) {
+    if (throttle_ != nullptr) {
+      throttle_->acquire(size);
+    }
+    const auto *p = static_cast<const char *>(data);
+    while (size > 0) {
+      const ssize_t n = ::write(fd_, p, size);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        throw std::runtime_error(std::string("Bundle write failed: ") +
+                                 std::strerror(errno));
+      }
+      p += n;
+      size -= static_cast<size_t>(n);
+      position_ += static_cast<uint64_t>(n);
+    }
+  }
+
+  /// Pads with zeros up to the next multiple of alignment
+  void align(uint64_t alignment) {
+    static const char zeros[COMPONENT_ALIGNMENT] = {};
+    const uint64_t padding = (alignment - position_ % alignment) % alignment;
+    write(zeros, static_cast<size_t>(padding));
+  }
+
+  /// Appends the content of a file; returns its length
+  uint64_t copyFrom(const std::string &path, std::vector<char> &buffer) {
+    const int in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+      throw std::runtime_error("Cannot open " + path + ": " +
+                               std::strerror(errno));
+    }
+    uint64_t copied = 0;
+    while (true) {
+      const ssize_t n = ::read(in, buffer.data(), buffer.size());
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        const int error = errno;
+        ::close(in);
+        throw std::runtime_error("Cannot read " + path + ": " +
+                                 std::strerror(error));
+      }
+      if (n == 0) {
+        break;
+      }
+      write(buffer.data(), static_cast<size_t>(n));
+      copied += static_cast<uint64_t>(n);
+    }
+    ::close(in);
+    return copied;
+  }
+
+  uint64_t position() const { return position_; }
+
+private:
+  const int fd_;
+  ExportThrottle *const throttle_;
+  uint64_t position_ = 0;
+};
+
+} // namespace
+
+uint64_t writeEventBundle(const std::string &path,
+                          const std::vector<BundleComponent> &components,
+                          ExportThrottle *throttle) {
+  const std::string tmpPath = path + ".tmp";
+  int fd =
+      ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot create " + tmpPath + ": " +
+                             std::strerror(errno));
+  }
+  try {
+    BundleFile file(fd, throttle);
+    BundleHeader header{};
+    std::memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    file.write(&header, sizeof(header));
+
+    std::vector<BundleEntry> entries;
+    std::vector<char> buffer(COPY_CHUNK_BYTES);
+    for (const auto &component : components) {
+      file.align(COMPONENT_ALIGNMENT);
+      BundleEntry entry{};
+      std::strncpy(entry.name, component.name.c_str(), sizeof(entry.name) - 1);
+      entry.kind = static_cast<uint32_t>(component.kind);
+      entry.offset = file.position();
+      if (!component.path.empty()) {
+        entry.size = file.copyFrom(component.path, buffer);
+      } else {
+        file.write(component.data.data(), component.data.size());
+        entry.size = component.data.size();
+      }
+      entries.push_back(entry);
+    }
+
+    file.align(alignof(BundleEntry)); // The index is read in place
+    BundleTrailer trailer{};
+    trailer.indexOffset = file.position();
+    trailer.count = static_cast<uint32_t>(entries.size());
+    trailer.entrySize = sizeof(BundleEntry);
+    std::memcpy(trailer.magic, TRAILER_MAGIC, sizeof(trailer.magic));
+    file.write(entries.data(), entries.size() * sizeof(BundleEntry));
+    file.write(&trailer, sizeof(trailer));
+    if (::fdatasync(fd) != 0) {
+      throw std::runtime_error(std::string("Bundle sync failed: ") +
+                               std::strerror(errno));
+    }
+    ::close(fd);
+    fd = -1; // The number may be reused by another thread from here on
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+      throw std::runtime_error("Cannot rename " + tmpPath + ": " +
+                               std::strerror(errno));
+    }
+    return file.position();
+  } catch (...) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    std::remove(tmpPath.c_str());
+    throw;
+  }
+}
+
+EventBundleReader::EventBundleReader(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open event bundle " + path + ": " +
+                             std::strerror(errno));
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) <
+          sizeof(BundleHeader) + sizeof(BundleTrailer)) {
+    ::close(fd);
+    throw std::runtime_error(path + " is not an event bundle");
+  }
+  mapBytes_ = static_cast<size_t>(st.st_size);
+  map_ = ::mmap(nullptr, mapBytes_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    throw std::runtime_error("Cannot map event bundle " + path);
+  }
+
+  const auto *base = static_cast<const uint8_t *>(map_);
+  const auto *header = reinterpret_cast<const BundleHeader *>(base);
+  BundleTrailer trailer;
+  std::memcpy(&trailer, base + mapBytes_ - sizeof(trailer), sizeof(trailer));
+  const uint64_t indexEnd = mapBytes_ - sizeof(trailer);
+  bool valid = std::memcmp(header->magic, BUNDLE_MAGIC, 8) == 0 &&
+               header->version == BUNDLE_VERSION &&
+               std::memcmp(trailer.magic, TRAILER_MAGIC, 8) == 0 &&
+               trailer.entrySize == sizeof(BundleEntry) &&
+               trailer.indexOffset % alignof(BundleEntry) == 0 &&
+               trailer.indexOffset <= indexEnd &&
+               indexEnd - trailer.indexOffset ==
+                   uint64_t{trailer.count} * sizeof(BundleEntry);
+  if (valid) {
+    entries_ =
+        reinterpret_cast<const BundleEntry *>(base + trailer.indexOffset);
+    count_ = trailer.count;
+    for (size_t i = 0; i < count_ && valid; ++i) {
+      valid = entries_[i].offset <= trailer.indexOffset &&
+              entries_[i].size <= trailer.indexOffset - entries_[i].offset;
+    }
+  }
+  if (!valid) {
+    ::munmap(map_, mapBytes_);
+    map_ = nullptr;
+    throw std::runtime_error(path + " is not a complete event bundle");
+  }
+}
+
+EventBundleReader::~EventBundleReader() {
+  if (map_ != nullptr) {
+    ::munmap(map_, mapBytes_);
+  }
+}
+
+std::string EventBundleReader::name(size_t i) const {
+  const BundleEntry &e = entries_[i];
+  return std::string(e.name, strnlen(e.name, sizeof(e.name)));
+}
+
+size_t EventBundleReader::find(const std::string &name) const {
+  for (size_t i = 0; i < count_; ++i) {
+    if (this->name(i) == name) {
+      return i;
+    }
+  }
+  return count_;
+}
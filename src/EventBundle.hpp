@@ -0,0 +1,119 @@
+/**
+ * @file EventBundle.hpp
+ * @brief Single-file event bundle: video, CAN data, metadata and an index
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ExportThrottle;
+
+/**
+ * @brief Kind of a bundle component
+ */
+enum class BundleKind : uint32_t {
+  Metadata = 1,   ///< Trigger metadata as key=value lines (event.ini)
+  Video = 2,      ///< Stream-copied MP4 segment
+  FrameIndex = 3, ///< Frame index sidecar of the preceding video
+  CanLog = 4,     ///< Raw CAN frames in candump log format
+  Signals = 5,    ///< Decoded signal series as CSV
+  Overlay = 6,    ///< Overlay image (PNG)
+};
+
+/**
+ * @struct BundleComponent
+ * @brief One component to write into a bundle
+ *
+ * The content is read from path if it is set, otherwise taken from data.
+ */
+struct BundleComponent {
+  std::string name; ///< Name within the bundle, e.g. "front/pretrigger_0.mp4"
+  BundleKind kind = BundleKind::Metadata; ///< What the component holds
+  std::string path; ///< File to copy, or empty
+  std::string data; ///< In-memory content if path is empty
+};
+
+/**
+ * @struct BundleEntry
+ * @brief Fixed-size footer index entry locating one component
+ *
+ * Stored in native (little-endian) byte order. Offsets are from the start of
+ * the bundle file and page aligned, so a component can be mapped on its own.
+ */
+struct BundleEntry {
+  char name[64];   ///< Component name, zero-padded
+  uint64_t offset; ///< Byte offset of the content
+  uint64_t size;   ///< Content length in bytes
+  uint32_t kind;   ///< BundleKind
+  uint32_t reserved;
+};
+static_assert(sizeof(BundleEntry) == 88, "BundleEntry must stay 88 bytes");
+
+/**
+ * @brief Writes an event bundle in one sequential pass
+ * @param path Path of the bundle file
+ * @param components Components in the order they are written
+ * @param throttle Optional export throttle limiting the write rate
+ * (non-owning)
+ * @return Number of bytes written
+ * @throws std::runtime_error if a component file cannot be read or the
+ * bundle cannot be written
+ *
+ * Layout: a 16-byte header, the components (each starting on a 4 KiB
+ * boundary), the index of BundleEntry records, and a 32-byte trailer
+ * holding the index position. The bundle is written to "<path>.tmp", synced
+ * and renamed, so an interrupted write never leaves a partial bundle.
+ */
+uint64_t writeEventBundle(const std::string &path,
+                          const std::vector<BundleComponent> &components,
+                          ExportThrottle *throttle = nullptr);
+
+/**
+ * @class EventBundleReader
+ * @brief Memory-maps an event bundle and gives direct access to components
+ *
+ * @note Thread Safety: Immutable after construction; safe to share.
+ */
+class EventBundleReader final {
+public:
+  /**
+   * @brief Maps a bundle read-only and validates its index
+   * @param path Path of the bundle file
+   * @throws std::runtime_error if the file cannot be mapped or is not a
+   * complete event bundle
+   */
+  explicit EventBundleReader(const std::string &path);
+  ~EventBundleReader();
+
+  EventBundleReader(const EventBundleReader &) = delete;
+  EventBundleReader &operator=(const EventBundleReader &) = delete;
+
+  /** @brief Number of components */
+  size_t size() const { return count_; }
+
+  /** @brief Index entry of component i */
+  const BundleEntry &entry(size_t i) const { return entries_[i]; }
+
+  /** @brief Name of component i */
+  std::string name(size_t i) const;
+
+  /** @brief Content of component i within the mapping */
+  const uint8_t *data(size_t i) const {
+    return static_cast<const uint8_t *>(map_) + entries_[i].offset;
+  }
+
+  /**
+   * @brief Finds a component by name
+   * @return Its position, or size() if there is none
+   */
+  size_t find(const std::string &name) const;
+
+private:
+  void *map_ = nullptr;                  ///< Mapping of the whole file
+  size_t mapBytes_ = 0;                  ///< Size of the mapping
+  const BundleEntry *entries_ = nullptr; ///< Index within the mapping
+  size_t count_ = 0;                     ///< Number of index entries
+};
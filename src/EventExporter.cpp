@@ -0,0 +1,168 @@
+#include "EventExporter.hpp"
+#include "FrameIndex.hpp"
+#include "TimeSync.hpp"
+#include "Tracer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+EventExporter::EventExporter(FileManager *fileManager, CSVLogger *csvLogger,
+                             OverlayRenderer *overlayRenderer,
+                             const std::string &canInterface,
+                             bool eventBundles)
+    : fileManager_(fileManager), csvLogger_(csvLogger),
+      overlayRenderer_(overlayRenderer), canInterface_(canInterface),
+      eventBundles_(eventBundles) {
+  if (fileManager == nullptr || csvLogger == nullptr ||
+      overlayRenderer == nullptr) {
+    throw std::invalid_argument("EventExporter needs a FileManager, a "
+                                "CSVLogger and an OverlayRenderer");
+  }
+}
+
+void EventExporter::exportEvent(const EventInfo &event,
+                                const std::vector<EventCamera> &cameras,
+                                const CanFrameRing *canFrames) {
+  std::string overlayFile;
+  std::vector<const EventCamera *> exported;
+  std::vector<SegmentHandle> loggedPre;
+  std::string loggedPost;
+  for (const EventCamera &camera : cameras) {
+    const SegmentHandle &postFile = camera.post;
+    if (!postFile || !std::filesystem::exists(postFile.path())) {
+      continue;
+    }
+    if (overlayFile.empty()) {
+      overlayFile = overlayRenderer_->renderOverlay(
+          event.speed, event.warningType, event.timestamp, event.vehicle);
+    }
+    exported.push_back(&camera);
+    loggedPre.insert(loggedPre.end(), camera.pre.begin(), camera.pre.end());
+    loggedPost += (loggedPost.empty() ? "" : ",") + postFile.path();
+  }
+  if (exported.empty()) {
+    return;
+  }
+
+  // The bundle holds the videos and the overlay, so loose copies are only
+  // written without one
+  bool bundled = false;
+  if (eventBundles_) {
+    try {
+      writeBundle(event, cameras, canFrames, overlayFile);
+      bundled = true;
+    } catch (const std::exception &e) {
+      std::cerr << "Warning: Event bundle failed, exporting loose videos: "
+                << e.what() << std::endl;
+    }
+  }
+  if (!bundled) {
+    for (const EventCamera *camera : exported) {
+      // The suffix keeps all cameras under one event for retention
+      const std::string suffix =
+          cameras.size() > 1 ? "_" + camera->camera : "";
+      if (!camera->pre.empty()) {
+        fileManager_->copyEventSegments(camera->pre, event.warningType,
+                                        event.timestamp, overlayFile,
+                                        "pretrigger" + suffix);
+      }
+      fileManager_->copyEventSegments({camera->post}, event.warningType,
+                                      event.timestamp, overlayFile,
+                                      "posttrigger" + suffix);
+    }
+  }
+
+  csvLogger_->logEvent(event.timestamp, event.triggerType, event.warningType,
+                       event.speed, loggedPre, loggedPost);
+}
+
+void EventExporter::writeBundle(const EventInfo &event,
+                                const std::vector<EventCamera> &cameras,
+                                const CanFrameRing *canFrames,
+                                const std::string &overlayFile) {
+  TraceScope span("trigger", "bundle");
+  std::ostringstream metadata;
+  metadata << "timestamp=" << event.timestamp
+           << "\ntrigger=" << event.triggerType
+           << "\nwarning=" << event.warningType
+           << "\nspeed_kmh=" << event.speed
+           << "\ntrigger_us=" << event.triggerUs
+           << "\npre_minutes=" << event.preMin
+           << "\npost_minutes=" << event.postMin << "\n";
+
+  std::vector<BundleComponent> components(1); // Metadata, filled in last
+  const int64_t nowUs = TimeSync::monotonicMicros();
+  // 0 = triggered now, as for getBufferedSegments()
+  int64_t windowStartUs = (event.triggerUs > 0
+                               ? event.triggerUs
+                               : TimeSync::systemFromMonotonic(nowUs)) -
+                          static_cast<int64_t>(event.preMin) * 60 * 1000000;
+  auto addVideo = [&](const std::string &camera, const std::string &name,
+                      const SegmentHandle &segment) {
+    const SegmentInfo info = segment.info();
+    components.push_back(
+        {camera + "/" + name, BundleKind::Video, segment.path(), ""});
+    std::error_code ec;
+    if (std::filesystem::exists(frameIndexPath(segment.path()), ec)) {
+      components.push_back({camera + "/" + name + ".idx",
+                            BundleKind::FrameIndex,
+                            frameIndexPath(segment.path()), ""});
+    }
+    metadata << "video=" << camera << "/" << name << "," << info.startUs << ","
+             << info.endUs << "," << info.frameIntervalNs << "\n";
+    if (info.startUs > 0) {
+      windowStartUs = std::min(windowStartUs, info.startUs);
+    }
+  };
+  for (const EventCamera &camera : cameras) {
+    for (size_t j = 0; j < camera.pre.size(); ++j) {
+      addVideo(camera.camera, "pretrigger_" + std::to_string(j) + ".mp4",
+               camera.pre[j]);
+    }
+    std::error_code ec;
+    if (camera.post && std::filesystem::exists(camera.post.path(), ec)) {
+      addVideo(camera.camera, "posttrigger.mp4", camera.post);
+    }
+  }
+
+  if (canFrames != nullptr) {
+    // Everything received from the first exported frame until now
+    const std::vector<CanFrameRecord> frames = canFrames->snapshot(
+        TimeSync::monotonicFromSystem(windowStartUs), nowUs);
+    const int64_t systemOffsetUs = TimeSync::systemFromMonotonic(0);
+    components.push_back(
+        {"can.log", BundleKind::CanLog, "",
+         formatCandump(frames, canInterface_, systemOffsetUs)});
+
+    std::ostringstream signals;
+    signals << "time_us,speed_kmh,trip_km,odometer_km,can_time\n";
+    VehicleState state;
+    char canTime[32];
+    for (const auto &frame : frames) {
+      if (!CANListener::decodeFrame(frame.id, frame.data, state)) {
+        continue;
+      }
+      std::snprintf(canTime, sizeof(canTime), "%04d%02d%02d_%02d%02d%02d",
+                    state.year, state.month, state.day, state.hour,
+                    state.minute, state.second);
+      signals << frame.rxUs + systemOffsetUs << "," << state.speed << ","
+              << state.tripMileage << "," << state.totalMileage << ","
+              << canTime << "\n";
+    }
+    components.push_back(
+        {"signals.csv", BundleKind::Signals, "", signals.str()});
+    metadata << "can_interface=" << canInterface_
+             << "\ncan_frames=" << frames.size() << "\n";
+  }
+
+  std::error_code ec;
+  if (!overlayFile.empty() && std::filesystem::exists(overlayFile, ec)) {
+    components.push_back({"overlay.png", BundleKind::Overlay, overlayFile, ""});
+  }
+  components.front() = {"event.ini", BundleKind::Metadata, "", metadata.str()};
+  fileManager_->writeEventBundle(event.warningType, event.timestamp,
+                                 components);
+}
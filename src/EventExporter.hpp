@@ -0,0 +1,105 @@
+/**
+ * @file EventExporter.hpp
+ * @brief Export of a captured event: overlay, segment copies, event log and
+ * bundle
+ */
+
+#pragma once
+#include "CSVLogger.hpp"
+#include "CanFrameRing.hpp"
+#include "FileManager.hpp"
+#include "OverlayRenderer.hpp"
+#include "Segment.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @struct EventInfo
+ * @brief Trigger metadata of one event, fixed when the trigger is handled
+ */
+struct EventInfo {
+  std::string timestamp;   ///< CAN-based event time (YYYYMMDD_HHMMSS)
+  std::string triggerType; ///< Source of the trigger ("CAN", "MOTION", ...)
+  std::string warningType; ///< Warning or event label
+  int speed = 0;           ///< Vehicle speed at the trigger in km/h
+  int preMin = 0;          ///< Pre-trigger duration in minutes
+  int postMin = 0;         ///< Post-trigger duration in minutes
+  int64_t triggerUs = 0;   ///< Wall-clock trigger time (0 = now)
+  VehicleState vehicle;    ///< Vehicle state at the trigger, for the overlay
+};
+
+/**
+ * @struct EventCamera
+ * @brief Segments of one camera that belong to an event
+ */
+struct EventCamera {
+  std::string camera;             ///< Camera name
+  std::vector<SegmentHandle> pre; ///< Pre-trigger segments, oldest first
+  SegmentHandle post;             ///< Post-trigger segment, may be empty
+};
+
+/**
+ * @class EventExporter
+ * @brief Turns the pinned segments of an event into event files
+ *
+ * With event bundles on, every event is stored once, as a self-contained
+ * bundle holding the stream-copied segments of every camera with a
+ * post-trigger segment, their frame indexes, the raw CAN frames of the
+ * event window, their decoded signals, the overlay and the trigger
+ * metadata. Without bundles, or if the bundle cannot be written, the
+ * segments are copied into the event directory with the overlay applied.
+ * The event is then logged.
+ *
+ * TriggerManager exports through it directly; with pipeline=split the
+ * EventProcessor does, in a process of its own.
+ *
+ * @note Thread Safety: exportEvent() may be called from several trigger
+ * threads; the components it drives are thread-safe.
+ */
+class EventExporter final {
+public:
+  /**
+   * @brief Constructs the exporter
+   * @param fileManager Copies segments and writes bundles (non-owning)
+   * @param csvLogger Event log (non-owning)
+   * @param overlayRenderer Renders the overlay image (non-owning)
+   * @param canInterface CAN interface named in bundles
+   * @param eventBundles Write an event bundle for every event
+   * @throws std::invalid_argument if a pointer is nullptr
+   */
+  explicit EventExporter(FileManager *fileManager, CSVLogger *csvLogger,
+                         OverlayRenderer *overlayRenderer,
+                         const std::string &canInterface, bool eventBundles);
+
+  /**
+   * @brief Exports and logs one event
+   * @param event Trigger metadata
+   * @param cameras Segments per camera, first camera first
+   * @param canFrames CAN history the bundle's frames are taken from
+   * (nullptr = bundles carry no CAN data)
+   * @note Cameras without a post-trigger segment are skipped; an event
+   * without any is neither exported nor logged
+   */
+  void exportEvent(const EventInfo &event,
+                   const std::vector<EventCamera> &cameras,
+                   const CanFrameRing *canFrames);
+
+private:
+  /**
+   * @brief Writes the event bundle of an event
+   * @param overlayFile Overlay image, or empty
+   * @throws std::runtime_error if the bundle cannot be written
+   * @note The other parameters are those of exportEvent()
+   */
+  void writeBundle(const EventInfo &event,
+                   const std::vector<EventCamera> &cameras,
+                   const CanFrameRing *canFrames,
+                   const std::string &overlayFile);
+
+  FileManager *const fileManager_;         ///< Segment copies and bundles
+  CSVLogger *const csvLogger_;             ///< Event logging system
+  OverlayRenderer *const overlayRenderer_; ///< Overlay generation system
+  const std::string canInterface_;         ///< CAN interface for bundles
+  const bool eventBundles_;                ///< Write an event bundle per event
+};
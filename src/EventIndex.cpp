@@ -0,0 +1,208 @@
+#include "EventIndex.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/// On-disk header preceding the records
+struct IndexHeader {
+  uint32_t magic;       ///< INDEX_MAGIC
+  uint16_t version;     ///< INDEX_VERSION
+  uint16_t recordSize;  ///< sizeof(EventRecord)
+  uint64_t sortedCount; ///< Records [0, sortedCount) are sorted by time
+  uint8_t reserved[48]; ///< Pads the header to one record
+};
+static_assert(sizeof(IndexHeader) == sizeof(EventRecord),
+              "header occupies one record slot");
+
+constexpr uint32_t INDEX_MAGIC = 0x49564544; ///< "DEVI"
+constexpr uint16_t INDEX_VERSION = 1;
+
+bool validHeader(const IndexHeader &header) {
+  return header.magic == INDEX_MAGIC && header.version == INDEX_VERSION &&
+         header.recordSize == sizeof(EventRecord);
+}
+
+bool pwriteAll(int fd, const void *data, size_t size, off_t offset) {
+  const auto *p = static_cast<const char *>(data);
+  while (size > 0) {
+    const ssize_t n = ::pwrite(fd, p, size, offset);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += n;
+    size -= static_cast<size_t>(n);
+    offset += n;
+  }
+  return true;
+}
+
+} // namespace
+
+int64_t packTimestamp(const std::string &timestamp) {
+  std::string digits;
+  for (char c : timestamp) {
+    if (std::isdigit(static_cast<unsigned char>(c))) {
+      digits += c;
+    } else if (c != '_' && c != '-' && c != ':' && c != 'T') {
+      return -1;
+    }
+  }
+  if (digits.size() == 8) {
+    digits += "000000";
+  }
+  if (digits.size() != 14) {
+    return -1;
+  }
+  return std::stoll(digits);
+}
+
+void setRecordText(char *field, size_t size, const std::string &value) {
+  std::memset(field, 0, size);
+  std::memcpy(field, value.data(), std::min(size, value.size()));
+}
+
+std::string recordText(const char *field, size_t size) {
+  return std::string(field, strnlen(field, size));
+}
+
+EventIndexWriter::EventIndexWriter(const std::string &path) : path_(path) {
+  if (path.empty()) {
+    throw std::invalid_argument("Event index path cannot be empty");
+  }
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    throw std::runtime_error("Cannot open event index " + path + ": " +
+                             std::strerror(errno));
+  }
+
+  struct stat st {};
+  ::fstat(fd_, &st);
+  IndexHeader header{};
+  if (st.st_size == 0) {
+    if (!writeHeader()) {
+      ::close(fd_);
+      throw std::runtime_error("Cannot initialize event index " + path);
+    }
+    return;
+  }
+  if (::pread(fd_, &header, sizeof(header), 0) != sizeof(header) ||
+      !validHeader(header)) {
+    ::close(fd_);
+    throw std::runtime_error(path + " is not an event index");
+  }
+
+  // A torn last record is dropped and overwritten by the next append
+  count_ = static_cast<uint64_t>(st.st_size) / sizeof(EventRecord) - 1;
+  sortedCount_ = std::min<uint64_t>(header.sortedCount, count_);
+  if (count_ > 0) {
+    EventRecord last{};
+    ::pread(fd_, &last, sizeof(last),
+            static_cast<off_t>(count_ * sizeof(EventRecord)));
+    lastTime_ = last.time;
+  }
+}
+
+EventIndexWriter::~EventIndexWriter() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+bool EventIndexWriter::append(const std::vector<EventRecord> &records) {
+  if (records.empty()) {
+    return true;
+  }
+  const off_t offset = static_cast<off_t>((count_ + 1) * sizeof(EventRecord));
+  if (!pwriteAll(fd_, records.data(), records.size() * sizeof(EventRecord),
+                 offset)) {
+    return false;
+  }
+  for (const auto &record : records) {
+    if (sortedCount_ == count_ && record.time >= lastTime_) {
+      ++sortedCount_;
+    }
+    lastTime_ = record.time;
+    ++count_;
+  }
+  return true;
+}
+
+bool EventIndexWriter::sync() {
+  // Records first: a stale header only makes readers scan more
+  return ::fdatasync(fd_) == 0 && writeHeader() && ::fdatasync(fd_) == 0;
+}
+
+bool EventIndexWriter::writeHeader() {
+  IndexHeader header{};
+  header.magic = INDEX_MAGIC;
+  header.version = INDEX_VERSION;
+  header.recordSize = sizeof(EventRecord);
+  header.sortedCount = sortedCount_;
+  return pwriteAll(fd_, &header, sizeof(header), 0);
+}
+
+EventIndexReader::EventIndexReader(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open event index " + path + ": " +
+                             std::strerror(errno));
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(IndexHeader)) {
+    ::close(fd);
+    throw std::runtime_error(path + " is not an event index");
+  }
+  mapBytes_ = static_cast<size_t>(st.st_size);
+  map_ = ::mmap(nullptr, mapBytes_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    throw std::runtime_error("Cannot map event index " + path);
+  }
+
+  const auto *header = static_cast<const IndexHeader *>(map_);
+  if (!validHeader(*header)) {
+    ::munmap(map_, mapBytes_);
+    map_ = nullptr;
+    throw std::runtime_error(path + " is not an event index");
+  }
+  records_ = reinterpret_cast<const EventRecord *>(header + 1);
+  count_ = mapBytes_ / sizeof(EventRecord) - 1;
+  sortedCount_ = std::min<size_t>(header->sortedCount, count_);
+}
+
+EventIndexReader::~EventIndexReader() {
+  if (map_ != nullptr) {
+    ::munmap(map_, mapBytes_);
+  }
+}
+
+std::vector<const EventRecord *> EventIndexReader::range(int64_t from,
+                                                         int64_t to) const {
+  std::vector<const EventRecord *> result;
+  const EventRecord *sortedEnd = records_ + sortedCount_;
+  const EventRecord *first = std::lower_bound(
+      records_, sortedEnd, from,
+      [](const EventRecord &r, int64_t t) { return r.time < t; });
+  for (const EventRecord *r = first; r != sortedEnd && r->time <= to; ++r) {
+    result.push_back(r);
+  }
+  for (const EventRecord *r = sortedEnd; r != records_ + count_; ++r) {
+    if (r->time >= from && r->time <= to) {
+      result.push_back(r);
+    }
+  }
+  return result;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file EventIndex.hpp
+ * @brief Compact binary index of logged events for fast range queries
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @struct EventRecord
+ * @brief Fixed-size index entry describing one event log line
+ *
+ * Stored in native (little-endian) byte order. Text fields are truncated
+ * and zero-padded.
+ */
+struct EventRecord {
+  int64_t time;       ///< Event time as YYYYMMDDhhmmss
+  uint64_t csvOffset; ///< Byte offset of the event's line in the CSV log
+  uint32_t csvLength; ///< Length of that line including the newline
+  int32_t speed;      ///< Vehicle speed in km/h
+  char trigger[16];   ///< Trigger source ("CAN", "GPIO_BUTTON", ...)
+  char warning[24];   ///< Warning type
+};
+static_assert(sizeof(EventRecord) == 64, "EventRecord must stay 64 bytes");
+
+/**
+ * @brief Converts a "YYYYMMDD_HHMMSS" timestamp into YYYYMMDDhhmmss
+ * @param timestamp Timestamp as produced by currentTimestamp(); the time
+ * part is optional ("YYYYMMDD") and the underscore may be omitted
+ * @return Packed time, or -1 if timestamp is malformed
+ */
+int64_t packTimestamp(const std::string &timestamp);
+
+/**
+ * @brief Copies a string into a fixed-size, zero-padded record field
+ * @param field Destination field
+ * @param size Size of the field in bytes
+ * @param value String to store (truncated if longer than size)
+ */
+void setRecordText(char *field, size_t size, const std::string &value);
+
+/**
+ * @brief Reads a fixed-size record field back into a string
+ * @param field Source field
+ * @param size Size of the field in bytes
+ * @return Field contents without padding
+ */
+std::string recordText(const char *field, size_t size);
+
+/**
+ * @class EventIndexWriter
+ * @brief Appends EventRecords to an index file
+ *
+ * The file starts with a header holding the length of its sorted prefix:
+ * records appended in time order extend it, so queries can binary-search
+ * the prefix and only scan records written after the clock went backwards.
+ * A torn trailing record is ignored by readers and overwritten on the next
+ * open.
+ *
+ * @note Thread Safety: Not thread-safe; owned by the CSVLogger writer thread.
+ */
+class EventIndexWriter final {
+public:
+  /**
+   * @brief Opens (or creates) an index file for appending
+   * @param path Path of the index file
+   * @throws std::invalid_argument if path is empty
+   * @throws std::runtime_error if the file cannot be opened or is not an
+   * event index
+   */
+  explicit EventIndexWriter(const std::string &path);
+  ~EventIndexWriter();
+
+  EventIndexWriter(const EventIndexWriter &) = delete;
+  EventIndexWriter &operator=(const EventIndexWriter &) = delete;
+
+  /**
+   * @brief Writes records after the existing ones (not yet durable)
+   * @param records Records to append
+   * @return true on success
+   */
+  bool append(const std::vector<EventRecord> &records);
+
+  /**
+   * @brief Makes appended records and the header durable
+   * @return true on success
+   */
+  bool sync();
+
+private:
+  bool writeHeader();
+
+  const std::string path_;   ///< Index file path
+  int fd_ = -1;              ///< Open index file
+  uint64_t count_ = 0;       ///< Complete records in the file
+  uint64_t sortedCount_ = 0; ///< Length of the time-sorted prefix
+  int64_t lastTime_ = 0;     ///< Time of the last record
+};
+
+/**
+ * @class EventIndexReader
+ * @brief Memory-maps an index file and answers time-range queries
+ *
+ * @note Thread Safety: Immutable after construction; safe to share.
+ */
+class EventIndexReader final {
+public:
+  /**
+   * @brief Maps an index file read-only
+   * @param path Path of the index file
+   * @throws std::runtime_error if the file cannot be mapped or is not an
+   * event index
+   */
+  explicit EventIndexReader(const std::string &path);
+  ~EventIndexReader();
+
+  EventIndexReader(const EventIndexReader &) = delete;
+  EventIndexReader &operator=(const EventIndexReader &) = delete;
+
+  /**
+   * @brief Returns the records with from <= time <= to
+   * @param from Packed start time (inclusive)
+   * @param to Packed end time (inclusive)
+   * @return Pointers into the mapping; binary search over the sorted prefix
+   * followed by a scan of the unsorted tail
+   */
+  std::vector<const EventRecord *> range(int64_t from, int64_t to) const;
+
+  /** @brief Number of complete records in the index */
+  size_t size() const { return count_; }
+
+  /** @brief Length of the time-sorted prefix */
+  size_t sortedSize() const { return sortedCount_; }
+
+private:
+  void *map_ = nullptr;                 ///< Mapping of the whole file
+  size_t mapBytes_ = 0;                 ///< Size of the mapping
+  const EventRecord *records_ = nullptr; ///< First record in the mapping
+  size_t count_ = 0;                    ///< Complete records
+  size_t sortedCount_ = 0;              ///< Sorted prefix length
+};
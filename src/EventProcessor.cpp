@@ -0,0 +1,141 @@
+#include "EventProcessor.hpp"
+#include "Metrics.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <sys/file.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+EventProcessor::EventProcessor(PipelineReader *reader, EventExporter *exporter,
+                               const std::string &stagingDir,
+                               ExportThrottle *throttle)
+    : reader_(reader), exporter_(exporter), stagingDir_(stagingDir),
+      throttle_(throttle) {
+  if (reader == nullptr || exporter == nullptr) {
+    throw std::invalid_argument("EventProcessor needs a PipelineReader and "
+                                "an EventExporter");
+  }
+  if (stagingDir.empty()) {
+    throw std::invalid_argument("Staging directory cannot be empty");
+  }
+}
+
+void EventProcessor::run() {
+  std::filesystem::create_directories(stagingDir_);
+  // Kept open for the life of the process
+  const std::string lockPath = stagingDir_ + "/processor.lock";
+  const int lockFd =
+      ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lockFd >= 0 && ::flock(lockFd, LOCK_EX | LOCK_NB) != 0) {
+    std::cerr << "Waiting for the other event processor to exit" << std::endl;
+    ::flock(lockFd, LOCK_EX);
+  }
+
+  Metrics &metrics = Metrics::instance();
+  std::atomic<int64_t> &missedTotal =
+      metrics.value("dacl_pipeline_missed_total");
+  recover(); // Whatever was staged while no processor ran
+  int64_t instance = 0;
+  uint64_t missed = 0;
+  while (true) {
+    if (reader_->poll()) {
+      if (reader_->instance() != instance) {
+        instance = reader_->instance();
+        missed = 0;
+        std::cerr << "Event processor attached to the capture daemon"
+                  << std::endl;
+        recover(); // Staged before the attachment
+      }
+      speed_ = reader_->vehicle().speed;
+      if (throttle_ != nullptr) {
+        int64_t latencyUs = 0;
+        int backlogPermille = 0;
+        reader_->pressure(latencyUs, backlogPermille);
+        throttle_->recordWriteLatency(latencyUs);
+        throttle_->recordBacklog(static_cast<size_t>(backlogPermille), 1000);
+      }
+      PipelineEvent event;
+      while (reader_->next(event)) {
+        // Already exported if recover() came across it
+        process(stagedEventName(instance, event.sequence),
+                reader_->canFrames());
+      }
+      if (reader_->missed() > missed) {
+        missedTotal += static_cast<int64_t>(reader_->missed() - missed);
+        missed = reader_->missed();
+        recover();
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+  }
+}
+
+void EventProcessor::recover() {
+  std::vector<std::string> names;
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(stagingDir_, ec)) {
+    if (entry.is_directory(ec)) {
+      names.push_back(entry.path().filename().string());
+    }
+  }
+  // Names sort in staging order
+  std::sort(names.begin(), names.end());
+  const auto now = std::filesystem::file_time_type::clock::now();
+  // Frames of an earlier daemon are gone; its bundles carry no CAN data
+  std::string prefix;
+  if (reader_->instance() != 0) {
+    prefix = stagedEventName(reader_->instance(), 0);
+    prefix.erase(prefix.find('_') + 1);
+  }
+  for (const auto &name : names) {
+    const bool sameDaemon = !prefix.empty() && name.rfind(prefix, 0) == 0;
+    if (process(name, sameDaemon ? reader_->canFrames() : nullptr)) {
+      ++Metrics::instance().value("dacl_processor_recovered_total");
+      continue;
+    }
+    const std::string dir = stagingDir_ + "/" + name;
+    const auto mtime = std::filesystem::last_write_time(dir, ec);
+    if (!ec && now - mtime > std::chrono::seconds(TORN_SECONDS)) {
+      std::cerr << "Warning: Removing incomplete staged event " << dir
+                << std::endl;
+      std::filesystem::remove_all(dir, ec);
+    }
+  }
+}
+
+bool EventProcessor::process(const std::string &name,
+                             const CanFrameRing *canFrames) {
+  const std::string dir = stagingDir_ + "/" + name;
+  EventInfo event;
+  std::vector<EventCamera> cameras;
+  if (!loadStagedEvent(dir, event, cameras)) {
+    return false;
+  }
+  Metrics &metrics = Metrics::instance();
+  if (event.triggerUs > 0) {
+    metrics.value("dacl_processor_lag_ms") =
+        std::max<int64_t>(0, wallClockMicros() - event.triggerUs) / 1000;
+  }
+  busy_ = true;
+  try {
+    exporter_->exportEvent(event, cameras, canFrames);
+    ++metrics.value("dacl_processor_events_total");
+  } catch (const std::exception &e) {
+    // Not retried: a failure that repeats would block all later events
+    std::cerr << "Warning: Export of event " << event.warningType << " at "
+              << event.timestamp << " failed: " << e.what() << std::endl;
+    ++metrics.value("dacl_processor_failures_total");
+  }
+  busy_ = false;
+  cameras.clear();
+  std::error_code ec;
+  std::filesystem::remove_all(dir, ec);
+  return true;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file EventProcessor.hpp
+ * @brief Event export in a process separate from capture (pipeline=split)
+ */
+
+#pragma once
+#include "EventExporter.hpp"
+#include "ExportThrottle.hpp"
+#include "PipelineRing.hpp"
+#include <atomic>
+#include <string>
+
+/**
+ * @class EventProcessor
+ * @brief Exports the events the capture daemon publishes in the pipeline
+ * ring
+ *
+ * Runs in `dacl --processor`, which the daemon starts and restarts when it
+ * exits, so overlay rendering, ffmpeg exports, event logging and bundles
+ * can crash, hang or be restarted without touching recording:
+ * - Follows the ring and exports each event from its staging directory,
+ *   taking the bundle's CAN frames from the daemon's shared ring
+ * - On startup, after a daemon restart and when events were overwritten
+ *   before they were read, first exports every staged event it finds, so
+ *   none is lost while no processor runs; staged events without event.ini
+ *   older than TORN_SECONDS are left over from a crash and are removed
+ * - Forwards the recorders' write latency and pipe backlog to the export
+ *   throttle of its process
+ * - Holds `<stagingDir>/processor.lock`, so a second processor waits
+ *
+ * @note Thread Safety: run() owns the reader; busy() and vehicleSpeed()
+ * may be called from any thread.
+ */
+class EventProcessor final {
+public:
+  /**
+   * @brief Constructs the processor
+   * @param reader Pipeline of the capture daemon (non-owning)
+   * @param exporter Exports the events (non-owning)
+   * @param stagingDir Directory of staged events
+   * @param throttle Throttle receiving the recorders' pressure (nullptr =
+   * none)
+   * @throws std::invalid_argument if a pointer is nullptr or stagingDir is
+   * empty
+   */
+  explicit EventProcessor(PipelineReader *reader, EventExporter *exporter,
+                          const std::string &stagingDir,
+                          ExportThrottle *throttle = nullptr);
+
+  /**
+   * @brief Main loop following the pipeline
+   * @note Runs indefinitely; should be executed in a dedicated thread
+   */
+  void run();
+
+  /** @brief True while an event is being exported */
+  bool busy() const { return busy_; }
+
+  /** @brief Vehicle speed last published by the daemon in km/h */
+  int vehicleSpeed() const { return speed_; }
+
+private:
+  /** @brief Exports all complete staged events, oldest first */
+  void recover();
+
+  /**
+   * @brief Exports one staged event and removes its staging directory
+   * @param name Name of the staging directory
+   * @param canFrames CAN history of the event's daemon, or nullptr
+   * @return false if the event is not (or no longer) staged completely
+   */
+  bool process(const std::string &name, const CanFrameRing *canFrames);
+
+  PipelineReader *const reader_;   ///< Daemon's pipeline
+  EventExporter *const exporter_;  ///< Exports the events
+  const std::string stagingDir_;   ///< Directory of staged events
+  ExportThrottle *const throttle_; ///< Receives pressure, or nullptr
+  std::atomic<bool> busy_{false};  ///< Set during an export
+  std::atomic<int> speed_{0};      ///< Vehicle speed from the daemon
+
+  static constexpr int POLL_INTERVAL_MS = 50; ///< Ring polling period
+  static constexpr int TORN_SECONDS =
+      60; ///< Age of an incomplete staged event that is removed
+};
@@ -0,0 +1,137 @@
+#include "ExportThrottle.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+constexpr double BYTES_PER_MB = 1024.0 * 1024.0;
+
+/// Raises value to at least candidate
+template <typename T> void raiseTo(std::atomic<T> &value, T candidate) {
+  T current = value.load(std::memory_order_relaxed);
+  while (candidate > current &&
+         !value.compare_exchange_weak(current, candidate,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+/// Bandwidth ceiling in bytes per second, once all limits are checked
+double checkedMaxRate(int latencyTargetMs, int minMBps, int maxMBps,
+                      size_t maxConcurrency) {
+  if (latencyTargetMs <= 0 || minMBps <= 0 || maxMBps <= 0 ||
+      maxConcurrency == 0) {
+    throw std::invalid_argument("Export throttle limits must be positive");
+  }
+  if (minMBps > maxMBps) {
+    throw std::invalid_argument(
+        "Export throttle minimum exceeds the maximum bandwidth");
+  }
+  return maxMBps * BYTES_PER_MB;
+}
+
+} // namespace
+
+ExportThrottle::ExportThrottle(int latencyTargetMs, int minMBps, int maxMBps,
+                               size_t maxConcurrency,
+                               ProcessSupervisor *supervisor)
+    : latencyTargetUs_(static_cast<int64_t>(latencyTargetMs) * 1000),
+      minBytesPerSec_(minMBps * BYTES_PER_MB),
+      maxBytesPerSec_(maxMBps * BYTES_PER_MB),
+      maxConcurrency_(maxConcurrency), supervisor_(supervisor),
+      concurrency_(maxConcurrency),
+      bucket_(checkedMaxRate(latencyTargetMs, minMBps, maxMBps,
+                             maxConcurrency),
+              BURST_SECONDS) {}
+
+void ExportThrottle::recordWriteLatency(int64_t micros) {
+  raiseTo(windowLatencyUs_, micros);
+}
+
+void ExportThrottle::recordBacklog(size_t queuedBytes, size_t capacityBytes) {
+  if (capacityBytes > 0) {
+    raiseTo(windowBacklogPermille_,
+            static_cast<int>(std::min<size_t>(
+                1000, queuedBytes * 1000 / capacityBytes)));
+  }
+}
+
+void ExportThrottle::drainPressure(int64_t &latencyUs,
+                                   int &backlogPermille) {
+  latencyUs = windowLatencyUs_.exchange(0);
+  backlogPermille = windowBacklogPermille_.exchange(0);
+}
+
+bool ExportThrottle::tryAcquire(size_t bytes) {
+  demand_.store(true, std::memory_order_relaxed);
+  return bucket_.tryAcquire(bytes);
+}
+
+void ExportThrottle::acquire(size_t bytes) {
+  demand_.store(true, std::memory_order_relaxed);
+  bucket_.acquire(bytes);
+}
+
+void ExportThrottle::adjust() {
+  const int64_t latencyUs = windowLatencyUs_.exchange(0);
+  const int backlog = windowBacklogPermille_.exchange(0);
+  const bool demand = demand_.exchange(false);
+  const bool congested = latencyUs > latencyTargetUs_ ||
+                         backlog >= CONGESTED_BACKLOG_PERMILLE;
+  const bool severe =
+      latencyUs > latencyTargetUs_ * SEVERE_LATENCY_FACTOR ||
+      backlog >= SEVERE_BACKLOG_PERMILLE;
+
+  Metrics &metrics = Metrics::instance();
+  // Only this thread changes the rate and the concurrency limit
+  double rate = bucket_.rate();
+  if (congested) {
+    rate = std::max(minBytesPerSec_, rate / 2);
+    concurrency_ = std::max<size_t>(1, concurrency_ / 2);
+    ++metrics.value("dacl_export_congestion_total");
+  } else {
+    rate = std::min(maxBytesPerSec_, rate + maxBytesPerSec_ / 16);
+    concurrency_ = std::min(maxConcurrency_, concurrency_ + 1);
+  }
+  bucket_.setRate(rate);
+
+  if (supervisor_ != nullptr) {
+    if (severe) {
+      // Also catches overlays started since the last pause
+      if (supervisor_->pauseJob("overlay") > 0) {
+        overlaysPaused_ = true;
+      }
+    } else if (!congested && overlaysPaused_) {
+      supervisor_->resumeJob("overlay");
+      overlaysPaused_ = false;
+    }
+  }
+
+  // Held back: exports wanted to run while below full speed or paused
+  const bool throttled =
+      overlaysPaused_ ||
+      (demand && (rate < maxBytesPerSec_ || concurrency_ < maxConcurrency_));
+  if (throttled) {
+    metrics.value("dacl_export_throttled_ms_total") += CONTROL_INTERVAL_MS;
+  }
+  if (overlaysPaused_) {
+    metrics.value("dacl_export_paused_ms_total") += CONTROL_INTERVAL_MS;
+  }
+  metrics.value("dacl_export_rate_kbps") = static_cast<int64_t>(rate / 1024);
+  metrics.value("dacl_export_concurrency") =
+      static_cast<int64_t>(concurrency_.load());
+  metrics.value("dacl_recorder_write_latency_max_us") = latencyUs;
+  metrics.value("dacl_capture_backlog_permille") = backlog;
+}
+
+void ExportThrottle::run() {
+  while (!stopping_.load()) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(CONTROL_INTERVAL_MS));
+    adjust();
+  }
+}
+
+void ExportThrottle::stop() { stopping_ = true; }
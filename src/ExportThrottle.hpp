@@ -0,0 +1,131 @@
+/**
+ * @file ExportThrottle.hpp
+ * @brief Adaptive back-pressure on event export I/O, driven by the live
+ * recorder's write latency
+ */
+
+#pragma once
+#include "ProcessSupervisor.hpp"
+#include "TokenBucket.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class ExportThrottle
+ * @brief Slows event exports down while they hurt live recording
+ *
+ * The recorder reports how long each write into the segment muxer blocks
+ * and how full the capture source's pipe is; both rise when the storage
+ * device cannot keep up and frames are about to be dropped. Every control
+ * interval the throttle adjusts export limits AIMD-style:
+ * - congested (latency above target or source pipe mostly full): the
+ *   export bandwidth and the number of concurrent copy requests are halved
+ * - otherwise: bandwidth grows by a sixteenth of the maximum and
+ *   concurrency by one per interval
+ * - severely congested: overlay re-encodes are stopped (SIGSTOP) until the
+ *   congestion clears
+ *
+ * Export I/O draws from a token bucket refilled at the current rate. Time
+ * during which exports were held back is reported as
+ * `dacl_export_throttled_ms_total`, so storage can be sized from the data.
+ *
+ * @note Thread Safety: All methods are thread-safe. run() should be executed
+ * in a dedicated thread.
+ */
+class ExportThrottle final {
+public:
+  /**
+   * @brief Constructs the throttle at full speed
+   * @param latencyTargetMs Recorder write latency considered congested
+   * @param minMBps Lowest export bandwidth in MB/s
+   * @param maxMBps Highest export bandwidth in MB/s
+   * @param maxConcurrency Highest number of concurrent copy requests
+   * @param supervisor Supervisor whose overlay jobs are paused under severe
+   * congestion (nullptr = never pause)
+   * @throws std::invalid_argument if a limit is not positive or minMBps
+   * exceeds maxMBps
+   */
+  explicit ExportThrottle(int latencyTargetMs, int minMBps, int maxMBps,
+                          size_t maxConcurrency,
+                          ProcessSupervisor *supervisor = nullptr);
+
+  /**
+   * @brief Reports one write into the segment muxer
+   * @param micros Time the write blocked
+   * @note Called from the recording pipeline; lock-free
+   */
+  void recordWriteLatency(int64_t micros);
+
+  /**
+   * @brief Reports how much captured data waits to be consumed
+   * @param queuedBytes Bytes queued in the source pipe
+   * @param capacityBytes Capacity of the source pipe
+   * @note Called from the recording pipeline; lock-free
+   */
+  void recordBacklog(size_t queuedBytes, size_t capacityBytes);
+
+  /**
+   * @brief Takes the pressure reported since the last call
+   * @param[out] latencyUs Worst write latency
+   * @param[out] backlogPermille Fullest source pipe in permille
+   * @note Used instead of run() when the exports run in the event processor
+   * (pipeline=split): the capture daemon forwards the pressure through the
+   * pipeline ring to the processor's throttle
+   */
+  void drainPressure(int64_t &latencyUs, int &backlogPermille);
+
+  /**
+   * @brief Takes tokens for an export transfer if any are available
+   * @param bytes Size of the transfer
+   * @return false if the caller should retry later
+   */
+  bool tryAcquire(size_t bytes);
+
+  /**
+   * @brief Takes tokens for an export transfer, waiting for them if needed
+   * @param bytes Size of the transfer
+   */
+  void acquire(size_t bytes);
+
+  /** @brief Current limit of concurrent copy requests */
+  size_t concurrency() const { return concurrency_.load(); }
+
+  /**
+   * @brief Control loop adapting the limits
+   * @note Runs until stop(); should be executed in a dedicated thread
+   */
+  void run();
+
+  /** @brief Makes run() return after its current control interval */
+  void stop();
+
+private:
+  /** @brief One control step; called by run() */
+  void adjust();
+
+  const int64_t latencyTargetUs_;  ///< Congestion threshold
+  const double minBytesPerSec_;    ///< Bandwidth floor
+  const double maxBytesPerSec_;    ///< Bandwidth ceiling
+  const size_t maxConcurrency_;    ///< Concurrency ceiling
+  ProcessSupervisor *const supervisor_; ///< Pauses overlays, or nullptr
+
+  std::atomic<int64_t> windowLatencyUs_{0}; ///< Worst write this interval
+  std::atomic<int> windowBacklogPermille_{0}; ///< Fullest pipe this interval
+  std::atomic<bool> demand_{false}; ///< Export I/O requested this interval
+  std::atomic<size_t> concurrency_; ///< Current concurrency limit
+  std::atomic<bool> stopping_{false}; ///< Set by stop()
+
+  TokenBucket bucket_;          ///< Export I/O at the current bandwidth
+  bool overlaysPaused_ = false; ///< Overlay jobs are stopped
+
+  static constexpr int CONTROL_INTERVAL_MS = 200; ///< Control loop period
+  static constexpr double BURST_SECONDS =
+      0.1; ///< Token bucket depth in seconds of the current rate
+  static constexpr int CONGESTED_BACKLOG_PERMILLE =
+      750; ///< Source pipe fill level treated as congestion
+  static constexpr int SEVERE_BACKLOG_PERMILLE =
+      900; ///< Source pipe fill level that pauses overlays
+  static constexpr int SEVERE_LATENCY_FACTOR =
+      4; ///< Latency target multiple that pauses overlays
+};
@@ -1,14 +1,22 @@
 #include "FileManager.hpp"
+#include "FrameIndex.hpp"
+#include "Tracer.hpp"
+#include "utils.hpp"
+#include <algorithm>
 #include <chrono>
-#include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <stdexcept>
 #include <thread>
 
 FileManager::FileManager(const std::string &bufferDir,
-                         const std::string &eventDir)
-    : bufferDir_(bufferDir), eventDir_(eventDir) {
+                         const std::string &eventDir,
+                         ProcessSupervisor *supervisor, CopyEngine *copier,
+                         ExportThrottle *throttle)
+    : bufferDir_(bufferDir), eventDir_(eventDir),
+      eventManifest_(eventDir + "/segments.manifest"),
+      supervisor_(supervisor), copier_(copier), throttle_(throttle) {
   // Input validation
   if (bufferDir.empty()) {
     throw std::invalid_argument("Buffer directory path cannot be empty");
@@ -29,13 +37,27 @@ FileManager::FileManager(const std::string &bufferDir,
     throw std::filesystem::filesystem_error(
         "Cannot access or create event directory", eventDir_, ec);
   }
+
+  // Drop journal entries of event files deleted by retention meanwhile
+  std::vector<SegmentInfo> exported = eventManifest_.replay();
+  exported.erase(std::remove_if(exported.begin(), exported.end(),
+                                [](const SegmentInfo &info) {
+                                  std::error_code existsEc;
+                                  return !std::filesystem::exists(info.path,
+                                                                  existsEc);
+                                }),
+                 exported.end());
+  if (eventManifest_.existed()) {
+    eventManifest_.compact(exported);
+  }
 }
 
-void FileManager::copyEventSegments(const std::vector<std::string> &segments,
+void FileManager::copyEventSegments(const std::vector<SegmentHandle> &segments,
                                     const std::string &warningType,
                                     const std::string &timestamp,
                                     const std::string &overlayFile,
                                     const std::string &suffix) {
+  TraceScope span("files", "export_segments");
   // Input validation
   if (segments.empty()) {
     throw std::invalid_argument("Segments list cannot be empty");
@@ -52,6 +74,10 @@ void FileManager::copyEventSegments(const std::vector<std::string> &segments,
   if (suffix.empty()) {
     throw std::invalid_argument("Suffix cannot be empty");
   }
+  if (supervisor_ == nullptr || copier_ == nullptr) {
+    throw std::runtime_error("No process supervisor or copy engine for "
+                             "event export");
+  }
 
   // Ensure the event directory exists
   std::error_code ec;
@@ -60,37 +86,92 @@ void FileManager::copyEventSegments(const std::vector<std::string> &segments,
                              ec.message());
   }
 
+  // All segments are copied concurrently by the copy engine
+  std::vector<std::pair<std::string, std::string>> copies;
   for (size_t i = 0; i < segments.size(); ++i) {
-    const std::string dest = eventDir_ + "/" + timestamp + "_" + warningType +
-                             "_" + suffix + "_" + std::to_string(i) + ".mp4";
+    copies.emplace_back(segments[i].path(),
+                        eventDir_ + "/" + timestamp + "_" + warningType + "_" +
+                            suffix + "_" + std::to_string(i) + ".mp4");
+  }
+  std::vector<int> copyErrors;
+  {
+    TraceScope copySpan("files", "copy");
+    copyErrors = copier_->copyAll(copies);
+  }
 
-    // Copy file with error checking
-    try {
-      std::filesystem::copy(segments[i], dest,
-                            std::filesystem::copy_options::overwrite_existing);
-    } catch (const std::filesystem::filesystem_error &e) {
-      throw std::runtime_error("Failed to copy segment " + segments[i] +
-                               " to " + dest + ": " + e.what());
+  std::string firstFailure;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const std::string &dest = copies[i].second;
+    if (copyErrors[i] != 0) {
+      // The other segments are still exported
+      if (firstFailure.empty()) {
+        firstFailure = "Failed to copy segment " + segments[i].path() +
+                       " to " + dest + ": " + std::strerror(copyErrors[i]);
+      }
+      continue;
     }
 
-    // Apply overlay using ffmpeg - improved command construction and error
-    // handling
+    // Apply overlay using ffmpeg; the image is a second input rather than a
+    // movie= filter so paths need no filtergraph escaping
     const std::string tempDest = dest + "_temp.mp4";
-    const std::string cmd =
-        "ffmpeg -y -i " + dest + " -vf \"movie=" + overlayFile +
-        " [overlay]; [in][overlay] overlay=0:0 [out]\" -codec:a copy " +
-        tempDest + " && mv " + tempDest + " " + dest;
-
-    const int ret = std::system(cmd.c_str());
-    if (ret != 0) {
-      std::cerr << "Warning: ffmpeg overlay command failed for " << dest
-                << " (return code: " << ret << ")" << std::endl;
+    SpawnOptions options;
+    options.job = "overlay";
+    options.captureStderr = true;
+    options.timeoutMs = OVERLAY_TIMEOUT_MS;
+    TraceScope overlaySpan("files", "overlay_ffmpeg");
+    const ProcessResult result = supervisor_->run(
+        {"ffmpeg", "-hide_banner", "-loglevel", "error", "-y", "-i", dest,
+         "-i", overlayFile, "-filter_complex", "[0:v][1:v]overlay=0:0",
+         "-codec:a", "copy", tempDest},
+        options);
+    if (result.ok()) {
+      std::filesystem::rename(tempDest, dest, ec);
+    }
+    if (!result.ok() || ec) {
+      std::cerr << "Warning: ffmpeg overlay failed for " << dest
+                << (result.timedOut ? " (timed out)" : "")
+                << " (exit code: " << result.exitCode << ")";
+      if (!result.errorOutput.empty()) {
+        std::cerr << ": " << result.errorOutput;
+      }
+      std::cerr << std::endl;
+      std::filesystem::remove(tempDest, ec);
       // Continue processing other segments even if overlay fails
     }
+
+    SegmentInfo exported = segments[i].info();
+    exported.path = dest;
+    exported.sizeBytes = std::filesystem::file_size(dest, ec);
+    eventManifest_.appendAdd(exported);
+  }
+  if (!firstFailure.empty()) {
+    throw std::runtime_error(firstFailure);
+  }
+}
+
+std::string
+FileManager::writeEventBundle(const std::string &warningType,
+                              const std::string &timestamp,
+                              const std::vector<BundleComponent> &components) {
+  TraceScope span("files", "write_bundle");
+  if (warningType.empty()) {
+    throw std::invalid_argument("Warning type cannot be empty");
+  }
+  if (timestamp.empty()) {
+    throw std::invalid_argument("Timestamp cannot be empty");
   }
+  // Shares the event key of the exported segments, so retention keeps or
+  // evicts the bundle with them
+  const std::string path =
+      eventDir_ + "/" + timestamp + "_" + warningType + ".dacl";
+  const uint64_t bytes = ::writeEventBundle(path, components, throttle_);
+  std::cerr << "Event bundle created: " << path << " (" << bytes / 1024
+            << " KiB)" << std::endl;
+  return path;
 }
 
-void FileManager::cleanOldSegments(int maxMinutes) {
+void FileManager::cleanOldSegments(const std::string &bufferDir,
+                                   int maxMinutes, const PinCheck &isPinned) {
   // Input validation
   if (maxMinutes <= 0) {
     throw std::invalid_argument("maxMinutes must be positive");
@@ -100,24 +181,34 @@ void FileManager::cleanOldSegments(int maxMinutes) {
   const auto now = system_clock::now();
 
   std::error_code ec;
-  if (!std::filesystem::exists(bufferDir_, ec)) {
+  if (!std::filesystem::exists(bufferDir, ec)) {
     if (ec) {
       throw std::filesystem::filesystem_error("Cannot access buffer directory",
-                                              bufferDir_, ec);
+                                              bufferDir, ec);
     }
     return; // Directory doesn't exist, nothing to clean
   }
 
-  for (const auto &entry :
-       std::filesystem::directory_iterator(bufferDir_, ec)) {
+  // Recursive, since each camera of a multi-camera setup has a subdirectory
+  const std::filesystem::recursive_directory_iterator end;
+  for (auto it = std::filesystem::recursive_directory_iterator(bufferDir, ec);
+       it != end; it.increment(ec)) {
     if (ec) {
-      std::cerr << "Warning: Error iterating directory " << bufferDir_ << ": "
+      std::cerr << "Warning: Error iterating directory " << bufferDir << ": "
                 << ec.message() << std::endl;
+      break;
+    }
+    const auto &entry = *it;
+    if (entry.path().filename() == PIPELINE_STAGING_DIR) {
+      it.disable_recursion_pending(); // Staged events belong to the processor
       continue;
     }
 
-    if (!entry.is_regular_file()) {
-      continue; // Skip non-regular files
+    if (!entry.is_regular_file() || entry.path().extension() != ".mp4") {
+      continue; // Skip non-regular files and the segment manifest
+    }
+    if (isPinned && isPinned(entry.path().string())) {
+      continue; // Still referenced by an event export
     }
 
     try {
@@ -130,7 +221,7 @@ void FileManager::cleanOldSegments(int maxMinutes) {
           std::chrono::duration_cast<std::chrono::minutes>(now - sctp);
 
       if (age.count() > maxMinutes) {
-        std::filesystem::remove(entry, ec);
+        removeSegmentFiles(entry.path().string(), ec);
         if (ec) {
           std::cerr << "Warning: Failed to remove old segment " << entry.path()
                     << ": " << ec.message() << std::endl;
@@ -4,6 +4,11 @@
  */
 
 #pragma once
+#include "CopyEngine.hpp"
+#include "EventBundle.hpp"
+#include "ProcessSupervisor.hpp"
+#include "Segment.hpp"
+#include "SegmentManifest.hpp"
 #include <string>
 #include <vector>
 
@@ -12,10 +17,14 @@
  * @brief Manages file operations for video segments and event archival
  *
  * This class handles:
- * - Copying video segments from buffer to event directory
+ * - Copying video segments from buffer to event directory, concurrently
+ *   through the CopyEngine
  * - Applying overlays to video files using ffmpeg
  * - Cleaning up old video segments to maintain storage limits
  * - File naming conventions for event videos
+ * - Journaling exported segments, with their signal summaries, in
+ *   `<eventDir>/segments.manifest` for segment search
+ * - Writing single-file event bundles (`<timestamp>_<warning>.dacl`)
  *
  * @note This class performs file I/O operations and may throw filesystem
  * exceptions
@@ -26,42 +35,76 @@ public:
    * @brief Constructs a FileManager with specified directories
    * @param bufferDir Source directory containing buffered video segments
    * @param eventDir Destination directory for saved event videos
+   * @param supervisor Process supervisor running the overlay ffmpeg jobs
+   * @param copier Copy engine copying the segments
+   * @param throttle Export throttle limiting event bundle writes (optional)
+   * @note supervisor and copier may be nullptr if copyEventSegments() is not
+   * used
    * @throws std::invalid_argument if either directory path is empty
    * @throws std::filesystem::filesystem_error if directories cannot be accessed
    */
   explicit FileManager(const std::string &bufferDir,
-                       const std::string &eventDir);
+                       const std::string &eventDir,
+                       ProcessSupervisor *supervisor = nullptr,
+                       CopyEngine *copier = nullptr,
+                       ExportThrottle *throttle = nullptr);
 
   /**
    * @brief Copies and processes video segments for event archival
-   * @param segments List of video segment filenames to copy
+   * @param segments Pinned handles of the video segments to copy
    * @param warningType Type of warning that triggered the event
    * @param timestamp Formatted timestamp for file naming (YYYYMMDD_HHMMSS)
    * @param overlayFile Path to overlay image file for video annotation
    * @param suffix File naming suffix ("pretrigger" or "posttrigger")
-   * @throws std::runtime_error if copy operations fail
+   * @throws std::runtime_error if a copy fails (after exporting the other
+   * segments) or no supervisor or copy engine was given
    * @throws std::invalid_argument if any parameter is empty
    *
-   * @note Uses ffmpeg subprocess to apply overlays to copied video files
+   * @note Uses a supervised ffmpeg process to apply overlays to copied video
+   * files; a failed or timed-out overlay leaves the plain copy in place
    */
-  void copyEventSegments(const std::vector<std::string> &segments,
+  void copyEventSegments(const std::vector<SegmentHandle> &segments,
                          const std::string &warningType,
                          const std::string &timestamp,
                          const std::string &overlayFile,
                          const std::string &suffix);
 
   /**
-   * @brief Removes old video segments from buffer directory
+   * @brief Writes an event bundle into the event directory
+   * @param warningType Type of warning that triggered the event
+   * @param timestamp Formatted timestamp for file naming (YYYYMMDD_HHMMSS)
+   * @param components Bundle components in the order they are written
+   * @return Path of the bundle
+   * @throws std::runtime_error if the bundle cannot be written
+   * @throws std::invalid_argument if warningType or timestamp is empty
+   */
+  std::string writeEventBundle(const std::string &warningType,
+                               const std::string &timestamp,
+                               const std::vector<BundleComponent> &components);
+
+  /**
+   * @brief Removes old video segments from a buffer directory
+   * @param bufferDir Buffer directory, searched recursively
    * @param maxMinutes Maximum age of segments to keep (in minutes)
+   * @param isPinned Optional predicate; files it reports as pinned are kept
+   * @throws std::invalid_argument if maxMinutes <= 0
    * @throws std::filesystem::filesystem_error if directory operations fail
    *
-   * @note This method is typically called by StorageManager to maintain buffer
-   * size
+   * @note Static, so StorageManager can clean the buffer without a
+   * FileManager and its event manifest
    */
-  void cleanOldSegments(int maxMinutes);
+  static void cleanOldSegments(const std::string &bufferDir, int maxMinutes,
+                               const PinCheck &isPinned = nullptr);
 
 private:
   const std::string
       bufferDir_;              ///< Source directory for buffered video segments
   const std::string eventDir_; ///< Destination directory for event videos
+  SegmentManifest eventManifest_; ///< Journal of exported event segments
+  ProcessSupervisor *const supervisor_; ///< Runs overlay jobs, or nullptr
+  CopyEngine *const copier_;            ///< Copies segments, or nullptr
+  ExportThrottle *const throttle_;      ///< Limits bundle writes, or nullptr
+
+  static constexpr int OVERLAY_TIMEOUT_MS =
+      300000; ///< Time limit of one overlay ffmpeg job
 };
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "FrameIndex.hpp"
+#include "MediaProbe.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/// On-disk header preceding the records
+struct FrameIndexHeader {
+  uint32_t magic;           ///< FRAME_INDEX_MAGIC
+  uint16_t version;         ///< FRAME_INDEX_VERSION
+  uint16_t recordSize;      ///< sizeof(FrameRecord)
+  uint64_t count;           ///< Number of records
+  int64_t startUs;          ///< Wall-clock time of the first frame
+  uint32_t frameIntervalNs; ///< Measured frame interval (0 = unknown)
+  uint8_t reserved[12];     ///< Pads the header to one record
+};
+static_assert(sizeof(FrameIndexHeader) == sizeof(FrameRecord),
+              "header occupies one record slot");
+
+constexpr uint32_t FRAME_INDEX_MAGIC = 0x58494644; ///< "DFIX"
+constexpr uint16_t FRAME_INDEX_VERSION = 1;
+
+bool writeAll(int fd, const void *data, size_t size) {
+  const auto *p = static_cast<const char *>(data);
+  while (size > 0) {
+    const ssize_t n = ::write(fd, p, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+} // namespace
+
+std::string frameIndexPath(const std::string &segmentPath) {
+  return segmentPath + ".idx";
+}
+
+size_t writeFrameIndex(const SegmentInfo &info) {
+  std::vector<MediaSample> samples = readFragmentSamples(info.path);
+  if (samples.empty()) {
+    return 0;
+  }
+  std::stable_sort(samples.begin(), samples.end(),
+                   [](const MediaSample &a, const MediaSample &b) {
+                     return a.ptsUs < b.ptsUs;
+                   });
+
+  // The muxer stamps frame n with n / framerate; the wall-clock time of
+  // frame n comes from the measured interval instead
+  const int64_t firstPtsUs = samples.front().ptsUs;
+  std::vector<FrameRecord> records(samples.size());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const MediaSample &sample = samples[i];
+    FrameRecord &record = records[i];
+    int64_t sinceStartUs = sample.ptsUs - firstPtsUs;
+    if (info.framerate > 0 && info.frameIntervalNs > 0) {
+      const int64_t frame =
+          std::llround(static_cast<double>(sinceStartUs) * info.framerate /
+                       1000000.0);
+      sinceStartUs = frame * info.frameIntervalNs / 1000;
+    }
+    record.ptsUs = sample.ptsUs;
+    record.systemUs = info.startUs + sinceStartUs;
+    record.canUs = info.canStartUs != 0 ? info.canStartUs + sinceStartUs : 0;
+    record.offset = sample.offset;
+    record.size = sample.size;
+    record.flags = sample.keyframe ? FRAME_KEYFRAME : 0;
+  }
+
+  FrameIndexHeader header{};
+  header.magic = FRAME_INDEX_MAGIC;
+  header.version = FRAME_INDEX_VERSION;
+  header.recordSize = sizeof(FrameRecord);
+  header.count = records.size();
+  header.startUs = info.startUs;
+  header.frameIntervalNs = info.frameIntervalNs;
+
+  const std::string path = frameIndexPath(info.path);
+  const std::string tmpPath = path + ".tmp";
+  const int fd =
+      ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::perror(("open " + tmpPath).c_str());
+    return 0;
+  }
+  const bool written =
+      writeAll(fd, &header, sizeof(header)) &&
+      writeAll(fd, records.data(), records.size() * sizeof(FrameRecord));
+  ::close(fd);
+  if (!written || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    std::perror(("write " + path).c_str());
+    std::remove(tmpPath.c_str());
+    return 0;
+  }
+  return records.size();
+}
+
+bool removeSegmentFiles(const std::string &segmentPath, std::error_code &ec) {
+  std::error_code indexEc;
+  std::filesystem::remove(frameIndexPath(segmentPath), indexEc);
+  return std::filesystem::remove(segmentPath, ec);
+}
+
+FrameIndex::FrameIndex(const std::string &segmentPath) {
+  const std::string path = frameIndexPath(segmentPath);
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open frame index " + path + ": " +
+                             std::strerror(errno));
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(FrameIndexHeader)) {
+    ::close(fd);
+    throw std::runtime_error(path + " is not a frame index");
+  }
+  mapBytes_ = static_cast<size_t>(st.st_size);
+  map_ = ::mmap(nullptr, mapBytes_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    throw std::runtime_error("Cannot map frame index " + path);
+  }
+
+  const auto *header = static_cast<const FrameIndexHeader *>(map_);
+  if (header->magic != FRAME_INDEX_MAGIC ||
+      header->version != FRAME_INDEX_VERSION ||
+      header->recordSize != sizeof(FrameRecord)) {
+    ::munmap(map_, mapBytes_);
+    map_ = nullptr;
+    throw std::runtime_error(path + " is not a frame index");
+  }
+  records_ = reinterpret_cast<const FrameRecord *>(header + 1);
+  count_ = std::min<size_t>(header->count,
+                            mapBytes_ / sizeof(FrameRecord) - 1);
+}
+
+FrameIndex::~FrameIndex() {
+  if (map_ != nullptr) {
+    ::munmap(map_, mapBytes_);
+  }
+}
+
+size_t FrameIndex::findSystemTime(int64_t systemUs) const {
+  const FrameRecord *end = records_ + count_;
+  const FrameRecord *next = std::upper_bound(
+      records_, end, systemUs,
+      [](int64_t t, const FrameRecord &r) { return t < r.systemUs; });
+  return next == records_ ? count_ : static_cast<size_t>(next - records_) - 1;
+}
+
+size_t FrameIndex::findCanTime(int64_t canUs) const {
+  if (count_ == 0 || records_[0].canUs == 0) {
+    return count_;
+  }
+  const FrameRecord *end = records_ + count_;
+  const FrameRecord *next = std::upper_bound(
+      records_, end, canUs,
+      [](int64_t t, const FrameRecord &r) { return t < r.canUs; });
+  return next == records_ ? count_ : static_cast<size_t>(next - records_) - 1;
+}
+
+size_t FrameIndex::keyframeBefore(size_t i) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  for (size_t k = std::min(i, count_ - 1) + 1; k-- > 0;) {
+    if (records_[k].flags & FRAME_KEYFRAME) {
+      return k;
+    }
+  }
+  return 0;
+}
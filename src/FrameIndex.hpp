@@ -0,0 +1,120 @@
+/**
+ * @file FrameIndex.hpp
+ * @brief Per-segment sidecar mapping wall-clock and CAN time to frames
+ */
+
+#pragma once
+#include "Segment.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+/**
+ * @struct FrameRecord
+ * @brief Fixed-size sidecar entry describing one frame of a segment
+ *
+ * Stored in native (little-endian) byte order, sorted by presentation time.
+ */
+struct FrameRecord {
+  int64_t ptsUs;    ///< Presentation time in the segment file
+  int64_t systemUs; ///< Wall-clock time of the frame (us since epoch)
+  int64_t canUs;    ///< CAN clock time of the frame (us, 0 = none)
+  uint64_t offset;  ///< Byte offset of the frame data in the segment file
+  uint32_t size;    ///< Size of the frame data in bytes
+  uint32_t flags;   ///< FRAME_KEYFRAME
+};
+static_assert(sizeof(FrameRecord) == 40, "FrameRecord must stay 40 bytes");
+
+constexpr uint32_t FRAME_KEYFRAME = 1; ///< Decoding can start at this frame
+
+/**
+ * @brief Path of the frame index sidecar of a segment file
+ * @param segmentPath Path of the segment file
+ * @return segmentPath with ".idx" appended
+ */
+std::string frameIndexPath(const std::string &segmentPath);
+
+/**
+ * @brief Writes the frame index sidecar of a finished segment
+ * @param info Segment metadata: path, first-frame time, measured frame
+ * interval, nominal frame rate and CAN time of the first frame
+ * @return Number of frames indexed, or 0 if the segment could not be parsed
+ * or the sidecar could not be written
+ *
+ * Frame positions come from the fragment tables of the MP4 file (no media
+ * data is read). Frame n, counted in presentation order from the file's
+ * time stamps (n / framerate), is stamped info.startUs plus n measured frame
+ * intervals; the CAN time follows from info.canStartUs. The sidecar is
+ * written to a temporary file and renamed, so readers never see a partial
+ * index.
+ */
+size_t writeFrameIndex(const SegmentInfo &info);
+
+/**
+ * @brief Removes a segment file together with its frame index sidecar
+ * @param segmentPath Path of the segment file
+ * @param ec Receives the error of removing the segment file, if any
+ * @return true if the segment file was removed
+ */
+bool removeSegmentFiles(const std::string &segmentPath, std::error_code &ec);
+
+/**
+ * @class FrameIndex
+ * @brief Memory-maps a frame index sidecar and finds frames by time
+ *
+ * A lookup is a binary search over the mapped records, so locating the
+ * frame at a given instant and reading it costs O(log n) plus one read of
+ * the segment file, instead of demuxing the MP4.
+ *
+ * @note Thread Safety: Immutable after construction; safe to share.
+ */
+class FrameIndex final {
+public:
+  /**
+   * @brief Maps the sidecar of a segment read-only
+   * @param segmentPath Path of the segment file (not of the sidecar)
+   * @throws std::runtime_error if the sidecar cannot be mapped or is not a
+   * frame index
+   */
+  explicit FrameIndex(const std::string &segmentPath);
+  ~FrameIndex();
+
+  FrameIndex(const FrameIndex &) = delete;
+  FrameIndex &operator=(const FrameIndex &) = delete;
+
+  /** @brief Number of indexed frames */
+  size_t size() const { return count_; }
+
+  /** @brief Frame i in presentation order */
+  const FrameRecord &operator[](size_t i) const { return records_[i]; }
+
+  /**
+   * @brief Finds the frame shown at a wall-clock time
+   * @param systemUs Wall-clock time in microseconds since the epoch
+   * @return Index of the last frame at or before systemUs, or size() if
+   * systemUs precedes the first frame
+   */
+  size_t findSystemTime(int64_t systemUs) const;
+
+  /**
+   * @brief Finds the frame shown at a CAN clock time
+   * @param canUs CAN clock time in microseconds since the epoch
+   * @return Index of the last frame at or before canUs, or size() if the
+   * segment has no CAN time or canUs precedes the first frame
+   */
+  size_t findCanTime(int64_t canUs) const;
+
+  /**
+   * @brief Finds the keyframe decoding of a frame has to start from
+   * @param i Frame index
+   * @return Index of the last keyframe at or before frame i (0 if none)
+   */
+  size_t keyframeBefore(size_t i) const;
+
+private:
+  void *map_ = nullptr;                  ///< Mapping of the whole file
+  size_t mapBytes_ = 0;                  ///< Size of the mapping
+  const FrameRecord *records_ = nullptr; ///< First record in the mapping
+  size_t count_ = 0;                     ///< Complete records
+};
@@ -0,0 +1,228 @@
+#include "FrameTap.hpp"
+#include "utils.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t TAP_MAGIC = 0x50415444; ///< "DTAP"
+constexpr uint32_t TAP_VERSION = 1;
+constexpr int SLOT_COUNT = 3;
+constexpr size_t CACHE_LINE = 64;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "frame tap needs address-free 64-bit atomics");
+
+size_t alignUp(size_t n) { return (n + CACHE_LINE - 1) & ~(CACHE_LINE - 1); }
+
+} // namespace
+
+/// Per-slot seqlock and metadata, followed by the pixels
+struct alignas(64) FrameTapSlot {
+  std::atomic<uint64_t> seq; ///< Odd while the slot is being written
+  uint64_t frameNumber;      ///< Frame stored in the slot
+  int64_t timestampUs;       ///< Capture time of the stored frame
+};
+
+/// Layout of the start of the shared-memory segment
+struct alignas(64) FrameTapHeader {
+  uint32_t magic;            ///< TAP_MAGIC once initialized
+  uint32_t version;          ///< TAP_VERSION
+  uint32_t width;            ///< Frame width in pixels
+  uint32_t height;           ///< Frame height in pixels
+  uint64_t slotStride;       ///< Bytes between slot headers
+  std::atomic<uint64_t> latest; ///< (frameNumber << 2) | slot, 0 = none
+};
+
+namespace {
+
+FrameTapSlot *slotAt(FrameTapHeader *header, int index) {
+  auto *base = reinterpret_cast<uint8_t *>(header) + alignUp(sizeof(*header));
+  return reinterpret_cast<FrameTapSlot *>(base + index * header->slotStride);
+}
+
+const FrameTapSlot *slotAt(const FrameTapHeader *header, int index) {
+  return slotAt(const_cast<FrameTapHeader *>(header), index);
+}
+
+uint8_t *pixelsOf(FrameTapSlot *slot) {
+  return reinterpret_cast<uint8_t *>(slot) + alignUp(sizeof(*slot));
+}
+
+const uint8_t *pixelsOf(const FrameTapSlot *slot) {
+  return pixelsOf(const_cast<FrameTapSlot *>(slot));
+}
+
+size_t segmentBytes(size_t frameBytes) {
+  return alignUp(sizeof(FrameTapHeader)) +
+         SLOT_COUNT * (alignUp(sizeof(FrameTapSlot)) + alignUp(frameBytes));
+}
+
+} // namespace
+
+FrameTapWriter::FrameTapWriter(const std::string &name, int width, int height)
+    : name_(name), width_(width), height_(height),
+      frameBytes_(static_cast<size_t>(width) * height * 3) {
+  if (name.size() < 2 || name[0] != '/') {
+    throw std::invalid_argument("Frame tap name must start with '/'");
+  }
+  if (width <= 0 || height <= 0) {
+    throw std::invalid_argument("Frame tap dimensions must be positive");
+  }
+
+  // Start from a fresh segment; readers of an old one re-attach when it
+  // goes stale
+  ::shm_unlink(name_.c_str());
+  const int fd = ::shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot create frame tap " + name_ + ": " +
+                             std::strerror(errno));
+  }
+  mapBytes_ = segmentBytes(frameBytes_);
+  void *map = MAP_FAILED;
+  if (::ftruncate(fd, static_cast<off_t>(mapBytes_)) == 0) {
+    map = ::mmap(nullptr, mapBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                 0);
+  }
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    ::shm_unlink(name_.c_str());
+    throw std::runtime_error("Cannot map frame tap " + name_);
+  }
+
+  header_ = new (map) FrameTapHeader;
+  header_->width = static_cast<uint32_t>(width);
+  header_->height = static_cast<uint32_t>(height);
+  header_->slotStride = alignUp(sizeof(FrameTapSlot)) + alignUp(frameBytes_);
+  header_->latest.store(0, std::memory_order_relaxed);
+  for (int i = 0; i < SLOT_COUNT; ++i) {
+    auto *slot = new (slotAt(header_, i)) FrameTapSlot;
+    slot->seq.store(0, std::memory_order_relaxed);
+  }
+  header_->version = TAP_VERSION;
+  // Readers check the magic last, so publish it after everything else
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = TAP_MAGIC;
+}
+
+FrameTapWriter::~FrameTapWriter() {
+  if (header_ != nullptr) {
+    ::munmap(header_, mapBytes_);
+    ::shm_unlink(name_.c_str());
+  }
+}
+
+void FrameTapWriter::publish(const uint8_t *bgr, int64_t timestampUs) {
+  // Rotate so the slot written is neither the latest nor the one before it
+  const int index = static_cast<int>(published_ % SLOT_COUNT);
+  FrameTapSlot *slot = slotAt(header_, index);
+  ++published_;
+
+  const uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+  slot->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(pixelsOf(slot), bgr, frameBytes_);
+  slot->frameNumber = published_;
+  slot->timestampUs = timestampUs;
+  slot->seq.store(seq + 2, std::memory_order_release);
+
+  header_->latest.store((published_ << 2) | static_cast<uint64_t>(index),
+                        std::memory_order_release);
+}
+
+FrameTapReader::FrameTapReader(const std::string &name) : name_(name) {
+  if (name.empty()) {
+    throw std::invalid_argument("Frame tap name cannot be empty");
+  }
+}
+
+FrameTapReader::~FrameTapReader() { detach(); }
+
+bool FrameTapReader::attach() {
+  const int fd = ::shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st {};
+  void *map = MAP_FAILED;
+  if (::fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(FrameTapHeader)) {
+    map = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                 MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  const auto *header = static_cast<const FrameTapHeader *>(map);
+  const size_t size = static_cast<size_t>(st.st_size);
+  bool valid = header->magic == TAP_MAGIC;
+  // Pairs with the writer's release fence before it stores the magic
+  std::atomic_thread_fence(std::memory_order_acquire);
+  valid = valid && header->version == TAP_VERSION &&
+          size >= segmentBytes(static_cast<size_t>(header->width) *
+                               header->height * 3);
+  if (!valid) {
+    ::munmap(map, size);
+    return false;
+  }
+  header_ = header;
+  mapBytes_ = size;
+  lastFrame_ = 0;
+  lastProgressUs_ = wallClockMicros();
+  return true;
+}
+
+void FrameTapReader::detach() {
+  if (header_ != nullptr) {
+    ::munmap(const_cast<FrameTapHeader *>(header_), mapBytes_);
+    header_ = nullptr;
+  }
+}
+
+bool FrameTapReader::readLatest(TapFrame &frame) {
+  if (header_ == nullptr && !attach()) {
+    return false;
+  }
+
+  const size_t frameBytes =
+      static_cast<size_t>(header_->width) * header_->height * 3;
+  for (int attempt = 0; attempt < MAX_RETRIES; ++attempt) {
+    const uint64_t latest = header_->latest.load(std::memory_order_acquire);
+    const uint64_t frameNumber = latest >> 2;
+    if (frameNumber == 0 || frameNumber == lastFrame_) {
+      break;
+    }
+    const FrameTapSlot *slot = slotAt(header_, static_cast<int>(latest & 3));
+    const uint64_t before = slot->seq.load(std::memory_order_acquire);
+    if (before & 1) {
+      continue;
+    }
+    frame.bgr.resize(frameBytes);
+    std::memcpy(frame.bgr.data(), pixelsOf(slot), frameBytes);
+    frame.frameNumber = slot->frameNumber;
+    frame.timestampUs = slot->timestampUs;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->seq.load(std::memory_order_relaxed) != before) {
+      continue; // Overwritten while copying
+    }
+    frame.width = static_cast<int>(header_->width);
+    frame.height = static_cast<int>(header_->height);
+    lastFrame_ = frame.frameNumber;
+    lastProgressUs_ = wallClockMicros();
+    return true;
+  }
+
+  if (wallClockMicros() - lastProgressUs_ > STALE_US) {
+    detach();
+  }
+  return false;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file FrameTap.hpp
+ * @brief Lock-free shared-memory triple buffer publishing decoded frames
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct FrameTapHeader;
+
+/**
+ * @struct TapFrame
+ * @brief A frame copied out of the frame tap
+ */
+struct TapFrame {
+  int width = 0;             ///< Frame width in pixels
+  int height = 0;            ///< Frame height in pixels
+  uint64_t frameNumber = 0;  ///< Publication counter (1 for the first frame)
+  int64_t timestampUs = 0;   ///< Wall-clock publication time in microseconds
+  std::vector<uint8_t> bgr;  ///< Packed BGR24 pixels, width * 3 per row
+};
+
+/**
+ * @class FrameTapWriter
+ * @brief Publishes downscaled BGR frames into a POSIX shared-memory segment
+ *
+ * The segment holds a header and three frame slots. Each slot is guarded by
+ * its own sequence counter (seqlock): odd while the writer copies into it,
+ * even when it is stable. The writer rotates through the slots and then
+ * advertises the newest one, so it never touches the two most recent frames
+ * and readers of the latest frame are only disturbed if they take longer
+ * than two frame periods to copy it. The writer never blocks on readers and
+ * any number of readers can attach.
+ *
+ * @note Thread Safety: A single thread (or process) may publish.
+ */
+class FrameTapWriter final {
+public:
+  /**
+   * @brief Creates (or replaces) the shared-memory segment
+   * @param name POSIX shared-memory name, e.g. "/dacl_frames"
+   * @param width Frame width in pixels
+   * @param height Frame height in pixels
+   * @throws std::invalid_argument if name or dimensions are invalid
+   * @throws std::runtime_error if the segment cannot be created or mapped
+   */
+  explicit FrameTapWriter(const std::string &name, int width, int height);
+  ~FrameTapWriter();
+
+  FrameTapWriter(const FrameTapWriter &) = delete;
+  FrameTapWriter &operator=(const FrameTapWriter &) = delete;
+
+  /**
+   * @brief Copies a frame into the next slot and makes it the latest
+   * @param bgr Packed BGR24 pixels of frameBytes() bytes
+   * @param timestampUs Capture time of the frame in microseconds
+   */
+  void publish(const uint8_t *bgr, int64_t timestampUs);
+
+  /** @brief Size of one frame in bytes */
+  size_t frameBytes() const { return frameBytes_; }
+
+  int width() const { return width_; }   ///< Frame width in pixels
+  int height() const { return height_; } ///< Frame height in pixels
+
+private:
+  const std::string name_;  ///< Shared-memory name
+  const int width_;         ///< Frame width in pixels
+  const int height_;        ///< Frame height in pixels
+  const size_t frameBytes_; ///< width * height * 3
+  size_t mapBytes_ = 0;     ///< Size of the mapping
+  FrameTapHeader *header_ = nullptr; ///< Mapped segment
+  uint64_t published_ = 0;  ///< Frames published so far
+};
+
+/**
+ * @class FrameTapReader
+ * @brief Reads the latest frame from a FrameTapWriter's segment
+ *
+ * Attaches lazily, so a reader can be created before the writer exists.
+ * Reading never blocks the writer: a copy that overlaps a write is detected
+ * through the slot's sequence counter and retried.
+ *
+ * @note Thread Safety: Not thread-safe; use one reader per thread.
+ */
+class FrameTapReader final {
+public:
+  /**
+   * @brief Constructs a reader for a shared-memory segment
+   * @param name POSIX shared-memory name used by the writer
+   * @throws std::invalid_argument if name is empty
+   */
+  explicit FrameTapReader(const std::string &name);
+  ~FrameTapReader();
+
+  FrameTapReader(const FrameTapReader &) = delete;
+  FrameTapReader &operator=(const FrameTapReader &) = delete;
+
+  /**
+   * @brief Copies the latest frame if it is newer than the last one read
+   * @param[out] frame Receives the frame; its buffer is reused between calls
+   * @return true if a new, consistent frame was copied
+   *
+   * Re-attaches when the segment is missing or the writer has stopped
+   * publishing, e.g. because the recorder restarted and recreated it.
+   */
+  bool readLatest(TapFrame &frame);
+
+private:
+  bool attach();
+  void detach();
+
+  const std::string name_;           ///< Shared-memory name
+  size_t mapBytes_ = 0;              ///< Size of the mapping
+  const FrameTapHeader *header_ = nullptr; ///< Mapped segment, read-only
+  uint64_t lastFrame_ = 0;           ///< Frame number of the last copy
+  int64_t lastProgressUs_ = 0;       ///< Time a new frame was last seen
+
+  static constexpr int MAX_RETRIES = 4; ///< Torn-copy retries per call
+  static constexpr int64_t STALE_US =
+      5000000; ///< Silence after which the reader re-attaches
+};
@@ -0,0 +1,191 @@
+#include "HttpClient.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+/// Closes the socket when the request ends
+class Socket {
+public:
+  explicit Socket(int fd) : fd_(fd) {}
+  ~Socket() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+  Socket(const Socket &) = delete;
+  Socket &operator=(const Socket &) = delete;
+  int fd() const { return fd_; }
+
+private:
+  const int fd_;
+};
+
+void sendAll(int fd, const char *data, size_t length) {
+  while (length > 0) {
+    // MSG_NOSIGNAL: a peer that went away is an error, not SIGPIPE
+    const ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw std::runtime_error(std::string("HTTP send failed: ") +
+                               std::strerror(errno));
+    }
+    data += n;
+    length -= static_cast<size_t>(n);
+  }
+}
+
+} // namespace
+
+std::string encodePathSegment(const std::string &segment) {
+  static const char DIGITS[] = "0123456789ABCDEF";
+  std::string out;
+  for (unsigned char c : segment) {
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+        (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' ||
+        c == '~') {
+      out.push_back(static_cast<char>(c));
+    } else {
+      out.push_back('%');
+      out.push_back(DIGITS[c >> 4]);
+      out.push_back(DIGITS[c & 0xF]);
+    }
+  }
+  return out;
+}
+
+HttpClient::HttpClient(const std::string &baseUrl, int timeoutMs)
+    : timeoutMs_(timeoutMs) {
+  // Input validation
+  static const std::string SCHEME = "http://";
+  if (baseUrl.compare(0, SCHEME.size(), SCHEME) != 0) {
+    throw std::invalid_argument("Offload URL must start with http://: " +
+                                baseUrl);
+  }
+  if (timeoutMs <= 0) {
+    throw std::invalid_argument("HTTP timeout must be positive");
+  }
+
+  const std::string rest = baseUrl.substr(SCHEME.size());
+  const size_t slash = rest.find('/');
+  const std::string authority = rest.substr(0, slash);
+  prefix_ = slash == std::string::npos ? "" : rest.substr(slash);
+  while (!prefix_.empty() && prefix_.back() == '/') {
+    prefix_.pop_back();
+  }
+  const size_t colon = authority.rfind(':');
+  if (colon != std::string::npos && authority.find(']', colon) ==
+                                        std::string::npos) {
+    host_ = authority.substr(0, colon);
+    port_ = authority.substr(colon + 1);
+  } else {
+    host_ = authority;
+    port_ = "80";
+  }
+  if (host_.size() > 2 && host_.front() == '[' && host_.back() == ']') {
+    host_ = host_.substr(1, host_.size() - 2); // IPv6 literal
+  }
+  if (host_.empty() || port_.empty()) {
+    throw std::invalid_argument("Offload URL has no host: " + baseUrl);
+  }
+}
+
+HttpResponse HttpClient::request(const std::string &method,
+                                 const std::string &path, const void *body,
+                                 size_t length,
+                                 const SendPacer &pacer) const {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *addresses = nullptr;
+  const int rc =
+      ::getaddrinfo(host_.c_str(), port_.c_str(), &hints, &addresses);
+  if (rc != 0) {
+    throw std::runtime_error("Cannot resolve " + host_ + ": " +
+                             ::gai_strerror(rc));
+  }
+
+  // The send timeout also bounds connect()
+  timeval timeout{};
+  timeout.tv_sec = timeoutMs_ / 1000;
+  timeout.tv_usec = (timeoutMs_ % 1000) * 1000;
+  int fd = -1;
+  int error = 0;
+  for (addrinfo *a = addresses; a != nullptr && fd < 0; a = a->ai_next) {
+    fd = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC,
+                  a->ai_protocol);
+    if (fd < 0) {
+      error = errno;
+      continue;
+    }
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (::connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+      error = errno;
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  ::freeaddrinfo(addresses);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot connect to " + host_ + ":" + port_ +
+                             ": " + std::strerror(error));
+  }
+  Socket socket(fd);
+
+  const std::string header =
+      method + " " + prefix_ + path + " HTTP/1.1\r\nHost: " + host_ +
+      "\r\nContent-Type: application/octet-stream\r\nContent-Length: " +
+      std::to_string(length) + "\r\nConnection: close\r\n\r\n";
+  sendAll(fd, header.data(), header.size());
+  const auto *p = static_cast<const char *>(body);
+  for (size_t sent = 0; sent < length;) {
+    const size_t slice = std::min(SEND_SLICE_BYTES, length - sent);
+    if (pacer) {
+      pacer(slice);
+    }
+    sendAll(fd, p + sent, slice);
+    sent += slice;
+  }
+
+  // The server closes the connection after the response
+  std::string response;
+  char buf[16384];
+  while (true) {
+    const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      throw std::runtime_error(std::string("HTTP receive failed: ") +
+                               std::strerror(errno));
+    }
+    if (n == 0) {
+      break;
+    }
+    response.append(buf, static_cast<size_t>(n));
+    if (response.size() > MAX_RESPONSE_BYTES) {
+      throw std::runtime_error("HTTP response too large");
+    }
+  }
+
+  HttpResponse result;
+  const size_t headerEnd = response.find("\r\n\r\n");
+  if (response.compare(0, 5, "HTTP/") != 0 ||
+      headerEnd == std::string::npos) {
+    throw std::runtime_error("Malformed HTTP response from " + host_);
+  }
+  const size_t space = response.find(' ');
+  result.status = std::atoi(response.c_str() + space + 1);
+  result.body = response.substr(headerEnd + 4);
+  return result;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file HttpClient.hpp
+ * @brief Minimal blocking HTTP/1.1 client over POSIX sockets for offloading
+ */
+
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/**
+ * @struct HttpResponse
+ * @brief Status and body of an HTTP response
+ */
+struct HttpResponse {
+  int status = 0;   ///< HTTP status code
+  std::string body; ///< Response body
+};
+
+/// Called before each slice of a request body is sent, with its size; may
+/// block to shape bandwidth
+using SendPacer = std::function<void(size_t bytes)>;
+
+/**
+ * @brief Percent-encodes a URL path segment
+ * @param segment Text of one segment; '/' is encoded as well
+ * @return The encoded segment
+ */
+std::string encodePathSegment(const std::string &segment);
+
+/**
+ * @class HttpClient
+ * @brief Sends requests to one http:// endpoint
+ *
+ * Each request uses its own connection ("Connection: close"), so a broken
+ * link never leaves a half-used connection behind. Connect, send and receive
+ * are bounded by the timeout. There is no TLS; an https endpoint is reached
+ * through a local terminating proxy.
+ *
+ * @note Thread Safety: Immutable after construction; request() may be called
+ * from several threads at once.
+ */
+class HttpClient final {
+public:
+  /**
+   * @brief Parses the endpoint URL
+   * @param baseUrl "http://host[:port][/prefix]"
+   * @param timeoutMs Limit of each connect, send and receive step
+   * @throws std::invalid_argument if the URL is not an http:// URL or the
+   * timeout is not positive
+   */
+  explicit HttpClient(const std::string &baseUrl, int timeoutMs);
+
+  /**
+   * @brief Sends one request and reads the response
+   * @param method "GET", "PUT", "POST", ...
+   * @param path Path below the URL prefix, starting with '/' (encoded)
+   * @param body Request body
+   * @param length Body length in bytes
+   * @param pacer Optional bandwidth shaping callback
+   * @return Status and body of the response
+   * @throws std::runtime_error if the endpoint cannot be reached or the
+   * response is malformed
+   */
+  HttpResponse request(const std::string &method, const std::string &path,
+                       const void *body = nullptr, size_t length = 0,
+                       const SendPacer &pacer = nullptr) const;
+
+  /** @brief Host name of the endpoint */
+  const std::string &host() const { return host_; }
+
+private:
+  std::string host_;   ///< Host name or address
+  std::string port_;   ///< Port (default "80")
+  std::string prefix_; ///< Path prefix without trailing '/'
+  const int timeoutMs_; ///< Per-step timeout
+
+  static constexpr size_t SEND_SLICE_BYTES =
+      64 * 1024; ///< Body bytes per send() and pacer call
+  static constexpr size_t MAX_RESPONSE_BYTES =
+      16 * 1024 * 1024; ///< Responses beyond this are rejected
+};
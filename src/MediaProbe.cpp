@@ -0,0 +1,451 @@
+#include "MediaProbe.hpp"
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+uint32_t readBE32(const uint8_t *p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+uint64_t readBE64(const uint8_t *p) {
+  return (static_cast<uint64_t>(readBE32(p)) << 32) | readBE32(p + 4);
+}
+
+/// Header of one ISO BMFF box
+struct BoxHeader {
+  char type[5] = {0};      ///< Four-character box type
+  uint64_t size = 0;       ///< Total box size including header
+  uint64_t headerSize = 0; ///< 8 or 16 bytes
+};
+
+bool readBoxHeader(std::ifstream &f, uint64_t offset, uint64_t limit,
+                   BoxHeader &box) {
+  uint8_t hdr[16];
+  if (offset + 8 > limit) {
+    return false;
+  }
+  f.clear();
+  f.seekg(static_cast<std::streamoff>(offset));
+  if (!f.read(reinterpret_cast<char *>(hdr), 8)) {
+    return false;
+  }
+  box.size = readBE32(hdr);
+  std::memcpy(box.type, hdr + 4, 4);
+  box.headerSize = 8;
+  if (box.size == 1) {
+    if (!f.read(reinterpret_cast<char *>(hdr + 8), 8)) {
+      return false;
+    }
+    box.size = readBE64(hdr + 8);
+    box.headerSize = 16;
+  } else if (box.size == 0) {
+    box.size = limit - offset; // Box extends to the end of its parent
+  }
+  return box.size >= box.headerSize && offset + box.size <= limit;
+}
+
+/// Finds a child box of the given type inside [begin, end)
+bool findBox(std::ifstream &f, uint64_t begin, uint64_t end, const char *type,
+             uint64_t &payload, uint64_t &payloadEnd) {
+  BoxHeader box;
+  for (uint64_t offset = begin; readBoxHeader(f, offset, end, box);
+       offset += box.size) {
+    if (std::strcmp(box.type, type) == 0) {
+      payload = offset + box.headerSize;
+      payloadEnd = offset + box.size;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t countMp4Keyframes(std::ifstream &f, uint64_t fileSize) {
+  // Fragmented files start every fragment on a keyframe
+  uint32_t fragments = 0;
+  uint64_t moov = 0, moovEnd = 0;
+  BoxHeader box;
+  for (uint64_t offset = 0; readBoxHeader(f, offset, fileSize, box);
+       offset += box.size) {
+    if (std::strcmp(box.type, "moof") == 0) {
+      ++fragments;
+    } else if (std::strcmp(box.type, "moov") == 0) {
+      moov = offset + box.headerSize;
+      moovEnd = offset + box.size;
+    }
+  }
+  if (fragments > 0 || moovEnd == 0) {
+    return fragments;
+  }
+
+  // Progressive file: read the sync-sample table of the first track
+  uint64_t begin = moov, end = moovEnd;
+  for (const char *type : {"trak", "mdia", "minf", "stbl", "stss"}) {
+    if (!findBox(f, begin, end, type, begin, end)) {
+      return 0;
+    }
+  }
+  uint8_t stss[8]; // version/flags, entry count
+  f.clear();
+  f.seekg(static_cast<std::streamoff>(begin));
+  if (!f.read(reinterpret_cast<char *>(stss), sizeof(stss))) {
+    return 0;
+  }
+  return readBE32(stss + 4);
+}
+
+uint32_t countAnnexBKeyframes(std::ifstream &f) {
+  static constexpr size_t CHUNK_SIZE = 1 << 20;
+  static constexpr int NAL_TYPE_IDR = 5;
+
+  std::vector<char> buf(CHUNK_SIZE + 3);
+  size_t carry = 0;
+  uint32_t keyframes = 0;
+  int previousType = -1;
+
+  f.clear();
+  f.seekg(0);
+  while (f) {
+    f.read(buf.data() + carry, CHUNK_SIZE);
+    const size_t n = carry + static_cast<size_t>(f.gcount());
+    if (n < 4) {
+      break;
+    }
+    const auto *p = reinterpret_cast<const uint8_t *>(buf.data());
+    for (size_t i = 0; i + 3 < n; ++i) {
+      if (p[i] == 0 && p[i + 1] == 0 && p[i + 2] == 1) {
+        const int type = p[i + 3] & 0x1F;
+        // Count each IDR access unit once, even if split into slices
+        if (type == NAL_TYPE_IDR && previousType != NAL_TYPE_IDR) {
+          ++keyframes;
+        }
+        previousType = type;
+        i += 2;
+      }
+    }
+    // Keep the tail so start codes spanning chunks are found
+    carry = 3;
+    std::memmove(buf.data(), buf.data() + n - carry, carry);
+  }
+  return keyframes;
+}
+
+} // namespace
+
+uint32_t countKeyframes(const std::string &path) {
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  if (!f.is_open()) {
+    return 0;
+  }
+  const uint64_t fileSize = static_cast<uint64_t>(f.tellg());
+
+  char head[8];
+  f.seekg(0);
+  if (!f.read(head, sizeof(head))) {
+    return 0;
+  }
+  if (std::memcmp(head + 4, "ftyp", 4) == 0) {
+    return countMp4Keyframes(f, fileSize);
+  }
+  return countAnnexBKeyframes(f);
+}
+
+uint64_t completeFragmentsLength(const std::string &path) {
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  if (!f.is_open()) {
+    return 0;
+  }
+  const uint64_t fileSize = static_cast<uint64_t>(f.tellg());
+
+  uint64_t complete = 0;
+  bool initSeen = false, inFragment = false;
+  BoxHeader box;
+  for (uint64_t offset = 0; readBoxHeader(f, offset, fileSize, box);
+       offset += box.size) {
+    if (std::strcmp(box.type, "moov") == 0) {
+      initSeen = true;
+    } else if (std::strcmp(box.type, "moof") == 0) {
+      inFragment = true;
+    } else if (std::strcmp(box.type, "mdat") == 0 && initSeen && inFragment) {
+      // A fragment is usable once its media data box is complete
+      complete = offset + box.size;
+      inFragment = false;
+    }
+  }
+  return complete;
+}
+
+namespace {
+
+/// Reads [offset, offset + size) of the file into data
+bool readRange(std::ifstream &f, uint64_t offset, uint64_t size,
+               std::vector<uint8_t> &data) {
+  data.resize(size);
+  f.clear();
+  f.seekg(static_cast<std::streamoff>(offset));
+  return static_cast<bool>(
+      f.read(reinterpret_cast<char *>(data.data()),
+             static_cast<std::streamsize>(size)));
+}
+
+/// Finds a child box of the given type in an in-memory box payload
+bool findChild(const std::vector<uint8_t> &data, size_t begin, size_t end,
+               const char *type, size_t &payload, size_t &payloadEnd) {
+  size_t offset = begin;
+  while (offset + 8 <= end) {
+    uint64_t size = readBE32(&data[offset]);
+    size_t headerSize = 8;
+    if (size == 1) {
+      if (offset + 16 > end) {
+        return false;
+      }
+      size = readBE64(&data[offset + 8]);
+      headerSize = 16;
+    } else if (size == 0) {
+      size = end - offset;
+    }
+    if (size < headerSize || size > end - offset) {
+      return false;
+    }
+    if (std::memcmp(&data[offset + 4], type, 4) == 0) {
+      payload = offset + headerSize;
+      payloadEnd = offset + size;
+      return true;
+    }
+    offset += size;
+  }
+  return false;
+}
+
+/// Per-sample defaults of a track (trex, overridden per fragment by tfhd)
+struct SampleDefaults {
+  uint32_t duration = 0;
+  uint32_t size = 0;
+  uint32_t flags = 0;
+};
+
+/// Track of the first trak box: its ID, time scale and sample defaults
+struct TrackInfo {
+  uint32_t id = 0;
+  uint32_t timescale = 0;
+  SampleDefaults defaults;
+};
+
+bool readTrackInfo(const std::vector<uint8_t> &moov, TrackInfo &track) {
+  size_t trak, trakEnd, tkhd, tkhdEnd, mdia, mdiaEnd, mdhd, mdhdEnd;
+  if (!findChild(moov, 0, moov.size(), "trak", trak, trakEnd) ||
+      !findChild(moov, trak, trakEnd, "tkhd", tkhd, tkhdEnd) ||
+      !findChild(moov, trak, trakEnd, "mdia", mdia, mdiaEnd) ||
+      !findChild(moov, mdia, mdiaEnd, "mdhd", mdhd, mdhdEnd)) {
+    return false;
+  }
+  // Version 1 boxes have 64-bit creation/modification times
+  const size_t idAt = tkhd + (moov[tkhd] == 1 ? 20 : 12);
+  const size_t scaleAt = mdhd + (moov[mdhd] == 1 ? 20 : 12);
+  if (idAt + 4 > tkhdEnd || scaleAt + 4 > mdhdEnd) {
+    return false;
+  }
+  track.id = readBE32(&moov[idAt]);
+  track.timescale = readBE32(&moov[scaleAt]);
+
+  size_t mvex, mvexEnd, trex, trexEnd;
+  if (findChild(moov, 0, moov.size(), "mvex", mvex, mvexEnd)) {
+    size_t from = mvex;
+    while (findChild(moov, from, mvexEnd, "trex", trex, trexEnd)) {
+      if (trex + 24 <= trexEnd && readBE32(&moov[trex + 4]) == track.id) {
+        track.defaults.duration = readBE32(&moov[trex + 12]);
+        track.defaults.size = readBE32(&moov[trex + 16]);
+        track.defaults.flags = readBE32(&moov[trex + 20]);
+        break;
+      }
+      from = trexEnd;
+    }
+  }
+  return track.timescale != 0;
+}
+
+/**
+ * @brief Appends the samples of the track's fragments in one moof box
+ * @param moof The moof box payload
+ * @param moofOffset File offset of the moof box (the default data base)
+ * @param decodeTime Decode time of the next sample, carried between
+ * fragments without a tfdt box
+ */
+void readMoofSamples(const std::vector<uint8_t> &moof, uint64_t moofOffset,
+                     const TrackInfo &track, uint64_t fileSize,
+                     uint64_t &decodeTime, std::vector<MediaSample> &samples) {
+  static constexpr uint32_t TFHD_BASE_DATA_OFFSET = 0x000001;
+  static constexpr uint32_t TFHD_DESCRIPTION_INDEX = 0x000002;
+  static constexpr uint32_t TFHD_DEFAULT_DURATION = 0x000008;
+  static constexpr uint32_t TFHD_DEFAULT_SIZE = 0x000010;
+  static constexpr uint32_t TFHD_DEFAULT_FLAGS = 0x000020;
+  static constexpr uint32_t TRUN_DATA_OFFSET = 0x000001;
+  static constexpr uint32_t TRUN_FIRST_FLAGS = 0x000004;
+  static constexpr uint32_t TRUN_DURATION = 0x000100;
+  static constexpr uint32_t TRUN_SIZE = 0x000200;
+  static constexpr uint32_t TRUN_FLAGS = 0x000400;
+  static constexpr uint32_t TRUN_CTS_OFFSET = 0x000800;
+  static constexpr uint32_t SAMPLE_NON_SYNC = 0x00010000;
+
+  size_t traf, trafEnd;
+  size_t from = 0;
+  while (findChild(moof, from, moof.size(), "traf", traf, trafEnd)) {
+    from = trafEnd;
+    size_t tfhd, tfhdEnd;
+    if (!findChild(moof, traf, trafEnd, "tfhd", tfhd, tfhdEnd) ||
+        tfhd + 8 > tfhdEnd || readBE32(&moof[tfhd + 4]) != track.id) {
+      continue;
+    }
+    const uint32_t tfhdFlags = readBE32(&moof[tfhd]) & 0xFFFFFF;
+    SampleDefaults defaults = track.defaults;
+    uint64_t base = moofOffset;
+    size_t at = tfhd + 8;
+    auto field32 = [&](uint32_t &value) {
+      if (at + 4 <= tfhdEnd) {
+        value = readBE32(&moof[at]);
+      }
+      at += 4;
+    };
+    if (tfhdFlags & TFHD_BASE_DATA_OFFSET) {
+      if (at + 8 <= tfhdEnd) {
+        base = readBE64(&moof[at]);
+      }
+      at += 8;
+    }
+    uint32_t unused = 0;
+    if (tfhdFlags & TFHD_DESCRIPTION_INDEX) {
+      field32(unused);
+    }
+    if (tfhdFlags & TFHD_DEFAULT_DURATION) {
+      field32(defaults.duration);
+    }
+    if (tfhdFlags & TFHD_DEFAULT_SIZE) {
+      field32(defaults.size);
+    }
+    if (tfhdFlags & TFHD_DEFAULT_FLAGS) {
+      field32(defaults.flags);
+    }
+
+    size_t tfdt, tfdtEnd;
+    if (findChild(moof, traf, trafEnd, "tfdt", tfdt, tfdtEnd)) {
+      if (moof[tfdt] == 1 && tfdt + 12 <= tfdtEnd) {
+        decodeTime = readBE64(&moof[tfdt + 4]);
+      } else if (tfdt + 8 <= tfdtEnd) {
+        decodeTime = readBE32(&moof[tfdt + 4]);
+      }
+    }
+
+    // Runs without a data offset continue where the previous one ended
+    uint64_t dataOffset = base;
+    size_t trun, trunEnd;
+    size_t runFrom = traf;
+    while (findChild(moof, runFrom, trafEnd, "trun", trun, trunEnd)) {
+      runFrom = trunEnd;
+      if (trun + 8 > trunEnd) {
+        continue;
+      }
+      const uint8_t version = moof[trun];
+      const uint32_t flags = readBE32(&moof[trun]) & 0xFFFFFF;
+      const uint32_t count = readBE32(&moof[trun + 4]);
+      size_t p = trun + 8;
+      if (flags & TRUN_DATA_OFFSET) {
+        if (p + 4 > trunEnd) {
+          continue;
+        }
+        dataOffset = base + static_cast<int32_t>(readBE32(&moof[p]));
+        p += 4;
+      }
+      uint32_t firstFlags = defaults.flags;
+      const bool hasFirstFlags = (flags & TRUN_FIRST_FLAGS) != 0;
+      if (hasFirstFlags) {
+        if (p + 4 > trunEnd) {
+          continue;
+        }
+        firstFlags = readBE32(&moof[p]);
+        p += 4;
+      }
+      const size_t entrySize = 4 * (((flags & TRUN_DURATION) != 0) +
+                                    ((flags & TRUN_SIZE) != 0) +
+                                    ((flags & TRUN_FLAGS) != 0) +
+                                    ((flags & TRUN_CTS_OFFSET) != 0));
+      for (uint32_t i = 0; i < count; ++i) {
+        if (p + entrySize > trunEnd) {
+          break;
+        }
+        uint32_t duration = defaults.duration;
+        uint32_t size = defaults.size;
+        uint32_t sampleFlags =
+            i == 0 && hasFirstFlags ? firstFlags : defaults.flags;
+        int64_t ctsOffset = 0;
+        if (flags & TRUN_DURATION) {
+          duration = readBE32(&moof[p]);
+          p += 4;
+        }
+        if (flags & TRUN_SIZE) {
+          size = readBE32(&moof[p]);
+          p += 4;
+        }
+        if (flags & TRUN_FLAGS) {
+          sampleFlags = readBE32(&moof[p]);
+          p += 4;
+        }
+        if (flags & TRUN_CTS_OFFSET) {
+          const uint32_t raw = readBE32(&moof[p]);
+          ctsOffset = version == 0 ? static_cast<int64_t>(raw)
+                                   : static_cast<int32_t>(raw);
+          p += 4;
+        }
+        if (dataOffset + size <= fileSize) {
+          const int64_t pts = static_cast<int64_t>(decodeTime) + ctsOffset;
+          MediaSample sample;
+          sample.ptsUs = pts / track.timescale * 1000000 +
+                         pts % track.timescale * 1000000 / track.timescale;
+          sample.offset = dataOffset;
+          sample.size = size;
+          sample.keyframe = (sampleFlags & SAMPLE_NON_SYNC) == 0;
+          samples.push_back(sample);
+        }
+        dataOffset += size;
+        decodeTime += duration;
+      }
+    }
+  }
+}
+
+} // namespace
+
+std::vector<MediaSample> readFragmentSamples(const std::string &path) {
+  std::vector<MediaSample> samples;
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  if (!f.is_open()) {
+    return samples;
+  }
+  const uint64_t fileSize = static_cast<uint64_t>(f.tellg());
+
+  TrackInfo track;
+  bool haveTrack = false;
+  uint64_t decodeTime = 0;
+  std::vector<uint8_t> payload;
+  BoxHeader box;
+  for (uint64_t offset = 0; readBoxHeader(f, offset, fileSize, box);
+       offset += box.size) {
+    const bool moov = std::strcmp(box.type, "moov") == 0;
+    const bool moof = std::strcmp(box.type, "moof") == 0;
+    if ((!moov && !moof) || (moof && !haveTrack)) {
+      continue;
+    }
+    if (!readRange(f, offset + box.headerSize, box.size - box.headerSize,
+                   payload)) {
+      break;
+    }
+    if (moov) {
+      haveTrack = readTrackInfo(payload, track);
+    } else {
+      readMoofSamples(payload, offset, track, fileSize, decodeTime, samples);
+    }
+  }
+  return samples;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file MediaProbe.hpp
+ * @brief Lightweight inspection of recorded segment files without decoding
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @struct MediaSample
+ * @brief Location and timing of one video frame in a fragmented MP4 file
+ */
+struct MediaSample {
+  int64_t ptsUs = 0;     ///< Presentation time in the file's time base
+  uint64_t offset = 0;   ///< Byte offset of the frame data in the file
+  uint32_t size = 0;     ///< Size of the frame data in bytes
+  bool keyframe = false; ///< Sync sample, i.e. decoding can start here
+};
+
+/**
+ * @brief Counts the keyframes of a recorded segment file
+ * @param path Path of an MP4 file or raw H.264 (Annex B) elementary stream
+ * @return Number of keyframes, or 0 if the file cannot be read or parsed
+ *
+ * MP4 files are inspected through their box structure (sync-sample table or
+ * fragment count); raw H.264 streams are scanned for IDR access units. No
+ * frame is decoded.
+ */
+uint32_t countKeyframes(const std::string &path);
+
+/**
+ * @brief Returns the length of the readable prefix of a fragmented MP4 file
+ * @param path Path of a fragmented MP4 file, possibly still being written
+ * @return Byte length covering the init segment and all complete
+ * moof/mdat fragments, or 0 if the file is not fragmented or has no complete
+ * fragment
+ *
+ * Used to salvage a segment cut off by a power loss: truncating the file to
+ * this length yields a valid, playable file.
+ */
+uint64_t completeFragmentsLength(const std::string &path);
+
+/**
+ * @brief Reads the sample tables of the complete fragments of an MP4 file
+ * @param path Path of a fragmented MP4 file
+ * @return Samples of the first track in file order, or an empty vector if the
+ * file is not fragmented or cannot be parsed
+ *
+ * Only the moov box and the moof boxes are read (track fragment headers,
+ * decode times and run tables); media data is skipped.
+ */
+std::vector<MediaSample> readFragmentSamples(const std::string &path);
@@ -0,0 +1,64 @@
+#include "Metrics.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+Metrics &Metrics::instance() {
+  static Metrics metrics;
+  return metrics;
+}
+
+std::atomic<int64_t> &Metrics::value(const std::string &name) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  auto &slot = values_[name];
+  if (!slot) {
+    slot = std::make_unique<std::atomic<int64_t>>(0);
+  }
+  return *slot;
+}
+
+void Metrics::setInfo(const std::string &name, const std::string &key,
+                      const std::map<std::string, std::string> &labels) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  info_[name + "\n" + key] = labels;
+}
+
+bool Metrics::writeTo(const std::string &path) const {
+  std::ostringstream out;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (const auto &entry : values_) {
+      out << entry.first << " " << entry.second->load() << "\n";
+    }
+    for (const auto &entry : info_) {
+      out << entry.first.substr(0, entry.first.find('\n')) << "{";
+      const char *separator = "";
+      for (const auto &label : entry.second) {
+        out << separator << label.first << "=\"" << label.second << "\"";
+        separator = ",";
+      }
+      out << "} 1\n";
+    }
+  }
+
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream f(tmpPath, std::ios::trunc);
+    if (!f.is_open() || !(f << out.str())) {
+      return false;
+    }
+  }
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+void Metrics::run(const std::string &path, int intervalSeconds) {
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::seconds(intervalSeconds));
+    if (!writeTo(path)) {
+      std::cerr << "Warning: Cannot write metrics to " << path << std::endl;
+    }
+  }
+}
@@ -0,0 +1,69 @@
+/**
+ * @file Metrics.hpp
+ * @brief Process-wide registry of counters and gauges, exported to a file
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @class Metrics
+ * @brief Registry of named numeric values and info labels
+ *
+ * Modules look up a value once and keep the returned reference; updates are
+ * then plain atomic operations, cheap enough for per-frame counters. run()
+ * periodically writes all values in Prometheus text format, replacing the
+ * file atomically so readers never see a partial snapshot.
+ *
+ * @note Thread Safety: All methods are thread-safe.
+ */
+class Metrics final {
+public:
+  /** @brief Returns the process-wide registry */
+  static Metrics &instance();
+
+  /**
+   * @brief Returns the value registered under a name, creating it at 0
+   * @param name Metric name, e.g. "dacl_can_frames_total"
+   * @return Reference that stays valid for the lifetime of the process
+   */
+  std::atomic<int64_t> &value(const std::string &name);
+
+  /**
+   * @brief Sets an info metric: a set of labels with the constant value 1
+   * @param name Metric name, e.g. "dacl_thread_info"
+   * @param key Distinguishes several label sets of one metric (e.g. role)
+   * @param labels Label names and values
+   */
+  void setInfo(const std::string &name, const std::string &key,
+               const std::map<std::string, std::string> &labels);
+
+  /**
+   * @brief Writes a snapshot of all metrics to a file
+   * @param path Destination file (replaced atomically)
+   * @return true on success
+   */
+  bool writeTo(const std::string &path) const;
+
+  /**
+   * @brief Periodically writes snapshots until the process exits
+   * @param path Destination file
+   * @param intervalSeconds Seconds between snapshots
+   * @note Should be executed in a dedicated thread.
+   */
+  void run(const std::string &path, int intervalSeconds);
+
+private:
+  Metrics() = default;
+
+  mutable std::mutex mtx_; ///< Guards the maps (not the values)
+  std::map<std::string, std::unique_ptr<std::atomic<int64_t>>>
+      values_; ///< Counters and gauges by name
+  std::map<std::string, std::map<std::string, std::string>>
+      info_; ///< Info label sets by "name\nkey"
+};
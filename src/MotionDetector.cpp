@@ -0,0 +1,235 @@
+#include "MotionDetector.hpp"
+#include "Metrics.hpp"
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+int64_t threadCpuMicros() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+} // namespace
+
+void blockSadScalar(const uint8_t *previous, const uint8_t *current,
+                    int width, int height, uint32_t *sums) {
+  const int blocksX = width / MOTION_BLOCK_SIZE;
+  const int blocksY = height / MOTION_BLOCK_SIZE;
+  for (int by = 0; by < blocksY; ++by) {
+    for (int bx = 0; bx < blocksX; ++bx) {
+      uint32_t sum = 0;
+      for (int y = 0; y < MOTION_BLOCK_SIZE; ++y) {
+        const size_t row =
+            static_cast<size_t>(by * MOTION_BLOCK_SIZE + y) * width +
+            bx * MOTION_BLOCK_SIZE;
+        for (int x = 0; x < MOTION_BLOCK_SIZE; ++x) {
+          const int a = previous[row + x];
+          const int b = current[row + x];
+          sum += static_cast<uint32_t>(a > b ? a - b : b - a);
+        }
+      }
+      sums[by * blocksX + bx] = sum;
+    }
+  }
+}
+
+void blockSad(const uint8_t *previous, const uint8_t *current, int width,
+              int height, uint32_t *sums) {
+#if defined(__SSE2__) || defined(__ARM_NEON)
+  static_assert(MOTION_BLOCK_SIZE == 16, "SIMD kernels load 16-byte rows");
+  const int blocksX = width / MOTION_BLOCK_SIZE;
+  const int blocksY = height / MOTION_BLOCK_SIZE;
+  for (int by = 0; by < blocksY; ++by) {
+    for (int bx = 0; bx < blocksX; ++bx) {
+      const size_t origin =
+          static_cast<size_t>(by * MOTION_BLOCK_SIZE) * width +
+          bx * MOTION_BLOCK_SIZE;
+#if defined(__SSE2__)
+      // psadbw sums |a - b| of each 8-byte half into a 64-bit lane
+      __m128i acc = _mm_setzero_si128();
+      for (int y = 0; y < MOTION_BLOCK_SIZE; ++y) {
+        const size_t row = origin + static_cast<size_t>(y) * width;
+        const __m128i a = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(previous + row));
+        const __m128i b = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(current + row));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(a, b));
+      }
+      sums[by * blocksX + bx] =
+          static_cast<uint32_t>(_mm_cvtsi128_si32(acc) +
+                                _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#else
+      // 16 rows of pairwise sums stay below 16 * 2 * 255, so 16-bit lanes
+      // cannot overflow
+      uint16x8_t acc = vdupq_n_u16(0);
+      for (int y = 0; y < MOTION_BLOCK_SIZE; ++y) {
+        const size_t row = origin + static_cast<size_t>(y) * width;
+        acc = vpadalq_u8(acc,
+                         vabdq_u8(vld1q_u8(previous + row),
+                                  vld1q_u8(current + row)));
+      }
+      const uint64x2_t total = vpaddlq_u32(vpaddlq_u16(acc));
+      sums[by * blocksX + bx] = static_cast<uint32_t>(
+          vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1));
+#endif
+    }
+  }
+#else
+  blockSadScalar(previous, current, width, height, sums);
+#endif
+}
+
+const char *blockSadKernel() {
+#if defined(__SSE2__)
+  return "sse2";
+#elif defined(__ARM_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+void bgrToGrayHalf(const uint8_t *bgr, int width, int height, uint8_t *gray) {
+  const int outWidth = width / 2;
+  const int outHeight = height / 2;
+  const size_t stride = static_cast<size_t>(width) * 3;
+  for (int y = 0; y < outHeight; ++y) {
+    const uint8_t *top = bgr + static_cast<size_t>(2 * y) * stride;
+    const uint8_t *bottom = top + stride;
+    uint8_t *out = gray + static_cast<size_t>(y) * outWidth;
+    for (int x = 0; x < outWidth; ++x) {
+      const uint8_t *a = top + x * 6;
+      const uint8_t *b = bottom + x * 6;
+      // Luma approximated as (B + 2G + R) / 4, averaged over 2x2 pixels
+      const unsigned sum = a[0] + 2u * a[1] + a[2] + a[3] + 2u * a[4] + a[5] +
+                           b[0] + 2u * b[1] + b[2] + b[3] + 2u * b[4] + b[5];
+      out[x] = static_cast<uint8_t>(sum >> 4);
+    }
+  }
+}
+
+MotionDetector::MotionDetector(const std::string &tapName,
+                               const ProfileSelector *profiles, int threshold,
+                               int minBlocks)
+    : reader_(tapName), profiles_(profiles),
+      blockThreshold_(static_cast<uint32_t>(threshold) * MOTION_BLOCK_SIZE *
+                      MOTION_BLOCK_SIZE),
+      minBlocks_(minBlocks) {
+  if (profiles == nullptr) {
+    throw std::invalid_argument("Profile selector cannot be null");
+  }
+  if (threshold <= 0 || threshold > 255 || minBlocks <= 0) {
+    throw std::invalid_argument(
+        "Motion threshold must be 1-255 and minimum blocks positive");
+  }
+}
+
+int MotionDetector::changedBlocks(const TapFrame &frame) {
+  const int width = frame.width / 2;
+  const int height = frame.height / 2;
+  const size_t pixels = static_cast<size_t>(width) * height;
+  if (current_.size() != pixels) {
+    current_.assign(pixels, 0);
+    previous_.assign(pixels, 0);
+    sums_.assign(static_cast<size_t>(width / MOTION_BLOCK_SIZE) *
+                     (height / MOTION_BLOCK_SIZE),
+                 0);
+    havePrevious_ = false;
+  }
+  bgrToGrayHalf(frame.bgr.data(), frame.width, frame.height, current_.data());
+  if (!havePrevious_) {
+    previous_.swap(current_);
+    havePrevious_ = true;
+    return 0;
+  }
+
+  blockSad(previous_.data(), current_.data(), width, height, sums_.data());
+  uint64_t total = 0;
+  int changed = 0;
+  for (const uint32_t sum : sums_) {
+    total += sum;
+    if (sum > blockThreshold_) {
+      ++changed;
+    }
+  }
+  if (total == 0) {
+    return -1; // Same frame published twice
+  }
+  previous_.swap(current_);
+  if (static_cast<size_t>(changed) * 1000 >
+      sums_.size() * LIGHTING_CHANGE_PERMILLE) {
+    return 0;
+  }
+  return changed;
+}
+
+void MotionDetector::run() {
+  Metrics &metrics = Metrics::instance();
+  std::atomic<int64_t> &frames = metrics.value("dacl_motion_frames_total");
+  std::atomic<int64_t> &events = metrics.value("dacl_motion_events_total");
+  std::atomic<int64_t> &cpuUs = metrics.value("dacl_motion_cpu_us_total");
+  std::atomic<int64_t> &blocks = metrics.value("dacl_motion_changed_blocks");
+  metrics.setInfo("dacl_motion_kernel_info", "",
+                  {{"kernel", blockSadKernel()}});
+
+  TapFrame frame;
+  int confirmed = 0;
+  bool reported = false;
+  std::chrono::steady_clock::time_point lastEvent;
+  while (true) {
+    if (profiles_->state() != DrivingState::Parked) {
+      havePrevious_ = false;
+      confirmed = 0;
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(IDLE_INTERVAL_MS));
+      continue;
+    }
+    if (!reader_.readLatest(frame)) {
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(POLL_INTERVAL_MS));
+      continue;
+    }
+
+    const int64_t start = threadCpuMicros();
+    const int changed = changedBlocks(frame);
+    cpuUs += threadCpuMicros() - start;
+    if (changed < 0) {
+      continue;
+    }
+    ++frames;
+    blocks = changed;
+
+    confirmed = changed >= minBlocks_ ? confirmed + 1 : 0;
+    const auto now = std::chrono::steady_clock::now();
+    if (confirmed >= MOTION_CONFIRM_FRAMES &&
+        (!reported ||
+         now - lastEvent >= std::chrono::seconds(MIN_EVENT_INTERVAL_S))) {
+      std::cerr << "Motion detected: " << changed << " blocks changed"
+                << std::endl;
+      lastChangedBlocks_ = changed;
+      newMotion_ = true;
+      ++events;
+      reported = true;
+      lastEvent = now;
+      confirmed = 0;
+    }
+  }
+}
+
+bool MotionDetector::getLatestMotion(int &blocks) {
+  if (!newMotion_.exchange(false)) {
+    return false;
+  }
+  blocks = lastChangedBlocks_;
+  return true;
+}
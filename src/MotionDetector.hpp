@@ -0,0 +1,130 @@
+/**
+ * @file MotionDetector.hpp
+ * @brief Parked-mode motion detection on frame-tap frames
+ */
+
+#pragma once
+#include "FrameTap.hpp"
+#include "ProfileSelector.hpp"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/// Width and height of the blocks compared by the motion detector
+constexpr int MOTION_BLOCK_SIZE = 16;
+
+/**
+ * @brief Sums absolute differences of two grayscale frames per block
+ * @param previous Previous frame, width * height bytes
+ * @param current Current frame, width * height bytes
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ * @param[out] sums One sum per MOTION_BLOCK_SIZE block, row-major; holds
+ * (width / MOTION_BLOCK_SIZE) * (height / MOTION_BLOCK_SIZE) values
+ *
+ * Pixels right of or below the last complete block are ignored. Uses SSE2
+ * (`psadbw`) or NEON (`vabd` + pairwise accumulate) when the target supports
+ * it and the portable loop otherwise.
+ */
+void blockSad(const uint8_t *previous, const uint8_t *current, int width,
+              int height, uint32_t *sums);
+
+/** @brief Portable reference implementation of blockSad() */
+void blockSadScalar(const uint8_t *previous, const uint8_t *current,
+                    int width, int height, uint32_t *sums);
+
+/** @brief Instruction set used by blockSad() ("sse2", "neon" or "scalar") */
+const char *blockSadKernel();
+
+/**
+ * @brief Converts a BGR frame to grayscale at half its width and height
+ * @param bgr Packed BGR24 pixels
+ * @param width Source width in pixels (even)
+ * @param height Source height in pixels (even)
+ * @param[out] gray Receives (width / 2) * (height / 2) luma values, each
+ * the average of a 2x2 pixel square
+ */
+void bgrToGrayHalf(const uint8_t *bgr, int width, int height, uint8_t *gray);
+
+/**
+ * @class MotionDetector
+ * @brief Raises MOTION events while the vehicle is parked
+ *
+ * Reads frames from the frame tap, reduces them to half-size grayscale and
+ * compares each with the previous one in blocks of MOTION_BLOCK_SIZE pixels.
+ * A block has changed when its mean absolute difference exceeds the
+ * threshold; motion is reported when at least minBlocks blocks changed in
+ * MOTION_CONFIRM_FRAMES consecutive frames. Frames in which most blocks
+ * changed at once are treated as lighting changes (headlights, clouds)
+ * and ignored, and duplicated frames (the tap runs faster than parked
+ * capture) are skipped.
+ *
+ * The detector only looks at frames while the ProfileSelector reports the
+ * parked state. Frames are small (640x360 by default) and the per-frame
+ * work is a few hundred microseconds, far below 5% of a core at 10 fps
+ * (bench/motion_bench measures it); the processing time is reported as
+ * `dacl_motion_cpu_us_total`.
+ *
+ * @note Thread Safety: run() should be executed in a dedicated thread;
+ * getLatestMotion() can be called from any thread.
+ */
+class MotionDetector final {
+public:
+  /**
+   * @brief Constructs a detector
+   * @param tapName Shared-memory name of the frame tap
+   * @param profiles Driving state source; detection runs only when parked
+   * (non-owning)
+   * @param threshold Mean absolute difference (0-255) of a changed block
+   * @param minBlocks Changed blocks that count as motion
+   * @throws std::invalid_argument if profiles is null, tapName is empty or a
+   * limit is not positive
+   */
+  explicit MotionDetector(const std::string &tapName,
+                          const ProfileSelector *profiles, int threshold,
+                          int minBlocks);
+
+  /**
+   * @brief Main detection loop
+   * @note Runs indefinitely; should be executed in a dedicated thread
+   */
+  void run();
+
+  /**
+   * @brief Takes the latest motion event if one is pending
+   * @param[out] blocks Changed blocks in the frame that confirmed it
+   * @return true if motion was detected since the last call
+   * @note Thread-safe: Called from the trigger thread
+   */
+  bool getLatestMotion(int &blocks);
+
+private:
+  /**
+   * @brief Compares a frame with the previous one
+   * @return Number of changed blocks, or -1 for a duplicated frame
+   */
+  int changedBlocks(const TapFrame &frame);
+
+  FrameTapReader reader_;                ///< Source of frames
+  const ProfileSelector *const profiles_; ///< Arms the detector when parked
+  const uint32_t blockThreshold_;        ///< SAD of a changed block
+  const int minBlocks_;                  ///< Changed blocks that are motion
+
+  std::vector<uint8_t> previous_; ///< Grayscale previous frame
+  std::vector<uint8_t> current_;  ///< Grayscale current frame
+  std::vector<uint32_t> sums_;    ///< Per-block SAD of the current frame
+  bool havePrevious_ = false;     ///< previous_ holds a frame
+
+  std::atomic<bool> newMotion_{false};  ///< Motion pending for the trigger
+  std::atomic<int> lastChangedBlocks_{0}; ///< Blocks of the pending motion
+
+  static constexpr int MOTION_CONFIRM_FRAMES =
+      3; ///< Consecutive frames with motion before it is reported
+  static constexpr int LIGHTING_CHANGE_PERMILLE =
+      500; ///< Changed share of all blocks treated as a lighting change
+  static constexpr int MIN_EVENT_INTERVAL_S =
+      60; ///< Minimum time between two reported motion events
+  static constexpr int POLL_INTERVAL_MS = 20; ///< Wait for the next frame
+  static constexpr int IDLE_INTERVAL_MS =
+      500; ///< Check interval while not parked
+};
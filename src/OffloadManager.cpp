@@ -0,0 +1,391 @@
+#include "OffloadManager.hpp"
+#include "Metrics.hpp"
+#include "RetentionManager.hpp"
+#include "Sha256.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+constexpr double BYTES_PER_KB = 1024.0;
+
+/// Closes a file descriptor when the upload ends
+class FileDescriptor {
+public:
+  explicit FileDescriptor(int fd) : fd_(fd) {}
+  ~FileDescriptor() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+  FileDescriptor(const FileDescriptor &) = delete;
+  FileDescriptor &operator=(const FileDescriptor &) = delete;
+  int fd() const { return fd_; }
+
+private:
+  const int fd_;
+};
+
+/// Reads length bytes at offset; throws on errors and short files
+void readAt(int fd, char *buffer, size_t length, uint64_t offset,
+            const std::string &path) {
+  size_t done = 0;
+  while (done < length) {
+    const ssize_t n = ::pread(fd, buffer + done, length - done,
+                              static_cast<off_t>(offset + done));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw std::runtime_error("Cannot read " + path + ": " +
+                               (n < 0 ? std::strerror(errno) : "truncated"));
+    }
+    done += static_cast<size_t>(n);
+  }
+}
+
+int64_t mtimeSeconds(const std::filesystem::directory_entry &entry,
+                     std::error_code &ec) {
+  const auto ftime = entry.last_write_time(ec);
+  const auto sctp =
+      std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+          ftime - std::filesystem::file_time_type::clock::now() +
+          std::chrono::system_clock::now());
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             sctp.time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+OffloadManager::OffloadManager(const std::string &eventDir,
+                               const OffloadSettings &settings,
+                               const std::vector<std::string> &criticalTokens,
+                               ExportThrottle *throttle,
+                               const BusyCheck &exportsBusy)
+    : eventDir_(eventDir), journalPath_(eventDir + "/offload.journal"),
+      settings_(settings), criticalTokens_(criticalTokens),
+      throttle_(throttle), exportsBusy_(exportsBusy),
+      client_(settings.url, HTTP_TIMEOUT_MS) {
+  // Input validation
+  if (eventDir.empty()) {
+    throw std::invalid_argument("Event directory path cannot be empty");
+  }
+  if (settings.concurrency <= 0 || settings.maxKBps < 0) {
+    throw std::invalid_argument("Invalid offload limits");
+  }
+  if (settings.maxKBps > 0) {
+    networkBucket_ = std::make_unique<TokenBucket>(
+        settings.maxKBps * BYTES_PER_KB, BURST_SECONDS);
+  }
+
+  // Lines are "F\t<file name>\t<size>" for uploaded files and
+  // "E\t<event key>" for completed events
+  std::ifstream in(journalPath_);
+  std::string line;
+  std::vector<std::string> kept;
+  bool stale = false;
+  while (std::getline(in, line)) {
+    std::error_code ec;
+    if (line.compare(0, 2, "F\t") == 0 && line.rfind('\t') > 1) {
+      const size_t tab = line.rfind('\t');
+      const std::string name = line.substr(2, tab - 2);
+      if (std::filesystem::exists(eventDir_ + "/" + name, ec)) {
+        uploadedFiles_[name] = std::strtoull(line.c_str() + tab + 1,
+                                             nullptr, 10);
+        kept.push_back(line);
+        continue;
+      }
+    } else if (line.compare(0, 2, "E\t") == 0) {
+      completedEvents_.insert(line.substr(2));
+      kept.push_back(line);
+      continue;
+    }
+    stale = true; // Torn line, or a file evicted by retention meanwhile
+  }
+  in.close();
+  if (stale) {
+    const std::string tmpPath = journalPath_ + ".tmp";
+    {
+      std::ofstream out(tmpPath, std::ios::trunc);
+      for (const auto &keptLine : kept) {
+        out << keptLine << "\n";
+      }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, journalPath_, ec);
+  }
+}
+
+void OffloadManager::journal(const std::string &line) {
+  std::ofstream out(journalPath_, std::ios::app);
+  out << line << "\n";
+  if (!out) {
+    std::cerr << "Warning: Cannot write " << journalPath_ << std::endl;
+  }
+}
+
+void OffloadManager::pace(size_t bytes) {
+  if (networkBucket_) {
+    networkBucket_->acquire(bytes);
+  }
+}
+
+std::vector<OffloadManager::PendingEvent>
+OffloadManager::pendingEvents() const {
+  const int64_t now =
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  std::map<std::string, PendingEvent> events;
+  std::set<std::string> unsettled;
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(eventDir_, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (!entry.is_regular_file(ec) || !isEventFile(name)) {
+      continue;
+    }
+    const uint64_t size = entry.file_size(ec);
+    const int64_t mtime = mtimeSeconds(entry, ec);
+    if (ec) {
+      continue;
+    }
+    const std::string key = eventKey(name);
+    if (now - mtime < SETTLE_SECONDS) {
+      unsettled.insert(key); // Still being exported
+    }
+    PendingEvent &event = events[key];
+    event.key = key;
+    event.mtime = std::max(event.mtime, mtime);
+    event.files.emplace_back(name, size);
+  }
+
+  std::vector<PendingEvent> pending;
+  for (auto &kv : events) {
+    PendingEvent &event = kv.second;
+    if (unsettled.count(event.key)) {
+      continue;
+    }
+    const bool filesDone = std::all_of(
+        event.files.begin(), event.files.end(), [this](const auto &file) {
+          const auto it = uploadedFiles_.find(file.first);
+          return it != uploadedFiles_.end() && it->second == file.second;
+        });
+    if (filesDone && completedEvents_.count(event.key)) {
+      continue;
+    }
+    // Event keys start with "YYYYMMDD_HHMMSS_" followed by the warning type
+    static constexpr size_t TIMESTAMP_PREFIX_LENGTH = 16;
+    const std::string warningType =
+        event.key.size() > TIMESTAMP_PREFIX_LENGTH
+            ? event.key.substr(TIMESTAMP_PREFIX_LENGTH)
+            : event.key;
+    event.rank = static_cast<int>(classifyWarning(warningType,
+                                                  criticalTokens_));
+    pending.push_back(std::move(event));
+  }
+  std::sort(pending.begin(), pending.end(),
+            [](const PendingEvent &a, const PendingEvent &b) {
+              return a.rank != b.rank ? a.rank > b.rank : a.mtime < b.mtime;
+            });
+  return pending;
+}
+
+void OffloadManager::uploadFile(const std::string &key,
+                                const std::string &name, uint64_t size) {
+  Metrics &metrics = Metrics::instance();
+  const std::string path = eventDir_ + "/" + name;
+  FileDescriptor file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (file.fd() < 0) {
+    if (errno == ENOENT) {
+      return; // Evicted by retention since the scan
+    }
+    throw std::runtime_error("Cannot open " + path + ": " +
+                             std::strerror(errno));
+  }
+  const auto start = std::chrono::steady_clock::now();
+
+  // Chunk digests; the chunks are read again only if the endpoint lacks them
+  const size_t chunks = static_cast<size_t>((size + CHUNK_BYTES - 1) /
+                                            CHUNK_BYTES);
+  auto chunkLength = [size](size_t i) {
+    return static_cast<size_t>(
+        std::min<uint64_t>(CHUNK_BYTES, size - i * CHUNK_BYTES));
+  };
+  std::vector<char> buffer(CHUNK_BYTES);
+  std::vector<std::string> digests;
+  std::string digestList;
+  for (size_t i = 0; i < chunks; ++i) {
+    if (throttle_ != nullptr) {
+      throttle_->acquire(chunkLength(i));
+    }
+    readAt(file.fd(), buffer.data(), chunkLength(i), i * CHUNK_BYTES, path);
+    digests.push_back(Sha256::hex(buffer.data(), chunkLength(i)));
+    digestList += digests.back() + "\n";
+  }
+
+  const HttpResponse missingResponse = client_.request(
+      "POST", "/chunks/missing", digestList.data(), digestList.size());
+  if (missingResponse.status != 200) {
+    throw std::runtime_error("Chunk query failed with HTTP " +
+                             std::to_string(missingResponse.status));
+  }
+  std::set<std::string> missing;
+  std::istringstream lines(missingResponse.body);
+  for (std::string line; std::getline(lines, line);) {
+    missing.insert(line);
+  }
+  std::vector<size_t> toSend;
+  for (size_t i = 0; i < chunks; ++i) {
+    // Repeated chunks within the file are sent once
+    if (missing.erase(digests[i]) > 0) {
+      toSend.push_back(i);
+    }
+  }
+  metrics.value("dacl_offload_chunks_deduplicated_total") +=
+      static_cast<int64_t>(chunks - toSend.size());
+
+  // Workers take the next missing chunk until all are sent or one fails
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+  std::mutex errorMtx;
+  std::string error;
+  auto worker = [&]() {
+    std::vector<char> chunk(CHUNK_BYTES);
+    for (size_t n = next++; n < toSend.size() && !failed; n = next++) {
+      const size_t i = toSend[n];
+      try {
+        // Charged to the throttle while hashing; this re-read of a
+        // missing chunk is paced by the network bucket instead
+        readAt(file.fd(), chunk.data(), chunkLength(i), i * CHUNK_BYTES,
+               path);
+        const HttpResponse response = client_.request(
+            "PUT", "/chunks/" + digests[i], chunk.data(), chunkLength(i),
+            [this](size_t bytes) { pace(bytes); });
+        if (response.status != 200 && response.status != 201) {
+          throw std::runtime_error("Chunk upload failed with HTTP " +
+                                   std::to_string(response.status));
+        }
+        metrics.value("dacl_offload_bytes_total") +=
+            static_cast<int64_t>(chunkLength(i));
+        ++metrics.value("dacl_offload_chunks_total");
+      } catch (const std::exception &e) {
+        std::lock_guard<std::mutex> lk(errorMtx);
+        if (!failed.exchange(true)) {
+          error = e.what();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  const size_t workerCount =
+      std::min(toSend.size(), static_cast<size_t>(settings_.concurrency));
+  for (size_t i = 1; i < workerCount; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : workers) {
+    t.join();
+  }
+  if (failed) {
+    throw std::runtime_error(error);
+  }
+
+  const std::string manifest = "size " + std::to_string(size) + "\n" +
+                               digestList;
+  const HttpResponse response = client_.request(
+      "PUT", "/events/" + encodePathSegment(key) + "/" +
+                 encodePathSegment(name),
+      manifest.data(), manifest.size());
+  if (response.status != 200 && response.status != 201) {
+    throw std::runtime_error("File upload of " + name + " failed with HTTP " +
+                             std::to_string(response.status));
+  }
+  uploadedFiles_[name] = size;
+  journal("F\t" + name + "\t" + std::to_string(size));
+  ++metrics.value("dacl_offload_files_total");
+
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  uint64_t sent = 0;
+  for (size_t i : toSend) {
+    sent += chunkLength(i);
+  }
+  if (seconds > 0) {
+    metrics.value("dacl_offload_throughput_bytes_per_second") =
+        static_cast<int64_t>(sent / seconds);
+  }
+}
+
+void OffloadManager::uploadEvent(const PendingEvent &event) {
+  std::string names;
+  for (const auto &file : event.files) {
+    const auto it = uploadedFiles_.find(file.first);
+    if (it == uploadedFiles_.end() || it->second != file.second) {
+      uploadFile(event.key, file.first, file.second);
+    }
+    names += file.first + "\n";
+  }
+  const HttpResponse response = client_.request(
+      "POST", "/events/" + encodePathSegment(event.key) + "/complete",
+      names.data(), names.size());
+  if (response.status != 200 && response.status != 201) {
+    throw std::runtime_error("Completing event " + event.key +
+                             " failed with HTTP " +
+                             std::to_string(response.status));
+  }
+  completedEvents_.insert(event.key);
+  journal("E\t" + event.key);
+  ++Metrics::instance().value("dacl_offload_events_total");
+  std::cerr << "Event offloaded: " << event.key << " to " << client_.host()
+            << std::endl;
+}
+
+void OffloadManager::run() {
+  Metrics &metrics = Metrics::instance();
+  auto &pending = metrics.value("dacl_offload_pending_events");
+  auto &connected = metrics.value("dacl_offload_connected");
+  int backoffSeconds = 1;
+  while (true) {
+    // Captures get the disk to themselves
+    if (exportsBusy_ && exportsBusy_()) {
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+      continue;
+    }
+    const std::vector<PendingEvent> events = pendingEvents();
+    pending = static_cast<int64_t>(events.size());
+    if (events.empty()) {
+      std::this_thread::sleep_for(std::chrono::seconds(SCAN_INTERVAL_SECONDS));
+      continue;
+    }
+    try {
+      // One event per pass, so a new critical event goes next
+      uploadEvent(events.front());
+      connected = 1;
+      backoffSeconds = 1;
+    } catch (const std::exception &e) {
+      connected = 0;
+      ++metrics.value("dacl_offload_failures_total");
+      std::cerr << "Warning: Offload of " << events.front().key
+                << " failed: " << e.what() << "; retrying in "
+                << backoffSeconds << " s" << std::endl;
+      std::this_thread::sleep_for(std::chrono::seconds(backoffSeconds));
+      backoffSeconds = std::min(backoffSeconds * 2, MAX_BACKOFF_SECONDS);
+    }
+  }
+}
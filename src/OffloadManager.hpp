@@ -0,0 +1,146 @@
+/**
+ * @file OffloadManager.hpp
+ * @brief Resumable, chunked upload of finished events to an HTTP endpoint
+ */
+
+#pragma once
+#include "ExportThrottle.hpp"
+#include "HttpClient.hpp"
+#include "TokenBucket.hpp"
+#include "utils.hpp"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @struct OffloadSettings
+ * @brief Endpoint and limits of event offloading
+ */
+struct OffloadSettings {
+  std::string url;     ///< Endpoint, "http://host[:port][/prefix]"
+  int concurrency = 2; ///< Chunks uploaded at once
+  int maxKBps = 1024;  ///< Upload bandwidth in KB/s (0 = unlimited)
+};
+
+/**
+ * @class OffloadManager
+ * @brief Uploads finished events in content-addressed chunks
+ *
+ * This class runs as a background job to:
+ * - Collect the files of each finished event (no file written for
+ *   SETTLE_SECONDS and no capture in progress) that were not uploaded yet
+ * - Upload events by retention class, Critical before Manual before Routine
+ *   and oldest first within a class; the queue is re-read after every event
+ *   so a new critical event goes next
+ * - Split each file into CHUNK_BYTES chunks named by their SHA-256, ask the
+ *   endpoint which chunks it lacks and upload only those, up to concurrency
+ *   at a time; then send the file's chunk list, from which the endpoint
+ *   assembles the file, and finally mark the event complete
+ * - Resume after connectivity loss: chunks already on the endpoint are never
+ *   sent again, finished files are recorded in `<eventDir>/offload.journal`,
+ *   and failed attempts back off exponentially up to MAX_BACKOFF_SECONDS
+ * - Shape network use with a token bucket of maxKBps, and draw disk reads
+ *   from the ExportThrottle, which yields to the live recorder
+ * - Report bytes, chunks, deduplicated chunks, files, events, failures,
+ *   throughput and queue length in Metrics
+ *
+ * Endpoint protocol (paths below the URL prefix, names percent-encoded):
+ * - `POST /chunks/missing`: body and response are SHA-256 hex digests, one
+ *   per line; the response lists those the endpoint does not have
+ * - `PUT /chunks/<sha256>`: chunk content; the endpoint verifies the digest
+ * - `PUT /events/<event>/<file>`: "size <bytes>" followed by the chunk
+ *   digests in order, one per line; 201 once the file is assembled
+ * - `POST /events/<event>/complete`: names of the event's files
+ *
+ * The thread should run with a low-priority profile (DEFAULT_THREAD_PROFILE);
+ * the upload workers inherit it.
+ *
+ * @note Thread Safety: run() owns all state except the token bucket.
+ */
+class OffloadManager final {
+public:
+  /**
+   * @brief Constructs the offloader and loads its journal
+   * @param eventDir Directory of saved events
+   * @param settings Endpoint and limits
+   * @param criticalTokens Warning tokens classified as Critical
+   * @param throttle Export throttle limiting disk reads (optional)
+   * @param exportsBusy Optional predicate reporting running captures
+   * @throws std::invalid_argument if eventDir is empty, the URL is invalid
+   * or a limit is out of range
+   */
+  explicit OffloadManager(const std::string &eventDir,
+                          const OffloadSettings &settings,
+                          const std::vector<std::string> &criticalTokens,
+                          ExportThrottle *throttle = nullptr,
+                          const BusyCheck &exportsBusy = nullptr);
+
+  /**
+   * @brief Main loop uploading pending events
+   * @note Runs indefinitely; should be executed in a dedicated thread
+   */
+  void run();
+
+  /// Thread profile used for the offload role unless thread_offload is set
+  static constexpr const char *DEFAULT_THREAD_PROFILE = "nice=10,io=idle";
+
+private:
+  /// A finished event with files left to upload
+  struct PendingEvent {
+    std::string key; ///< Event key
+    int rank = 0;    ///< Upload order, higher goes first
+    int64_t mtime = 0; ///< Newest modification time (s)
+    std::vector<std::pair<std::string, uint64_t>>
+        files; ///< All event files (name, size)
+  };
+
+  /** @brief Finished events not yet completely uploaded, in upload order */
+  std::vector<PendingEvent> pendingEvents() const;
+
+  /**
+   * @brief Uploads the missing files of an event and marks it complete
+   * @throws std::runtime_error if the endpoint fails or cannot be reached
+   */
+  void uploadEvent(const PendingEvent &event);
+
+  /**
+   * @brief Uploads one file chunk by chunk
+   * @throws std::runtime_error if the endpoint fails or cannot be reached
+   */
+  void uploadFile(const std::string &key, const std::string &name,
+                  uint64_t size);
+
+  /** @brief Waits for network tokens; called by the upload workers */
+  void pace(size_t bytes);
+
+  /** @brief Appends a line to the journal */
+  void journal(const std::string &line);
+
+  const std::string eventDir_;    ///< Directory of saved events
+  const std::string journalPath_; ///< Uploaded files journal
+  const OffloadSettings settings_; ///< Endpoint and limits
+  const std::vector<std::string> criticalTokens_; ///< Critical warnings
+  ExportThrottle *const throttle_; ///< Limits disk reads, or nullptr
+  const BusyCheck exportsBusy_;    ///< Reports running captures
+  const HttpClient client_;        ///< Endpoint connection factory
+  std::map<std::string, uint64_t>
+      uploadedFiles_; ///< File name -> uploaded size (run() only)
+  std::set<std::string> completedEvents_; ///< Event keys marked complete
+
+  std::unique_ptr<TokenBucket>
+      networkBucket_; ///< Limits network bytes, or nullptr if unlimited
+
+  static constexpr size_t CHUNK_BYTES = 4 * 1024 * 1024; ///< Chunk size
+  static constexpr int SETTLE_SECONDS =
+      30; ///< Quiet time after which an event counts as finished
+  static constexpr int SCAN_INTERVAL_SECONDS =
+      10; ///< Period of event directory scans when idle
+  static constexpr int MAX_BACKOFF_SECONDS =
+      300; ///< Longest wait between failed attempts
+  static constexpr int HTTP_TIMEOUT_MS = 30000; ///< Per-step HTTP timeout
+  static constexpr double BURST_SECONDS =
+      0.5; ///< Token bucket depth in seconds of the bandwidth limit
+};
@@ -1,18 +1,26 @@
 #include "OverlayRenderer.hpp"
+#include "Tracer.hpp"
 #include <filesystem>
 #include <opencv2/opencv.hpp>
 #include <stdexcept>
 
 OverlayRenderer::OverlayRenderer(CANListener *canListener)
-    : canListener_(canListener) {
-  if (canListener == nullptr) {
-    throw std::invalid_argument("CANListener pointer cannot be null");
-  }
-}
+    : canListener_(canListener) {}
 
 std::string OverlayRenderer::renderOverlay(int speed,
                                            const std::string &warningType,
                                            const std::string &timestamp) {
+  // Get vehicle data from CAN listener as one snapshot
+  return renderOverlay(speed, warningType, timestamp,
+                       canListener_ != nullptr ? canListener_->getVehicleState()
+                                               : VehicleState());
+}
+
+std::string OverlayRenderer::renderOverlay(int speed,
+                                           const std::string &warningType,
+                                           const std::string &timestamp,
+                                           const VehicleState &state) {
+  TraceScope span("overlay", "render");
   // Input validation
   if (warningType.empty()) {
     throw std::invalid_argument("Warning type cannot be empty");
@@ -21,9 +29,8 @@ std::string OverlayRenderer::renderOverlay(int speed,
     throw std::invalid_argument("Timestamp cannot be empty");
   }
 
-  // Get vehicle data from CAN listener
-  const int tripMileage = canListener_->getTripMileage();
-  const int totalMileage = canListener_->getTotalMileage();
+  const int tripMileage = state.tripMileage;
+  const int totalMileage = state.totalMileage;
 
   // Create overlay image with transparency (4 channels: BGR + Alpha)
   cv::Mat img(OVERLAY_HEIGHT, OVERLAY_WIDTH, CV_8UC4, cv::Scalar(0, 0, 0, 0));
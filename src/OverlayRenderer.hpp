@@ -27,9 +27,10 @@ public:
   /**
    * @brief Constructs an OverlayRenderer with CAN data integration
    * @param canListener Pointer to CAN listener for real-time data access
-   * @throws std::invalid_argument if canListener is nullptr
+   * (nullptr = the vehicle state is always passed to renderOverlay(), as
+   * in the event processor)
    */
-  explicit OverlayRenderer(CANListener *canListener);
+  explicit OverlayRenderer(CANListener *canListener = nullptr);
 
   /**
    * @brief Generates an overlay image with specified information
@@ -45,8 +46,22 @@ public:
   std::string renderOverlay(int speed, const std::string &warningType,
                             const std::string &timestamp);
 
+  /**
+   * @brief Generates an overlay image from a given vehicle state
+   * @param speed Vehicle speed to display
+   * @param warningType Warning message to display
+   * @param timestamp Timestamp string for display
+   * @param state Vehicle state whose mileage is displayed, e.g. the one
+   * captured with the trigger
+   * @return Path to generated overlay image file
+   * @throws std::runtime_error if image generation fails
+   */
+  std::string renderOverlay(int speed, const std::string &warningType,
+                            const std::string &timestamp,
+                            const VehicleState &state);
+
 private:
-  CANListener *const canListener_; ///< Pointer to CAN listener for data access
+  CANListener *const canListener_; ///< CAN data source, or nullptr
 
   // Overlay styling constants
   static constexpr int OVERLAY_WIDTH = 800;  ///< Overlay image width
@@ -0,0 +1,458 @@
+#include "PipelineRing.hpp"
+#include "FrameIndex.hpp"
+#include "Metrics.hpp"
+#include "SegmentManifest.hpp"
+#include "Seqlock.hpp"
+#include "TimeSync.hpp"
+#include "Tracer.hpp"
+#include "utils.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t PIPELINE_MAGIC = 0x4C505044; ///< "DPPL"
+constexpr uint32_t PIPELINE_VERSION = 1;
+constexpr size_t CACHE_LINE = 64;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "pipeline ring needs address-free 64-bit atomics");
+
+size_t alignUp(size_t n) { return (n + CACHE_LINE - 1) & ~(CACHE_LINE - 1); }
+
+} // namespace
+
+/// Layout of the start of the shared-memory segment
+struct alignas(64) PipelineHeader {
+  uint32_t magic;      ///< PIPELINE_MAGIC once initialized
+  uint32_t version;    ///< PIPELINE_VERSION
+  int64_t instance;    ///< Wall-clock start of the daemon
+  uint64_t eventSlots; ///< Slots of the event ring
+  uint64_t canFrames;  ///< Capacity of the CAN frame ring
+  std::atomic<uint64_t> published;      ///< Events published so far
+  std::atomic<int64_t> heartbeatUs;     ///< CLOCK_MONOTONIC of last refresh
+  std::atomic<int64_t> writeLatencyUs;  ///< Worst recorder write latency
+  std::atomic<int64_t> backlogPermille; ///< Fullest capture pipe
+  Seqlock<VehicleState> vehicle;        ///< Latest vehicle state
+};
+
+namespace {
+
+size_t eventsOffset() { return alignUp(sizeof(PipelineHeader)); }
+
+size_t canOffset() {
+  return alignUp(eventsOffset() + PipelineWriter::EVENT_SLOTS *
+                                      sizeof(Seqlock<PipelineEvent>));
+}
+
+size_t segmentBytes(size_t canFrames) {
+  return canOffset() + CanFrameRing::storageBytes(canFrames);
+}
+
+Seqlock<PipelineEvent> *eventSlots(PipelineHeader *header) {
+  return reinterpret_cast<Seqlock<PipelineEvent> *>(
+      reinterpret_cast<uint8_t *>(header) + eventsOffset());
+}
+
+const Seqlock<PipelineEvent> *eventSlots(const PipelineHeader *header) {
+  return eventSlots(const_cast<PipelineHeader *>(header));
+}
+
+/// Copies text into a fixed field, cut to fit and zero-terminated
+template <size_t N> void setText(char (&field)[N], const std::string &text) {
+  std::snprintf(field, N, "%s", text.c_str());
+}
+
+/// Hard-links source to target, copying if they are on different
+/// filesystems
+bool stageFile(const std::string &source, const std::string &target) {
+  if (::link(source.c_str(), target.c_str()) == 0) {
+    return true;
+  }
+  if (errno != EXDEV && errno != EPERM) {
+    return false;
+  }
+  std::error_code ec;
+  return std::filesystem::copy_file(
+      source, target, std::filesystem::copy_options::overwrite_existing, ec);
+}
+
+/// Writes a file through a temporary file and a rename
+bool writeFileAtomically(const std::string &path, const std::string &data) {
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::trunc);
+    if (!out.is_open() || !(out << data) || !out.flush()) {
+      return false;
+    }
+  }
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+} // namespace
+
+PipelineWriter::PipelineWriter(const std::string &name, size_t canFrames,
+                               const std::string &stagingDir,
+                               ExportThrottle *throttle)
+    : name_(name), stagingDir_(stagingDir), throttle_(throttle) {
+  if (name.size() < 2 || name[0] != '/') {
+    throw std::invalid_argument("Pipeline name must start with '/'");
+  }
+  if (stagingDir.empty()) {
+    throw std::invalid_argument("Staging directory cannot be empty");
+  }
+  if (canFrames == 0) {
+    throw std::invalid_argument("Pipeline needs CAN frames");
+  }
+  std::filesystem::create_directories(stagingDir_);
+
+  // Start from a fresh segment; a processor attached to an old one
+  // re-attaches when its heartbeat stops
+  ::shm_unlink(name_.c_str());
+  const int fd = ::shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot create pipeline " + name_ + ": " +
+                             std::strerror(errno));
+  }
+  mapBytes_ = segmentBytes(canFrames);
+  void *map = MAP_FAILED;
+  if (::ftruncate(fd, static_cast<off_t>(mapBytes_)) == 0) {
+    map = ::mmap(nullptr, mapBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                 0);
+  }
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    ::shm_unlink(name_.c_str());
+    throw std::runtime_error("Cannot map pipeline " + name_);
+  }
+
+  header_ = new (map) PipelineHeader;
+  header_->instance = wallClockMicros();
+  header_->eventSlots = EVENT_SLOTS;
+  header_->canFrames = canFrames;
+  header_->published.store(0, std::memory_order_relaxed);
+  header_->heartbeatUs.store(TimeSync::monotonicMicros(),
+                             std::memory_order_relaxed);
+  header_->writeLatencyUs.store(0, std::memory_order_relaxed);
+  header_->backlogPermille.store(0, std::memory_order_relaxed);
+  header_->vehicle.write(VehicleState());
+  Seqlock<PipelineEvent> *slots = eventSlots(header_);
+  for (size_t i = 0; i < EVENT_SLOTS; ++i) {
+    new (&slots[i]) Seqlock<PipelineEvent>();
+  }
+  canFrames_ = std::make_unique<CanFrameRing>(
+      canFrames, static_cast<uint8_t *>(map) + canOffset(), false);
+  header_->version = PIPELINE_VERSION;
+  // Readers check the magic last, so publish it after everything else
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = PIPELINE_MAGIC;
+}
+
+PipelineWriter::~PipelineWriter() {
+  if (header_ != nullptr) {
+    canFrames_.reset();
+    ::munmap(header_, mapBytes_);
+    ::shm_unlink(name_.c_str());
+  }
+}
+
+bool PipelineWriter::publish(const EventInfo &event,
+                             const std::vector<EventCamera> &cameras) {
+  TraceScope span("pipeline", "publish");
+  std::lock_guard<std::mutex> lk(mtx_);
+  const uint64_t sequence =
+      header_->published.load(std::memory_order_relaxed) + 1;
+  const std::string dir =
+      stagingDir_ + "/" + stagedEventName(header_->instance, sequence);
+
+  // The links pin the files; the handles only have to live until here
+  std::vector<SegmentInfo> staged;
+  std::string cameraNames;
+  try {
+    for (const EventCamera &camera : cameras) {
+      cameraNames += (cameraNames.empty() ? "" : ",") + camera.camera;
+      auto stage = [&](const SegmentHandle &segment, const std::string &role) {
+        const std::string roleDir = dir + "/" + camera.camera + "/" + role;
+        std::filesystem::create_directories(roleDir);
+        SegmentInfo info = segment.info();
+        info.path = roleDir + "/" +
+                    std::filesystem::path(segment.path()).filename().string();
+        if (!stageFile(segment.path(), info.path)) {
+          throw std::runtime_error("Cannot stage " + segment.path() + ": " +
+                                   std::strerror(errno));
+        }
+        // Optional; bundles carry the index when there is one
+        stageFile(frameIndexPath(segment.path()), frameIndexPath(info.path));
+        staged.push_back(info);
+      };
+      for (const SegmentHandle &segment : camera.pre) {
+        stage(segment, "pre");
+      }
+      std::error_code ec;
+      if (camera.post && std::filesystem::exists(camera.post.path(), ec)) {
+        stage(camera.post, "post");
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Warning: Event " << event.warningType
+              << " not handed to the processor: " << e.what() << std::endl;
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return false;
+  }
+  std::filesystem::create_directories(dir);
+  SegmentManifest manifest(dir + "/segments.manifest");
+  std::ostringstream metadata;
+  metadata << "timestamp=" << event.timestamp
+           << "\ntrigger=" << event.triggerType
+           << "\nwarning=" << event.warningType
+           << "\nspeed_kmh=" << event.speed
+           << "\ntrigger_us=" << event.triggerUs
+           << "\npre_minutes=" << event.preMin
+           << "\npost_minutes=" << event.postMin
+           << "\ntrip_km=" << event.vehicle.tripMileage
+           << "\nodometer_km=" << event.vehicle.totalMileage
+           << "\ncameras=" << cameraNames << "\n";
+  // event.ini comes last: it marks the staged event as complete
+  if (!manifest.compact(staged) ||
+      !writeFileAtomically(dir + "/event.ini", metadata.str())) {
+    std::cerr << "Warning: Event " << event.warningType
+              << " not handed to the processor: cannot write " << dir
+              << std::endl;
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return false;
+  }
+
+  PipelineEvent record;
+  record.sequence = sequence;
+  record.triggerUs = event.triggerUs;
+  record.speed = event.speed;
+  record.preMin = event.preMin;
+  record.postMin = event.postMin;
+  record.vehicle = event.vehicle;
+  setText(record.timestamp, event.timestamp);
+  setText(record.triggerType, event.triggerType);
+  setText(record.warningType, event.warningType);
+  eventSlots(header_)[(sequence - 1) % EVENT_SLOTS].write(record);
+  header_->published.store(sequence, std::memory_order_release);
+  ++Metrics::instance().value("dacl_pipeline_events_total");
+  return true;
+}
+
+void PipelineWriter::run(const CANListener *canListener) {
+  while (true) {
+    header_->vehicle.write(canListener->getVehicleState());
+    if (throttle_ != nullptr) {
+      int64_t latencyUs = 0;
+      int backlogPermille = 0;
+      throttle_->drainPressure(latencyUs, backlogPermille);
+      header_->writeLatencyUs.store(latencyUs, std::memory_order_relaxed);
+      header_->backlogPermille.store(backlogPermille,
+                                     std::memory_order_relaxed);
+    }
+    header_->heartbeatUs.store(TimeSync::monotonicMicros(),
+                               std::memory_order_release);
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(REFRESH_INTERVAL_MS));
+  }
+}
+
+PipelineReader::PipelineReader(const std::string &name) : name_(name) {
+  if (name.empty()) {
+    throw std::invalid_argument("Pipeline name cannot be empty");
+  }
+}
+
+PipelineReader::~PipelineReader() { detach(); }
+
+bool PipelineReader::poll() {
+  if (header_ == nullptr && !attach()) {
+    return false;
+  }
+  const int64_t ageUs = TimeSync::monotonicMicros() -
+                        header_->heartbeatUs.load(std::memory_order_acquire);
+  if (ageUs > STALE_US) {
+    // The daemon is gone, or was restarted with a new segment
+    detach();
+    return false;
+  }
+  return true;
+}
+
+bool PipelineReader::attach() {
+  const int fd = ::shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st {};
+  void *map = MAP_FAILED;
+  if (::fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(PipelineHeader)) {
+    map = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                 MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  const auto *header = static_cast<const PipelineHeader *>(map);
+  const size_t size = static_cast<size_t>(st.st_size);
+  bool valid = header->magic == PIPELINE_MAGIC;
+  // Pairs with the writer's release fence before it stores the magic
+  std::atomic_thread_fence(std::memory_order_acquire);
+  valid = valid && header->version == PIPELINE_VERSION &&
+          header->eventSlots == PipelineWriter::EVENT_SLOTS &&
+          header->canFrames > 0 && size >= segmentBytes(header->canFrames) &&
+          TimeSync::monotonicMicros() -
+                  header->heartbeatUs.load(std::memory_order_acquire) <=
+              STALE_US;
+  if (!valid) {
+    ::munmap(map, size);
+    return false;
+  }
+  header_ = header;
+  mapBytes_ = size;
+  // Mapped read-only; the reader only calls the ring's const methods
+  canFrames_ = std::make_unique<CanFrameRing>(
+      header->canFrames, static_cast<uint8_t *>(map) + canOffset(), true);
+  if (header->instance != instance_) {
+    // A new daemon: its events start after the ones already published,
+    // which the processor finds staged
+    instance_ = header->instance;
+    read_ = header->published.load(std::memory_order_acquire);
+    missed_ = 0;
+  }
+  return true;
+}
+
+void PipelineReader::detach() {
+  if (header_ != nullptr) {
+    canFrames_.reset();
+    ::munmap(const_cast<PipelineHeader *>(header_), mapBytes_);
+    header_ = nullptr;
+  }
+}
+
+bool PipelineReader::next(PipelineEvent &event) {
+  if (header_ == nullptr) {
+    return false;
+  }
+  const uint64_t published =
+      header_->published.load(std::memory_order_acquire);
+  const uint64_t slots = PipelineWriter::EVENT_SLOTS;
+  const uint64_t oldest = published > slots ? published - slots + 1 : 1;
+  if (read_ + 1 < oldest) {
+    missed_ += oldest - read_ - 1;
+    read_ = oldest - 1;
+  }
+  while (read_ < published) {
+    event = eventSlots(header_)[read_ % slots].read();
+    ++read_;
+    if (event.sequence == read_) {
+      return true;
+    }
+    ++missed_; // Overwritten while we were copying
+  }
+  return false;
+}
+
+VehicleState PipelineReader::vehicle() const {
+  return header_ != nullptr ? header_->vehicle.read() : VehicleState();
+}
+
+void PipelineReader::pressure(int64_t &latencyUs,
+                              int &backlogPermille) const {
+  latencyUs = 0;
+  backlogPermille = 0;
+  if (header_ != nullptr) {
+    latencyUs = header_->writeLatencyUs.load(std::memory_order_relaxed);
+    backlogPermille = static_cast<int>(
+        header_->backlogPermille.load(std::memory_order_relaxed));
+  }
+}
+
+std::string stagedEventName(int64_t instance, uint64_t sequence) {
+  char name[48];
+  std::snprintf(name, sizeof(name), "%016lld_%08llu",
+                static_cast<long long>(instance),
+                static_cast<unsigned long long>(sequence));
+  return name;
+}
+
+bool loadStagedEvent(const std::string &dir, EventInfo &event,
+                     std::vector<EventCamera> &cameras) {
+  std::ifstream in(dir + "/event.ini");
+  if (!in.is_open()) {
+    return false;
+  }
+  std::map<std::string, std::string> kv;
+  std::string line;
+  while (std::getline(in, line)) {
+    const auto eq = line.find('=');
+    if (eq != std::string::npos) {
+      kv[line.substr(0, eq)] = line.substr(eq + 1);
+    }
+  }
+  if (!kv.count("timestamp") || !kv.count("trigger") ||
+      !kv.count("warning") || !kv.count("cameras")) {
+    return false;
+  }
+  try {
+    event = EventInfo();
+    event.timestamp = kv["timestamp"];
+    event.triggerType = kv["trigger"];
+    event.warningType = kv["warning"];
+    event.speed = std::stoi(kv["speed_kmh"]);
+    event.triggerUs = std::stoll(kv["trigger_us"]);
+    event.preMin = std::stoi(kv["pre_minutes"]);
+    event.postMin = std::stoi(kv["post_minutes"]);
+    event.vehicle.speed = event.speed;
+    event.vehicle.tripMileage = std::stoi(kv["trip_km"]);
+    event.vehicle.totalMileage = std::stoi(kv["odometer_km"]);
+  } catch (const std::exception &) {
+    return false; // Missing or malformed number
+  }
+
+  cameras.clear();
+  std::istringstream names(kv["cameras"]);
+  std::string name;
+  while (std::getline(names, name, ',')) {
+    cameras.push_back({name, {}, SegmentHandle()});
+  }
+  // Staged as <dir>/<camera>/{pre,post}/<file>, in recording order
+  for (const SegmentInfo &info :
+       SegmentManifest::read(dir + "/segments.manifest")) {
+    const std::filesystem::path roleDir =
+        std::filesystem::path(info.path).parent_path();
+    const std::string role = roleDir.filename().string();
+    const std::string camera = roleDir.parent_path().filename().string();
+    for (EventCamera &entry : cameras) {
+      if (entry.camera != camera) {
+        continue;
+      }
+      SegmentHandle handle(std::make_shared<Segment>(info));
+      if (role == "pre") {
+        entry.pre.push_back(std::move(handle));
+      } else if (role == "post") {
+        entry.post = std::move(handle);
+      }
+    }
+  }
+  return true;
+}
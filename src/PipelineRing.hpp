@@ -0,0 +1,215 @@
+/**
+ * @file PipelineRing.hpp
+ * @brief Shared-memory hand-over of trigger events and CAN frames from the
+ * capture daemon to the event processor
+ */
+
+#pragma once
+#include "CANListener.hpp"
+#include "CanFrameRing.hpp"
+#include "EventExporter.hpp"
+#include "ExportThrottle.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @struct PipelineEvent
+ * @brief One trigger as published in the pipeline ring
+ *
+ * Fixed-size, so that it can live in a Seqlock slot; the texts are
+ * zero-terminated and cut to fit.
+ */
+struct PipelineEvent {
+  uint64_t sequence = 0;   ///< Number of the event since the daemon started
+  int64_t triggerUs = 0;   ///< Wall-clock trigger time (0 = untimed)
+  int32_t speed = 0;       ///< Vehicle speed at the trigger in km/h
+  int32_t preMin = 0;      ///< Pre-trigger duration in minutes
+  int32_t postMin = 0;     ///< Post-trigger duration in minutes
+  VehicleState vehicle;    ///< Vehicle state at the trigger
+  char timestamp[24] = {}; ///< CAN-based event time (YYYYMMDD_HHMMSS)
+  char triggerType[24] = {}; ///< Source of the trigger
+  char warningType[64] = {}; ///< Warning or event label
+};
+
+struct PipelineHeader;
+
+/**
+ * @class PipelineWriter
+ * @brief Capture-daemon side of the pipeline (pipeline=split)
+ *
+ * Creates the shared memory `name`, holding:
+ * - a ring of the last EVENT_SLOTS trigger events, each a Seqlock slot
+ * - the CanFrameRing the CAN thread appends every received frame to
+ * - the vehicle state, a heartbeat and the recorders' write latency and
+ *   pipe backlog, refreshed by run()
+ *
+ * Before an event is published, its segments are hard-linked into a
+ * staging directory of their own (`<stagingDir>/<instance>_<sequence>`),
+ * together with a segment manifest and the trigger metadata (event.ini).
+ * The links keep the files alive when the recorder evicts them, however
+ * long the processor needs; they cost no copy, and the staged events let a
+ * processor that was restarted pick up what it missed.
+ *
+ * @note Thread Safety: publish() may be called from any thread; run()
+ * should be executed in a dedicated thread.
+ */
+class PipelineWriter final {
+public:
+  /**
+   * @brief Creates the shared memory, replacing a stale one
+   * @param name Shared-memory name, e.g. "/dacl_pipeline"
+   * @param canFrames Number of CAN frames kept
+   * @param stagingDir Directory of staged events; must be on the buffer's
+   * filesystem, or every segment is copied in the trigger thread
+   * @param throttle Throttle whose recorder pressure is forwarded (nullptr
+   * = none)
+   * @throws std::invalid_argument if name or stagingDir is empty or
+   * canFrames is 0
+   * @throws std::runtime_error if the shared memory cannot be created
+   */
+  explicit PipelineWriter(const std::string &name, size_t canFrames,
+                          const std::string &stagingDir,
+                          ExportThrottle *throttle = nullptr);
+  ~PipelineWriter();
+
+  PipelineWriter(const PipelineWriter &) = delete;
+  PipelineWriter &operator=(const PipelineWriter &) = delete;
+
+  /** @brief CAN frame history in the shared memory, for the CAN thread */
+  CanFrameRing *canFrames() { return canFrames_.get(); }
+
+  /**
+   * @brief Stages the segments of an event and publishes the event
+   * @param event Trigger metadata
+   * @param cameras Pinned segments per camera, first camera first
+   * @return false if staging failed; the event is not published then
+   * @note Only links files; a segment that cannot be linked (another
+   * filesystem) is copied
+   */
+  bool publish(const EventInfo &event,
+               const std::vector<EventCamera> &cameras);
+
+  /**
+   * @brief Refreshes heartbeat, vehicle state and recorder pressure
+   * @param canListener Source of the vehicle state; passed here because
+   * it is built on canFrames()
+   * @note Runs indefinitely; should be executed in a dedicated thread
+   */
+  void run(const CANListener *canListener);
+
+  /// Trigger events kept in the ring
+  static constexpr size_t EVENT_SLOTS = 64;
+  /// Period of run()
+  static constexpr int REFRESH_INTERVAL_MS = 100;
+
+private:
+  const std::string name_;                  ///< Shared-memory name
+  const std::string stagingDir_;            ///< Directory of staged events
+  ExportThrottle *const throttle_;          ///< Pressure source, or nullptr
+  PipelineHeader *header_ = nullptr;        ///< Start of the mapping
+  size_t mapBytes_ = 0;                     ///< Size of the mapping
+  std::unique_ptr<CanFrameRing> canFrames_; ///< Ring within the mapping
+  std::mutex mtx_;                          ///< Serializes publish()
+};
+
+/**
+ * @class PipelineReader
+ * @brief Event-processor side of the pipeline
+ *
+ * Maps the daemon's shared memory read-only. It attaches lazily and
+ * re-attaches when the daemon was restarted (a new instance) or stops
+ * refreshing the heartbeat, so a processor may start before the daemon.
+ *
+ * @note Thread Safety: Not thread-safe; owned by the EventProcessor thread.
+ * canFrames() may be read from other threads until the next attach().
+ */
+class PipelineReader final {
+public:
+  /**
+   * @brief Constructs a reader for a pipeline
+   * @param name Shared-memory name
+   * @throws std::invalid_argument if name is empty
+   */
+  explicit PipelineReader(const std::string &name);
+  ~PipelineReader();
+
+  PipelineReader(const PipelineReader &) = delete;
+  PipelineReader &operator=(const PipelineReader &) = delete;
+
+  /**
+   * @brief Attaches if needed and checks that the daemon is alive
+   * @return true while attached to a live daemon
+   * @note A new attachment starts at the newest event; call instance()
+   * to notice that it changed
+   */
+  bool poll();
+
+  /**
+   * @brief Takes the next published event
+   * @param[out] event The event
+   * @return false if there is none
+   * @note Events overwritten before they were read are counted in
+   * missed()
+   */
+  bool next(PipelineEvent &event);
+
+  /** @brief Start time of the attached daemon (0 = not attached) */
+  int64_t instance() const { return instance_; }
+
+  /** @brief Events overwritten before they were read since attaching */
+  uint64_t missed() const { return missed_; }
+
+  /** @brief Vehicle state last published by the daemon */
+  VehicleState vehicle() const;
+
+  /**
+   * @brief Recorder pressure of the daemon's last refresh
+   * @param[out] latencyUs Worst recorder write latency
+   * @param[out] backlogPermille Fullest capture pipe in permille
+   */
+  void pressure(int64_t &latencyUs, int &backlogPermille) const;
+
+  /** @brief The daemon's CAN frame history, or nullptr if not attached */
+  const CanFrameRing *canFrames() const { return canFrames_.get(); }
+
+  /// Heartbeat age after which the daemon is considered gone
+  static constexpr int64_t STALE_US = 5000000;
+
+private:
+  /** @brief Maps the shared memory; false if absent or invalid */
+  bool attach();
+  /** @brief Unmaps the shared memory */
+  void detach();
+
+  const std::string name_;                    ///< Shared-memory name
+  const PipelineHeader *header_ = nullptr;    ///< Start of the mapping
+  size_t mapBytes_ = 0;                       ///< Size of the mapping
+  std::unique_ptr<CanFrameRing> canFrames_;   ///< Ring within the mapping
+  int64_t instance_ = 0;                      ///< Attached daemon instance
+  uint64_t read_ = 0;                         ///< Events taken so far
+  uint64_t missed_ = 0;                       ///< Events overwritten unread
+};
+
+/**
+ * @brief Name of the staging directory of an event
+ * @param instance Start time of the daemon that staged it
+ * @param sequence Number of the event
+ * @return Name that sorts in staging order
+ */
+std::string stagedEventName(int64_t instance, uint64_t sequence);
+
+/**
+ * @brief Reads a staged event
+ * @param dir Staging directory of the event
+ * @param[out] event Trigger metadata from event.ini
+ * @param[out] cameras Staged segments per camera; the handles do not delete
+ * the files
+ * @return false if the event is incomplete (event.ini missing) or damaged
+ */
+bool loadStagedEvent(const std::string &dir, EventInfo &event,
+                     std::vector<EventCamera> &cameras);
@@ -1,31 +1,29 @@
 #include "PreviewManager.hpp"
-#include <algorithm>
-#include <chrono>
-#include <filesystem>
+#include "FrameTap.hpp"
 #include <opencv2/opencv.hpp>
-#include <thread>
-#include <vector>
+#include <stdexcept>
 
-PreviewManager::PreviewManager(const std::string &bufferDir)
-    : bufferDir_(bufferDir) {}
+PreviewManager::PreviewManager(const std::string &tapName)
+    : tapName_(tapName) {
+  if (tapName.empty()) {
+    throw std::invalid_argument("Frame tap name cannot be empty");
+  }
+}
 
 void PreviewManager::run() {
+  FrameTapReader reader(tapName_);
+  TapFrame frame;
   cv::namedWindow("Preview");
   while (true) {
-    std::vector<std::string> files;
-    for (auto &p : std::filesystem::directory_iterator(bufferDir_)) {
-      files.push_back(p.path().string());
+    if (reader.readLatest(frame)) {
+      // Wraps the copied pixels without another copy
+      const cv::Mat image(frame.height, frame.width, CV_8UC3,
+                          frame.bgr.data());
+      cv::imshow("Preview", image);
     }
-    if (!files.empty()) {
-      std::sort(files.begin(), files.end());
-      std::string file = files.back();
-      cv::VideoCapture cap(file);
-      cv::Mat frame;
-      if (cap.isOpened() && cap.read(frame)) {
-        cv::imshow("Preview", frame);
-        cv::waitKey(60);
-      }
+    if ((cv::waitKey(FRAME_DELAY_MS) & 0xFF) == 'q') {
+      break;
     }
-    std::this_thread::sleep_for(std::chrono::seconds(2));
   }
-}
\ No newline at end of file
+  cv::destroyWindow("Preview");
+}
@@ -11,34 +11,34 @@
  * @brief Provides live video preview capabilities using OpenCV display
  *
  * This class enables real-time video monitoring by:
- * - Reading latest video segments from buffer directory
+ * - Reading the latest frame from the recorder's shared-memory frame tap
  * - Displaying video frames in an OpenCV window
  * - Providing visual feedback for development and debugging
  *
+ * Frames are copied from shared memory, so the preview neither decodes
+ * video nor touches the buffer directory.
+ *
  * @note Preview functionality is optional and typically used during
  * development. Requires X11 forwarding or local display for GUI output.
  */
 class PreviewManager final {
 public:
   /**
-   * @brief Constructs a PreviewManager for the specified buffer directory
-   * @param bufferDir Directory containing video segments to preview
-   * @throws std::invalid_argument if bufferDir is empty
-   * @throws std::runtime_error if OpenCV display initialization fails
+   * @brief Constructs a PreviewManager reading from a frame tap
+   * @param tapName Shared-memory name of the recorder's frame tap
+   * @throws std::invalid_argument if tapName is empty
    */
-  explicit PreviewManager(const std::string &bufferDir);
+  explicit PreviewManager(const std::string &tapName);
 
   /**
    * @brief Main loop for continuous video preview
-   * @note This method runs indefinitely, displaying video frames.
-   *       Should be executed in a separate thread.
-   *       Press 'q' key to exit preview loop.
+   * @note This method runs until 'q' is pressed in the preview window,
+   *       displaying video frames. Should be executed in a separate thread.
    */
   void run();
 
 private:
-  const std::string
-      bufferDir_; ///< Directory containing video segments to preview
+  const std::string tapName_; ///< Shared-memory name of the frame tap
 
   static constexpr int FRAME_DELAY_MS = 33; ///< Delay between frames (~30 FPS)
-};
\ No newline at end of file
+};
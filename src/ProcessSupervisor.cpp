@@ -0,0 +1,436 @@
+#include "ProcessSupervisor.hpp"
+#include "Metrics.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <spawn.h>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t elapsedUs(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               since)
+      .count();
+}
+
+double seconds(const timeval &tv) { return tv.tv_sec + tv.tv_usec / 1e6; }
+
+/// Adds per-job resource usage to the metrics registry
+void recordJob(const std::string &job, const ProcessResult &result) {
+  Metrics &metrics = Metrics::instance();
+  const std::string prefix = "dacl_job_" + job + "_";
+  ++metrics.value(prefix + "runs_total");
+  if (!result.ok()) {
+    ++metrics.value(prefix + "failures_total");
+  }
+  if (result.timedOut) {
+    ++metrics.value(prefix + "timeouts_total");
+  }
+  metrics.value(prefix + "cpu_ms_total") +=
+      static_cast<int64_t>((result.userSeconds + result.systemSeconds) * 1e3);
+  metrics.value(prefix + "wall_ms_total") +=
+      static_cast<int64_t>(result.wallSeconds * 1e3);
+  metrics.value(prefix + "max_rss_kb") = result.maxRssKb;
+}
+
+} // namespace
+
+ChildProcess::ChildProcess(ChildProcess &&other) noexcept
+    : pid_(other.pid_), stdoutFd_(other.stdoutFd_),
+      stderrFd_(other.stderrFd_), job_(std::move(other.job_)),
+      start_(other.start_) {
+  other.pid_ = -1;
+  other.stdoutFd_ = -1;
+  other.stderrFd_ = -1;
+}
+
+ChildProcess &ChildProcess::operator=(ChildProcess &&other) noexcept {
+  if (this != &other) {
+    closeFds();
+    pid_ = other.pid_;
+    stdoutFd_ = other.stdoutFd_;
+    stderrFd_ = other.stderrFd_;
+    job_ = std::move(other.job_);
+    start_ = other.start_;
+    other.pid_ = -1;
+    other.stdoutFd_ = -1;
+    other.stderrFd_ = -1;
+  }
+  return *this;
+}
+
+ChildProcess::~ChildProcess() {
+  closeFds();
+  if (pid_ > 0) {
+    std::cerr << "Warning: Child process " << pid_ << " (" << job_
+              << ") was never waited for" << std::endl;
+  }
+}
+
+void ChildProcess::closeFds() {
+  for (int *fd : {&stdoutFd_, &stderrFd_}) {
+    if (*fd >= 0) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+ProcessSupervisor::~ProcessSupervisor() { terminateAll(); }
+
+ChildProcess ProcessSupervisor::spawn(const std::vector<std::string> &argv,
+                                      const SpawnOptions &options) {
+  if (argv.empty()) {
+    throw std::invalid_argument("Cannot spawn an empty command");
+  }
+  std::vector<char *> args;
+  args.reserve(argv.size() + 1);
+  for (const auto &arg : argv) {
+    args.push_back(const_cast<char *>(arg.c_str()));
+  }
+  args.push_back(nullptr);
+
+  int outPipe[2] = {-1, -1};
+  int errPipe[2] = {-1, -1};
+  if ((options.captureStdout && ::pipe2(outPipe, O_CLOEXEC) != 0) ||
+      (options.captureStderr && ::pipe2(errPipe, O_CLOEXEC) != 0)) {
+    std::perror("pipe2");
+    for (int fd : {outPipe[0], outPipe[1], errPipe[0], errPipe[1]}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    ++Metrics::instance().value("dacl_spawn_failures_total");
+    return ChildProcess();
+  }
+
+  // dup2 clears FD_CLOEXEC on the child's copies; every other descriptor of
+  // this process is close-on-exec and does not leak into the child
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (options.stdinFd >= 0) {
+    posix_spawn_file_actions_adddup2(&actions, options.stdinFd, STDIN_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+                                     O_RDONLY, 0);
+  }
+  if (options.captureStdout) {
+    posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+  } else if (options.stdoutFd >= 0) {
+    posix_spawn_file_actions_adddup2(&actions, options.stdoutFd,
+                                     STDOUT_FILENO);
+  }
+  if (options.captureStderr) {
+    posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+  }
+
+  // Own process group, default dispositions and an empty signal mask, so
+  // the blocked shutdown signals of this process do not carry over
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t noSignals, defaultSignals;
+  sigemptyset(&noSignals);
+  sigemptyset(&defaultSignals);
+  for (int sig : {SIGINT, SIGTERM, SIGPIPE, SIGHUP, SIGUSR1, SIGUSR2}) {
+    sigaddset(&defaultSignals, sig);
+  }
+  posix_spawnattr_setsigmask(&attr, &noSignals);
+  posix_spawnattr_setsigdefault(&attr, &defaultSignals);
+  posix_spawnattr_setpgroup(&attr, 0);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+                                      POSIX_SPAWN_SETSIGDEF |
+                                      POSIX_SPAWN_SETPGROUP);
+
+  ChildProcess child;
+  child.job_ = options.job;
+  child.start_ = Clock::now();
+  pid_t pid = -1;
+  int err = 0;
+  {
+    // Registered under the lock so the watchdog never misses the child
+    std::lock_guard<std::mutex> lk(mtx_);
+    err = stopping_ ? ECANCELED
+                    : ::posix_spawnp(&pid, args[0], &actions, &attr,
+                                     args.data(), environ);
+    if (err == 0) {
+      Entry entry;
+      entry.job = options.job;
+      entry.deadline =
+          options.timeoutMs > 0
+              ? child.start_ + std::chrono::milliseconds(options.timeoutMs)
+              : Clock::time_point::max();
+      entry.killAt = Clock::time_point::max();
+      children_[pid] = entry;
+    }
+  }
+  const int64_t spawnUs = elapsedUs(child.start_);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  for (int fd : {outPipe[1], errPipe[1]}) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  Metrics &metrics = Metrics::instance();
+  if (err != 0) {
+    std::cerr << "Error: Cannot spawn " << argv[0] << ": "
+              << std::strerror(err) << std::endl;
+    for (int fd : {outPipe[0], errPipe[0]}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    ++metrics.value("dacl_spawn_failures_total");
+    return ChildProcess();
+  }
+  ++metrics.value("dacl_spawn_total");
+  metrics.value("dacl_spawn_us_total") += spawnUs;
+  metrics.value("dacl_spawn_last_us") = spawnUs;
+
+  child.pid_ = pid;
+  child.stdoutFd_ = outPipe[0];
+  child.stderrFd_ = errPipe[0];
+  return child;
+}
+
+void ProcessSupervisor::drain(ChildProcess &child, ProcessResult &result,
+                              bool keepStdout) {
+  char buf[4096];
+  while (child.stdoutFd_ >= 0 || child.stderrFd_ >= 0) {
+    pollfd fds[2];
+    nfds_t count = 0;
+    for (int fd : {child.stdoutFd_, child.stderrFd_}) {
+      if (fd >= 0) {
+        fds[count++] = {fd, POLLIN, 0};
+      }
+    }
+    if (::poll(fds, count, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    for (nfds_t i = 0; i < count; ++i) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      const ssize_t n = ::read(fds[i].fd, buf, sizeof(buf));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      const bool isStdout = fds[i].fd == child.stdoutFd_;
+      if (n <= 0) {
+        ::close(fds[i].fd);
+        (isStdout ? child.stdoutFd_ : child.stderrFd_) = -1;
+      } else if (isStdout) {
+        if (keepStdout) {
+          result.output.append(buf, static_cast<size_t>(n));
+        }
+      } else {
+        result.errorOutput.append(buf, static_cast<size_t>(n));
+        if (result.errorOutput.size() > STDERR_TAIL_BYTES) {
+          result.errorOutput.erase(
+              0, result.errorOutput.size() - STDERR_TAIL_BYTES);
+        }
+      }
+    }
+  }
+}
+
+ProcessResult ProcessSupervisor::wait(ChildProcess &child) {
+  ProcessResult result;
+  if (!child) {
+    return result;
+  }
+  result.spawned = true;
+
+  // Output the caller did not consume is discarded; the child gets EPIPE
+  if (child.stdoutFd_ >= 0) {
+    ::close(child.stdoutFd_);
+    child.stdoutFd_ = -1;
+  }
+  drain(child, result, false);
+
+  // Wait without reaping first, so the watchdog can never signal a pid
+  // that has been reused by another process
+  siginfo_t info{};
+  while (::waitid(P_PID, static_cast<id_t>(child.pid_), &info,
+                  WEXITED | WNOWAIT) != 0 &&
+         errno == EINTR) {
+  }
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const auto it = children_.find(child.pid_);
+    if (it != children_.end()) {
+      result.timedOut = it->second.timedOut;
+      children_.erase(it);
+    }
+  }
+  int status = 0;
+  rusage usage{};
+  while (::wait4(child.pid_, &status, 0, &usage) < 0 && errno == EINTR) {
+  }
+
+  result.wallSeconds = elapsedUs(child.start_) / 1e6;
+  if (WIFEXITED(status)) {
+    result.exitCode = WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    result.signal = WTERMSIG(status);
+  }
+  result.userSeconds = seconds(usage.ru_utime);
+  result.systemSeconds = seconds(usage.ru_stime);
+  result.maxRssKb = usage.ru_maxrss;
+  recordJob(child.job_, result);
+
+  child.pid_ = -1;
+  return result;
+}
+
+bool ProcessSupervisor::exited(const ChildProcess &child) const {
+  if (!child) {
+    return true;
+  }
+  // WNOWAIT leaves the zombie for wait(), which collects its usage
+  siginfo_t info{};
+  int rc = 0;
+  while ((rc = ::waitid(P_PID, static_cast<id_t>(child.pid_), &info,
+                        WEXITED | WNOHANG | WNOWAIT)) != 0 &&
+         errno == EINTR) {
+  }
+  return rc != 0 || info.si_pid == child.pid_;
+}
+
+ProcessResult ProcessSupervisor::run(const std::vector<std::string> &argv,
+                                     const SpawnOptions &options) {
+  ChildProcess child = spawn(argv, options);
+  ProcessResult partial;
+  if (child) {
+    drain(child, partial, true);
+  }
+  ProcessResult result = wait(child);
+  result.output = std::move(partial.output);
+  result.errorOutput = std::move(partial.errorOutput);
+  return result;
+}
+
+void ProcessSupervisor::terminateAll() {
+  std::vector<pid_t> pids;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    stopping_ = true;
+    for (auto &entry : children_) {
+      ::kill(-entry.first, SIGTERM);
+      ::kill(-entry.first, SIGCONT); // Paused children must run to exit
+      entry.second.killAt =
+          Clock::now() + std::chrono::milliseconds(KILL_GRACE_MS);
+      pids.push_back(entry.first);
+    }
+  }
+  if (pids.empty()) {
+    return;
+  }
+  std::cerr << "Terminating " << pids.size() << " child processes"
+            << std::endl;
+
+  // Children still alive after the grace period are killed
+  const auto deadline =
+      Clock::now() + std::chrono::milliseconds(KILL_GRACE_MS);
+  while (Clock::now() < deadline) {
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      if (children_.empty()) {
+        return;
+      }
+    }
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(WATCHDOG_INTERVAL_MS));
+  }
+  std::lock_guard<std::mutex> lk(mtx_);
+  for (const auto &entry : children_) {
+    ::kill(-entry.first, SIGKILL);
+  }
+}
+
+void ProcessSupervisor::enforceTimeouts() {
+  const auto now = Clock::now();
+  std::lock_guard<std::mutex> lk(mtx_);
+  for (auto &entry : children_) {
+    Entry &child = entry.second;
+    if (child.paused && child.killAt == Clock::time_point::max()) {
+      continue;
+    }
+    if (now >= child.killAt) {
+      ::kill(-entry.first, SIGKILL);
+      child.killAt = Clock::time_point::max();
+    } else if (now >= child.deadline) {
+      std::cerr << "Warning: " << child.job << " process " << entry.first
+                << " timed out, terminating" << std::endl;
+      ::kill(-entry.first, SIGTERM);
+      ::kill(-entry.first, SIGCONT);
+      child.timedOut = true;
+      child.deadline = Clock::time_point::max();
+      child.killAt = now + std::chrono::milliseconds(KILL_GRACE_MS);
+    }
+  }
+}
+
+size_t ProcessSupervisor::pauseJob(const std::string &job) {
+  size_t count = 0;
+  std::lock_guard<std::mutex> lk(mtx_);
+  for (auto &entry : children_) {
+    Entry &child = entry.second;
+    if (child.job == job && !child.paused &&
+        child.killAt == Clock::time_point::max() &&
+        ::kill(-entry.first, SIGSTOP) == 0) {
+      child.paused = true;
+      child.pausedAt = Clock::now();
+      ++count;
+    }
+  }
+  return count;
+}
+
+size_t ProcessSupervisor::resumeJob(const std::string &job) {
+  size_t count = 0;
+  std::lock_guard<std::mutex> lk(mtx_);
+  for (auto &entry : children_) {
+    Entry &child = entry.second;
+    if (child.job != job || !child.paused) {
+      continue;
+    }
+    ::kill(-entry.first, SIGCONT);
+    child.paused = false;
+    if (child.deadline != Clock::time_point::max()) {
+      child.deadline += Clock::now() - child.pausedAt;
+    }
+    ++count;
+  }
+  return count;
+}
+
+void ProcessSupervisor::run() {
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      if (stopping_) {
+        return;
+      }
+    }
+    enforceTimeouts();
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(WATCHDOG_INTERVAL_MS));
+  }
+}
@@ -0,0 +1,205 @@
+/**
+ * @file ProcessSupervisor.hpp
+ * @brief posix_spawn-based launching, monitoring and shutdown of child
+ * processes
+ */
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @struct SpawnOptions
+ * @brief How a child process is wired up and supervised
+ */
+struct SpawnOptions {
+  std::string job = "process"; ///< Job name used in metrics ("overlay", ...)
+  int stdinFd = -1;  ///< Descriptor that becomes stdin (-1 = /dev/null)
+  int stdoutFd = -1; ///< Descriptor that becomes stdout (-1 = inherited,
+                     ///< unless captureStdout is set)
+  bool captureStdout = false; ///< Connect stdout to a pipe read by the parent
+  bool captureStderr = false; ///< Collect stderr into ProcessResult
+  int timeoutMs = 0;          ///< Terminate after this long (0 = no limit)
+};
+
+/**
+ * @struct ProcessResult
+ * @brief Outcome and resource usage of a finished child process
+ */
+struct ProcessResult {
+  bool spawned = false;     ///< posix_spawn succeeded
+  int exitCode = -1;        ///< Exit status, or -1 if killed by a signal
+  int signal = 0;           ///< Terminating signal, 0 if it exited
+  bool timedOut = false;    ///< Terminated by the supervisor's timeout
+  double wallSeconds = 0;   ///< Time from spawn to exit
+  double userSeconds = 0;   ///< User CPU time
+  double systemSeconds = 0; ///< System CPU time
+  long maxRssKb = 0;        ///< Peak resident set size in KiB
+  std::string output;       ///< Captured stdout (run() only)
+  std::string errorOutput;  ///< Tail of captured stderr
+
+  /** @brief True if the process ran and exited with status 0 in time */
+  bool ok() const { return spawned && exitCode == 0 && !timedOut; }
+};
+
+/**
+ * @class ChildProcess
+ * @brief Handle of a running child returned by ProcessSupervisor::spawn()
+ *
+ * Must be passed to ProcessSupervisor::wait() to reap the child.
+ */
+class ChildProcess final {
+public:
+  ChildProcess() = default;
+  ChildProcess(ChildProcess &&other) noexcept;
+  ChildProcess &operator=(ChildProcess &&other) noexcept;
+  ChildProcess(const ChildProcess &) = delete;
+  ChildProcess &operator=(const ChildProcess &) = delete;
+  ~ChildProcess();
+
+  /** @brief True if the child was spawned and not yet waited for */
+  explicit operator bool() const { return pid_ > 0; }
+
+  pid_t pid() const { return pid_; } ///< Process id (also its process group)
+
+  /** @brief Read end of the child's stdout, or -1 if not captured */
+  int stdoutFd() const { return stdoutFd_; }
+
+private:
+  friend class ProcessSupervisor;
+  void closeFds();
+
+  pid_t pid_ = -1;     ///< Child process id
+  int stdoutFd_ = -1;  ///< Captured stdout
+  int stderrFd_ = -1;  ///< Captured stderr
+  std::string job_;    ///< Job name for metrics
+  std::chrono::steady_clock::time_point start_; ///< Spawn time
+};
+
+/**
+ * @class ProcessSupervisor
+ * @brief Launches helper processes (ffmpeg, libcamera-vid, ...) without a
+ * shell and keeps track of them
+ *
+ * Children are started with posix_spawnp() from argv vectors, so arguments
+ * are never re-parsed by /bin/sh and paths may contain any character. Each
+ * child runs in its own process group with default signal handling. The
+ * supervisor enforces per-child timeouts (SIGTERM, then SIGKILL after a
+ * grace period), can pause and resume all children of a job (used for
+ * export back-pressure), terminates all children on shutdown and reports
+ * spawn latency and per-job CPU time, peak RSS and wall time in Metrics.
+ *
+ * @note Thread Safety: All methods are thread-safe. run() should be executed
+ * in a dedicated thread to enforce timeouts.
+ */
+class ProcessSupervisor final {
+public:
+  ProcessSupervisor() = default;
+
+  /** @brief Terminates any children still running */
+  ~ProcessSupervisor();
+
+  ProcessSupervisor(const ProcessSupervisor &) = delete;
+  ProcessSupervisor &operator=(const ProcessSupervisor &) = delete;
+
+  /**
+   * @brief Starts a child process
+   * @param argv Command and arguments; argv[0] is looked up in PATH
+   * @param options Descriptor wiring, capture and timeout
+   * @return Handle of the child; empty if it could not be spawned or the
+   * supervisor is shutting down
+   * @throws std::invalid_argument if argv is empty
+   */
+  ChildProcess spawn(const std::vector<std::string> &argv,
+                     const SpawnOptions &options = SpawnOptions());
+
+  /**
+   * @brief Waits for a child to exit and reaps it
+   * @param child Handle from spawn(); empty afterwards
+   * @return Exit status and resource usage
+   *
+   * Drains captured stderr while waiting. A captured stdout that the caller
+   * has not read to the end is closed first.
+   */
+  ProcessResult wait(ChildProcess &child);
+
+  /**
+   * @brief Checks without blocking whether a child has exited
+   * @param child Handle from spawn()
+   * @return true if the child has exited (or the handle is empty); it still
+   * has to be reaped with wait()
+   */
+  bool exited(const ChildProcess &child) const;
+
+  /**
+   * @brief Spawns a child, collects its output and waits for it
+   * @param argv Command and arguments
+   * @param options Descriptor wiring, capture and timeout
+   * @return Result including captured stdout
+   */
+  ProcessResult run(const std::vector<std::string> &argv,
+                    const SpawnOptions &options = SpawnOptions());
+
+  /**
+   * @brief Terminates every running child (SIGTERM, then SIGKILL)
+   * @note Used on shutdown: later spawn() calls fail. Blocks for at most the
+   * grace period.
+   */
+  void terminateAll();
+
+  /**
+   * @brief Stops all children of a job with SIGSTOP
+   * @param job Job name as given in SpawnOptions
+   * @return Number of children paused
+   * @note Paused time does not count towards a child's timeout
+   */
+  size_t pauseJob(const std::string &job);
+
+  /**
+   * @brief Continues children paused by pauseJob() with SIGCONT
+   * @param job Job name as given in SpawnOptions
+   * @return Number of children resumed
+   */
+  size_t resumeJob(const std::string &job);
+
+  /**
+   * @brief Watchdog loop enforcing timeouts
+   * @note Runs until terminateAll(); should be executed in a dedicated
+   * thread
+   */
+  void run();
+
+private:
+  /// Bookkeeping of a child that has not been reaped yet
+  struct Entry {
+    std::string job; ///< Job name
+    std::chrono::steady_clock::time_point deadline; ///< Timeout, or max()
+    std::chrono::steady_clock::time_point killAt;   ///< SIGKILL time after
+                                                    ///< SIGTERM, or max()
+    bool timedOut = false; ///< SIGTERM sent because of the timeout
+    bool paused = false;   ///< Stopped by pauseJob()
+    std::chrono::steady_clock::time_point pausedAt; ///< Time of pauseJob()
+  };
+
+  /** @brief Signals overdue children; called by run() */
+  void enforceTimeouts();
+
+  /** @brief Reads captured stdout/stderr until both reach end of file */
+  static void drain(ChildProcess &child, ProcessResult &result,
+                    bool keepStdout);
+
+  std::mutex mtx_;                 ///< Guards children_
+  std::map<pid_t, Entry> children_; ///< Running, unreaped children
+  bool stopping_ = false;           ///< Set by terminateAll()
+
+  static constexpr int KILL_GRACE_MS =
+      2000; ///< Time between SIGTERM and SIGKILL
+  static constexpr int WATCHDOG_INTERVAL_MS = 100; ///< Timeout check period
+  static constexpr size_t STDERR_TAIL_BYTES =
+      4096; ///< Captured stderr kept per child
+};
@@ -0,0 +1,83 @@
+#include "ProfileSelector.hpp"
+#include <stdexcept>
+
+namespace {
+
+void validate(const CaptureSettings &settings, const char *profile) {
+  if (settings.width <= 0 || settings.height <= 0 || settings.framerate <= 0 ||
+      settings.bitrate <= 0) {
+    throw std::invalid_argument(std::string("Capture settings of the ") +
+                                profile + " profile must be positive");
+  }
+}
+
+} // namespace
+
+ProfileSelector::ProfileSelector(const CaptureSettings &parked,
+                                 const CaptureSettings &urban,
+                                 const CaptureSettings &highway,
+                                 int parkedAfterSeconds, int highwaySpeedKmh,
+                                 const CANListener *canListener)
+    : parked_(parked), urban_(urban), highway_(highway),
+      parkedAfter_(std::chrono::seconds(parkedAfterSeconds)),
+      highwaySpeedKmh_(highwaySpeedKmh), canListener_(canListener),
+      lastMoving_(Clock::now()) {
+  if (canListener == nullptr) {
+    throw std::invalid_argument("CAN listener cannot be null");
+  }
+  if (parkedAfterSeconds <= 0 || highwaySpeedKmh <= 0) {
+    throw std::invalid_argument(
+        "Parked delay and highway speed must be positive");
+  }
+  validate(parked, "parked");
+  validate(urban, "urban");
+  validate(highway, "highway");
+}
+
+DrivingState ProfileSelector::update() {
+  const int speed = canListener_->getVehicleSpeed();
+  const auto now = Clock::now();
+  std::lock_guard<std::mutex> lk(mtx_);
+  if (speed > 0) {
+    lastMoving_ = now;
+  }
+  if (speed >= highwaySpeedKmh_ ||
+      (state_ == DrivingState::Highway &&
+       speed > highwaySpeedKmh_ - HIGHWAY_HYSTERESIS_KMH)) {
+    state_ = DrivingState::Highway;
+  } else if (speed == 0 && now - lastMoving_ >= parkedAfter_) {
+    state_ = DrivingState::Parked;
+  } else {
+    state_ = DrivingState::Urban;
+  }
+  return state_;
+}
+
+DrivingState ProfileSelector::state() const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return state_;
+}
+
+const CaptureSettings &ProfileSelector::settings(DrivingState state) const {
+  switch (state) {
+  case DrivingState::Parked:
+    return parked_;
+  case DrivingState::Highway:
+    return highway_;
+  case DrivingState::Urban:
+  default:
+    return urban_;
+  }
+}
+
+const char *ProfileSelector::name(DrivingState state) {
+  switch (state) {
+  case DrivingState::Parked:
+    return "parked";
+  case DrivingState::Highway:
+    return "highway";
+  case DrivingState::Urban:
+  default:
+    return "urban";
+  }
+}
@@ -0,0 +1,89 @@
+/**
+ * @file ProfileSelector.hpp
+ * @brief Speed-dependent recording profiles (parked, urban, highway)
+ */
+
+#pragma once
+#include "CANListener.hpp"
+#include "VideoSource.hpp"
+#include <chrono>
+#include <mutex>
+
+/**
+ * @brief Vehicle state a recording profile is chosen for
+ */
+enum class DrivingState {
+  Parked,  ///< Stationary for longer than the parked delay
+  Urban,   ///< Moving, or stopped only briefly
+  Highway  ///< At or above the highway speed
+};
+
+/**
+ * @class ProfileSelector
+ * @brief Chooses capture settings from the vehicle speed on the CAN bus
+ *
+ * The vehicle counts as parked once its speed has been 0 for the parked
+ * delay, and as on the highway from the highway speed until it drops
+ * HIGHWAY_HYSTERESIS_KMH below it again; anything else is urban. A short
+ * stop at a traffic light therefore keeps the urban profile, and cruising
+ * around the threshold does not flap between profiles.
+ *
+ * The selector only tracks time stationary while update() is called, so
+ * the recorder samples it continuously while a segment records. The state
+ * starts as urban.
+ *
+ * @note Thread Safety: All methods are thread-safe.
+ */
+class ProfileSelector final {
+public:
+  /**
+   * @brief Constructs a selector
+   * @param parked Capture settings while parked
+   * @param urban Capture settings while driving below the highway speed
+   * @param highway Capture settings at highway speed; also used for
+   * post-trigger recording
+   * @param parkedAfterSeconds Time at speed 0 after which the vehicle counts
+   * as parked
+   * @param highwaySpeedKmh Speed from which the highway profile is used
+   * @param canListener Source of the vehicle speed (non-owning)
+   * @throws std::invalid_argument if canListener is null or a limit or
+   * setting is not positive
+   */
+  explicit ProfileSelector(const CaptureSettings &parked,
+                           const CaptureSettings &urban,
+                           const CaptureSettings &highway,
+                           int parkedAfterSeconds, int highwaySpeedKmh,
+                           const CANListener *canListener);
+
+  /**
+   * @brief Samples the vehicle speed and returns the resulting state
+   * @return Current driving state
+   */
+  DrivingState update();
+
+  /** @brief State determined by the last update() */
+  DrivingState state() const;
+
+  /** @brief Capture settings of a state */
+  const CaptureSettings &settings(DrivingState state) const;
+
+  /** @brief Lower-case name of a state ("parked", "urban", "highway") */
+  static const char *name(DrivingState state);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  const CaptureSettings parked_;  ///< Settings while parked
+  const CaptureSettings urban_;   ///< Settings below highway speed
+  const CaptureSettings highway_; ///< Settings at highway speed
+  const Clock::duration parkedAfter_; ///< Stationary time until parked
+  const int highwaySpeedKmh_;     ///< Highway threshold
+  const CANListener *const canListener_; ///< Speed source
+
+  mutable std::mutex mtx_;     ///< Guards the fields below
+  DrivingState state_ = DrivingState::Urban; ///< Result of the last update
+  Clock::time_point lastMoving_; ///< Last update with a speed above 0
+
+  static constexpr int HIGHWAY_HYSTERESIS_KMH =
+      10; ///< Speed drop below the threshold that leaves the highway profile
+};
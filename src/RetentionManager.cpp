@@ -0,0 +1,414 @@
+#include "RetentionManager.hpp"
+#include "FrameIndex.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <sys/statvfs.h>
+
+namespace {
+
+/// Free and used space of one filesystem
+struct FsUsage {
+  uint64_t freeBytes = 0;
+  uint64_t usedBytes = 0;
+};
+
+bool statFs(const std::string &dir, unsigned long &fsid, FsUsage &usage) {
+  struct statvfs st;
+  if (statvfs(dir.c_str(), &st) != 0) {
+    return false;
+  }
+  fsid = st.f_fsid;
+  usage.freeBytes = static_cast<uint64_t>(st.f_bavail) * st.f_frsize;
+  usage.usedBytes =
+      static_cast<uint64_t>(st.f_blocks - st.f_bfree) * st.f_frsize;
+  return true;
+}
+
+int64_t mtimeSeconds(const std::filesystem::directory_entry &entry) {
+  const auto ftime = entry.last_write_time();
+  const auto sctp =
+      std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+          ftime - std::filesystem::file_time_type::clock::now() +
+          std::chrono::system_clock::now());
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             sctp.time_since_epoch())
+      .count();
+}
+
+bool endsWith(const std::string &name, const std::string &suffix) {
+  return name.size() > suffix.size() &&
+         name.compare(name.size() - suffix.size(), suffix.size(), suffix) ==
+             0;
+}
+
+} // namespace
+
+std::string eventKey(const std::string &filename) {
+  for (const char *marker : {"_pretrigger_", "_posttrigger_"}) {
+    const auto pos = filename.find(marker);
+    if (pos != std::string::npos) {
+      return filename.substr(0, pos);
+    }
+  }
+  // Event bundles are named after the event itself
+  static const std::string BUNDLE_SUFFIX = ".dacl";
+  if (endsWith(filename, BUNDLE_SUFFIX)) {
+    return filename.substr(0, filename.size() - BUNDLE_SUFFIX.size());
+  }
+  return filename;
+}
+
+bool isEventFile(const std::string &filename) {
+  // Overlay output, bundles or re-encodings still being written, and the
+  // export and archive bookkeeping
+  return !endsWith(filename, "_temp.mp4") && !endsWith(filename, ".tmp") &&
+         !endsWith(filename, ".manifest") && !endsWith(filename, ".journal");
+}
+
+std::vector<std::string>
+parseCriticalWarnings(const std::string &tokensString) {
+  std::vector<std::string> tokens;
+  std::stringstream ss(tokensString);
+  std::string token;
+  while (std::getline(ss, token, ',')) {
+    if (!token.empty()) {
+      tokens.push_back(token);
+    }
+  }
+  return tokens;
+}
+
+EventPriority classifyWarning(const std::string &warningType,
+                              const std::vector<std::string> &criticalTokens) {
+  bool manual = false;
+  std::string part;
+  for (size_t i = 0; i <= warningType.size(); ++i) {
+    if (i < warningType.size() && warningType[i] != '_' &&
+        warningType[i] != ' ') {
+      part += warningType[i];
+      continue;
+    }
+    if (std::find(criticalTokens.begin(), criticalTokens.end(), part) !=
+        criticalTokens.end()) {
+      return EventPriority::Critical;
+    }
+    if (part == "Manual") {
+      manual = true;
+    }
+    part.clear();
+  }
+  return manual ? EventPriority::Manual : EventPriority::Routine;
+}
+
+RetentionManager::RetentionManager(
+    const std::string &bufferDir, const std::string &eventDir,
+    uint64_t bufferBudgetBytes, uint64_t eventBudgetBytes,
+    uint64_t minFreeBytes, int protectedSeconds,
+    const std::vector<std::string> &criticalTokens, const PinCheck &isPinned,
+    const SegmentEvictor &evictSegment)
+    : bufferDir_(bufferDir), eventDir_(eventDir),
+      bufferBudgetBytes_(bufferBudgetBytes),
+      eventBudgetBytes_(eventBudgetBytes), minFreeBytes_(minFreeBytes),
+      protectedSeconds_(protectedSeconds), criticalTokens_(criticalTokens),
+      isPinned_(isPinned), evictSegment_(evictSegment) {
+  // Input validation
+  if (bufferDir.empty()) {
+    throw std::invalid_argument("Buffer directory path cannot be empty");
+  }
+  if (eventDir.empty()) {
+    throw std::invalid_argument("Event directory path cannot be empty");
+  }
+  if (protectedSeconds < 0) {
+    throw std::invalid_argument("Protected window cannot be negative");
+  }
+}
+
+std::vector<RetentionManager::Candidate> RetentionManager::scanBuffer() const {
+  std::vector<Candidate> candidates;
+  unsigned long fsid = 0;
+  FsUsage usage;
+  statFs(bufferDir_, fsid, usage);
+
+  // Recursive, since each camera of a multi-camera setup has a subdirectory
+  std::error_code ec;
+  const std::filesystem::recursive_directory_iterator end;
+  for (auto it = std::filesystem::recursive_directory_iterator(bufferDir_, ec);
+       it != end; it.increment(ec)) {
+    const auto &entry = *it;
+    if (entry.path().filename() == PIPELINE_STAGING_DIR) {
+      it.disable_recursion_pending(); // Staged events belong to the processor
+      continue;
+    }
+    if (!entry.is_regular_file(ec) || entry.path().extension() != ".mp4") {
+      continue; // Only video segments; leaves the segment manifest alone
+    }
+    if (isPinned_ && isPinned_(entry.path().string())) {
+      continue; // Still referenced by an event export
+    }
+    Candidate c;
+    c.paths.push_back(entry.path().string());
+    c.bytes = entry.file_size(ec);
+    if (ec) {
+      continue; // File vanished while scanning
+    }
+    // The frame index sidecar goes with its segment
+    const std::string sidecar = frameIndexPath(entry.path().string());
+    std::error_code sidecarEc;
+    const uint64_t sidecarBytes =
+        std::filesystem::file_size(sidecar, sidecarEc);
+    if (!sidecarEc) {
+      c.paths.push_back(sidecar);
+      c.bytes += sidecarBytes;
+    }
+    c.mtime = mtimeSeconds(entry);
+    c.rank = 0;
+    c.inBuffer = true;
+    c.fsid = fsid;
+    candidates.push_back(std::move(c));
+  }
+  return candidates;
+}
+
+std::vector<RetentionManager::Candidate> RetentionManager::scanEvents() const {
+  unsigned long fsid = 0;
+  FsUsage usage;
+  statFs(eventDir_, fsid, usage);
+
+  std::map<std::string, Candidate> events;
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(eventDir_, ec)) {
+    if (!entry.is_regular_file(ec)) {
+      continue;
+    }
+    const std::string name = entry.path().filename().string();
+    // Copies, overlay passes and bundles still being written keep their
+    // event young, but are not evicted themselves
+    const bool writing = endsWith(name, "_temp.mp4") || endsWith(name, ".tmp");
+    if (!writing && !isEventFile(name)) {
+      continue;
+    }
+    const uint64_t bytes = entry.file_size(ec);
+    if (ec) {
+      continue;
+    }
+
+    const std::string key =
+        eventKey(endsWith(name, ".tmp") ? name.substr(0, name.size() - 4)
+                                        : name);
+    Candidate &c = events[key];
+    c.mtime = std::max(c.mtime, mtimeSeconds(entry));
+    if (writing) {
+      continue;
+    }
+    if (c.paths.empty()) {
+      // Event keys start with "YYYYMMDD_HHMMSS_" followed by the warning type
+      static constexpr size_t TIMESTAMP_PREFIX_LENGTH = 16;
+      const std::string warningType =
+          key.size() > TIMESTAMP_PREFIX_LENGTH
+              ? key.substr(TIMESTAMP_PREFIX_LENGTH)
+              : key;
+      c.rank = 1 + static_cast<int>(classifyWarning(warningType,
+                                                    criticalTokens_));
+      c.fsid = fsid;
+    }
+    c.paths.push_back(entry.path().string());
+    c.bytes += bytes;
+  }
+
+  std::vector<Candidate> candidates;
+  candidates.reserve(events.size());
+  for (auto &kv : events) {
+    if (!kv.second.paths.empty()) {
+      candidates.push_back(std::move(kv.second));
+    }
+  }
+  return candidates;
+}
+
+uint64_t RetentionManager::removeCandidate(const Candidate &candidate) {
+  uint64_t removed = 0;
+  std::vector<uint64_t> sizes;
+  for (const auto &path : candidate.paths) {
+    std::error_code ec;
+    const uint64_t size = std::filesystem::file_size(path, ec);
+    sizes.push_back(ec ? 0 : size);
+  }
+  // The recorder deletes the segment with its sidecar and drops it from its
+  // buffer and manifest; the files stay while a late pin holds them
+  if (candidate.inBuffer && evictSegment_ &&
+      evictSegment_(candidate.paths.front())) {
+    for (size_t i = 0; i < candidate.paths.size(); ++i) {
+      std::error_code ec;
+      if (!std::filesystem::exists(candidate.paths[i], ec)) {
+        removed += sizes[i];
+      }
+    }
+  } else {
+    for (size_t i = 0; i < candidate.paths.size(); ++i) {
+      std::error_code ec;
+      if (std::filesystem::remove(candidate.paths[i], ec)) {
+        removed += sizes[i];
+      } else if (ec) {
+        std::cerr << "Warning: Retention failed to remove "
+                  << candidate.paths[i] << ": " << ec.message() << std::endl;
+      }
+    }
+  }
+  evictedSinceLast_ += removed;
+  evictedTotal_ += removed;
+  return removed;
+}
+
+void RetentionManager::enforce(int horizonSeconds) {
+  std::lock_guard<std::mutex> lk(mtx_);
+
+  auto byAge = [](const Candidate &a, const Candidate &b) {
+    return a.mtime < b.mtime;
+  };
+
+  const int64_t nowSeconds =
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  auto isProtected = [this, nowSeconds](const Candidate &c) {
+    return nowSeconds - c.mtime <= protectedSeconds_;
+  };
+
+  // 1. Buffer byte budget: drop the oldest unprotected segments first
+  auto buffer = scanBuffer();
+  std::sort(buffer.begin(), buffer.end(), byAge);
+  if (bufferBudgetBytes_ > 0) {
+    uint64_t total = 0;
+    uint64_t protectedBytes = 0;
+    for (const auto &c : buffer) {
+      total += c.bytes;
+      protectedBytes += isProtected(c) ? c.bytes : 0;
+    }
+    if (protectedBytes > bufferBudgetBytes_ && !budgetWarned_) {
+      std::cerr << "Warning: Buffer budget of " << bufferBudgetBytes_
+                << " bytes is smaller than the protected pre-trigger window ("
+                << protectedBytes << " bytes); the buffer exceeds it"
+                << std::endl;
+    }
+    budgetWarned_ = protectedBytes > bufferBudgetBytes_;
+    for (auto it = buffer.begin();
+         total > bufferBudgetBytes_ && it != buffer.end();) {
+      if (isProtected(*it)) {
+        ++it; // Oldest first, so all later ones are protected too
+        continue;
+      }
+      total -= std::min(total, removeCandidate(*it));
+      it = buffer.erase(it);
+    }
+  }
+
+  // 2. Event byte budget: drop lowest priority, then oldest events first
+  auto events = scanEvents();
+  auto byValue = [](const Candidate &a, const Candidate &b) {
+    return a.rank != b.rank ? a.rank < b.rank : a.mtime < b.mtime;
+  };
+  std::sort(events.begin(), events.end(), byValue);
+  if (eventBudgetBytes_ > 0) {
+    uint64_t total = 0;
+    for (const auto &c : events) {
+      total += c.bytes;
+    }
+    for (auto it = events.begin();
+         total > eventBudgetBytes_ && it != events.end();) {
+      if (isProtected(*it)) {
+        ++it; // Possibly still being exported
+        continue;
+      }
+      std::cerr << "Retention: evicting event " << it->paths.front()
+                << " (event budget exceeded)" << std::endl;
+      total -= std::min(total, removeCandidate(*it));
+      it = events.erase(it);
+    }
+  }
+
+  // 3. Sample free space per filesystem and update the write-rate estimate
+  std::map<unsigned long, FsUsage> filesystems;
+  for (const auto &dir : {bufferDir_, eventDir_}) {
+    unsigned long fsid = 0;
+    FsUsage usage;
+    if (statFs(dir, fsid, usage)) {
+      filesystems[fsid] = usage;
+    } else {
+      std::cerr << "Warning: statvfs failed for " << dir << std::endl;
+    }
+  }
+
+  uint64_t used = 0;
+  for (const auto &kv : filesystems) {
+    used += kv.second.usedBytes;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  if (haveSample_) {
+    const double dt =
+        std::chrono::duration<double>(now - lastSample_).count();
+    if (dt > 0.0) {
+      // Bytes we evicted would otherwise hide the writers' growth
+      const double written = static_cast<double>(used + evictedSinceLast_) -
+                             static_cast<double>(lastUsedBytes_);
+      const double sample = std::max(0.0, written) / dt;
+      writeRate_ =
+          RATE_SMOOTHING * sample + (1.0 - RATE_SMOOTHING) * writeRate_;
+    }
+  }
+  haveSample_ = true;
+  lastSample_ = now;
+  lastUsedBytes_ = used;
+  evictedSinceLast_ = 0;
+
+  // 4. Predictive free-space eviction in value order
+  const uint64_t predicted = static_cast<uint64_t>(
+      writeRate_ * RATE_SAFETY_FACTOR * std::max(horizonSeconds, 1));
+  const uint64_t required = minFreeBytes_ + predicted;
+
+  std::vector<Candidate> pool;
+  for (auto &c : buffer) {
+    if (!isProtected(c)) {
+      pool.push_back(std::move(c));
+    }
+  }
+  for (auto &c : events) {
+    if (!isProtected(c)) {
+      pool.push_back(std::move(c));
+    }
+  }
+  std::stable_sort(pool.begin(), pool.end(), byValue);
+
+  for (auto &kv : filesystems) {
+    FsUsage &fs = kv.second;
+    for (auto it = pool.begin();
+         fs.freeBytes < required && it != pool.end(); ++it) {
+      if (it->fsid != kv.first || it->paths.empty()) {
+        continue;
+      }
+      std::cerr << "Retention: evicting " << it->paths.front()
+                << " (free space below " << required << " bytes)" << std::endl;
+      fs.freeBytes += removeCandidate(*it);
+      it->paths.clear();
+    }
+    if (fs.freeBytes < required) {
+      std::cerr << "Warning: Retention cannot reach required free space ("
+                << fs.freeBytes << " < " << required << " bytes)" << std::endl;
+    }
+  }
+}
+
+uint64_t RetentionManager::writeRateBytesPerSecond() const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return static_cast<uint64_t>(writeRate_);
+}
+
+uint64_t RetentionManager::evictedBytes() const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return evictedTotal_;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file RetentionManager.hpp
+ * @brief Byte-budget retention engine with event priorities and free-space
+ * awareness
+ */
+
+#pragma once
+#include "Segment.hpp"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @enum EventPriority
+ * @brief Value classes used to decide which recordings are evicted first
+ *
+ * Lower values are evicted before higher ones. Plain buffer segments that
+ * are not part of any saved event rank below all event classes.
+ */
+enum class EventPriority {
+  Routine = 0,  ///< Ordinary CAN warnings
+  Manual = 1,   ///< Manual triggers (GPIO button, console)
+  Critical = 2, ///< Safety-critical warnings (e.g. ECALL, ESC)
+};
+
+/**
+ * @brief Parses the comma-separated list of critical warning tokens
+ * @param tokensString Comma-separated tokens, e.g. "ECALL,ESC"
+ * @return List of non-empty tokens
+ */
+std::vector<std::string> parseCriticalWarnings(const std::string &tokensString);
+
+/**
+ * @brief Classifies a warning type into a retention priority
+ * @param warningType Warning label, e.g. "WarningMsg_ESC" or "Manual Trigger"
+ * @param criticalTokens Tokens marking a warning as critical
+ * @return Priority class of events carrying this warning type
+ *
+ * The label is split on '_' and ' '; if any part equals a critical token the
+ * event is Critical, if any part equals "Manual" it is Manual, otherwise it is
+ * Routine.
+ */
+EventPriority classifyWarning(const std::string &warningType,
+                              const std::vector<std::string> &criticalTokens);
+
+/**
+ * @brief Returns the event a file in the event directory belongs to
+ * @param filename File name without directory
+ * @return Event key "YYYYMMDD_HHMMSS_<warning>", shared by the exported
+ * segments and the bundle of one event
+ */
+std::string eventKey(const std::string &filename);
+
+/**
+ * @brief True if a file in the event directory is part of a finished event
+ * @param filename File name without directory
+ * @return false for files still being written and for bookkeeping files
+ */
+bool isEventFile(const std::string &filename);
+
+/**
+ * @class RetentionManager
+ * @brief Keeps buffer and event storage within byte budgets and free-space
+ * limits
+ *
+ * Each call to enforce() performs one retention pass:
+ * - Evicts the oldest buffer segments while the buffer exceeds its budget
+ * - Evicts whole events, lowest priority and oldest first, while the event
+ *   directory exceeds its budget
+ * - Predicts the bytes written until the next pass from the observed write
+ *   rate and evicts data in value order (old buffer segments, Routine,
+ *   Manual, Critical events) until that headroom plus the free-space reserve
+ *   is available, so writers never run into ENOSPC
+ *
+ * Buffer segments younger than the protected window are never evicted, by
+ * neither the budget nor free space, so the next trigger still finds its
+ * pre-trigger history. Segments pinned by an outstanding SegmentHandle are
+ * never evicted. Buffer segments are evicted through their recorder, so
+ * they also leave its buffer index and segment manifest. Events are
+ * protected for the same window after their newest file was written (files
+ * still being written included), so an event is never evicted while it is
+ * being exported.
+ *
+ * @note Thread Safety: enforce() and the getters are serialized by an internal
+ * mutex. Typically driven by StorageManager.
+ */
+class RetentionManager final {
+public:
+  /**
+   * @brief Constructs a RetentionManager for the buffer and event directories
+   * @param bufferDir Directory containing buffered video segments
+   * @param eventDir Directory containing saved event videos
+   * @param bufferBudgetBytes Maximum bytes in bufferDir (0 = unlimited)
+   * @param eventBudgetBytes Maximum bytes in eventDir (0 = unlimited)
+   * @param minFreeBytes Free-space reserve to keep on each filesystem
+   * @param protectedSeconds Age below which buffer segments and events are
+   * kept
+   * @param criticalTokens Warning tokens classified as Critical
+   * @param isPinned Optional predicate protecting pinned buffer segments
+   * @param evictSegment Optional recorder hook evicting buffer segments;
+   * files no recorder owns are removed directly
+   * @throws std::invalid_argument if a directory path is empty or
+   * protectedSeconds is negative
+   */
+  explicit RetentionManager(const std::string &bufferDir,
+                            const std::string &eventDir,
+                            uint64_t bufferBudgetBytes,
+                            uint64_t eventBudgetBytes, uint64_t minFreeBytes,
+                            int protectedSeconds,
+                            const std::vector<std::string> &criticalTokens,
+                            const PinCheck &isPinned = nullptr,
+                            const SegmentEvictor &evictSegment = nullptr);
+
+  /**
+   * @brief Runs one retention pass over buffer and event directories
+   * @param horizonSeconds Time until the next pass, used for prediction
+   * @note Errors on individual files are reported and skipped
+   */
+  void enforce(int horizonSeconds);
+
+  /**
+   * @brief Returns the smoothed write rate observed between passes
+   * @return Estimated bytes written per second across managed filesystems
+   */
+  uint64_t writeRateBytesPerSecond() const;
+
+  /**
+   * @brief Returns the total number of bytes evicted since construction
+   */
+  uint64_t evictedBytes() const;
+
+private:
+  /// A unit of eviction: one buffer segment or all files of one event
+  struct Candidate {
+    std::vector<std::string> paths; ///< Files removed together
+    uint64_t bytes = 0;             ///< Total size of all files
+    int64_t mtime = 0;              ///< Newest modification time (s)
+    int rank = 0;                   ///< Eviction order, lower goes first
+    bool inBuffer = false;          ///< True for buffer segments
+    unsigned long fsid = 0;         ///< Filesystem the files live on
+  };
+
+  std::vector<Candidate> scanBuffer() const;
+  std::vector<Candidate> scanEvents() const;
+  uint64_t removeCandidate(const Candidate &candidate);
+
+  const std::string bufferDir_; ///< Directory of buffered video segments
+  const std::string eventDir_;  ///< Directory of saved event videos
+  const uint64_t bufferBudgetBytes_; ///< Buffer byte budget (0 = unlimited)
+  const uint64_t eventBudgetBytes_;  ///< Event byte budget (0 = unlimited)
+  const uint64_t minFreeBytes_;      ///< Free-space reserve per filesystem
+  const int protectedSeconds_; ///< Age of buffer segments and events
+                               ///< protected from eviction
+  const std::vector<std::string> criticalTokens_; ///< Critical warning tokens
+  const PinCheck isPinned_; ///< Reports buffer segments pinned by exports
+  const SegmentEvictor evictSegment_; ///< Evicts through the recorders
+
+  mutable std::mutex mtx_; ///< Serializes passes and statistics
+
+  // Write-rate estimation state
+  bool haveSample_ = false;      ///< True once a free-space sample exists
+  uint64_t lastUsedBytes_ = 0;   ///< Used bytes at the previous pass
+  uint64_t evictedSinceLast_ = 0; ///< Bytes evicted since the previous pass
+  std::chrono::steady_clock::time_point lastSample_; ///< Previous pass time
+  double writeRate_ = 0.0;       ///< Smoothed write rate in bytes/s
+  uint64_t evictedTotal_ = 0;    ///< Bytes evicted since construction
+  bool budgetWarned_ = false; ///< Protected window exceeds the buffer budget
+
+  static constexpr double RATE_SMOOTHING =
+      0.3; ///< EWMA weight of the newest write-rate sample
+  static constexpr double RATE_SAFETY_FACTOR =
+      2.0; ///< Multiplier applied to predicted writes
+};
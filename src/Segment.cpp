@@ -0,0 +1,110 @@
+#include "Segment.hpp"
+#include "FrameIndex.hpp"
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+SegmentInfo infoForPath(const std::string &path) {
+  SegmentInfo info;
+  info.path = path;
+  return info;
+}
+
+} // namespace
+
+Segment::Segment(const std::string &path) : Segment(infoForPath(path)) {}
+
+Segment::Segment(const SegmentInfo &info)
+    : path_(info.path), info_(info), pins_(0), retired_(false),
+      removed_(false) {
+  if (info.path.empty()) {
+    throw std::invalid_argument("Segment path cannot be empty");
+  }
+}
+
+SegmentInfo Segment::info() const {
+  std::lock_guard<std::mutex> lk(infoMtx_);
+  return info_;
+}
+
+void Segment::finish(const SegmentInfo &info) {
+  if (info.path != path_) {
+    throw std::invalid_argument("Segment info path does not match: " +
+                                info.path);
+  }
+  std::lock_guard<std::mutex> lk(infoMtx_);
+  info_ = info;
+}
+
+void Segment::retire() {
+  retired_ = true;
+  if (pins_.load() == 0) {
+    removeFile();
+  }
+}
+
+void Segment::unpin() {
+  if (pins_.fetch_sub(1) == 1 && retired_.load()) {
+    removeFile();
+  }
+}
+
+void Segment::removeFile() {
+  // Both retire() and the last unpin() may get here; delete only once
+  if (removed_.exchange(true)) {
+    return;
+  }
+  std::error_code ec;
+  removeSegmentFiles(path_, ec);
+  if (ec) {
+    std::cerr << "Warning: Failed to remove retired segment " << path_
+              << ": " << ec.message() << std::endl;
+  }
+}
+
+SegmentHandle::SegmentHandle(std::shared_ptr<Segment> segment)
+    : segment_(std::move(segment)) {
+  if (segment_) {
+    segment_->pin();
+  }
+}
+
+SegmentHandle::SegmentHandle(const SegmentHandle &other)
+    : segment_(other.segment_) {
+  if (segment_) {
+    segment_->pin();
+  }
+}
+
+SegmentHandle::SegmentHandle(SegmentHandle &&other) noexcept
+    : segment_(std::move(other.segment_)) {}
+
+SegmentHandle &SegmentHandle::operator=(SegmentHandle other) noexcept {
+  std::swap(segment_, other.segment_);
+  return *this; // other releases our previous pin
+}
+
+SegmentHandle::~SegmentHandle() { release(); }
+
+const std::string &SegmentHandle::path() const {
+  if (!segment_) {
+    throw std::logic_error("Empty segment handle has no path");
+  }
+  return segment_->path();
+}
+
+SegmentInfo SegmentHandle::info() const {
+  if (!segment_) {
+    throw std::logic_error("Empty segment handle has no info");
+  }
+  return segment_->info();
+}
+
+void SegmentHandle::release() {
+  if (segment_) {
+    segment_->unpin();
+    segment_.reset();
+  }
+}
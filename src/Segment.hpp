@@ -0,0 +1,197 @@
+/**
+ * @file Segment.hpp
+ * @brief Reference-counted video segment handles that pin files against
+ * eviction
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Predicate telling storage cleanup whether a file is pinned
+ *
+ * Directory-scanning evictors (FileManager, RetentionManager) consult it and
+ * skip files for which it returns true.
+ */
+using PinCheck = std::function<bool(const std::string &path)>;
+
+/**
+ * @brief Hands a buffer segment to the recorder that owns it for eviction
+ *
+ * The recorder drops it from its buffer and manifest and retires it, so it
+ * is never returned as pre-trigger history afterwards. Returns false if no
+ * recorder owns the file; the caller then removes it itself.
+ */
+using SegmentEvictor = std::function<bool(const std::string &path)>;
+
+/**
+ * @struct SegmentSummary
+ * @brief CAN signal aggregates over the time span of one segment
+ *
+ * Computed incrementally by SignalAccumulator while the segment records, so
+ * footage can be searched without decoding video or CAN logs.
+ */
+struct SegmentSummary {
+  int minSpeed = 0;          ///< Lowest vehicle speed in km/h
+  int maxSpeed = 0;          ///< Highest vehicle speed in km/h
+  uint64_t speedSum = 0;     ///< Sum of all speed samples
+  uint32_t speedSamples = 0; ///< Number of speed samples (0 = no CAN data)
+  int odometerStart = 0;     ///< First odometer reading in km
+  int odometerEnd = 0;       ///< Last odometer reading in km
+  std::map<std::string, uint32_t>
+      warnings; ///< Number of warning messages per warning type
+
+  /** @brief Mean speed in km/h, or 0 without samples */
+  double meanSpeed() const {
+    return speedSamples == 0 ? 0.0
+                             : static_cast<double>(speedSum) / speedSamples;
+  }
+};
+
+/**
+ * @struct SegmentInfo
+ * @brief Metadata of one finished video segment
+ *
+ * This is the unit recorded in the SegmentManifest, so the buffer index can be
+ * rebuilt after a restart.
+ */
+struct SegmentInfo {
+  std::string path;        ///< Path of the segment file
+  int64_t startUs = 0;     ///< Wall-clock time of the first frame, or of the
+                           ///< capture start if frames were not timed
+  int64_t endUs = 0;       ///< Wall-clock end time (us since epoch)
+  uint64_t sizeBytes = 0;  ///< File size when the segment was finished
+  uint32_t keyframes = 0;  ///< Number of keyframes in the segment
+  int64_t canTimeBase = 0; ///< CAN clock at start (YYYYMMDDhhmmss, 0 = none)
+  SegmentSummary summary;  ///< CAN signal aggregates over the segment
+  int64_t canStartUs = 0;  ///< CAN clock at the first frame (us, 0 = none)
+  uint32_t frameIntervalNs = 0; ///< Measured frame interval (0 = unknown)
+  uint16_t framerate = 0;  ///< Nominal frame rate of the file's timestamps
+};
+
+/**
+ * @class Segment
+ * @brief A buffered video segment file owned by VideoRecorder
+ *
+ * A Segment is shared between the recorder and consumers through
+ * SegmentHandle. Each handle pins the file; a retired segment is deleted from
+ * disk as soon as it is retired with no pins, or when its last pin is
+ * released.
+ *
+ * @note Thread Safety: Pin counting, retire() and pinned() are lock-free and
+ * can be used from any thread; info() and finish() share a small mutex.
+ */
+class Segment final {
+public:
+  /**
+   * @brief Constructs a Segment for an existing file
+   * @param path Path of the segment file
+   * @throws std::invalid_argument if path is empty
+   */
+  explicit Segment(const std::string &path);
+
+  /**
+   * @brief Constructs a Segment with full metadata
+   * @param info Segment metadata; info.path must not be empty
+   * @throws std::invalid_argument if info.path is empty
+   */
+  explicit Segment(const SegmentInfo &info);
+
+  Segment(const Segment &) = delete;
+  Segment &operator=(const Segment &) = delete;
+
+  /** @brief Path of the segment file */
+  const std::string &path() const { return path_; }
+
+  /** @brief Snapshot of the metadata recorded for the segment */
+  SegmentInfo info() const;
+
+  /**
+   * @brief Replaces the metadata once the segment has been written
+   *
+   * Lets the recorder publish the finished live segment as the same object
+   * its handles already pin, so retire() sees every pin.
+   *
+   * @param info Final metadata; info.path must match path()
+   * @throws std::invalid_argument if info.path differs from path()
+   */
+  void finish(const SegmentInfo &info);
+
+  /** @brief True while at least one SegmentHandle pins the file */
+  bool pinned() const { return pins_.load() > 0; }
+
+  /** @brief True once the owner has given up the segment */
+  bool retired() const { return retired_.load(); }
+
+  /**
+   * @brief Marks the segment for deletion
+   * @note The file is removed immediately if unpinned, otherwise when the
+   * last SegmentHandle is released
+   */
+  void retire();
+
+private:
+  friend class SegmentHandle;
+
+  void pin() { pins_.fetch_add(1); }
+  void unpin();
+  void removeFile();
+
+  const std::string path_;      ///< Segment file path
+  mutable std::mutex infoMtx_;  ///< Guards info_
+  SegmentInfo info_;            ///< Metadata, updated once by finish()
+  std::atomic<int> pins_;       ///< Number of live handles
+  std::atomic<bool> retired_;   ///< Set when the owner evicts the segment
+  std::atomic<bool> removed_;   ///< Guards against deleting the file twice
+};
+
+/**
+ * @class SegmentHandle
+ * @brief Pinning reference to a Segment
+ *
+ * Copying a handle adds a pin and moving transfers it, so the file cannot be
+ * evicted while any handle to it is alive. Handles are cheap to pass around:
+ * the path string is shared, never copied.
+ */
+class SegmentHandle final {
+public:
+  SegmentHandle() = default;
+
+  /**
+   * @brief Creates a handle pinning the given segment
+   * @param segment Segment to pin (nullptr creates an empty handle)
+   */
+  explicit SegmentHandle(std::shared_ptr<Segment> segment);
+
+  SegmentHandle(const SegmentHandle &other);
+  SegmentHandle(SegmentHandle &&other) noexcept;
+  SegmentHandle &operator=(SegmentHandle other) noexcept;
+  ~SegmentHandle();
+
+  /** @brief True if the handle refers to a segment */
+  explicit operator bool() const { return segment_ != nullptr; }
+
+  /**
+   * @brief Path of the pinned segment file
+   * @throws std::logic_error if the handle is empty
+   */
+  const std::string &path() const;
+
+  /**
+   * @brief Metadata of the pinned segment
+   * @throws std::logic_error if the handle is empty
+   */
+  SegmentInfo info() const;
+
+  /** @brief Releases the pin early, leaving the handle empty */
+  void release();
+
+private:
+  std::shared_ptr<Segment> segment_; ///< Pinned segment (nullptr if empty)
+};
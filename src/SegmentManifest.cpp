@@ -0,0 +1,345 @@
+#include "SegmentManifest.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+void putU16(std::string &out, uint16_t v) {
+  for (int i = 0; i < 2; ++i) {
+    out.push_back(static_cast<char>(v >> (8 * i)));
+  }
+}
+
+void putU32(std::string &out, uint32_t v) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<char>(v >> (8 * i)));
+  }
+}
+
+void putU64(std::string &out, uint64_t v) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>(v >> (8 * i)));
+  }
+}
+
+/// Bounds-checked little-endian reader over a byte range
+class Reader {
+public:
+  Reader(const char *data, size_t size) : p_(data), end_(data + size) {}
+
+  bool u8(uint8_t &v) { return read(v); }
+  bool u16(uint16_t &v) { return read(v); }
+  bool u32(uint32_t &v) { return read(v); }
+  bool u64(uint64_t &v) { return read(v); }
+  bool i64(int64_t &v) {
+    uint64_t u = 0;
+    if (!read(u)) {
+      return false;
+    }
+    v = static_cast<int64_t>(u);
+    return true;
+  }
+  bool str(std::string &s, size_t n) {
+    if (static_cast<size_t>(end_ - p_) < n) {
+      return false;
+    }
+    s.assign(p_, n);
+    p_ += n;
+    return true;
+  }
+  size_t remaining() const { return static_cast<size_t>(end_ - p_); }
+
+private:
+  template <typename T> bool read(T &v) {
+    if (static_cast<size_t>(end_ - p_) < sizeof(T)) {
+      return false;
+    }
+    v = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      v |= static_cast<T>(static_cast<uint8_t>(p_[i])) << (8 * i);
+    }
+    p_ += sizeof(T);
+    return true;
+  }
+
+  const char *p_;
+  const char *end_;
+};
+
+std::string encodeAdd(const SegmentInfo &info) {
+  std::string payload;
+  putU16(payload, static_cast<uint16_t>(info.path.size()));
+  payload += info.path;
+  putU64(payload, static_cast<uint64_t>(info.startUs));
+  putU64(payload, static_cast<uint64_t>(info.endUs));
+  putU64(payload, info.sizeBytes);
+  putU32(payload, info.keyframes);
+  putU64(payload, static_cast<uint64_t>(info.canTimeBase));
+
+  // Signal summary, appended in a backward-compatible way
+  const SegmentSummary &summary = info.summary;
+  putU32(payload, static_cast<uint32_t>(summary.minSpeed));
+  putU32(payload, static_cast<uint32_t>(summary.maxSpeed));
+  putU64(payload, summary.speedSum);
+  putU32(payload, summary.speedSamples);
+  putU32(payload, static_cast<uint32_t>(summary.odometerStart));
+  putU32(payload, static_cast<uint32_t>(summary.odometerEnd));
+  putU16(payload, static_cast<uint16_t>(summary.warnings.size()));
+  for (const auto &warning : summary.warnings) {
+    const std::string name = warning.first.substr(0, UINT8_MAX);
+    payload.push_back(static_cast<char>(name.size()));
+    payload += name;
+    putU32(payload, warning.second);
+  }
+
+  // Frame timing, appended after the summary in the same way
+  putU64(payload, static_cast<uint64_t>(info.canStartUs));
+  putU32(payload, info.frameIntervalNs);
+  putU16(payload, info.framerate);
+  return payload;
+}
+
+bool decodeSummary(Reader &r, SegmentSummary &summary) {
+  uint32_t minSpeed = 0, maxSpeed = 0, odometerStart = 0, odometerEnd = 0;
+  uint16_t warningTypes = 0;
+  if (!(r.u32(minSpeed) && r.u32(maxSpeed) && r.u64(summary.speedSum) &&
+        r.u32(summary.speedSamples) && r.u32(odometerStart) &&
+        r.u32(odometerEnd) && r.u16(warningTypes))) {
+    return false;
+  }
+  summary.minSpeed = static_cast<int32_t>(minSpeed);
+  summary.maxSpeed = static_cast<int32_t>(maxSpeed);
+  summary.odometerStart = static_cast<int32_t>(odometerStart);
+  summary.odometerEnd = static_cast<int32_t>(odometerEnd);
+  for (uint16_t i = 0; i < warningTypes; ++i) {
+    uint8_t length = 0;
+    std::string name;
+    uint32_t count = 0;
+    if (!(r.u8(length) && r.str(name, length) && r.u32(count))) {
+      return false;
+    }
+    summary.warnings[name] = count;
+  }
+  return true;
+}
+
+bool decodeAdd(const char *data, size_t size, SegmentInfo &info) {
+  Reader r(data, size);
+  uint16_t pathLength = 0;
+  if (!(r.u16(pathLength) && r.str(info.path, pathLength) &&
+        r.i64(info.startUs) && r.i64(info.endUs) && r.u64(info.sizeBytes) &&
+        r.u32(info.keyframes) && r.i64(info.canTimeBase))) {
+    return false;
+  }
+  // Records written before summaries or frame timing existed end early;
+  // trailing bytes from newer record versions are ignored
+  if (r.remaining() > 0 && !decodeSummary(r, info.summary)) {
+    info.summary = SegmentSummary();
+    return true;
+  }
+  if (r.remaining() > 0 &&
+      !(r.i64(info.canStartUs) && r.u32(info.frameIntervalNs) &&
+        r.u16(info.framerate))) {
+    info.canStartUs = 0;
+    info.frameIntervalNs = 0;
+    info.framerate = 0;
+  }
+  return true;
+}
+
+bool writeAll(int fd, const std::string &data) {
+  size_t done = 0;
+  while (done < data.size()) {
+    const ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+} // namespace
+
+SegmentManifest::SegmentManifest(const std::string &path) : path_(path) {
+  if (path.empty()) {
+    throw std::invalid_argument("Manifest path cannot be empty");
+  }
+}
+
+std::vector<SegmentInfo> SegmentManifest::replay() {
+  std::vector<SegmentInfo> live;
+  unfinished_.clear();
+
+  std::ifstream f(path_, std::ios::binary);
+  existed_ = f.is_open();
+  if (!existed_) {
+    return live;
+  }
+  const std::string data((std::istreambuf_iterator<char>(f)),
+                         std::istreambuf_iterator<char>());
+  f.close();
+
+  const size_t offset = parse(data, live, unfinished_);
+  if (offset != data.size()) {
+    std::cerr << "Warning: Segment manifest " << path_ << " has a torn tail ("
+              << data.size() - offset << " bytes discarded)" << std::endl;
+    if (::truncate(path_.c_str(), static_cast<off_t>(offset)) != 0) {
+      std::perror("truncate segment manifest");
+    }
+  }
+  return live;
+}
+
+std::vector<SegmentInfo> SegmentManifest::read(const std::string &path) {
+  std::vector<SegmentInfo> live, unfinished;
+  std::ifstream f(path, std::ios::binary);
+  if (f.is_open()) {
+    const std::string data((std::istreambuf_iterator<char>(f)),
+                           std::istreambuf_iterator<char>());
+    parse(data, live, unfinished);
+  }
+  return live;
+}
+
+size_t SegmentManifest::parse(const std::string &data,
+                              std::vector<SegmentInfo> &live,
+                              std::vector<SegmentInfo> &unfinished) {
+  size_t offset = 0;
+  while (offset + HEADER_SIZE <= data.size()) {
+    Reader header(data.data() + offset, HEADER_SIZE);
+    uint32_t magic = 0, length = 0, crc = 0;
+    uint16_t type = 0, reserved = 0;
+    header.u32(magic);
+    header.u16(type);
+    header.u16(reserved);
+    header.u32(length);
+    header.u32(crc);
+    if (magic != RECORD_MAGIC || length > MAX_PAYLOAD ||
+        offset + HEADER_SIZE + length > data.size()) {
+      break;
+    }
+    const char *payload = data.data() + offset + HEADER_SIZE;
+    if (crc32(payload, length, crc32(&type, sizeof(type))) != crc) {
+      break;
+    }
+
+    if (type == RECORD_ADD || type == RECORD_OPEN) {
+      SegmentInfo info;
+      if (!decodeAdd(payload, length, info)) {
+        break;
+      }
+      const std::string path = info.path;
+      unfinished.erase(std::remove_if(unfinished.begin(), unfinished.end(),
+                                      [&path](const SegmentInfo &s) {
+                                        return s.path == path;
+                                      }),
+                       unfinished.end());
+      (type == RECORD_ADD ? live : unfinished).push_back(std::move(info));
+    } else if (type == RECORD_REMOVE) {
+      const std::string removed(payload, length);
+      for (auto *list : {&live, &unfinished}) {
+        list->erase(std::remove_if(list->begin(), list->end(),
+                                   [&removed](const SegmentInfo &s) {
+                                     return s.path == removed;
+                                   }),
+                    list->end());
+      }
+    }
+    offset += HEADER_SIZE + length;
+  }
+  return offset;
+}
+
+bool SegmentManifest::appendOpen(const SegmentInfo &info) {
+  return appendRecord(RECORD_OPEN, encodeAdd(info));
+}
+
+bool SegmentManifest::appendAdd(const SegmentInfo &info) {
+  return appendRecord(RECORD_ADD, encodeAdd(info));
+}
+
+bool SegmentManifest::appendRemove(const std::string &path) {
+  const bool ok = appendRecord(RECORD_REMOVE, path);
+  if (ok) {
+    ++removesSinceCompaction_;
+  }
+  return ok;
+}
+
+std::string SegmentManifest::frameRecord(uint16_t type,
+                                         const std::string &payload) {
+  std::string record;
+  record.reserve(HEADER_SIZE + payload.size());
+  putU32(record, RECORD_MAGIC);
+  putU16(record, type);
+  putU16(record, 0);
+  putU32(record, static_cast<uint32_t>(payload.size()));
+  putU32(record, crc32(payload.data(), payload.size(),
+                       crc32(&type, sizeof(type))));
+  record += payload;
+  return record;
+}
+
+bool SegmentManifest::appendRecord(uint16_t type, const std::string &payload) {
+  const std::string record = frameRecord(type, payload);
+  const int fd = ::open(path_.c_str(),
+                        O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::perror("open segment manifest");
+    return false;
+  }
+  // A single write keeps records contiguous; fdatasync makes them durable
+  const bool ok = writeAll(fd, record) && ::fdatasync(fd) == 0;
+  if (!ok) {
+    std::perror("write segment manifest");
+  }
+  ::close(fd);
+  return ok;
+}
+
+bool SegmentManifest::compact(const std::vector<SegmentInfo> &live) {
+  std::string journal;
+  for (const auto &info : live) {
+    journal += frameRecord(RECORD_ADD, encodeAdd(info));
+  }
+
+  const std::string tmpPath = path_ + ".tmp";
+  const int fd =
+      ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::perror("open segment manifest for compaction");
+    return false;
+  }
+  const bool written = writeAll(fd, journal) && ::fsync(fd) == 0;
+  ::close(fd);
+  if (!written || std::rename(tmpPath.c_str(), path_.c_str()) != 0) {
+    std::perror("compact segment manifest");
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+
+  // Make the rename itself durable
+  const auto slash = path_.find_last_of('/');
+  const std::string dir =
+      slash == std::string::npos ? "." : path_.substr(0, slash);
+  const int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirFd >= 0) {
+    ::fsync(dirFd);
+    ::close(dirFd);
+  }
+  removesSinceCompaction_ = 0;
+  return true;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file SegmentManifest.hpp
+ * @brief Append-only, checksummed journal of buffered video segments
+ */
+
+#pragma once
+#include "Segment.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @class SegmentManifest
+ * @brief Crash-safe journal used to rebuild the segment buffer at startup
+ *
+ * A segment is journaled with an OPEN record when recording starts, an ADD
+ * record once it is finished and a REMOVE record when it is evicted. Each
+ * record carries a CRC-32 and is made durable with fdatasync() before the
+ * call returns, so after a power loss the journal is valid up to the last
+ * completed record. A torn tail is detected by its
+ * checksum and cut off during replay.
+ *
+ * On-disk record layout (little-endian):
+ * | magic u32 | type u16 | reserved u16 | payload length u32 | crc32 u32 |
+ * followed by the payload. The CRC covers type and payload. ADD and OPEN
+ * payloads carry the SegmentInfo fields followed by its SegmentSummary and
+ * frame timing.
+ *
+ * @note Thread Safety: Not thread-safe; owned and used by VideoRecorder under
+ * its mutex.
+ */
+class SegmentManifest final {
+public:
+  /**
+   * @brief Constructs a manifest bound to a journal file
+   * @param path Path of the journal file (created on first append)
+   * @throws std::invalid_argument if path is empty
+   */
+  explicit SegmentManifest(const std::string &path);
+
+  /**
+   * @brief Replays the journal and returns the live segments
+   * @return Segments added and not removed, in recording order
+   *
+   * Stops at the first corrupted or incomplete record and truncates the
+   * journal there. The caller validates the files and then compacts the
+   * journal to the surviving set.
+   */
+  std::vector<SegmentInfo> replay();
+
+  /**
+   * @brief Reads the live segments of a journal without modifying it
+   * @param path Path of the journal file
+   * @return Segments added and not removed, up to the first damaged record;
+   * empty if the file does not exist
+   *
+   * Safe to use on a journal another process is appending to; used by
+   * segment search.
+   */
+  static std::vector<SegmentInfo> read(const std::string &path);
+
+  /**
+   * @brief Segments opened but never finished, as found by the last replay()
+   * @return Partial metadata (path, start time, CAN time base) of segments
+   * that were being recorded when the previous run stopped
+   */
+  const std::vector<SegmentInfo> &unfinished() const { return unfinished_; }
+
+  /**
+   * @brief Durably records that recording of a segment has started
+   * @param info Metadata known at start (path, start time, CAN time base)
+   * @return true if the record was written and synced
+   */
+  bool appendOpen(const SegmentInfo &info);
+
+  /**
+   * @brief Durably records a finished segment
+   * @param info Metadata of the segment
+   * @return true if the record was written and synced
+   */
+  bool appendAdd(const SegmentInfo &info);
+
+  /**
+   * @brief Durably records the eviction of a segment
+   * @param path Path of the evicted segment
+   * @return true if the record was written and synced
+   */
+  bool appendRemove(const std::string &path);
+
+  /**
+   * @brief Rewrites the journal to contain only the given segments
+   * @param live Segments that are still buffered, in recording order
+   * @return true on success
+   *
+   * The new journal is written to a temporary file, synced and renamed over
+   * the old one, so a crash leaves either the old or the new journal.
+   */
+  bool compact(const std::vector<SegmentInfo> &live);
+
+  /** @brief True if the journal file existed when replay() was called */
+  bool existed() const { return existed_; }
+
+  /** @brief Number of REMOVE records written since the last compaction */
+  size_t removesSinceCompaction() const { return removesSinceCompaction_; }
+
+private:
+  static std::string frameRecord(uint16_t type, const std::string &payload);
+  static size_t parse(const std::string &data, std::vector<SegmentInfo> &live,
+                      std::vector<SegmentInfo> &unfinished);
+  bool appendRecord(uint16_t type, const std::string &payload);
+
+  const std::string path_;            ///< Journal file path
+  bool existed_ = false;              ///< Journal existed at replay time
+  std::vector<SegmentInfo> unfinished_; ///< Opened, never finished segments
+  size_t removesSinceCompaction_ = 0; ///< Journal garbage since compaction
+
+  static constexpr uint32_t RECORD_MAGIC = 0x4D534144; ///< "DASM"
+  static constexpr uint16_t RECORD_ADD = 1;            ///< Segment added
+  static constexpr uint16_t RECORD_REMOVE = 2;         ///< Segment evicted
+  static constexpr uint16_t RECORD_OPEN = 3;           ///< Recording started
+  static constexpr size_t HEADER_SIZE = 16;            ///< Record header size
+  static constexpr uint32_t MAX_PAYLOAD =
+      64 * 1024; ///< Upper bound rejecting garbage lengths
+};
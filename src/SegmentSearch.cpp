@@ -0,0 +1,53 @@
+#include "SegmentSearch.hpp"
+#include "SegmentManifest.hpp"
+#include <algorithm>
+#include <filesystem>
+
+namespace {
+
+bool matches(const SegmentInfo &info, const SegmentQuery &query) {
+  if (info.endUs < query.fromUs || info.startUs > query.toUs) {
+    return false;
+  }
+  const SegmentSummary &summary = info.summary;
+  if ((query.speedAbove >= 0 || query.speedBelow >= 0) &&
+      summary.speedSamples == 0) {
+    return false;
+  }
+  if (query.speedAbove >= 0 && summary.maxSpeed < query.speedAbove) {
+    return false;
+  }
+  if (query.speedBelow >= 0 && summary.minSpeed > query.speedBelow) {
+    return false;
+  }
+  if (!query.warning.empty()) {
+    return std::any_of(summary.warnings.begin(), summary.warnings.end(),
+                       [&query](const auto &warning) {
+                         return warning.second > 0 &&
+                                warning.first.find(query.warning) !=
+                                    std::string::npos;
+                       });
+  }
+  return true;
+}
+
+} // namespace
+
+std::vector<SegmentInfo>
+searchSegments(const std::vector<std::string> &manifests,
+               const SegmentQuery &query) {
+  std::vector<SegmentInfo> result;
+  for (const auto &manifest : manifests) {
+    for (auto &info : SegmentManifest::read(manifest)) {
+      std::error_code ec;
+      if (matches(info, query) && std::filesystem::exists(info.path, ec)) {
+        result.push_back(std::move(info));
+      }
+    }
+  }
+  std::sort(result.begin(), result.end(),
+            [](const SegmentInfo &a, const SegmentInfo &b) {
+              return a.startUs < b.startUs;
+            });
+  return result;
+}
@@ -0,0 +1,36 @@
+/**
+ * @file SegmentSearch.hpp
+ * @brief Searches recorded segments by their CAN signal summaries
+ */
+
+#pragma once
+#include "Segment.hpp"
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+/**
+ * @struct SegmentQuery
+ * @brief Criteria for searchSegments(); unset fields match everything
+ */
+struct SegmentQuery {
+  int64_t fromUs = std::numeric_limits<int64_t>::min(); ///< Overlap start
+  int64_t toUs = std::numeric_limits<int64_t>::max();   ///< Overlap end
+  int speedAbove = -1; ///< Peak speed at least this (km/h), -1 = any
+  int speedBelow = -1; ///< Lowest speed at most this (km/h), -1 = any
+  std::string warning; ///< Substring of a warning type seen in the segment
+};
+
+/**
+ * @brief Returns the segments matching a query
+ * @param manifests Segment manifests to search (buffer and event journals)
+ * @param query Search criteria
+ * @return Matching segments whose files still exist, ordered by start time
+ *
+ * Only the manifests are read; no video or CAN log is decoded. Speed
+ * criteria never match segments recorded without CAN speed data.
+ */
+std::vector<SegmentInfo>
+searchSegments(const std::vector<std::string> &manifests,
+               const SegmentQuery &query);
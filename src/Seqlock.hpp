@@ -0,0 +1,100 @@
+/**
+ * @file Seqlock.hpp
+ * @brief Single-writer sequence lock publishing a small trivially copyable
+ * value
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/**
+ * @class Seqlock
+ * @brief Publishes a value to any number of readers without blocking the
+ * writer
+ *
+ * The value is stored as relaxed 64-bit atomic words next to a sequence
+ * counter that is odd while a write is in progress. A reader copies the
+ * words between two loads of the counter and retries if it changed, so it
+ * always returns a value the writer published as a whole. Reads take no
+ * lock and write no shared memory, so readers never slow the writer or
+ * each other down; a read costs one acquire load, one relaxed load per
+ * word and a retry only if it overlapped a write.
+ *
+ * @tparam T Trivially copyable value, e.g. a struct of integers
+ * @note Thread Safety: write() must only be called from one thread at a
+ * time; read() and version() can be called from any thread.
+ */
+template <typename T> class Seqlock final {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Seqlock values are copied word by word");
+
+public:
+  /** @brief Constructs a seqlock holding value */
+  explicit Seqlock(const T &value = T()) { store(value); }
+
+  Seqlock(const Seqlock &) = delete;
+  Seqlock &operator=(const Seqlock &) = delete;
+
+  /**
+   * @brief Publishes a new value
+   * @note Single writer only
+   */
+  void write(const T &value) {
+    const uint64_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    store(value);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  /** @brief Returns the last published value */
+  T read() const {
+    uint64_t raw[WORDS];
+    while (true) {
+      const uint64_t before = seq_.load(std::memory_order_acquire);
+      if (before & 1) {
+        std::this_thread::yield(); // Writer preempted mid-write
+        continue;
+      }
+      for (size_t i = 0; i < WORDS; ++i) {
+        raw[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == before) {
+        break;
+      }
+    }
+    T value;
+    std::memcpy(&value, raw, sizeof(T));
+    return value;
+  }
+
+  /**
+   * @brief Number of values published so far
+   *
+   * Lets a reader skip work when nothing changed since its last read.
+   */
+  uint64_t version() const {
+    return seq_.load(std::memory_order_acquire) / 2;
+  }
+
+private:
+  static constexpr size_t WORDS =
+      (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t); ///< Storage size
+
+  /// Copies value into the words without touching the sequence counter
+  void store(const T &value) {
+    uint64_t raw[WORDS] = {};
+    std::memcpy(raw, &value, sizeof(T));
+    for (size_t i = 0; i < WORDS; ++i) {
+      words_[i].store(raw[i], std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<uint64_t> seq_{0};        ///< Odd while a write is in progress
+  std::atomic<uint64_t> words_[WORDS];  ///< The value, word by word
+};
@@ -0,0 +1,51 @@
+/**
+ * @file Sha256.hpp
+ * @brief SHA-256 digests for content-addressed offload chunks
+ */
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @class Sha256
+ * @brief Incremental SHA-256 (FIPS 180-4)
+ *
+ * @note Not thread-safe; use one instance per digest.
+ */
+class Sha256 final {
+public:
+  Sha256();
+
+  /**
+   * @brief Adds bytes to the digest
+   * @param data Pointer to the bytes
+   * @param length Number of bytes
+   */
+  void update(const void *data, size_t length);
+
+  /**
+   * @brief Completes the digest
+   * @return The 32-byte digest
+   * @note The instance must not be updated afterwards
+   */
+  std::array<uint8_t, 32> finish();
+
+  /**
+   * @brief Digest of a byte range as 64 lowercase hex digits
+   * @param data Pointer to the bytes
+   * @param length Number of bytes
+   */
+  static std::string hex(const void *data, size_t length);
+
+private:
+  /** @brief Processes one 64-byte block */
+  void transform(const uint8_t *block);
+
+  std::array<uint32_t, 8> state_; ///< Hash state H0..H7
+  uint8_t buffer_[64];            ///< Incomplete block
+  size_t buffered_ = 0;           ///< Bytes in buffer_
+  uint64_t length_ = 0;           ///< Total message length in bytes
+};
@@ -0,0 +1,41 @@
+#include "SignalAccumulator.hpp"
+#include <algorithm>
+
+void SignalAccumulator::onSpeed(int speed) {
+  speed = std::max(speed, 0);
+  std::lock_guard<std::mutex> lk(mtx_);
+  if (current_.speedSamples == 0) {
+    current_.minSpeed = speed;
+    current_.maxSpeed = speed;
+  } else {
+    current_.minSpeed = std::min(current_.minSpeed, speed);
+    current_.maxSpeed = std::max(current_.maxSpeed, speed);
+  }
+  current_.speedSum += static_cast<uint64_t>(speed);
+  ++current_.speedSamples;
+}
+
+void SignalAccumulator::onOdometer(int kilometres) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  if (!haveOdometer_) {
+    current_.odometerStart = kilometres;
+    haveOdometer_ = true;
+  }
+  current_.odometerEnd = kilometres;
+}
+
+void SignalAccumulator::onWarning(const std::string &warningType) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  ++current_.warnings[warningType];
+}
+
+SegmentSummary SignalAccumulator::roll() {
+  std::lock_guard<std::mutex> lk(mtx_);
+  SegmentSummary finished = std::move(current_);
+  current_ = SegmentSummary();
+  if (haveOdometer_) {
+    current_.odometerStart = finished.odometerEnd;
+    current_.odometerEnd = finished.odometerEnd;
+  }
+  return finished;
+}
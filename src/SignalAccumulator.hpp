@@ -0,0 +1,48 @@
+/**
+ * @file SignalAccumulator.hpp
+ * @brief Incremental aggregation of CAN signals per recorded segment
+ */
+
+#pragma once
+#include "Segment.hpp"
+#include <mutex>
+#include <string>
+
+/**
+ * @class SignalAccumulator
+ * @brief Folds CAN signal updates into the summary of the current segment
+ *
+ * CANListener reports every decoded speed, odometer and warning message;
+ * VideoRecorder collects the summary with roll() when a segment finishes,
+ * which also starts the next one. Each update is O(1), so per-segment
+ * statistics come for free while recording.
+ *
+ * @note Thread Safety: All methods are thread-safe.
+ */
+class SignalAccumulator final {
+public:
+  SignalAccumulator() = default;
+
+  /** @brief Records a vehicle speed sample in km/h */
+  void onSpeed(int speed);
+
+  /** @brief Records an odometer reading in km */
+  void onOdometer(int kilometres);
+
+  /** @brief Counts a warning message of the given type */
+  void onWarning(const std::string &warningType);
+
+  /**
+   * @brief Returns the summary accumulated so far and starts a new one
+   * @return Summary since the previous roll()
+   *
+   * The last odometer reading carries over as the start of the next
+   * summary, so consecutive segments cover the distance without gaps.
+   */
+  SegmentSummary roll();
+
+private:
+  std::mutex mtx_;         ///< Guards current_
+  SegmentSummary current_; ///< Summary of the segment being recorded
+  bool haveOdometer_ = false; ///< An odometer reading was seen in current_
+};
@@ -5,8 +5,11 @@
 #include <stdexcept>
 #include <thread>
 
-StorageManager::StorageManager(const std::string &bufferDir, int maxMinutes)
-    : bufferDir_(bufferDir), maxMinutes_(maxMinutes) {
+StorageManager::StorageManager(const std::string &bufferDir, int maxMinutes,
+                               RetentionManager *retention,
+                               const PinCheck &isPinned)
+    : bufferDir_(bufferDir), maxMinutes_(maxMinutes), retention_(retention),
+      isPinned_(isPinned) {
   // Input validation
   if (bufferDir.empty()) {
     throw std::invalid_argument("Buffer directory path cannot be empty");
@@ -18,20 +21,31 @@ StorageManager::StorageManager(const std::string &bufferDir, int maxMinutes)
 
 void StorageManager::run() {
   try {
-    FileManager fm(bufferDir_,
-                   "/tmp"); // Use temporary event dir for cleanup operations
-
+    int secondsSinceCleanup = CLEANUP_INTERVAL_SECONDS;
     while (true) {
-      try {
-        fm.cleanOldSegments(maxMinutes_);
-      } catch (const std::exception &e) {
-        std::cerr << "Warning: Storage cleanup failed: " << e.what()
-                  << std::endl;
-        // Continue running even if cleanup fails
+      if (secondsSinceCleanup >= CLEANUP_INTERVAL_SECONDS) {
+        secondsSinceCleanup = 0;
+        try {
+          FileManager::cleanOldSegments(bufferDir_, maxMinutes_, isPinned_);
+        } catch (const std::exception &e) {
+          std::cerr << "Warning: Storage cleanup failed: " << e.what()
+                    << std::endl;
+          // Continue running even if cleanup fails
+        }
+      }
+
+      if (retention_ != nullptr) {
+        try {
+          retention_->enforce(RETENTION_INTERVAL_SECONDS);
+        } catch (const std::exception &e) {
+          std::cerr << "Warning: Retention pass failed: " << e.what()
+                    << std::endl;
+        }
       }
 
       std::this_thread::sleep_for(
-          std::chrono::seconds(CLEANUP_INTERVAL_SECONDS));
+          std::chrono::seconds(RETENTION_INTERVAL_SECONDS));
+      secondsSinceCleanup += RETENTION_INTERVAL_SECONDS;
     }
   } catch (const std::exception &e) {
     std::cerr << "Fatal error in StorageManager: " << e.what() << std::endl;
@@ -4,6 +4,7 @@
  */
 
 #pragma once
+#include "RetentionManager.hpp"
 #include <string>
 
 /**
@@ -13,6 +14,7 @@
  * This class runs as a background service to:
  * - Monitor buffer directory disk usage
  * - Remove old video segments when buffer exceeds time limits
+ * - Drive the RetentionManager to keep byte budgets and free space
  * - Ensure continuous operation without storage exhaustion
  *
  * @note This class should be run in a separate thread to avoid blocking main
@@ -24,9 +26,14 @@ public:
    * @brief Constructs a StorageManager for the specified buffer directory
    * @param bufferDir Directory path containing video segments to manage
    * @param maxMinutes Maximum buffer duration in minutes before cleanup
+   * @param retention Pointer to retention engine (can be nullptr to disable
+   * byte-budget retention)
+   * @param isPinned Optional predicate; pinned segments are never removed
    * @throws std::invalid_argument if bufferDir is empty or maxMinutes <= 0
    */
-  explicit StorageManager(const std::string &bufferDir, int maxMinutes);
+  explicit StorageManager(const std::string &bufferDir, int maxMinutes,
+                          RetentionManager *retention = nullptr,
+                          const PinCheck &isPinned = nullptr);
 
   /**
    * @brief Main loop for periodic storage cleanup
@@ -38,7 +45,11 @@ public:
 private:
   const std::string bufferDir_; ///< Directory to monitor and clean
   const int maxMinutes_;        ///< Maximum buffer duration before cleanup
+  RetentionManager *const retention_; ///< Byte-budget retention engine
+  const PinCheck isPinned_;           ///< Reports segments pinned by exports
 
   static constexpr int CLEANUP_INTERVAL_SECONDS =
       60; ///< Cleanup check interval
+  static constexpr int RETENTION_INTERVAL_SECONDS =
+      5; ///< Byte-budget and free-space check interval
 };
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "ThreadProfile.hpp"
+#include "Metrics.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int IOPRIO_CLASS_SHIFT = 13;
+constexpr int IOPRIO_WHO_PROCESS = 1;
+constexpr int IOPRIO_CLASS_RT = 1;
+constexpr int IOPRIO_CLASS_BE = 2;
+constexpr int IOPRIO_CLASS_IDLE = 3;
+
+int parseInt(const std::string &value, int low, int high,
+             const std::string &token) {
+  size_t used = 0;
+  int n = 0;
+  try {
+    n = std::stoi(value, &used);
+  } catch (const std::exception &) {
+    used = 0;
+  }
+  if (used != value.size() || n < low || n > high) {
+    throw std::invalid_argument("Invalid value in thread profile token '" +
+                                token + "'");
+  }
+  return n;
+}
+
+std::vector<int> parseCpus(const std::string &list, const std::string &token) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string part;
+  while (std::getline(ss, part, '+')) {
+    const auto dash = part.find('-');
+    const int first = parseInt(part.substr(0, dash), 0, CPU_SETSIZE - 1, token);
+    const int last =
+        dash == std::string::npos
+            ? first
+            : parseInt(part.substr(dash + 1), first, CPU_SETSIZE - 1, token);
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  if (cpus.empty()) {
+    throw std::invalid_argument("Empty CPU list in thread profile");
+  }
+  return cpus;
+}
+
+std::string joinCpus(const std::vector<int> &cpus) {
+  std::string out;
+  for (int cpu : cpus) {
+    out += (out.empty() ? "" : "+") + std::to_string(cpu);
+  }
+  return out;
+}
+
+void warn(const std::string &role, const std::string &what) {
+  std::cerr << "Warning: Cannot set " << what << " for thread role '" << role
+            << "': " << std::strerror(errno) << std::endl;
+}
+
+} // namespace
+
+ThreadProfile ThreadProfile::parse(const std::string &spec) {
+  ThreadProfile profile;
+  std::stringstream ss(spec);
+  std::string token;
+  while (std::getline(ss, token, ',')) {
+    token.erase(0, token.find_first_not_of(" \t"));
+    token.erase(token.find_last_not_of(" \t\r") + 1);
+    if (token.empty()) {
+      continue;
+    }
+    const auto eq = token.find('=');
+    const std::string key = token.substr(0, eq);
+    const std::string value =
+        eq == std::string::npos ? "" : token.substr(eq + 1);
+
+    if (key == "cpu") {
+      profile.cpus = parseCpus(value, token);
+    } else if (key == "fifo" || key == "rr") {
+      profile.policy = key;
+      profile.priority = parseInt(value, 1, 99, token);
+    } else if ((key == "batch" || key == "idle") && value.empty()) {
+      profile.policy = key;
+    } else if (key == "nice") {
+      profile.setNice = true;
+      profile.nice = parseInt(value, -20, 19, token);
+    } else if (key == "io") {
+      const auto colon = value.find(':');
+      profile.ioClass = value.substr(0, colon);
+      if (profile.ioClass == "idle" && colon == std::string::npos) {
+        profile.ioLevel = 0;
+      } else if ((profile.ioClass == "rt" || profile.ioClass == "be") &&
+                 colon != std::string::npos) {
+        profile.ioLevel = parseInt(value.substr(colon + 1), 0, 7, token);
+      } else {
+        throw std::invalid_argument("Invalid I/O class in thread profile "
+                                    "token '" + token + "'");
+      }
+    } else {
+      throw std::invalid_argument("Unknown thread profile token '" + token +
+                                  "'");
+    }
+  }
+  return profile;
+}
+
+bool ThreadProfile::empty() const {
+  return cpus.empty() && policy.empty() && !setNice && ioClass.empty();
+}
+
+bool applyThreadProfile(const std::string &role,
+                        const ThreadProfile &profile) {
+  const pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+  bool ok = true;
+  // The kernel limits names to 15 characters
+  ::pthread_setname_np(::pthread_self(), role.substr(0, 15).c_str());
+
+  if (!profile.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : profile.cpus) {
+      CPU_SET(cpu, &set);
+    }
+    const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+      errno = err;
+      warn(role, "CPU affinity");
+      ok = false;
+    }
+  }
+
+  if (!profile.policy.empty()) {
+    int policy = SCHED_OTHER;
+    if (profile.policy == "fifo") {
+      policy = SCHED_FIFO;
+    } else if (profile.policy == "rr") {
+      policy = SCHED_RR;
+    } else if (profile.policy == "batch") {
+      policy = SCHED_BATCH;
+    } else if (profile.policy == "idle") {
+      policy = SCHED_IDLE;
+    }
+    sched_param param{};
+    param.sched_priority = profile.priority;
+    if (::sched_setscheduler(tid, policy | SCHED_RESET_ON_FORK, &param) !=
+        0) {
+      warn(role, "scheduling policy " + profile.policy);
+      ok = false;
+    }
+  }
+
+  if (profile.setNice && ::setpriority(PRIO_PROCESS, static_cast<id_t>(tid),
+                                       profile.nice) != 0) {
+    warn(role, "nice value");
+    ok = false;
+  }
+
+  if (!profile.ioClass.empty()) {
+    const int ioClass = profile.ioClass == "rt"   ? IOPRIO_CLASS_RT
+                        : profile.ioClass == "be" ? IOPRIO_CLASS_BE
+                                                  : IOPRIO_CLASS_IDLE;
+    const int ioprio = (ioClass << IOPRIO_CLASS_SHIFT) | profile.ioLevel;
+    if (::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, ioprio) != 0) {
+      warn(role, "I/O priority");
+      ok = false;
+    }
+  }
+
+  // Report what the thread actually runs with
+  sched_param param{};
+  const int policy = ::sched_getscheduler(tid) & ~SCHED_RESET_ON_FORK;
+  ::sched_getparam(tid, &param);
+  errno = 0;
+  const int nice = ::getpriority(PRIO_PROCESS, static_cast<id_t>(tid));
+  const long ioprio = ::syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, tid);
+  const char *policyName = policy == SCHED_FIFO    ? "fifo"
+                           : policy == SCHED_RR    ? "rr"
+                           : policy == SCHED_BATCH ? "batch"
+                           : policy == SCHED_IDLE  ? "idle"
+                                                   : "other";
+  Metrics::instance().setInfo(
+      "dacl_thread_info", role,
+      {{"role", role},
+       {"tid", std::to_string(tid)},
+       {"cpus", profile.cpus.empty() ? "all" : joinCpus(profile.cpus)},
+       {"policy", policyName},
+       {"priority", std::to_string(param.sched_priority)},
+       {"nice", std::to_string(nice)},
+       {"ioprio", ioprio < 0 ? "unknown"
+                             : std::to_string(ioprio >> IOPRIO_CLASS_SHIFT) +
+                                   ":" + std::to_string(ioprio & 7)},
+       {"applied", ok ? "1" : "0"}});
+  return ok;
+}
+
+std::map<std::string, ThreadProfile>
+parseThreadProfiles(const std::map<std::string, std::string> &specs) {
+  std::map<std::string, ThreadProfile> profiles;
+  for (const auto &spec : specs) {
+    try {
+      profiles[spec.first] = ThreadProfile::parse(spec.second);
+    } catch (const std::invalid_argument &e) {
+      throw std::invalid_argument("thread_" + spec.first + ": " + e.what());
+    }
+  }
+  return profiles;
+}
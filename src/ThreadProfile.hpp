@@ -0,0 +1,96 @@
+/**
+ * @file ThreadProfile.hpp
+ * @brief CPU affinity, scheduling class and I/O priority per thread role
+ */
+
+#pragma once
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct ThreadProfile
+ * @brief Scheduling settings applied to a thread when it starts
+ *
+ * Parsed from a comma-separated spec, e.g. "cpu=3,fifo=50" for CAN
+ * reception or "cpu=0-2,nice=10,io=idle" for exports. Tokens:
+ * - `cpu=LIST`: allowed cores, as numbers and ranges joined by '+'
+ *   ("0-1+3")
+ * - `fifo=P` / `rr=P`: real-time policy with priority 1..99
+ * - `batch` / `idle`: SCHED_BATCH or SCHED_IDLE
+ * - `nice=N`: nice value -20..19
+ * - `io=rt:N` / `io=be:N` / `io=idle`: I/O scheduling class and level 0..7
+ *
+ * Settings are inherited by threads and processes the thread creates, so
+ * ffmpeg exports run with their parent thread's profile. Real-time policies
+ * are set with SCHED_RESET_ON_FORK, so child processes fall back to normal
+ * scheduling.
+ */
+struct ThreadProfile {
+  std::vector<int> cpus; ///< Allowed CPUs (empty = unchanged)
+  std::string policy;    ///< "", "fifo", "rr", "batch" or "idle"
+  int priority = 0;      ///< Real-time priority for fifo/rr
+  bool setNice = false;  ///< Whether nice is applied
+  int nice = 0;          ///< Nice value
+  std::string ioClass;   ///< "", "rt", "be" or "idle"
+  int ioLevel = 4;       ///< I/O priority level within rt/be
+
+  /**
+   * @brief Parses a profile spec
+   * @param spec Comma-separated tokens as described above ("" = no change)
+   * @return Parsed profile
+   * @throws std::invalid_argument if the spec is malformed
+   */
+  static ThreadProfile parse(const std::string &spec);
+
+  /** @brief True if the profile changes nothing */
+  bool empty() const;
+};
+
+/**
+ * @brief Applies a profile to the calling thread and reports it in Metrics
+ * @param role Name of the thread role ("can", "video", ...)
+ * @param profile Settings to apply
+ * @return true if every setting was applied
+ *
+ * The thread is also named after its role (truncated to 15 characters), as
+ * shown by top -H and in traces; threads it starts inherit the name.
+ * Settings that fail (typically EPERM without CAP_SYS_NICE) are reported
+ * with a warning and skipped; the thread keeps running.
+ */
+bool applyThreadProfile(const std::string &role, const ThreadProfile &profile);
+
+/**
+ * @brief Parses the profile of every configured role
+ * @param specs Role names and their specs (Config::threadProfiles)
+ * @return Parsed profiles by role
+ * @throws std::invalid_argument naming the role of a malformed spec
+ */
+std::map<std::string, ThreadProfile>
+parseThreadProfiles(const std::map<std::string, std::string> &specs);
+
+/**
+ * @brief Starts a thread that applies its role's profile before running
+ * @param profiles Profiles by role; roles without an entry only get reported
+ * @param role Thread role
+ * @param fn Callable to run
+ * @param args Arguments forwarded to fn
+ * @return The started thread
+ */
+template <typename Fn, typename... Args>
+std::thread startThread(const std::map<std::string, ThreadProfile> &profiles,
+                        const std::string &role, Fn &&fn, Args &&...args) {
+  const auto it = profiles.find(role);
+  const ThreadProfile profile =
+      it == profiles.end() ? ThreadProfile() : it->second;
+  return std::thread(
+      [role, profile](auto &&f, auto &&...a) {
+        applyThreadProfile(role, profile);
+        std::invoke(std::forward<decltype(f)>(f),
+                    std::forward<decltype(a)>(a)...);
+      },
+      std::forward<Fn>(fn), std::forward<Args>(args)...);
+}
@@ -0,0 +1,172 @@
+#include "TimeSync.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+int64_t clockMicros(clockid_t clock) {
+  timespec ts{};
+  ::clock_gettime(clock, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/// CLOCK_REALTIME minus CLOCK_MONOTONIC, sampled between two monotonic reads
+int64_t systemOffsetMicros() {
+  const int64_t before = clockMicros(CLOCK_MONOTONIC);
+  const int64_t system = clockMicros(CLOCK_REALTIME);
+  const int64_t after = clockMicros(CLOCK_MONOTONIC);
+  return system - (before + after) / 2;
+}
+
+} // namespace
+
+LinearFit::LinearFit(size_t window, double minRejectUs)
+    : window_(window), minRejectUs_(minRejectUs) {
+  if (window < MIN_POINTS) {
+    throw std::invalid_argument("Fit window must hold at least " +
+                                std::to_string(MIN_POINTS) + " samples");
+  }
+}
+
+bool LinearFit::add(int64_t x, int64_t y) {
+  if (valid()) {
+    const double residual = static_cast<double>(y - map(x));
+    if (std::fabs(residual) > std::max(REJECT_SIGMA * rms_, minRejectUs_)) {
+      if (++rejectsInRow_ < MAX_REJECTS_IN_ROW) {
+        return false;
+      }
+      reset(); // The clock stepped; follow it
+    }
+  }
+  rejectsInRow_ = 0;
+  if (points_.empty()) {
+    x0_ = x;
+    y0_ = y;
+  }
+  points_.emplace_back(x, y);
+  if (points_.size() > window_) {
+    points_.pop_front();
+  }
+  refit();
+  return true;
+}
+
+void LinearFit::reset() {
+  points_.clear();
+  intercept_ = 0;
+  slope_ = 1.0;
+  rms_ = 0;
+  rejectsInRow_ = 0;
+}
+
+void LinearFit::refit() {
+  const double n = static_cast<double>(points_.size());
+  double sx = 0, sy = 0;
+  for (const auto &p : points_) {
+    sx += static_cast<double>(p.first - x0_);
+    sy += static_cast<double>(p.second - y0_);
+  }
+  const double mx = sx / n;
+  const double my = sy / n;
+  double sxx = 0, sxy = 0;
+  for (const auto &p : points_) {
+    const double dx = static_cast<double>(p.first - x0_) - mx;
+    sxx += dx * dx;
+    sxy += dx * (static_cast<double>(p.second - y0_) - my);
+  }
+  if (sxx > 0) {
+    slope_ = sxy / sxx;
+  }
+  intercept_ = my - slope_ * mx;
+
+  double sse = 0;
+  for (const auto &p : points_) {
+    const double residual = static_cast<double>(p.second - y0_) -
+                            (intercept_ + slope_ * (p.first - x0_));
+    sse += residual * residual;
+  }
+  rms_ = std::sqrt(sse / n);
+}
+
+int64_t LinearFit::map(int64_t x) const {
+  return y0_ + static_cast<int64_t>(
+                   std::llround(intercept_ + slope_ * (x - x0_)));
+}
+
+int64_t LinearFit::inverse(int64_t y) const {
+  if (slope_ == 0) {
+    return x0_;
+  }
+  return x0_ + static_cast<int64_t>(
+                   std::llround((static_cast<double>(y - y0_) - intercept_) /
+                                slope_));
+}
+
+TimeSync::TimeSync() : canFit_(CAN_WINDOW, CAN_MIN_REJECT_US) {}
+
+int64_t TimeSync::monotonicMicros() { return clockMicros(CLOCK_MONOTONIC); }
+
+int64_t TimeSync::systemFromMonotonic(int64_t monotonicUs) {
+  return monotonicUs + systemOffsetMicros();
+}
+
+int64_t TimeSync::monotonicFromSystem(int64_t systemUs) {
+  return systemUs - systemOffsetMicros();
+}
+
+int64_t TimeSync::monotonicFromKernel(const timespec &ts) {
+  return monotonicFromSystem(static_cast<int64_t>(ts.tv_sec) * 1000000 +
+                             ts.tv_nsec / 1000);
+}
+
+void TimeSync::onCanClock(int64_t canUs, int64_t rxMonotonicUs) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  const int64_t previousCanUs = lastCanUs_;
+  const int64_t previousRxUs = lastRxUs_;
+  lastCanUs_ = canUs;
+  lastRxUs_ = rxMonotonicUs;
+  // Only a regular one-second tick between two nearby frames is usable;
+  // steps of the CAN clock show up as outliers of the following ticks
+  if (canUs - previousCanUs != 1000000 ||
+      rxMonotonicUs - previousRxUs > MAX_TICK_BRACKET_US) {
+    return;
+  }
+  const int64_t tickUs = previousRxUs + (rxMonotonicUs - previousRxUs) / 2;
+  Metrics &metrics = Metrics::instance();
+  ++metrics.value("dacl_timesync_ticks_total");
+  if (!canFit_.add(tickUs, canUs)) {
+    ++metrics.value("dacl_timesync_rejected_total");
+    return;
+  }
+  if (canFit_.valid()) {
+    // CAN clock minus system time, and the CAN clock's rate error
+    metrics.value("dacl_timesync_can_offset_us") =
+        canFit_.map(rxMonotonicUs) - systemFromMonotonic(rxMonotonicUs);
+    metrics.value("dacl_timesync_can_drift_ppb") =
+        std::llround((canFit_.slope() - 1.0) * 1e9);
+    metrics.value("dacl_timesync_residual_us") =
+        std::llround(canFit_.residualRms());
+  }
+}
+
+bool TimeSync::canFromMonotonic(int64_t monotonicUs, int64_t &canUs) const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  if (!canFit_.valid()) {
+    return false;
+  }
+  canUs = canFit_.map(monotonicUs);
+  return true;
+}
+
+bool TimeSync::monotonicFromCan(int64_t canUs, int64_t &monotonicUs) const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  if (!canFit_.valid()) {
+    return false;
+  }
+  monotonicUs = canFit_.inverse(canUs);
+  return true;
+}
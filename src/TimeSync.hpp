@@ -0,0 +1,157 @@
+/**
+ * @file TimeSync.hpp
+ * @brief Time base relating the CAN clock, the system clocks and video frames
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/**
+ * @class LinearFit
+ * @brief Least-squares line y = a + b * x over a sliding window of samples
+ *
+ * Used to estimate offset (a) and drift (b) between two clocks from noisy
+ * samples. Once the fit has MIN_POINTS samples, a sample whose residual
+ * exceeds REJECT_SIGMA times the residual RMS (and at least minRejectUs) is
+ * rejected as an outlier; MAX_REJECTS_IN_ROW rejections in a row mean the
+ * clock stepped, and the fit restarts from the new samples.
+ *
+ * @note Thread Safety: Not thread-safe; callers serialize access.
+ */
+class LinearFit final {
+public:
+  /**
+   * @brief Constructs an empty fit
+   * @param window Number of most recent samples fitted
+   * @param minRejectUs Residual always accepted, whatever the RMS
+   * @throws std::invalid_argument if window is below MIN_POINTS
+   */
+  explicit LinearFit(size_t window, double minRejectUs);
+
+  /**
+   * @brief Adds a sample and refits
+   * @return false if the sample was rejected as an outlier
+   */
+  bool add(int64_t x, int64_t y);
+
+  /** @brief Forgets all samples */
+  void reset();
+
+  /** @brief true once the fit has at least MIN_POINTS samples */
+  bool valid() const { return points_.size() >= MIN_POINTS; }
+
+  /** @brief y at x on the fitted line */
+  int64_t map(int64_t x) const;
+
+  /** @brief x at which the fitted line reaches y */
+  int64_t inverse(int64_t y) const;
+
+  /** @brief Fitted slope dy/dx (1.0 until two samples exist) */
+  double slope() const { return slope_; }
+
+  /** @brief Root mean square of the residuals of the fitted samples */
+  double residualRms() const { return rms_; }
+
+  /** @brief Number of samples currently fitted */
+  size_t size() const { return points_.size(); }
+
+  static constexpr size_t MIN_POINTS = 4; ///< Samples before the fit is used
+
+private:
+  void refit();
+
+  const size_t window_;      ///< Maximum number of samples
+  const double minRejectUs_; ///< Smallest residual treated as an outlier
+  std::deque<std::pair<int64_t, int64_t>> points_; ///< Fitted samples
+  int64_t x0_ = 0;        ///< Origin of x, keeps the sums well conditioned
+  int64_t y0_ = 0;        ///< Origin of y
+  double intercept_ = 0;  ///< y - y0_ at x = x0_
+  double slope_ = 1.0;    ///< dy/dx
+  double rms_ = 0;        ///< Residual RMS
+  int rejectsInRow_ = 0;  ///< Consecutive rejected samples
+
+  static constexpr double REJECT_SIGMA =
+      4.0; ///< Residual in RMS units above which a sample is an outlier
+  static constexpr int MAX_REJECTS_IN_ROW =
+      5; ///< Consecutive outliers that restart the fit
+};
+
+/**
+ * @class TimeSync
+ * @brief Converts between the CAN clock, CLOCK_MONOTONIC and system time
+ *
+ * The CAN clock (Uhrzeit_datum, 0x2F8) only has one-second resolution, but
+ * the instant its seconds value changes can be located to within one frame
+ * interval: the tick lies between the kernel RX timestamps of the last
+ * frame with the old second and the first frame with the new one.
+ * CANListener reports every 0x2F8 frame with its RX timestamp; the
+ * midpoints of these ticks are fitted against CLOCK_MONOTONIC, which
+ * yields the offset and drift of the CAN clock with microsecond
+ * resolution.
+ *
+ * System time (CLOCK_REALTIME) is related to CLOCK_MONOTONIC by sampling
+ * both clocks at conversion time, so NTP steps are followed immediately;
+ * kernel RX timestamps (SO_TIMESTAMPNS) are system time. Video frames are
+ * related to the same time base by VideoRecorder, which fits the arrival
+ * of every picture against CLOCK_MONOTONIC and stores the start time and
+ * frame interval of each segment.
+ *
+ * @note Thread Safety: All methods are thread-safe.
+ */
+class TimeSync final {
+public:
+  TimeSync();
+
+  /** @brief Current CLOCK_MONOTONIC time in microseconds */
+  static int64_t monotonicMicros();
+
+  /** @brief System time (us since epoch) of a CLOCK_MONOTONIC time */
+  static int64_t systemFromMonotonic(int64_t monotonicUs);
+
+  /** @brief CLOCK_MONOTONIC time of a system time (us since epoch) */
+  static int64_t monotonicFromSystem(int64_t systemUs);
+
+  /** @brief CLOCK_MONOTONIC time of a kernel (SO_TIMESTAMPNS) timestamp */
+  static int64_t monotonicFromKernel(const timespec &ts);
+
+  /**
+   * @brief Reports a received CAN clock frame
+   * @param canUs CAN date/time in microseconds since the epoch (a whole
+   * second)
+   * @param rxMonotonicUs CLOCK_MONOTONIC receive time of the frame
+   * @note Called from the CAN thread for every 0x2F8 frame
+   */
+  void onCanClock(int64_t canUs, int64_t rxMonotonicUs);
+
+  /**
+   * @brief CAN clock time of a CLOCK_MONOTONIC time
+   * @param monotonicUs Time to convert
+   * @param[out] canUs CAN time in microseconds since the epoch
+   * @return false until enough ticks have been observed
+   */
+  bool canFromMonotonic(int64_t monotonicUs, int64_t &canUs) const;
+
+  /**
+   * @brief CLOCK_MONOTONIC time of a CAN clock time
+   * @return false until enough ticks have been observed
+   */
+  bool monotonicFromCan(int64_t canUs, int64_t &monotonicUs) const;
+
+private:
+  mutable std::mutex mtx_;  ///< Guards the fields below
+  LinearFit canFit_;        ///< CAN time (y) against monotonic time (x)
+  int64_t lastCanUs_ = 0;   ///< CAN time of the previous 0x2F8 frame
+  int64_t lastRxUs_ = 0;    ///< Monotonic receive time of that frame
+
+  static constexpr size_t CAN_WINDOW =
+      120; ///< CAN ticks fitted (two minutes)
+  static constexpr double CAN_MIN_REJECT_US =
+      20000.0; ///< Tick residual always accepted
+  static constexpr int64_t MAX_TICK_BRACKET_US =
+      1100000; ///< Frame gap beyond which a tick cannot be located
+};
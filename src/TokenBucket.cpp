@@ -0,0 +1,58 @@
+#include "TokenBucket.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+TokenBucket::TokenBucket(double bytesPerSec, double burstSeconds)
+    : burstSeconds_(burstSeconds), rate_(bytesPerSec),
+      tokens_(bytesPerSec * burstSeconds), refilled_(Clock::now()) {
+  if (bytesPerSec <= 0.0 || burstSeconds <= 0.0) {
+    throw std::invalid_argument("Token bucket rate and depth must be "
+                                "positive");
+  }
+}
+
+void TokenBucket::refillLocked(Clock::time_point now) {
+  const double elapsed =
+      std::chrono::duration<double>(now - refilled_).count();
+  tokens_ = std::min(tokens_ + elapsed * rate_, rate_ * burstSeconds_);
+  refilled_ = now;
+}
+
+bool TokenBucket::tryAcquire(size_t bytes) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  refillLocked(Clock::now());
+  if (tokens_ <= 0.0) {
+    return false;
+  }
+  tokens_ -= static_cast<double>(bytes);
+  return true;
+}
+
+void TokenBucket::acquire(size_t bytes) {
+  while (!tryAcquire(bytes)) {
+    double waitSeconds = 0.0;
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      waitSeconds = -tokens_ / rate_;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(
+        std::max<int64_t>(1000, static_cast<int64_t>(waitSeconds * 1e6))));
+  }
+}
+
+void TokenBucket::setRate(double bytesPerSec) {
+  if (bytesPerSec <= 0.0) {
+    throw std::invalid_argument("Token bucket rate must be positive");
+  }
+  std::lock_guard<std::mutex> lk(mtx_);
+  refillLocked(Clock::now());
+  rate_ = bytesPerSec;
+  tokens_ = std::min(tokens_, rate_ * burstSeconds_);
+}
+
+double TokenBucket::rate() const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return rate_;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file TokenBucket.hpp
+ * @brief Byte-rate limiter shared by export and offload I/O
+ */
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+/**
+ * @class TokenBucket
+ * @brief Token bucket refilled at an adjustable byte rate
+ *
+ * The bucket holds up to burstSeconds of the current rate. A transfer is
+ * admitted while any tokens are left and may take the bucket into debt, so
+ * any transfer size works at any rate; later callers then wait for the
+ * debt to be repaid.
+ *
+ * @note Thread Safety: All methods are thread-safe.
+ */
+class TokenBucket final {
+public:
+  /**
+   * @brief Constructs a full bucket
+   * @param bytesPerSec Refill rate
+   * @param burstSeconds Bucket depth in seconds of the rate
+   * @throws std::invalid_argument if a parameter is not positive
+   */
+  explicit TokenBucket(double bytesPerSec, double burstSeconds);
+
+  /**
+   * @brief Takes tokens for a transfer if any are available
+   * @param bytes Size of the transfer
+   * @return false if the caller should retry later
+   */
+  bool tryAcquire(size_t bytes);
+
+  /**
+   * @brief Takes tokens for a transfer, waiting for them if needed
+   * @param bytes Size of the transfer
+   */
+  void acquire(size_t bytes);
+
+  /**
+   * @brief Changes the refill rate; the bucket shrinks to the new depth
+   * @param bytesPerSec New rate, must be positive
+   * @throws std::invalid_argument if bytesPerSec is not positive
+   */
+  void setRate(double bytesPerSec);
+
+  /** @brief Current refill rate in bytes per second */
+  double rate() const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /** @brief Adds tokens for the time since the last refill; mtx_ held */
+  void refillLocked(Clock::time_point now);
+
+  const double burstSeconds_;  ///< Depth in seconds of the rate
+  mutable std::mutex mtx_;     ///< Guards the fields below
+  double rate_;                ///< Refill rate in bytes per second
+  double tokens_;              ///< Available bytes (negative = debt)
+  Clock::time_point refilled_; ///< Time of the last refill
+};
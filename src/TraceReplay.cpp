@@ -0,0 +1,144 @@
+#include "TraceReplay.hpp"
+#include "CanFrameRing.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+TraceReplay::TraceReplay(const std::map<int, std::string> &idToWarning,
+                         int postMinutes)
+    : idToWarning_(idToWarning),
+      holdOffUs_(std::max<int64_t>(
+          static_cast<int64_t>(postMinutes) * 60 * 1000000, MIN_HOLDOFF_US)) {
+  // Input validation
+  if (postMinutes < 0) {
+    throw std::invalid_argument("Post-trigger minutes cannot be negative");
+  }
+}
+
+TracePartition TraceReplay::decode(const char *begin, const char *end) const {
+  TracePartition partition;
+  VehicleState scratch; // Only tells which frames carry signals
+  CanFrameRecord frame;
+  for (const char *cursor = begin; cursor < end;) {
+    if (*cursor == '\n') {
+      ++cursor; // Blank lines are not worth reporting
+      continue;
+    }
+    if (!parseCandump(cursor, end, frame)) {
+      ++partition.malformed;
+      continue;
+    }
+    ++partition.frames;
+
+    // As CANListener::run(): the mapping first, then the signals
+    auto it = idToWarning_.find(static_cast<int>(frame.id));
+    if (it != idToWarning_.end()) {
+      partition.warnings.push_back({frame.rxUs, &it->second, partition.latest});
+    }
+    if (!CANListener::decodeFrame(frame.id, frame.data, scratch)) {
+      continue;
+    }
+    ++partition.decoded;
+    auto latest = std::find_if(
+        partition.latest.begin(), partition.latest.end(),
+        [&frame](const auto &entry) { return entry.first == frame.id; });
+    if (latest == partition.latest.end()) {
+      partition.latest.emplace_back(frame.id, std::array<uint8_t, 8>{});
+      latest = partition.latest.end() - 1;
+    }
+    std::memcpy(latest->second.data(), frame.data, sizeof(frame.data));
+  }
+  return partition;
+}
+
+std::vector<TracePartition>
+TraceReplay::decodeAll(const std::vector<TraceSlice> &slices,
+                       unsigned threads) const {
+  std::vector<TracePartition> partitions(slices.size());
+  std::atomic<size_t> next{0};
+  auto worker = [&] {
+    for (size_t i = next++; i < slices.size(); i = next++) {
+      partitions[i] = decode(slices[i].begin, slices[i].end);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < std::max(threads, 1U); ++i) {
+    workers.emplace_back(worker);
+  }
+  worker(); // The calling thread is one of them
+  for (auto &thread : workers) {
+    thread.join();
+  }
+  return partitions;
+}
+
+void TraceReplay::split(const TraceSlice &text, size_t sliceBytes,
+                        std::vector<TraceSlice> &slices) {
+  const char *begin = text.begin;
+  while (begin < text.end) {
+    const char *end = text.end;
+    if (static_cast<size_t>(text.end - begin) > sliceBytes) {
+      const char *newline = static_cast<const char *>(
+          std::memchr(begin + sliceBytes, '\n',
+                      static_cast<size_t>(text.end - begin) - sliceBytes));
+      end = newline != nullptr ? newline + 1 : text.end;
+    }
+    slices.push_back({begin, end});
+    begin = end;
+  }
+}
+
+std::vector<ReplayEvent>
+TraceReplay::merge(const std::vector<TracePartition> &partitions) const {
+  auto advance = [](VehicleState state,
+                    const TracePartition::LatestFrames &latest) {
+    // Each ID sets its own fields, so the order does not matter
+    for (const auto &entry : latest) {
+      CANListener::decodeFrame(entry.first, entry.second.data(), state);
+    }
+    return state;
+  };
+
+  std::vector<ReplayEvent> events;
+  auto fire = [&events](const TracePartition::Warning &warning,
+                        const VehicleState &state) {
+    char timestamp[32];
+    std::snprintf(timestamp, sizeof(timestamp), "%04d%02d%02d_%02d%02d%02d",
+                  state.year, state.month, state.day, state.hour,
+                  state.minute, state.second);
+    events.push_back({timestamp, *warning.warning, state.speed, warning.rxUs});
+  };
+
+  // The live trigger thread is busy capturing until freeUs; the last
+  // warning meanwhile waits for it
+  int64_t freeUs = std::numeric_limits<int64_t>::min();
+  const TracePartition::Warning *pending = nullptr;
+  VehicleState pendingState;
+  VehicleState carry; // State at the start of the current slice
+  for (const auto &partition : partitions) {
+    for (const auto &warning : partition.warnings) {
+      if (pending != nullptr && warning.rxUs >= freeUs) {
+        fire(*pending, pendingState);
+        freeUs += holdOffUs_;
+        pending = nullptr;
+      }
+      const VehicleState state = advance(carry, warning.latest);
+      if (warning.rxUs >= freeUs) {
+        fire(warning, state);
+        freeUs = warning.rxUs + holdOffUs_;
+      } else {
+        pending = &warning;
+        pendingState = state;
+      }
+    }
+    carry = advance(carry, partition.latest);
+  }
+  if (pending != nullptr) {
+    fire(*pending, pendingState);
+  }
+  return events;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file TraceReplay.hpp
+ * @brief Deterministic re-run of CAN decoding and triggering over recorded
+ * traces
+ */
+
+#pragma once
+#include "CANListener.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct ReplayEvent
+ * @brief An event the trigger logic raises for a recorded trace
+ */
+struct ReplayEvent {
+  std::string timestamp; ///< CAN clock at the warning (YYYYMMDD_HHMMSS)
+  std::string warning;   ///< Warning type from the ID mapping
+  int speed = 0;         ///< Decoded vehicle speed at the warning (km/h)
+  int64_t triggerUs = 0; ///< Logged receive time of the warning frame
+};
+
+/**
+ * @struct TraceSlice
+ * @brief Whole lines of a candump log in memory
+ */
+struct TraceSlice {
+  const char *begin = nullptr; ///< First byte (start of a line)
+  const char *end = nullptr;   ///< One past the last byte (end of a line)
+};
+
+/**
+ * @struct TracePartition
+ * @brief What decoding one slice of a trace found, independent of all
+ * earlier slices
+ *
+ * The vehicle state at a point of the slice is the state at the slice start
+ * updated by the last frame of each decoded ID seen since; keeping those
+ * frames instead of a state lets slices be decoded in parallel and joined
+ * exactly afterwards.
+ */
+struct TracePartition {
+  /// Last payload of each decoded CAN ID, in first-seen order
+  using LatestFrames =
+      std::vector<std::pair<uint32_t, std::array<uint8_t, 8>>>;
+
+  /// A warning frame, with the decoded frames preceding it in the slice
+  struct Warning {
+    int64_t rxUs = 0;                    ///< Logged receive time
+    const std::string *warning = nullptr; ///< Type (owned by the mapping)
+    LatestFrames latest; ///< Decoded frames before it in the slice
+  };
+
+  uint64_t frames = 0;        ///< CAN frames parsed
+  uint64_t decoded = 0;       ///< Frames carrying decoded signals
+  uint64_t malformed = 0;     ///< Lines that are not CAN frames
+  std::vector<Warning> warnings; ///< Warning frames in receive order
+  LatestFrames latest;        ///< Decoded frames of the whole slice
+};
+
+/**
+ * @class TraceReplay
+ * @brief Re-applies a warning mapping and the CAN trigger rule to candump
+ * traces
+ *
+ * Decoding uses CANListener::decodeFrame(), as the live CAN thread does,
+ * and the same "ID,Name" mapping. Triggering follows TriggerManager: a
+ * warning outside a capture starts an event at the frame's receive time; a
+ * capture holds further events off for the post-trigger duration (at least
+ * MIN_HOLDOFF_US, the CAN trigger poll interval), and the last warning
+ * received meanwhile starts the next event once it ends. Speed and CAN
+ * timestamp are those decoded at the warning frame.
+ *
+ * Traces are split into slices decoded independently (decode()), then
+ * joined in trace order (merge()), so the result does not depend on how
+ * the work was partitioned or scheduled.
+ *
+ * @note Thread Safety: Immutable after construction; decode() may run in
+ * several threads at once.
+ */
+class TraceReplay final {
+public:
+  /**
+   * @brief Constructs the replay
+   * @param idToWarning Map of CAN message IDs to warning type strings
+   * @param postMinutes Post-trigger duration in minutes
+   * @throws std::invalid_argument if postMinutes is negative
+   */
+  explicit TraceReplay(const std::map<int, std::string> &idToWarning,
+                       int postMinutes);
+
+  /**
+   * @brief Decodes one slice of a candump log
+   * @param begin First byte of the slice (start of a line)
+   * @param end One past its last byte (end of a line)
+   * @return Frame counts, warning frames and decoded frames of the slice
+   */
+  TracePartition decode(const char *begin, const char *end) const;
+
+  /**
+   * @brief Decodes slices in parallel
+   * @param slices Slices in trace order
+   * @param threads Worker threads; each takes the next undecoded slice
+   * @return One partition per slice, in the order of slices
+   */
+  std::vector<TracePartition> decodeAll(const std::vector<TraceSlice> &slices,
+                                        unsigned threads) const;
+
+  /**
+   * @brief Cuts a log into slices of about sliceBytes at line boundaries
+   * @param text The log
+   * @param sliceBytes Target slice size
+   * @param[out] slices Receives the slices in order
+   */
+  static void split(const TraceSlice &text, size_t sliceBytes,
+                    std::vector<TraceSlice> &slices);
+
+  /**
+   * @brief Joins decoded slices and applies the trigger rule
+   * @param partitions Slices in trace order
+   * @return Events in trigger order
+   */
+  std::vector<ReplayEvent>
+  merge(const std::vector<TracePartition> &partitions) const;
+
+  /// Shortest time between two CAN-triggered events
+  static constexpr int64_t MIN_HOLDOFF_US = 200000;
+
+private:
+  const std::map<int, std::string> idToWarning_; ///< CAN ID -> warning type
+  const int64_t holdOffUs_; ///< Time a capture keeps further events off
+};
@@ -0,0 +1,164 @@
+#include "Tracer.hpp"
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <pthread.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+/// Writes s as a JSON string literal
+void writeJsonString(std::ostream &out, const char *s) {
+  out << '"';
+  for (; *s != '\0'; ++s) {
+    const unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      out << '\\' << *s;
+    } else if (c < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    } else {
+      out << *s;
+    }
+  }
+  out << '"';
+}
+
+} // namespace
+
+std::atomic<bool> Tracer::enabled_{false};
+
+Tracer &Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::enable(size_t spansPerThread) {
+  if (spansPerThread == 0) {
+    throw std::invalid_argument("Trace ring size must be positive");
+  }
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    capacity_ = spansPerThread;
+  }
+  enabled_.store(true, std::memory_order_release);
+}
+
+int64_t Tracer::now() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void Tracer::record(const char *category, const char *name, int64_t startUs,
+                    int64_t endUs) {
+  // Hands the ring on when the thread exits
+  struct Lease {
+    Ring *ring = nullptr;
+    int32_t tid = 0;
+    ~Lease() {
+      if (ring != nullptr) {
+        Tracer::instance().release(ring);
+      }
+    }
+  };
+  thread_local Lease lease;
+  if (lease.ring == nullptr) {
+    lease.ring = acquire();
+    lease.tid = static_cast<int32_t>(::syscall(SYS_gettid));
+  }
+  Ring &ring = *lease.ring;
+
+  TraceSpan span;
+  span.sequence = ring.written.load(std::memory_order_relaxed) + 1;
+  span.category = category;
+  span.name = name;
+  span.startUs = startUs;
+  span.durationUs = endUs - startUs;
+  span.tid = lease.tid;
+  ring.slots[(span.sequence - 1) % capacity_].write(span);
+  ring.written.store(span.sequence, std::memory_order_release);
+}
+
+Tracer::Ring *Tracer::acquire() {
+  char name[16] = {};
+  if (::pthread_getname_np(::pthread_self(), name, sizeof(name)) != 0) {
+    name[0] = '\0';
+  }
+  const int32_t tid = static_cast<int32_t>(::syscall(SYS_gettid));
+  std::lock_guard<std::mutex> lk(mtx_);
+  threadNames_[tid] = name;
+  if (!free_.empty()) {
+    Ring *ring = free_.back();
+    free_.pop_back();
+    return ring;
+  }
+  rings_.push_back(std::make_unique<Ring>(capacity_));
+  return rings_.back().get();
+}
+
+void Tracer::release(Ring *ring) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  free_.push_back(ring);
+}
+
+bool Tracer::writeTo(const std::string &path) const {
+  std::vector<const Ring *> rings;
+  std::map<int32_t, std::string> names;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (const auto &ring : rings_) {
+      rings.push_back(ring.get()); // Never freed, so safe to read unlocked
+    }
+    names = threadNames_;
+  }
+
+  std::ostringstream out;
+  const int pid = static_cast<int>(::getpid());
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << pid
+      << ",\"tid\":" << pid << ",\"args\":{\"name\":\"dacl\"}}";
+  std::map<int32_t, bool> seen;
+  for (const Ring *ring : rings) {
+    const uint64_t last = ring->written.load(std::memory_order_acquire);
+    const uint64_t first = last > capacity_ ? last - capacity_ + 1 : 1;
+    for (uint64_t sequence = first; sequence <= last; ++sequence) {
+      const TraceSpan span = ring->slots[(sequence - 1) % capacity_].read();
+      // The thread appended a newer span to the slot while we were copying
+      if (span.sequence != sequence) {
+        continue;
+      }
+      seen[span.tid] = true;
+      out << ",\n{\"ph\":\"X\",\"cat\":";
+      writeJsonString(out, span.category);
+      out << ",\"name\":";
+      writeJsonString(out, span.name);
+      out << ",\"ts\":" << span.startUs << ",\"dur\":" << span.durationUs
+          << ",\"pid\":" << pid << ",\"tid\":" << span.tid << "}";
+    }
+  }
+  for (const auto &entry : seen) {
+    const auto name = names.find(entry.first);
+    if (name == names.end()) {
+      continue;
+    }
+    out << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+        << ",\"tid\":" << entry.first << ",\"args\":{\"name\":";
+    writeJsonString(out, name->second.c_str());
+    out << "}}";
+  }
+  out << "\n]}\n";
+
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream f(tmpPath, std::ios::trunc);
+    if (!f.is_open() || !(f << out.str())) {
+      return false;
+    }
+  }
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file Tracer.hpp
+ * @brief Scoped trace spans in per-thread rings, exported as Chrome trace
+ * JSON
+ */
+
+#pragma once
+#include "Seqlock.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @struct TraceSpan
+ * @brief One timed section of a thread
+ */
+struct TraceSpan {
+  uint64_t sequence = 0;          ///< Number of the span in its ring, from 1
+  const char *category = nullptr; ///< Module, a string literal
+  const char *name = nullptr;     ///< Section, a string literal
+  int64_t startUs = 0;            ///< CLOCK_MONOTONIC start
+  int64_t durationUs = 0;         ///< Length
+  int32_t tid = 0;                ///< Kernel thread ID
+};
+
+/**
+ * @class Tracer
+ * @brief Records spans of the trigger and export pipeline for offline
+ * inspection
+ *
+ * Each thread appends to a ring of its own, allocated at its first span, so
+ * recording takes no lock and never waits for a dump; as in CanFrameRing,
+ * every slot is a Seqlock and a dump skips slots overwritten while it was
+ * copying. A thread's ring is handed to the next new thread once it exits,
+ * so short-lived workers do not accumulate rings. writeTo() produces the
+ * Chrome trace event format, which chrome://tracing and ui.perfetto.dev
+ * open; thread names are those set by applyThreadProfile().
+ *
+ * Until enable() is called, TraceScope costs one relaxed atomic load.
+ *
+ * @note Thread Safety: All methods are thread-safe.
+ */
+class Tracer final {
+public:
+  /** @brief Returns the process-wide tracer */
+  static Tracer &instance();
+
+  /**
+   * @brief Starts recording
+   * @param spansPerThread Ring size of each thread (the most recent spans
+   * are kept)
+   * @throws std::invalid_argument if spansPerThread is 0
+   * @note Call once, before the threads start
+   */
+  void enable(size_t spansPerThread);
+
+  /** @brief Whether spans are recorded */
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Appends a span to the calling thread's ring
+   * @param category Module name (string literal, not copied)
+   * @param name Section name (string literal, not copied)
+   * @param startUs CLOCK_MONOTONIC start
+   * @param endUs CLOCK_MONOTONIC end
+   */
+  void record(const char *category, const char *name, int64_t startUs,
+              int64_t endUs);
+
+  /**
+   * @brief Writes the spans of all threads as Chrome trace JSON
+   * @param path Destination file (replaced atomically)
+   * @return true on success
+   */
+  bool writeTo(const std::string &path) const;
+
+  /** @brief CLOCK_MONOTONIC in microseconds, the time base of the spans */
+  static int64_t now();
+
+private:
+  Tracer() = default;
+
+  /// Spans of one thread at a time
+  struct Ring {
+    explicit Ring(size_t capacity)
+        : slots(new Seqlock<TraceSpan>[capacity]) {}
+    std::unique_ptr<Seqlock<TraceSpan>[]> slots; ///< Span n at n % capacity
+    std::atomic<uint64_t> written{0};             ///< Spans appended so far
+  };
+
+  /// Gives the calling thread a ring, reusing one of an exited thread
+  Ring *acquire();
+  /// Returns the ring of an exiting thread; its spans stay readable
+  void release(Ring *ring);
+
+  static std::atomic<bool> enabled_; ///< Set by enable()
+  size_t capacity_ = 0;              ///< Spans per ring
+
+  mutable std::mutex mtx_;                  ///< Guards the members below
+  std::vector<std::unique_ptr<Ring>> rings_; ///< All rings ever allocated
+  std::vector<Ring *> free_;                 ///< Rings of exited threads
+  std::map<int32_t, std::string> threadNames_; ///< Names by thread ID
+};
+
+/**
+ * @class TraceScope
+ * @brief Records the lifetime of a scope as a span when tracing is enabled
+ *
+ * @code
+ * TraceScope span("trigger", "capture");
+ * @endcode
+ */
+class TraceScope final {
+public:
+  /**
+   * @param category Module name (string literal)
+   * @param name Section name (string literal)
+   */
+  TraceScope(const char *category, const char *name)
+      : category_(category), name_(name),
+        startUs_(Tracer::enabled() ? Tracer::now() : 0) {}
+  ~TraceScope() {
+    if (startUs_ != 0) {
+      Tracer::instance().record(category_, name_, startUs_, Tracer::now());
+    }
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const char *const category_; ///< Module name
+  const char *const name_;     ///< Section name
+  const int64_t startUs_;      ///< Start, 0 if tracing is disabled
+};
@@ -1,87 +1,171 @@
 #include "TriggerManager.hpp"
+#include "Metrics.hpp"
+#include "TimeSync.hpp"
+#include "Tracer.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <chrono>
-#include <filesystem>
 #include <iostream>
+#include <stdexcept>
 #include <thread>
+#ifndef DACL_NO_GPIO
 #include <wiringPi.h>
-
-TriggerManager::TriggerManager(VideoRecorder *vr, FileManager *fm,
-                               CSVLogger *cl, OverlayRenderer *overlayRenderer,
-                               CANListener *can, int gpioPin, int preMin,
-                               int postMin)
-    : videoRecorder_(vr), fileManager_(fm), csvLogger_(cl),
-      overlayRenderer_(overlayRenderer), canListener_(can), gpioPin_(gpioPin),
-      preMin_(preMin), postMin_(postMin), running_(true) {}
+#endif
+
+TriggerManager::TriggerManager(const std::vector<VideoRecorder *> &vrs,
+                               EventExporter *exporter, CANListener *can,
+                               int gpioPin, int preMin, int postMin,
+                               MotionDetector *motionDetector,
+                               int motionPreMin, int motionPostMin,
+                               const CanFrameRing *canFrames,
+                               PipelineWriter *pipeline)
+    : videoRecorders_(vrs), exporter_(exporter), canListener_(can),
+      motionDetector_(motionDetector), canFrames_(canFrames),
+      pipeline_(pipeline), gpioPin_(gpioPin), preMin_(preMin),
+      postMin_(postMin), motionPreMin_(motionPreMin),
+      motionPostMin_(motionPostMin), running_(true) {
+  if (vrs.empty() || std::find(vrs.begin(), vrs.end(), nullptr) != vrs.end()) {
+    throw std::invalid_argument("Video recorders cannot be empty or null");
+  }
+  if ((exporter == nullptr) == (pipeline == nullptr)) {
+    throw std::invalid_argument("TriggerManager needs either an "
+                                "EventExporter or a PipelineWriter");
+  }
+}
 
 void TriggerManager::run() {
+#ifndef DACL_NO_GPIO
   wiringPiSetup();
   pinMode(gpioPin_, INPUT);
   pullUpDnControl(gpioPin_, PUD_UP);
 
   std::thread gpioThread(&TriggerManager::handleGPIOTrigger, this);
+#endif
   std::thread canThread(&TriggerManager::handleCANTrigger, this);
   std::thread consoleThread(&TriggerManager::handleConsoleTrigger, this);
+  std::thread motionThread;
+  if (motionDetector_ != nullptr) {
+    motionThread = std::thread(&TriggerManager::handleMotionTrigger, this);
+  }
 
+#ifndef DACL_NO_GPIO
   gpioThread.join();
+#endif
   canThread.join();
   consoleThread.join();
+  if (motionThread.joinable()) {
+    motionThread.join();
+  }
+}
+
+void TriggerManager::captureEvent(const std::string &triggerType,
+                                  const std::string &warningType, int speed,
+                                  int preMin, int postMin, int64_t triggerUs) {
+  // Counted down however the capture ends; the trigger sources capture
+  // concurrently, each in its own thread
+  struct CaptureCount {
+    std::atomic<int> &count;
+    ~CaptureCount() { --count; }
+  } captureCount{capturing_};
+  ++capturing_;
+  TraceScope span("trigger", "capture");
+  std::string timestamp = currentTimestamp(canListener_);
+
+  // From the trigger to the start of its capture. Each trigger source polls
+  // in its own thread; a trigger that arrived while that thread was still
+  // capturing counts from the end of that capture, since the wait is the
+  // hold-off, not delay
+  static thread_local int64_t previousEndUs = 0;
+  Metrics &metrics = Metrics::instance();
+  const auto captureStart = std::chrono::steady_clock::now();
+  const int64_t startUs = wallClockMicros();
+  const int64_t latencyUs =
+      triggerUs > 0
+          ? std::max<int64_t>(0, startUs - std::max(triggerUs, previousEndUs))
+          : 0;
+  auto &latencyMax = metrics.value("dacl_trigger_latency_max_us");
+  metrics.value("dacl_trigger_latency_us") = latencyUs;
+  latencyMax = std::max<int64_t>(latencyMax, latencyUs);
+  ++metrics.value("dacl_trigger_events_total");
+  struct CaptureTime {
+    std::atomic<int64_t> &total;
+    std::chrono::steady_clock::time_point start;
+    ~CaptureTime() {
+      total += std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+      previousEndUs = wallClockMicros();
+    }
+  } captureTime{metrics.value("dacl_trigger_capture_ms_total"), captureStart};
+
+  // Handles pin the segments until they are exported or staged below
+  std::vector<EventCamera> cameras(videoRecorders_.size());
+  for (size_t i = 0; i < cameras.size(); ++i) {
+    TraceScope segmentsSpan("trigger", "collect_segments");
+    EventCamera &camera = cameras[i];
+    camera.camera = videoRecorders_[i]->camera();
+    // One instant for all cameras, so their windows line up
+    camera.pre = videoRecorders_[i]->getBufferedSegments(preMin, triggerUs);
+    videoRecorders_[i]->startPostTriggerRecording(postMin, warningType,
+                                                  camera.post, triggerUs);
+    FramePosition position;
+    if (videoRecorders_[i]->locateFrame(triggerUs, position)) {
+      std::cerr << "Trigger " << warningType << " on camera "
+                << camera.camera << ": frame " << position.frame << " ("
+                << position.ptsUs / 1000 << " ms) of " << position.path
+                << std::endl;
+    }
+  }
+
+  EventInfo event;
+  event.timestamp = timestamp;
+  event.triggerType = triggerType;
+  event.warningType = warningType;
+  event.speed = speed;
+  event.preMin = preMin;
+  event.postMin = postMin;
+  event.triggerUs = triggerUs;
+  event.vehicle = canListener_->getVehicleState();
+  if (pipeline_ != nullptr) {
+    pipeline_->publish(event, cameras);
+  } else {
+    try {
+      exporter_->exportEvent(event, cameras, canFrames_);
+    } catch (const std::exception &e) {
+      // Later events must still be captured
+      std::cerr << "Warning: Export of event " << warningType << " at "
+                << timestamp << " failed: " << e.what() << std::endl;
+      ++Metrics::instance().value("dacl_trigger_export_failures_total");
+    }
+  }
 }
 
 void TriggerManager::handleGPIOTrigger() {
+#ifndef DACL_NO_GPIO
   while (running_) {
     if (digitalRead(gpioPin_) == LOW) {
       std::string triggerType = "GPIO_BUTTON";
       std::string warningType = "Manual Trigger";
       int speed = canListener_->getVehicleSpeed();
-      std::string timestamp = currentTimestamp(canListener_);
-
-      auto preFiles = videoRecorder_->getBufferedSegments(preMin_);
-      std::string postFile;
-      videoRecorder_->startPostTriggerRecording(postMin_, warningType,
-                                                postFile);
-
-      if (!postFile.empty() && std::filesystem::exists(postFile)) {
-        std::string overlayFile =
-            overlayRenderer_->renderOverlay(speed, warningType, timestamp);
-        fileManager_->copyEventSegments(preFiles, warningType, timestamp,
-                                        overlayFile, "pretrigger");
-        fileManager_->copyEventSegments({postFile}, warningType, timestamp,
-                                        overlayFile, "posttrigger");
-
-        csvLogger_->logEvent(timestamp, triggerType, warningType, speed,
-                             preFiles, postFile);
-      }
+      captureEvent(triggerType, warningType, speed, preMin_, postMin_,
+                   wallClockMicros());
       std::this_thread::sleep_for(std::chrono::seconds(1));
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
   }
+#endif
 }
 
 void TriggerManager::handleCANTrigger() {
   while (running_) {
     std::string warningType;
-    if (canListener_->getLatestWarning(warningType)) {
+    int64_t rxMonotonicUs = 0;
+    if (canListener_->getLatestWarning(warningType, rxMonotonicUs)) {
       std::string triggerType = "CAN";
       int speed = canListener_->getVehicleSpeed();
-      std::string timestamp = currentTimestamp(canListener_);
-
-      auto preFiles = videoRecorder_->getBufferedSegments(preMin_);
-      std::string postFile;
-      videoRecorder_->startPostTriggerRecording(postMin_, warningType,
-                                                postFile);
-
-      if (!postFile.empty() && std::filesystem::exists(postFile)) {
-        std::string overlayFile =
-            overlayRenderer_->renderOverlay(speed, warningType, timestamp);
-        fileManager_->copyEventSegments(preFiles, warningType, timestamp,
-                                        overlayFile, "pretrigger");
-        fileManager_->copyEventSegments({postFile}, warningType, timestamp,
-                                        overlayFile, "posttrigger");
-
-        csvLogger_->logEvent(timestamp, triggerType, warningType, speed,
-                             preFiles, postFile);
-      }
+      // The frame's arrival, not when this thread polled it
+      captureEvent(triggerType, warningType, speed, preMin_, postMin_,
+                   TimeSync::systemFromMonotonic(rxMonotonicUs));
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
   }
@@ -94,25 +178,23 @@ void TriggerManager::handleConsoleTrigger() {
       std::string triggerType = "CONSOLE";
       std::string warningType = "Manual Terminal";
       int speed = 50; // Simulated
-      std::string timestamp = currentTimestamp(canListener_);
-
-      auto preFiles = videoRecorder_->getBufferedSegments(preMin_);
-      std::string postFile;
-      videoRecorder_->startPostTriggerRecording(postMin_, warningType,
-                                                postFile);
-
-      if (!postFile.empty() && std::filesystem::exists(postFile)) {
-        std::string overlayFile =
-            overlayRenderer_->renderOverlay(speed, warningType, timestamp);
-        fileManager_->copyEventSegments(preFiles, warningType, timestamp,
-                                        overlayFile, "pretrigger");
-        fileManager_->copyEventSegments({postFile}, warningType, timestamp,
-                                        overlayFile, "posttrigger");
-
-        csvLogger_->logEvent(timestamp, triggerType, warningType, speed,
-                             preFiles, postFile);
-      }
+      captureEvent(triggerType, warningType, speed, preMin_, postMin_,
+                   wallClockMicros());
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
   }
+}
+
+void TriggerManager::handleMotionTrigger() {
+  while (running_) {
+    int blocks = 0;
+    if (motionDetector_->getLatestMotion(blocks)) {
+      std::string triggerType = "MOTION";
+      std::string warningType = "Motion";
+      int speed = canListener_->getVehicleSpeed();
+      captureEvent(triggerType, warningType, speed, motionPreMin_,
+                   motionPostMin_, wallClockMicros());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
 }
\ No newline at end of file
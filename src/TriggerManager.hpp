@@ -5,11 +5,13 @@
 
 #pragma once
 #include "CANListener.hpp"
-#include "CSVLogger.hpp"
-#include "FileManager.hpp"
-#include "OverlayRenderer.hpp"
+#include "CanFrameRing.hpp"
+#include "EventExporter.hpp"
+#include "MotionDetector.hpp"
+#include "PipelineRing.hpp"
 #include "VideoRecorder.hpp"
 #include <atomic>
+#include <vector>
 
 /**
  * @class TriggerManager
@@ -20,8 +22,17 @@
  * - Monitors CAN bus for warning messages
  * - Handles GPIO button press events
  * - Processes console-based manual triggers
+ * - Raises MOTION events from the parked-mode motion detector, with their
+ *   own pre/post-trigger windows
  * - Coordinates video segment saving and overlay application
- * - Manages event logging and metadata recording
+ * - Captures every camera for each trigger: all recorders are asked for the
+ *   same wall-clock window, so the exported clips are time-aligned
+ * - Timestamps CAN triggers with the kernel receive time of the warning
+ *   frame and logs the frame of each camera recorded at that instant
+ * - Hands the pinned segments to the EventExporter, which copies them with
+ *   the overlay, logs the event and writes its bundle; with pipeline=split
+ *   they are published to the event processor instead, so that no export
+ *   runs in the capture process
  *
  * @note Thread Safety: This class manages multiple trigger sources and
  * coordinates with other system components in a thread-safe manner.
@@ -30,22 +41,30 @@ class TriggerManager final {
 public:
   /**
    * @brief Constructs a TriggerManager with system component references
-   * @param videoRecorder Pointer to video recording system
-   * @param fileManager Pointer to file management system
-   * @param csvLogger Pointer to event logging system
-   * @param overlayRenderer Pointer to overlay generation system
+   * @param videoRecorders Recorders of all cameras, first camera first
+   * @param exporter Exports the events in this process (nullptr with a
+   * pipeline)
    * @param canListener Pointer to CAN bus interface
    * @param gpioPin GPIO pin number for manual trigger button
    * @param preMin Pre-trigger duration in minutes
    * @param postMin Post-trigger duration in minutes
-   * @throws std::invalid_argument if any pointer is nullptr or timing
-   * parameters are invalid
+   * @param motionDetector Source of MOTION triggers (nullptr = none)
+   * @param motionPreMin Pre-trigger duration of MOTION events in minutes
+   * @param motionPostMin Post-trigger duration of MOTION events in minutes
+   * @param canFrames Raw CAN frame history for event bundles (nullptr =
+   * bundles carry no CAN data)
+   * @param pipeline Pipeline to the event processor (nullptr = export with
+   * exporter)
+   * @throws std::invalid_argument if videoRecorders is empty or holds
+   * nullptr, or not exactly one of exporter and pipeline is given
    */
-  explicit TriggerManager(VideoRecorder *videoRecorder,
-                          FileManager *fileManager, CSVLogger *csvLogger,
-                          OverlayRenderer *overlayRenderer,
-                          CANListener *canListener, int gpioPin, int preMin,
-                          int postMin);
+  explicit TriggerManager(const std::vector<VideoRecorder *> &videoRecorders,
+                          EventExporter *exporter, CANListener *canListener,
+                          int gpioPin, int preMin, int postMin,
+                          MotionDetector *motionDetector = nullptr,
+                          int motionPreMin = 0, int motionPostMin = 0,
+                          const CanFrameRing *canFrames = nullptr,
+                          PipelineWriter *pipeline = nullptr);
 
   /**
    * @brief Main event monitoring and processing loop
@@ -54,7 +73,28 @@ public:
    */
   void run();
 
+  /**
+   * @brief True while an event is being captured and exported
+   * @note Thread-safe; lets background jobs keep out of the way of exports
+   */
+  bool capturing() const { return capturing_ > 0; }
+
 private:
+  /**
+   * @brief Collects the pre/post-trigger segments of all cameras and
+   * exports or publishes the event
+   * @param triggerType Source of the trigger ("CAN", "GPIO_BUTTON", ...)
+   * @param warningType Warning or event label
+   * @param speed Vehicle speed at time of event
+   * @param preMin Pre-trigger duration in minutes
+   * @param postMin Post-trigger duration in minutes
+   * @param triggerUs Wall-clock time of the trigger in microseconds
+   * @note Called by all trigger handlers
+   */
+  void captureEvent(const std::string &triggerType,
+                    const std::string &warningType, int speed, int preMin,
+                    int postMin, int64_t triggerUs);
+
   /**
    * @brief Processes GPIO button press events
    * @note Called internally during main monitoring loop
@@ -73,18 +113,29 @@ private:
    */
   void handleConsoleTrigger();
 
+  /**
+   * @brief Processes motion detected while parked
+   * @note Runs in its own thread when a motion detector is configured
+   */
+  void handleMotionTrigger();
+
   // System component pointers - all non-owning
-  VideoRecorder *const videoRecorder_;     ///< Video recording system
-  FileManager *const fileManager_;         ///< File management system
-  CSVLogger *const csvLogger_;             ///< Event logging system
-  OverlayRenderer *const overlayRenderer_; ///< Overlay generation system
-  CANListener *const canListener_;         ///< CAN bus interface
+  const std::vector<VideoRecorder *>
+      videoRecorders_;                     ///< Recorders of all cameras
+  EventExporter *const exporter_;        ///< Exporter, or nullptr
+  CANListener *const canListener_;       ///< CAN bus interface
+  MotionDetector *const motionDetector_; ///< Motion source, or nullptr
+  const CanFrameRing *const canFrames_;  ///< CAN history, or nullptr
+  PipelineWriter *const pipeline_;       ///< Event processor, or nullptr
 
   const int gpioPin_; ///< GPIO pin for manual trigger button
   const int preMin_;  ///< Pre-trigger duration in minutes
   const int postMin_; ///< Post-trigger duration in minutes
+  const int motionPreMin_;  ///< Pre-trigger duration of MOTION events
+  const int motionPostMin_; ///< Post-trigger duration of MOTION events
 
   std::atomic<bool> running_; ///< Flag controlling main processing loop
+  std::atomic<int> capturing_{0}; ///< captureEvent() calls in progress
 
   static constexpr int POLLING_INTERVAL_MS =
       100; ///< Main loop polling interval
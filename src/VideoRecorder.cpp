@@ -1,88 +1,769 @@
 #include "VideoRecorder.hpp"
+#include "FrameIndex.hpp"
+#include "MediaProbe.hpp"
+#include "Metrics.hpp"
+#include "Tracer.hpp"
 #include "utils.hpp"
 #include <chrono>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <fcntl.h>
 #include <filesystem>
 #include <iostream> // Added to fix std::cerr error
+#include <stdexcept>
+#include <sys/ioctl.h>
 #include <thread>
+#include <unistd.h>
+
+namespace {
+
+/// Reads exactly size bytes; false on end of stream or error
+bool readFull(int fd, uint8_t *data, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t n = ::read(fd, data + done, size - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+/**
+ * @brief Finds the next sequence parameter set in an H.264 Annex B stream
+ * @return Offset of its start code, or size if there is none from `from`
+ *
+ * Sources repeat SPS/PPS before every keyframe, so this is where a new
+ * segment can start. A start code split across two reads is missed and the
+ * following keyframe is used instead.
+ */
+size_t findSequenceHeader(const uint8_t *data, size_t size, size_t from) {
+  static constexpr uint8_t NAL_TYPE_MASK = 0x1f;
+  static constexpr uint8_t NAL_TYPE_SPS = 7;
+  for (size_t i = from; i + 3 < size; ++i) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1 &&
+        (data[i + 3] & NAL_TYPE_MASK) == NAL_TYPE_SPS) {
+      return i;
+    }
+  }
+  return size;
+}
+
+/**
+ * @brief Counts pictures in an H.264 Annex B stream fed in arbitrary chunks
+ *
+ * A picture starts with a slice NAL unit (type 1 or 5) whose
+ * first_mb_in_slice is 0, i.e. whose first payload bit is set. The parser
+ * state carries over between chunks, so start codes split across reads are
+ * still found.
+ */
+class PictureCounter {
+public:
+  void feed(const uint8_t *data, size_t size) {
+    static constexpr uint8_t NAL_TYPE_MASK = 0x1f;
+    for (size_t i = 0; i < size; ++i) {
+      const uint8_t byte = data[i];
+      if (stage_ == Stage::NalHeader) {
+        const uint8_t type = byte & NAL_TYPE_MASK;
+        stage_ = type == 1 || type == 5 ? Stage::SliceHeader : Stage::Scan;
+        zeros_ = 0;
+      } else if (stage_ == Stage::SliceHeader) {
+        if ((byte & 0x80) != 0) {
+          ++pictures_;
+        }
+        stage_ = Stage::Scan;
+        zeros_ = byte == 0 ? 1 : 0;
+      } else if (byte == 0) {
+        ++zeros_;
+      } else {
+        if (byte == 1 && zeros_ >= 2) {
+          stage_ = Stage::NalHeader;
+        }
+        zeros_ = 0;
+      }
+    }
+  }
+
+  uint64_t pictures() const { return pictures_; }
+
+private:
+  enum class Stage { Scan, NalHeader, SliceHeader };
+  Stage stage_ = Stage::Scan; ///< What the next byte is
+  int zeros_ = 0;             ///< Zero bytes seen before the current one
+  uint64_t pictures_ = 0;     ///< Pictures started so far
+};
+
+} // namespace
 
 VideoRecorder::VideoRecorder(const std::string &bufferDir, int segmentSeconds,
-                             int bufferMinutes, CANListener *canListener)
+                             int bufferMinutes, CANListener *canListener,
+                             VideoSource *source,
+                             ProcessSupervisor *supervisor,
+                             CopyEngine *copier,
+                             const CaptureSettings &settings,
+                             FrameTapWriter *tap, int tapFramerate,
+                             SignalAccumulator *signals,
+                             ExportThrottle *throttle,
+                             ProfileSelector *profiles,
+                             const std::string &camera,
+                             const TimeSync *timeSync)
     : bufferDir_(bufferDir), segmentSeconds_(segmentSeconds),
       bufferMinutes_(bufferMinutes), postTriggerActive_(false),
-      postTriggerSegmentsLeft_(0), canListener_(canListener) {}
+      postTriggerUntilUs_(0), canListener_(canListener), source_(source),
+      supervisor_(supervisor), copier_(copier), settings_(settings), tap_(tap),
+      tapFramerate_(tapFramerate), signals_(signals), throttle_(throttle),
+      profiles_(profiles), manifest_(bufferDir + "/segments.manifest"),
+      camera_(camera), timeSync_(timeSync) {
+  if (source == nullptr) {
+    throw std::invalid_argument("Video source cannot be null");
+  }
+  if (supervisor == nullptr) {
+    throw std::invalid_argument("Process supervisor cannot be null");
+  }
+  if (copier == nullptr) {
+    throw std::invalid_argument("Copy engine cannot be null");
+  }
+  if (tap != nullptr && tapFramerate <= 0) {
+    throw std::invalid_argument("Frame tap frame rate must be positive");
+  }
+  if (camera.empty()) {
+    throw std::invalid_argument("Camera name cannot be empty");
+  }
+  std::cerr << "Video source of camera " << camera_ << ": " << source->name()
+            << std::endl;
+  try {
+    recoverBuffer();
+  } catch (const std::exception &e) {
+    std::cerr << "Warning: Segment buffer recovery failed: " << e.what()
+              << std::endl;
+  }
+}
+
+size_t VideoRecorder::bufferCapacity() const {
+  return static_cast<size_t>(bufferMinutes_ * 60 / segmentSeconds_);
+}
+
+void VideoRecorder::recoverBuffer() {
+  const auto start = std::chrono::steady_clock::now();
+  const auto records = manifest_.replay();
+
+  std::vector<SegmentInfo> live;
+  for (const auto &info : records) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(info.path, ec);
+    if (ec || size != info.sizeBytes) {
+      std::cerr << "Discarding torn segment: " << info.path << std::endl;
+      removeSegmentFiles(info.path, ec);
+      continue;
+    }
+    // E.g. recorded before frame indexing, or interrupted before indexing
+    if (!std::filesystem::exists(frameIndexPath(info.path), ec)) {
+      writeFrameIndex(info);
+    }
+    live.push_back(info);
+  }
+
+  // Segments cut off mid-recording keep their complete fragments
+  for (auto info : manifest_.unfinished()) {
+    const uint64_t usable = completeFragmentsLength(info.path);
+    std::error_code ec;
+    if (usable == 0) {
+      removeSegmentFiles(info.path, ec);
+      continue;
+    }
+    std::filesystem::resize_file(info.path, usable, ec);
+    const auto mtime = std::filesystem::last_write_time(info.path, ec);
+    if (ec) {
+      continue;
+    }
+    info.endUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                     (mtime - std::filesystem::file_time_type::clock::now() +
+                      std::chrono::system_clock::now())
+                         .time_since_epoch())
+                     .count();
+    info.sizeBytes = usable;
+    info.keyframes = countKeyframes(info.path);
+    writeFrameIndex(info);
+    std::cerr << "Salvaged " << usable << " bytes of interrupted segment "
+              << info.path << std::endl;
+    live.push_back(info);
+  }
+  std::sort(live.begin(), live.end(),
+            [](const SegmentInfo &a, const SegmentInfo &b) {
+              return a.startUs < b.startUs;
+            });
+
+  // Retire what no longer fits, e.g. after buffer_minutes was reduced
+  while (live.size() > bufferCapacity()) {
+    std::error_code ec;
+    removeSegmentFiles(live.front().path, ec);
+    live.erase(live.begin());
+  }
+
+  // Segments that never reached the manifest were cut off mid-recording
+  if (manifest_.existed()) {
+    std::error_code ec;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(bufferDir_, ec)) {
+      const std::string name = entry.path().filename().string();
+      if (name.rfind("video_", 0) != 0 || entry.path().extension() != ".mp4") {
+        continue;
+      }
+      const bool known =
+          std::any_of(live.begin(), live.end(), [&](const SegmentInfo &s) {
+            return s.path == entry.path().string();
+          });
+      if (!known) {
+        std::cerr << "Discarding unfinished segment: " << entry.path()
+                  << std::endl;
+        std::error_code rmEc;
+        removeSegmentFiles(entry.path().string(), rmEc);
+      }
+    }
+  }
+
+  manifest_.compact(live);
+  for (const auto &info : live) {
+    bufferFiles_.push_back(std::make_shared<Segment>(info));
+  }
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  std::cerr << "Recovered " << bufferFiles_.size()
+            << " buffered segments from manifest in " << elapsed.count()
+            << " ms" << std::endl;
+}
 
 void VideoRecorder::run() {
+  if (signals_ != nullptr) {
+    signals_->roll(); // Discard samples from before the first segment
+  }
+  Metrics &metrics = Metrics::instance();
+  const std::string prefix = "dacl_camera_" + camera_ + "_";
+  std::atomic<int64_t> &bytesTotal = metrics.value(prefix + "bytes_total");
+  std::atomic<int64_t> &framesTotal = metrics.value(prefix + "frames_total");
+  std::atomic<int64_t> &droppedTotal =
+      metrics.value(prefix + "dropped_frames_total");
+  std::atomic<int64_t> &segmentsTotal =
+      metrics.value(prefix + "segments_total");
+  std::atomic<int64_t> &failuresTotal =
+      metrics.value(prefix + "capture_failures_total");
+  std::atomic<int64_t> &gapMax = metrics.value(prefix + "frame_gap_max_us");
+  std::atomic<int64_t> &gapsTotal = metrics.value(prefix + "frame_gaps_total");
+  bool firstSegment = true;
+  DrivingState previousState = DrivingState::Highway;
   while (true) {
+    DrivingState state = DrivingState::Highway;
+    if (profiles_ != nullptr) {
+      state = profiles_->update();
+    }
     std::string timestamp =
         currentTimestamp(canListener_); // Use CAN-based timestamp
     std::string videoFile = bufferDir_ + "/video_" + timestamp + ".mp4";
-    std::string cmd = "libcamera-vid --nopreview -t " +
-                      std::to_string(segmentSeconds_ * 1000) + " -o " +
-                      videoFile + " --codec h264";
-    int ret = system(cmd.c_str());
+    SegmentInfo info;
+    info.path = videoFile;
+    info.startUs = wallClockMicros();
+    info.canTimeBase = packedCANTime(canListener_);
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      // Events are recorded at full quality whatever the vehicle does
+      if (postTriggerActive_) {
+        state = DrivingState::Highway;
+      }
+      segmentState_ = state;
+      cutRequested_ = false;
+      manifest_.appendOpen(info);
+      liveSegment_ = std::make_shared<Segment>(info);
+    }
+    const CaptureSettings &settings =
+        profiles_ != nullptr ? profiles_->settings(state) : settings_;
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      // Nominal timing until the pump has fitted the first pictures
+      liveTiming_ = SegmentInfo();
+      liveTiming_.startUs = info.startUs;
+      liveTiming_.framerate = static_cast<uint16_t>(settings.framerate);
+      liveTiming_.frameIntervalNs =
+          static_cast<uint32_t>(1000000000LL / settings.framerate);
+    }
+    if (profiles_ != nullptr && (firstSegment || state != previousState)) {
+      std::cerr << "Recording profile: " << ProfileSelector::name(state)
+                << " (" << settings.framerate << " fps, " << settings.bitrate
+                << " bit/s)" << std::endl;
+      if (!firstSegment) {
+        ++metrics.value("dacl_recording_profile_switches_total");
+      }
+      metrics.setInfo("dacl_recording_profile_info", "",
+                      {{"profile", ProfileSelector::name(state)}});
+      previousState = state;
+      firstSegment = false;
+    }
+
+    int ret = 0;
+    {
+      TraceScope span("video", "segment");
+      ret = capture(videoFile, settings, alignedDurationMs());
+    }
+    TraceScope finishSpan("video", "finish_segment");
+    bytesTotal += static_cast<int64_t>(pumpedBytes_);
+    framesTotal += static_cast<int64_t>(pumpedFrames_);
+    gapsTotal += static_cast<int64_t>(pumpedGaps_);
+    gapMax = std::max<int64_t>(gapMax, pumpedMaxGapUs_); // Since startup
     if (ret != 0) {
-      std::cerr << "Error: libcamera-vid command failed for " << videoFile
-                << std::endl;
-      continue;
+      ++failuresTotal;
+      // Keep whatever complete fragments made it to disk
+      const uint64_t usable = completeFragmentsLength(videoFile);
+      std::error_code ec;
+      if (usable == 0) {
+        std::cerr << "Error: capture pipeline failed for " << videoFile
+                  << std::endl;
+        if (signals_ != nullptr) {
+          signals_->roll();
+        }
+        std::lock_guard<std::mutex> lk(mtx_);
+        liveSegment_.reset();
+        manifest_.appendRemove(videoFile);
+        removeSegmentFiles(videoFile, ec);
+        continue;
+      }
+      std::cerr << "Warning: capture pipeline failed, keeping " << usable
+                << " bytes of " << videoFile << std::endl;
+      std::filesystem::resize_file(videoFile, usable, ec);
     }
 
-    // Add a short delay to ensure the file is fully created
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    info.endUs = wallClockMicros();
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      info.startUs = liveTiming_.startUs;
+      info.frameIntervalNs = liveTiming_.frameIntervalNs;
+      info.framerate = liveTiming_.framerate;
+    }
+    if (timeSync_ != nullptr && pumpedStartMonoUs_ != 0 &&
+        !timeSync_->canFromMonotonic(pumpedStartMonoUs_, info.canStartUs)) {
+      info.canStartUs = 0;
+    }
+    // Frames missing against the nominal rate, including startup gaps
+    const int64_t expectedFrames =
+        (info.endUs - info.startUs) * settings.framerate / 1000000;
+    droppedTotal += std::max<int64_t>(
+        0, expectedFrames - static_cast<int64_t>(pumpedFrames_));
+    ++segmentsTotal;
+    std::error_code sizeEc;
+    info.sizeBytes = std::filesystem::file_size(videoFile, sizeEc);
+    info.keyframes = countKeyframes(videoFile);
+    if (writeFrameIndex(info) == 0) {
+      std::cerr << "Warning: No frame index written for " << videoFile
+                << std::endl;
+    }
+    if (signals_ != nullptr) {
+      info.summary = signals_->roll();
+    }
+    if (profiles_ != nullptr) {
+      metrics.value(std::string("dacl_recording_") +
+                    ProfileSelector::name(state) + "_ms_total") +=
+          (info.endUs - info.startUs) / 1000;
+      if (cutRequested_) {
+        ++metrics.value("dacl_recording_cuts_total");
+      }
+    }
 
     {
       std::lock_guard<std::mutex> lk(mtx_);
-      bufferFiles_.push_back(videoFile);
+      manifest_.appendAdd(info);
+      // Publish the object the live handles already pin
+      liveSegment_->finish(info);
+      bufferFiles_.push_back(std::move(liveSegment_));
       std::cerr << "Video file created: " << videoFile << std::endl;
 
-      if ((int)bufferFiles_.size() > bufferMinutes_ * 60 / segmentSeconds_) {
-        std::cerr << "Removing old buffer file: " << bufferFiles_.front()
-                  << std::endl;
-        std::filesystem::remove(bufferFiles_.front());
-        bufferFiles_.erase(bufferFiles_.begin());
+      if (bufferFiles_.size() > bufferCapacity()) {
+        // Pinned segments are deleted when their last handle is released
+        auto oldest = std::move(bufferFiles_.front());
+        bufferFiles_.pop_front();
+        dropSegment(std::move(oldest));
       }
 
-      if (postTriggerActive_ && postTriggerSegmentsLeft_ > 0) {
-        std::string postFile = bufferDir_ + "/posttrigger_" + timestamp + "_" +
-                               eventType_ + ".mp4";
-        try {
-          std::filesystem::copy(
-              videoFile, postFile,
-              std::filesystem::copy_options::overwrite_existing);
-          std::cerr << "Post-trigger file created: " << postFile << std::endl;
-          postTriggerFile_ =
-              postFile; // Update postTriggerFile_ after successful copy
-          postTriggerSegmentsLeft_--;
-          if (postTriggerSegmentsLeft_ == 0) {
-            postTriggerActive_ = false;
-            std::cerr << "Post-trigger recording completed." << std::endl;
-          }
-        } catch (const std::filesystem::filesystem_error &e) {
-          std::cerr << "Error copying post-trigger file: " << e.what()
-                    << std::endl;
+      if (postTriggerActive_) {
+        const std::string postFile = bufferDir_ + "/posttrigger_" +
+                                     timestamp + "_" + eventType_ + ".mp4";
+        SegmentInfo postInfo = info;
+        postInfo.path = postFile;
+        // Copied in the background; the handle keeps the source pinned
+        // until the copy has finished
+        SegmentHandle source(bufferFiles_.back());
+        copier_->submit(videoFile, postFile,
+                        [this, source, postInfo](int error) {
+                          onPostTriggerCopied(postInfo, error);
+                        });
+        // Time-based, since a cut can leave a short segment
+        if (info.endUs >= postTriggerUntilUs_) {
+          postTriggerActive_ = false;
+          std::cerr << "Post-trigger recording completed." << std::endl;
         }
       }
     }
   }
 }
 
-std::vector<std::string> VideoRecorder::getBufferedSegments(int minutesBack) {
+void VideoRecorder::onPostTriggerCopied(const SegmentInfo &postInfo,
+                                        int error) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  if (error != 0) {
+    std::cerr << "Error copying post-trigger file " << postInfo.path << ": "
+              << std::strerror(error) << std::endl;
+    return;
+  }
+  std::cerr << "Post-trigger file created: " << postInfo.path << std::endl;
+  if (postTriggerFile_) {
+    detach(std::move(postTriggerFile_));
+  }
+  postTriggerFile_ = std::make_shared<Segment>(postInfo);
+}
+
+std::vector<std::string>
+VideoRecorder::muxerCommand(const std::string &file,
+                            const CaptureSettings &settings) const {
+  // Raw H.264 from the source is remuxed (not re-encoded) into fragmented
+  // MP4: one moof/mdat fragment per keyframe, i.e. about every second, so
+  // the file is readable and crash-safe while it is being written.
+  std::vector<std::string> muxer = {
+      "ffmpeg", "-hide_banner", "-loglevel", "error", "-f", "h264",
+      "-framerate", std::to_string(settings.framerate), "-i", "-", "-map",
+      "0:v", "-c", "copy", "-movflags",
+      "+frag_keyframe+empty_moov+default_base_moof", "-frag_duration",
+      "1000000", "-y", file};
+  if (tap_ != nullptr) {
+    // Second output: decoded, downscaled BGR frames on stdout for the tap
+    const std::vector<std::string> tapOutput = {
+        "-map", "0:v", "-vf",
+        "fps=" + std::to_string(tapFramerate_) +
+            ",scale=" + std::to_string(tap_->width()) + ":" +
+            std::to_string(tap_->height()),
+        "-pix_fmt", "bgr24", "-f", "rawvideo", "pipe:1"};
+    muxer.insert(muxer.end(), tapOutput.begin(), tapOutput.end());
+  }
+  return muxer;
+}
+
+int VideoRecorder::alignedDurationMs() const {
+  const int64_t segmentMs = static_cast<int64_t>(segmentSeconds_) * 1000;
+  const int64_t nowMs = wallClockMicros() / 1000;
+  int64_t durationMs = segmentMs - nowMs % segmentMs;
+  if (durationMs < MIN_SEGMENT_MS) {
+    durationMs += segmentMs;
+  }
+  return static_cast<int>(durationMs);
+}
+
+int VideoRecorder::capture(const std::string &file,
+                           const CaptureSettings &settings, int durationMs) {
+  pumpedBytes_ = 0;
+  pumpedFrames_ = 0;
+  pumpedStartMonoUs_ = 0;
+  pumpedMaxGapUs_ = 0;
+  pumpedGaps_ = 0;
+  int sourcePipe[2];
+  int muxerPipe[2];
+  if (::pipe2(sourcePipe, O_CLOEXEC) != 0) {
+    std::perror("pipe2 capture stream");
+    return -1;
+  }
+  if (::pipe2(muxerPipe, O_CLOEXEC) != 0) {
+    std::perror("pipe2 capture stream");
+    ::close(sourcePipe[0]);
+    ::close(sourcePipe[1]);
+    return -1;
+  }
+  SpawnOptions options;
+  options.timeoutMs = durationMs + CAPTURE_TIMEOUT_SLACK_MS;
+
+  options.job = "capture_source";
+  options.stdoutFd = sourcePipe[1];
+  ChildProcess source = supervisor_->spawn(
+      source_->captureCommand(durationMs, settings), options);
+  ::close(sourcePipe[1]);
+
+  options.job = "capture_muxer";
+  options.stdoutFd = -1;
+  options.stdinFd = muxerPipe[0];
+  options.captureStdout = tap_ != nullptr;
+  ChildProcess muxer =
+      supervisor_->spawn(muxerCommand(file, settings), options);
+  ::close(muxerPipe[0]);
+
+  // If either process is missing, the pump sees end of stream or EPIPE and
+  // closes its ends, which stops the other one
+  std::thread pumpThread(&VideoRecorder::pump, this, sourcePipe[0],
+                         muxerPipe[1]);
+  if (tap_ != nullptr && muxer) {
+    std::vector<uint8_t> frame(tap_->frameBytes());
+    while (readFull(muxer.stdoutFd(), frame.data(), frame.size())) {
+      tap_->publish(frame.data(), wallClockMicros());
+    }
+  }
+  pumpThread.join();
+  const ProcessResult sourceResult = supervisor_->wait(source);
+  const ProcessResult muxerResult = supervisor_->wait(muxer);
+  // After a cut the source fails writing into the closed pipe
+  return (sourceResult.ok() || cutRequested_) && muxerResult.ok() ? 0 : 1;
+}
+
+void VideoRecorder::pump(int in, int out) {
+  const int capacity = ::fcntl(in, F_GETPIPE_SZ);
+  std::vector<uint8_t> buffer(PUMP_CHUNK_BYTES);
+  PictureCounter pictures;
+  LinearFit arrivals(MAX_FIT_PICTURES, PICTURE_MIN_REJECT_US);
+  size_t forwarded = 0;
+  bool open = true;
+  int64_t gapLimitUs = 0;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    gapLimitUs = static_cast<int64_t>(liveTiming_.frameIntervalNs) / 1000 *
+                 FRAME_GAP_INTERVALS;
+  }
+  while (open) {
+    int queued = 0;
+    if (throttle_ != nullptr && capacity > 0 &&
+        ::ioctl(in, FIONREAD, &queued) == 0) {
+      throttle_->recordBacklog(static_cast<size_t>(queued),
+                               static_cast<size_t>(capacity));
+    }
+    const ssize_t n = ::read(in, buffer.data(), buffer.size());
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    const int64_t arrivalUs = TimeSync::monotonicMicros();
+    size_t length = static_cast<size_t>(n);
+    if (profiles_ != nullptr && segmentState_ == DrivingState::Parked &&
+        profiles_->update() != DrivingState::Parked) {
+      cutRequested_ = true;
+    }
+    if (cutRequested_) {
+      // Stop before the next keyframe, so the segment ends cleanly and the
+      // next one starts with the new settings
+      const size_t header =
+          findSequenceHeader(buffer.data(), length, forwarded == 0 ? 1 : 0);
+      if (header < length) {
+        length = header;
+        open = false;
+      }
+    }
+    forwarded += length;
+    const uint64_t before = pictures.pictures();
+    pictures.feed(buffer.data(), length);
+    if (pictures.pictures() > before) {
+      if (lastPictureMonoUs_ != 0) {
+        const int64_t gapUs = arrivalUs - lastPictureMonoUs_;
+        pumpedMaxGapUs_ = std::max(pumpedMaxGapUs_, gapUs);
+        if (gapLimitUs > 0 && gapUs > gapLimitUs) {
+          ++pumpedGaps_;
+        }
+      }
+      lastPictureMonoUs_ = arrivalUs;
+    }
+    if (pictures.pictures() > before &&
+        arrivals.add(static_cast<int64_t>(pictures.pictures() - 1),
+                     arrivalUs) &&
+        arrivals.valid()) {
+      // Picture n arrives at start + n * interval
+      std::lock_guard<std::mutex> lk(mtx_);
+      pumpedStartMonoUs_ = arrivals.map(0);
+      liveTiming_.startUs = TimeSync::systemFromMonotonic(pumpedStartMonoUs_);
+      liveTiming_.frameIntervalNs =
+          static_cast<uint32_t>(std::llround(arrivals.slope() * 1000.0));
+    }
+    // A write blocks when the muxer falls behind, i.e. when its writes to
+    // the storage device stall
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < length;) {
+      const ssize_t written =
+          ::write(out, buffer.data() + done, length - done);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        open = false; // Muxer gone (EPIPE)
+        break;
+      }
+      done += static_cast<size_t>(written);
+    }
+    if (throttle_ != nullptr) {
+      throttle_->recordWriteLatency(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count());
+    }
+  }
+  ::close(in);
+  ::close(out);
+  // Read by capture() after joining this thread
+  pumpedBytes_ = forwarded;
+  pumpedFrames_ = pictures.pictures();
+}
+
+std::vector<SegmentHandle>
+VideoRecorder::getBufferedSegments(int minutesBack, int64_t triggerUs) {
+  TraceScope span("video", "buffered_segments"); // Mostly the lock wait
   std::lock_guard<std::mutex> lk(mtx_);
-  int numSegments = minutesBack * 60 / segmentSeconds_;
-  if (numSegments >
-      static_cast<int>(bufferFiles_.size())) // Fixed signed/unsigned comparison
-    numSegments = bufferFiles_.size();
-  return std::vector<std::string>(bufferFiles_.end() - numSegments,
-                                  bufferFiles_.end());
+  // Time-based rather than a segment count, since segments cut at a profile
+  // switch are shorter than segmentSeconds_
+  const int64_t atUs = triggerUs > 0 ? triggerUs : wallClockMicros();
+  const int64_t cutoffUs =
+      atUs - static_cast<int64_t>(minutesBack) * 60 * 1000000;
+  auto first = bufferFiles_.end();
+  while (first != bufferFiles_.begin() &&
+         (*(first - 1))->info().endUs > cutoffUs) {
+    --first;
+  }
+
+  std::vector<SegmentHandle> segments;
+  segments.reserve(static_cast<size_t>(bufferFiles_.end() - first));
+  for (auto it = first; it != bufferFiles_.end(); ++it) {
+    segments.emplace_back(*it);
+  }
+  // The segment being written holds the last seconds before the trigger;
+  // as fragmented MP4 it is readable up to its last complete fragment
+  if (minutesBack > 0 && liveSegment_ &&
+      liveSegment_->info().startUs <= atUs) {
+    segments.emplace_back(liveSegment_);
+  }
+  return segments;
 }
 
 void VideoRecorder::startPostTriggerRecording(int minutesForward,
                                               const std::string &eventType,
-                                              std::string &postFileOut) {
+                                              SegmentHandle &postFileOut,
+                                              int64_t triggerUs) {
+  TraceScope span("video", "start_post_trigger"); // Mostly the lock wait
   std::lock_guard<std::mutex> lk(mtx_);
-  postTriggerActive_ = true;
-  postTriggerSegmentsLeft_ = minutesForward * 60 / segmentSeconds_;
+  postTriggerActive_ = minutesForward > 0;
+  postTriggerUntilUs_ = (triggerUs > 0 ? triggerUs : wallClockMicros()) +
+                        static_cast<int64_t>(minutesForward) * 60 * 1000000;
   eventType_ = eventType;
-  postFileOut = postTriggerFile_;
+  if (segmentState_ == DrivingState::Parked) {
+    cutRequested_ = true; // Switch to full quality at the next keyframe
+  }
+  postFileOut = SegmentHandle(postTriggerFile_);
+}
+
+bool VideoRecorder::locateFrame(int64_t systemUs,
+                                FramePosition &position) const {
+  auto locate = [&](const std::string &path, const SegmentInfo &timing) {
+    if (systemUs < timing.startUs || timing.frameIntervalNs == 0 ||
+        timing.framerate == 0) {
+      return false;
+    }
+    position.path = path;
+    position.frame = static_cast<uint64_t>((systemUs - timing.startUs) *
+                                           1000 / timing.frameIntervalNs);
+    // The muxer stamps frame n with n / framerate
+    position.ptsUs =
+        static_cast<int64_t>(position.frame * 1000000 / timing.framerate);
+    return true;
+  };
+  SegmentHandle segment;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (liveSegment_ && systemUs >= liveSegment_->info().startUs) {
+      return locate(liveSegment_->path(), liveTiming_);
+    }
+    for (auto it = bufferFiles_.rbegin(); it != bufferFiles_.rend(); ++it) {
+      const SegmentInfo info = (*it)->info();
+      if (systemUs < info.endUs && locate(info.path, info)) {
+        segment = SegmentHandle(*it); // Pinned while its index is read
+        break;
+      }
+    }
+  }
+  if (!segment) {
+    return false;
+  }
+  try {
+    const FrameIndex index(segment.path());
+    const size_t frame = index.findSystemTime(systemUs);
+    if (frame < index.size()) {
+      position.frame = frame;
+      position.ptsUs = index[frame].ptsUs;
+      position.offset = index[frame].offset;
+      position.size = index[frame].size;
+      position.keyframePtsUs = index[index.keyframeBefore(frame)].ptsUs;
+    }
+  } catch (const std::exception &) {
+    // Not indexed; keep the position computed from the segment timing
+  }
+  return true;
+}
+
+SegmentHandle VideoRecorder::getLiveSegment() {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return SegmentHandle(liveSegment_);
+}
+
+bool VideoRecorder::evictSegment(const std::string &path) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  const auto it = std::find_if(
+      bufferFiles_.begin(), bufferFiles_.end(),
+      [&path](const std::shared_ptr<Segment> &s) { return s->path() == path; });
+  if (it == bufferFiles_.end()) {
+    return false;
+  }
+  auto segment = std::move(*it);
+  bufferFiles_.erase(it);
+  dropSegment(std::move(segment));
+  return true;
+}
+
+void VideoRecorder::dropSegment(std::shared_ptr<Segment> segment) {
+  const bool pinned = isPinnedLocked(segment->path());
+  std::cerr << "Removing old buffer file: " << segment->path()
+            << (pinned ? " (deferred, pinned)" : "") << std::endl;
+  manifest_.appendRemove(segment->path());
+  segment->retire();
+  detach(std::move(segment));
+  if (manifest_.removesSinceCompaction() > bufferCapacity()) {
+    std::vector<SegmentInfo> live;
+    for (const auto &s : bufferFiles_) {
+      live.push_back(s->info());
+    }
+    manifest_.compact(live);
+  }
+}
+
+bool VideoRecorder::isPinned(const std::string &path) const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return isPinnedLocked(path);
+}
+
+bool VideoRecorder::isPinnedLocked(const std::string &path) const {
+  auto matches = [&path](const std::shared_ptr<Segment> &segment) {
+    return segment && segment->pinned() && segment->path() == path;
+  };
+  return std::any_of(bufferFiles_.begin(), bufferFiles_.end(), matches) ||
+         std::any_of(detached_.begin(), detached_.end(), matches) ||
+         matches(postTriggerFile_) || matches(liveSegment_);
+}
+
+void VideoRecorder::detach(std::shared_ptr<Segment> segment) {
+  if (!segment) {
+    return;
+  }
+  // Forget detached segments whose pins are all released
+  detached_.erase(std::remove_if(detached_.begin(), detached_.end(),
+                                 [](const std::shared_ptr<Segment> &s) {
+                                   return !s->pinned();
+                                 }),
+                  detached_.end());
+  if (segment->pinned()) {
+    detached_.push_back(std::move(segment));
+  }
 }
\ No newline at end of file
@@ -5,11 +5,38 @@
 
 #pragma once
 #include "CANListener.hpp"
+#include "CopyEngine.hpp"
+#include "ExportThrottle.hpp"
+#include "FrameTap.hpp"
+#include "ProcessSupervisor.hpp"
+#include "ProfileSelector.hpp"
+#include "Segment.hpp"
+#include "SegmentManifest.hpp"
+#include "SignalAccumulator.hpp"
+#include "TimeSync.hpp"
+#include "VideoSource.hpp"
+#include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
 
+/**
+ * @struct FramePosition
+ * @brief Where an instant falls in the recorded video
+ */
+struct FramePosition {
+  std::string path;   ///< Segment file holding the frame
+  uint64_t frame = 0; ///< Frame number within the segment, from 0
+  int64_t ptsUs = 0;  ///< Presentation time of the frame in the file
+  uint64_t offset = 0; ///< Byte offset of the frame data (0 = not indexed)
+  uint32_t size = 0;   ///< Size of the frame data in bytes
+  int64_t keyframePtsUs = 0; ///< Presentation time of the keyframe decoding
+                             ///< has to start from
+};
+
 /**
  * @class VideoRecorder
  * @brief Manages continuous video recording with circular buffering and event
@@ -18,8 +45,34 @@
  * This class provides the core video recording functionality:
  * - Continuous segmented recording to maintain a rolling buffer
  * - Event-triggered video capture with pre/post trigger periods
- * - Thread-safe access to buffered video segments
+ * - Thread-safe access to buffered video segments through pinning handles
  * - Integration with CAN data for timestamping and metadata
+ * - Fragmented MP4 segments (one fragment per second) that are readable
+ *   while being written and survive power loss up to the last fragment
+ * - Crash-safe SegmentManifest journal, replayed at construction so the
+ *   pre-trigger history of a previous run is available immediately
+ * - Pluggable VideoSource (camera, synthetic test pattern or file replay)
+ * - Optional FrameTap publishing downscaled frames to shared memory
+ * - Per-segment CAN signal summaries stored with each manifest record
+ * - Capture processes launched through the ProcessSupervisor, with the
+ *   source's stdout piped straight into the muxer
+ * - Post-trigger copies made in the background by the CopyEngine, so the
+ *   recording loop never waits for them
+ * - The H.264 stream is pumped from the source to the muxer by the
+ *   recorder, which measures how long muxer writes block and how full the
+ *   source pipe gets; both feed the ExportThrottle
+ * - Optional speed-dependent recording profiles: each segment starts with
+ *   the settings of the current driving state, and a parked segment is cut
+ *   at the next keyframe as soon as the vehicle moves or a trigger fires,
+ *   so low-quality idle recording never delays full-quality footage
+ * - One recorder per camera: segment boundaries follow the wall-clock grid
+ *   of segmentSeconds, so recorders started independently produce
+ *   time-aligned segments, and each one reports its throughput and
+ *   dropped frames under its camera name
+ * - Frame timing: the arrival of every picture is fitted against
+ *   CLOCK_MONOTONIC, so each segment records when its first frame arrived
+ *   (in system and CAN time) and the measured frame interval, and
+ *   locateFrame() maps an instant to a frame and file timestamp
  *
  * @note Thread Safety: All public methods are thread-safe using internal
  * mutexes. The run() method should be executed in a dedicated thread.
@@ -32,11 +85,38 @@ public:
    * @param segmentSeconds Duration of each video segment in seconds
    * @param bufferMinutes Total buffer duration in minutes
    * @param canListener Pointer to CAN listener for metadata integration
+   * @param source Video source producing the H.264 stream (non-owning)
+   * @param supervisor Process supervisor running the capture pipeline
+   * (non-owning)
+   * @param copier Copy engine producing post-trigger copies (non-owning)
+   * @param settings Resolution, frame rate and bitrate requested from source
+   * @param tap Frame tap receiving downscaled frames (nullptr = disabled)
+   * @param tapFramerate Frames per second published to tap
+   * @param signals Accumulator summarizing CAN signals per segment
+   * (nullptr = no summaries)
+   * @param throttle Export throttle receiving write latency and backlog
+   * (nullptr = not reported)
+   * @param profiles Selector of per-segment capture settings (nullptr =
+   * always record with settings)
+   * @param camera Camera name used in logs and metric names
+   * @param timeSync Time base giving segments their CAN start time
+   * (nullptr = none)
    * @throws std::invalid_argument if any parameter is invalid
+   *
+   * @note Replays the segment manifest in bufferDir to rebuild the buffer;
+   * segments whose files are missing or torn are discarded.
    * @throws std::runtime_error if video capture initialization fails
    */
   explicit VideoRecorder(const std::string &bufferDir, int segmentSeconds,
-                         int bufferMinutes, CANListener *canListener);
+                         int bufferMinutes, CANListener *canListener,
+                         VideoSource *source, ProcessSupervisor *supervisor,
+                         CopyEngine *copier, const CaptureSettings &settings,
+                         FrameTapWriter *tap = nullptr, int tapFramerate = 0,
+                         SignalAccumulator *signals = nullptr,
+                         ExportThrottle *throttle = nullptr,
+                         ProfileSelector *profiles = nullptr,
+                         const std::string &camera = "front",
+                         const TimeSync *timeSync = nullptr);
 
   /**
    * @brief Main recording loop for continuous video capture
@@ -46,43 +126,222 @@ public:
   void run();
 
   /**
-   * @brief Retrieves list of buffered video segments for event processing
+   * @brief Retrieves buffered video segments for event processing
    * @param minutesBack Number of minutes of segments to retrieve
-   * @return Vector of segment filenames sorted chronologically
+   * @param triggerUs Wall-clock time of the trigger in microseconds (0 =
+   * now); one instant shared by all cameras keeps their clips aligned
+   * @return Handles to the segments that ended within minutesBack minutes
+   * before triggerUs, sorted chronologically, followed by the live segment
+   * if it started before triggerUs (its endUs is 0). Each handle pins
+   * its file against eviction until it is released.
    * @note Thread-safe: Can be called from trigger processing threads
    */
-  std::vector<std::string> getBufferedSegments(int minutesBack);
+  std::vector<SegmentHandle> getBufferedSegments(int minutesBack,
+                                                 int64_t triggerUs = 0);
 
   /**
    * @brief Initiates post-trigger recording for event capture
    * @param minutesForward Duration of post-trigger recording in minutes
+   *
+   * Post-trigger segments are recorded with the highway (full-quality)
+   * profile; a parked segment in progress is cut at its next keyframe.
    * @param eventType Type of event triggering the recording
-   * @param[out] postFileOut Filename of the post-trigger video file
+   * @param[out] postFileOut Handle to the post-trigger video file (empty if
+   * none has been recorded yet)
+   * @param triggerUs Wall-clock time of the trigger in microseconds (0 =
+   * now); post-trigger recording lasts until minutesForward after it
    * @note Thread-safe: Coordinates with main recording loop
    */
   void startPostTriggerRecording(int minutesForward,
                                  const std::string &eventType,
-                                 std::string &postFileOut);
+                                 SegmentHandle &postFileOut,
+                                 int64_t triggerUs = 0);
+
+  /**
+   * @brief Returns a handle to the segment currently being recorded
+   * @return Handle to the live segment, or an empty handle between segments
+   *
+   * Segments are written as fragmented MP4, so the live file can be read up
+   * to its last complete fragment (about one second behind capture).
+   * @note Thread-safe: Can be called from preview and export threads
+   */
+  SegmentHandle getLiveSegment();
+
+  /**
+   * @brief Checks whether a file is pinned by an outstanding SegmentHandle
+   * @param path Path of the file to check
+   * @return true if the file must not be evicted
+   * @note Thread-safe: Used as PinCheck by storage cleanup
+   */
+  bool isPinned(const std::string &path) const;
+
+  /**
+   * @brief Evicts a buffered segment ahead of the ring's own rotation
+   * @param path Path of the segment file
+   * @return false if the segment is not in this recorder's buffer
+   *
+   * Removes the segment from the buffer and records the removal in the
+   * manifest; the file is deleted once no handle pins it.
+   * @note Thread-safe: Used as SegmentEvictor by RetentionManager
+   */
+  bool evictSegment(const std::string &path);
+
+  /**
+   * @brief Finds the frame recorded at an instant
+   * @param systemUs Wall-clock time in microseconds since the epoch
+   * @param[out] position Segment, frame number and presentation time
+   * @return false if no buffered or live segment covers systemUs
+   *
+   * Uses the measured start and frame interval of the segment, so the
+   * result is exact to about one frame; the source's own capture latency
+   * (constant per camera) is not included. Finished segments are looked up
+   * in their frame index sidecar, which also gives the frame's byte range
+   * and the preceding keyframe.
+   * @note Thread-safe: Called from trigger threads
+   */
+  bool locateFrame(int64_t systemUs, FramePosition &position) const;
+
+  /** @brief Name of the recorded camera */
+  const std::string &camera() const { return camera_; }
 
 private:
   const std::string bufferDir_; ///< Directory for video segment storage
   const int segmentSeconds_;    ///< Duration per segment in seconds
   const int bufferMinutes_;     ///< Total buffer duration in minutes
 
-  std::vector<std::string> bufferFiles_; ///< List of current buffer files
-  std::mutex mtx_;                       ///< Mutex for thread synchronization
+  std::deque<std::shared_ptr<Segment>>
+      bufferFiles_; ///< Current buffer segments, oldest first
+  std::vector<std::shared_ptr<Segment>>
+      detached_;          ///< Segments dropped by the recorder but still pinned
+  mutable std::mutex mtx_; ///< Mutex for thread synchronization
   std::condition_variable cv_; ///< Condition variable for coordination
 
   // Post-trigger recording state
   bool postTriggerActive_;      ///< Flag indicating post-trigger recording in
                                 ///< progress
-  int postTriggerSegmentsLeft_; ///< Remaining segments for post-trigger
+  int64_t postTriggerUntilUs_;  ///< Wall-clock end of post-trigger
                                 ///< recording
   std::string eventType_;       ///< Current event type being recorded
-  std::string postTriggerFile_; ///< Output filename for post-trigger video
+  std::shared_ptr<Segment>
+      postTriggerFile_; ///< Most recent post-trigger video segment
+  std::shared_ptr<Segment> liveSegment_; ///< Segment being recorded
 
   CANListener *const canListener_; ///< Pointer to CAN listener for metadata
+  VideoSource *const source_;      ///< Backend producing the video stream
+  ProcessSupervisor *const supervisor_; ///< Runs the capture processes
+  CopyEngine *const copier_;       ///< Copies post-trigger segments
+  const CaptureSettings settings_; ///< Capture parameters passed to source_
+  FrameTapWriter *const tap_;      ///< Frame tap, or nullptr
+  const int tapFramerate_;         ///< Frames per second published to tap_
+  SignalAccumulator *const signals_; ///< Per-segment summaries, or nullptr
+  ExportThrottle *const throttle_; ///< Receives I/O pressure, or nullptr
+  ProfileSelector *const profiles_; ///< Per-segment settings, or nullptr
+  DrivingState segmentState_ =
+      DrivingState::Highway; ///< Profile of the live segment (mtx_)
+  std::atomic<bool> cutRequested_{false}; ///< End the live segment at its
+                                          ///< next keyframe
+  SegmentManifest manifest_;       ///< Durable journal of buffered segments
+  const std::string camera_;       ///< Camera name for logs and metrics
+  const TimeSync *const timeSync_; ///< CAN time base, or nullptr
+  uint64_t pumpedBytes_ = 0;  ///< Bytes forwarded by the last pump()
+  uint64_t pumpedFrames_ = 0; ///< Pictures forwarded by the last pump()
+  int64_t pumpedStartMonoUs_ = 0; ///< Fitted arrival of the first picture
+                                  ///< of the last pump() (0 = unknown)
+  int64_t pumpedMaxGapUs_ = 0; ///< Longest wait for a picture in the last
+                               ///< pump(), from the one before it
+  uint64_t pumpedGaps_ = 0;    ///< Waits in the last pump() longer than
+                               ///< FRAME_GAP_INTERVALS frame intervals
+  int64_t lastPictureMonoUs_ = 0; ///< Arrival of the latest picture, kept
+                                  ///< across segments (pump() only)
+  SegmentInfo liveTiming_; ///< startUs, frameIntervalNs and framerate of
+                           ///< the live segment as fitted so far (mtx_)
+
+  /**
+   * @brief Rebuilds bufferFiles_ from the manifest after a restart
+   * @note Called once from the constructor
+   */
+  void recoverBuffer();
+
+  /** @brief Maximum number of segments kept in the ring */
+  size_t bufferCapacity() const;
+
+  /** @brief isPinned() for callers already holding mtx_ */
+  bool isPinnedLocked(const std::string &path) const;
+
+  /**
+   * @brief Retires a segment dropped from bufferFiles_ and journals it
+   * @note Caller must hold mtx_
+   */
+  void dropSegment(std::shared_ptr<Segment> segment);
+
+  /**
+   * @brief Keeps a segment visible to isPinned() until its pins are released
+   * @note Caller must hold mtx_
+   */
+  void detach(std::shared_ptr<Segment> segment);
+
+  /**
+   * @brief Publishes a finished post-trigger copy as postTriggerFile_
+   * @param postInfo Metadata of the copy
+   * @param error 0 or the errno value of a failed copy
+   * @note Runs on a CopyEngine thread
+   */
+  void onPostTriggerCopied(const SegmentInfo &postInfo, int error);
+
+  /**
+   * @brief Copies the H.264 stream from the source to the muxer
+   * @param in Read end of the source's stdout pipe; closed on return
+   * @param out Write end of the muxer's stdin pipe; closed on return
+   *
+   * Reports the time each write blocks and the source pipe's fill level to
+   * the throttle, and samples the profile selector. Returns at end of
+   * stream, when the muxer exits, or at the first keyframe after a cut was
+   * requested. Counts the forwarded bytes and pictures into pumpedBytes_
+   * and pumpedFrames_, fits the pictures' arrival times into liveTiming_
+   * and pumpedStartMonoUs_, and measures the gaps between arrivals, the
+   * one across the segment boundary included.
+   */
+  void pump(int in, int out);
+
+  /** @brief Builds the ffmpeg command remuxing the source into file */
+  std::vector<std::string>
+  muxerCommand(const std::string &file,
+               const CaptureSettings &settings) const;
+
+  /**
+   * @brief Milliseconds from now to the next segment boundary
+   *
+   * Boundaries lie on multiples of segmentSeconds_ since the epoch; a
+   * remainder shorter than MIN_SEGMENT_MS is joined to the next segment.
+   */
+  int alignedDurationMs() const;
+
+  /**
+   * @brief Records one segment into file
+   * @param file Output path of the segment
+   * @param settings Capture settings of the segment
+   * @param durationMs Length of the segment in milliseconds
+   * @return 0 if both the source and the muxer succeeded (the source may
+   * fail after a cut)
+   *
+   * With a frame tap, the muxer's stdout carries raw BGR frames which are
+   * published as they arrive.
+   */
+  int capture(const std::string &file, const CaptureSettings &settings,
+              int durationMs);
 
   static constexpr int MAX_BUFFER_FILES =
       60; ///< Maximum files in circular buffer
+  static constexpr size_t PUMP_CHUNK_BYTES =
+      64 * 1024; ///< Largest read from the source pipe
+  static constexpr int CAPTURE_TIMEOUT_SLACK_MS =
+      15000; ///< Allowed overrun of a capture process past the segment length
+  static constexpr int MIN_SEGMENT_MS =
+      2000; ///< Shortest segment recorded to reach the next boundary
+  static constexpr size_t MAX_FIT_PICTURES =
+      8192; ///< Picture arrivals fitted per segment
+  static constexpr double PICTURE_MIN_REJECT_US =
+      50000.0; ///< Arrival jitter always accepted by the picture fit
+  static constexpr int FRAME_GAP_INTERVALS =
+      3; ///< Wait for a picture, in frame intervals, counted as a gap
 };
\ No newline at end of file
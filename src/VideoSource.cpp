@@ -0,0 +1,151 @@
+#include "VideoSource.hpp"
+#include "utils.hpp"
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::string seconds(double value) {
+  std::ostringstream ss;
+  ss.precision(3);
+  ss << std::fixed << value;
+  return ss.str();
+}
+
+/// Encoder arguments shared by the ffmpeg-based sources
+void appendX264Output(std::vector<std::string> &argv,
+                      const CaptureSettings &settings) {
+  const std::string fps = std::to_string(settings.framerate);
+  const std::vector<std::string> output = {
+      "-vf",
+      "scale=" + std::to_string(settings.width) + ":" +
+          std::to_string(settings.height) + ",fps=" + fps,
+      "-c:v", "libx264", "-preset", "ultrafast", "-tune", "zerolatency",
+      "-pix_fmt", "yuv420p", "-x264-params", "repeat-headers=1", "-g", fps,
+      "-b:v", std::to_string(settings.bitrate), "-f", "h264", "-"};
+  argv.insert(argv.end(), output.begin(), output.end());
+}
+
+} // namespace
+
+LibcameraSource::LibcameraSource(int cameraIndex) : cameraIndex_(cameraIndex) {
+  if (cameraIndex < 0) {
+    throw std::invalid_argument("Camera index cannot be negative");
+  }
+}
+
+std::vector<std::string>
+LibcameraSource::captureCommand(int durationMs,
+                                const CaptureSettings &settings) {
+  const std::string fps = std::to_string(settings.framerate);
+  return {"libcamera-vid",
+          "--nopreview",
+          "--camera",
+          std::to_string(cameraIndex_),
+          "-t",
+          std::to_string(durationMs),
+          "--codec",
+          "h264",
+          "--inline",
+          "--width",
+          std::to_string(settings.width),
+          "--height",
+          std::to_string(settings.height),
+          "--framerate",
+          fps,
+          "--intra",
+          fps,
+          "--bitrate",
+          std::to_string(settings.bitrate),
+          "-o",
+          "-"};
+}
+
+TestPatternSource::TestPatternSource(const std::string &pattern)
+    : pattern_(pattern) {
+  if (pattern.empty()) {
+    throw std::invalid_argument("Test pattern name cannot be empty");
+  }
+}
+
+std::vector<std::string>
+TestPatternSource::captureCommand(int durationMs,
+                                  const CaptureSettings &settings) {
+  std::vector<std::string> argv = {
+      "ffmpeg", "-hide_banner", "-loglevel", "error", "-re", "-f", "lavfi",
+      "-i",
+      pattern_ + "=size=" + std::to_string(settings.width) + "x" +
+          std::to_string(settings.height) +
+          ":rate=" + std::to_string(settings.framerate),
+      "-t", seconds(durationMs / 1000.0)};
+  appendX264Output(argv, settings);
+  return argv;
+}
+
+FileReplaySource::FileReplaySource(const std::string &file, double speed,
+                                   ProcessSupervisor *supervisor)
+    : file_(file), speed_(speed) {
+  if (file.empty()) {
+    throw std::invalid_argument("Replay file cannot be empty");
+  }
+  if (!(speed > 0.0)) {
+    throw std::invalid_argument("Replay speed must be positive");
+  }
+  if (supervisor == nullptr) {
+    throw std::invalid_argument("Process supervisor cannot be null");
+  }
+
+  // Probe the duration once so replay can wrap around at the end
+  SpawnOptions options;
+  options.job = "ffprobe";
+  options.captureStdout = true;
+  options.timeoutMs = PROBE_TIMEOUT_MS;
+  const ProcessResult probe = supervisor->run(
+      {"ffprobe", "-v", "error", "-show_entries", "format=duration", "-of",
+       "default=noprint_wrappers=1:nokey=1", file},
+      options);
+  if (probe.ok() && !(std::istringstream(probe.output) >> durationSeconds_)) {
+    durationSeconds_ = 0.0;
+  }
+  if (durationSeconds_ <= 0.0) {
+    std::cerr << "Warning: Cannot determine duration of " << file
+              << "; replay will restart from the beginning" << std::endl;
+  }
+}
+
+std::vector<std::string>
+FileReplaySource::captureCommand(int durationMs,
+                                 const CaptureSettings &settings) {
+  const double span = durationMs / 1000.0 * speed_;
+  std::vector<std::string> argv = {"ffmpeg",   "-hide_banner", "-loglevel",
+                                   "error",    "-stream_loop", "-1",
+                                   "-readrate", seconds(speed_), "-ss",
+                                   seconds(positionSeconds_), "-i", file_,
+                                   "-t",       seconds(span),  "-an"};
+  appendX264Output(argv, settings);
+
+  positionSeconds_ += span;
+  if (durationSeconds_ > 0.0) {
+    positionSeconds_ = std::fmod(positionSeconds_, durationSeconds_);
+  } else {
+    positionSeconds_ = 0.0;
+  }
+  return argv;
+}
+
+std::unique_ptr<VideoSource> makeVideoSource(const CameraConfig &camera,
+                                             ProcessSupervisor *supervisor) {
+  if (camera.videoSource == "libcamera") {
+    return std::make_unique<LibcameraSource>(camera.cameraIndex);
+  }
+  if (camera.videoSource == "testpattern") {
+    return std::make_unique<TestPatternSource>(camera.testPattern);
+  }
+  if (camera.videoSource == "file") {
+    return std::make_unique<FileReplaySource>(
+        camera.replayFile, camera.replaySpeed, supervisor);
+  }
+  throw std::invalid_argument("Unknown video_source: " + camera.videoSource);
+}
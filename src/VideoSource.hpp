@@ -0,0 +1,143 @@
+/**
+ * @file VideoSource.hpp
+ * @brief Pluggable video sources producing the raw H.264 capture stream
+ */
+
+#pragma once
+#include "ProcessSupervisor.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+struct CameraConfig;
+
+/**
+ * @struct CaptureSettings
+ * @brief Encoder parameters requested from a video source
+ */
+struct CaptureSettings {
+  int width = 1920;        ///< Frame width in pixels
+  int height = 1080;       ///< Frame height in pixels
+  int framerate = 30;      ///< Frames per second; also the keyframe interval
+  int bitrate = 8000000;   ///< Target bitrate in bits per second
+};
+
+/**
+ * @class VideoSource
+ * @brief Interface for backends that capture or synthesize video
+ *
+ * A source describes a command that writes a raw H.264 (Annex B) elementary
+ * stream to stdout for a given duration, with SPS/PPS repeated inline and a
+ * keyframe every `framerate` frames. VideoRecorder pipes that stream into its
+ * segment writer, so all backends share the same buffer, trigger and export
+ * paths.
+ *
+ * @note Implementations may keep state between segments (e.g. replay
+ * position); captureCommand() is only called from the recording thread.
+ */
+class VideoSource {
+public:
+  virtual ~VideoSource() = default;
+
+  /** @brief Short backend name for logging ("libcamera", "testpattern", ...) */
+  virtual std::string name() const = 0;
+
+  /**
+   * @brief Builds the argv of the next capture process
+   * @param durationMs Length of the segment to produce in milliseconds
+   * @param settings Requested resolution, frame rate and bitrate
+   * @return Command and arguments; argv[0] is looked up in PATH
+   */
+  virtual std::vector<std::string>
+  captureCommand(int durationMs, const CaptureSettings &settings) = 0;
+};
+
+/**
+ * @class LibcameraSource
+ * @brief Captures from a Raspberry Pi camera through libcamera-vid
+ */
+class LibcameraSource final : public VideoSource {
+public:
+  /**
+   * @brief Constructs a libcamera source
+   * @param cameraIndex Index of the camera as listed by libcamera-vid
+   * @throws std::invalid_argument if cameraIndex is negative
+   */
+  explicit LibcameraSource(int cameraIndex);
+
+  std::string name() const override { return "libcamera"; }
+  std::vector<std::string>
+  captureCommand(int durationMs, const CaptureSettings &settings) override;
+
+private:
+  const int cameraIndex_; ///< libcamera camera index
+};
+
+/**
+ * @class TestPatternSource
+ * @brief Synthesizes a moving test pattern with ffmpeg's lavfi input
+ *
+ * Runs in real time (-re) and encodes with libx264, so the whole pipeline can
+ * be exercised and profiled on machines without a camera.
+ */
+class TestPatternSource final : public VideoSource {
+public:
+  /**
+   * @brief Constructs a test-pattern source
+   * @param pattern lavfi source name (e.g. "testsrc2", "smptebars")
+   * @throws std::invalid_argument if pattern is empty
+   */
+  explicit TestPatternSource(const std::string &pattern);
+
+  std::string name() const override { return "testpattern"; }
+  std::vector<std::string>
+  captureCommand(int durationMs, const CaptureSettings &settings) override;
+
+private:
+  const std::string pattern_; ///< lavfi source filter name
+};
+
+/**
+ * @class FileReplaySource
+ * @brief Replays an existing video file, looping at its end
+ *
+ * Each segment continues where the previous one stopped. With a speed above
+ * 1.0 the file is read and encoded faster than real time, so a segment holds
+ * speed times as many frames; this is meant for load testing.
+ */
+class FileReplaySource final : public VideoSource {
+public:
+  /**
+   * @brief Constructs a replay source
+   * @param file Path of the video file to replay
+   * @param speed Replay speed relative to real time (> 0)
+   * @param supervisor Runs ffprobe to determine the file duration
+   * @throws std::invalid_argument if file is empty, speed is not positive or
+   * supervisor is null
+   */
+  explicit FileReplaySource(const std::string &file, double speed,
+                            ProcessSupervisor *supervisor);
+
+  std::string name() const override { return "file"; }
+  std::vector<std::string>
+  captureCommand(int durationMs, const CaptureSettings &settings) override;
+
+private:
+  const std::string file_;        ///< File being replayed
+  const double speed_;            ///< Replay speed factor
+  double positionSeconds_ = 0.0;  ///< Start of the next segment in the file
+  double durationSeconds_ = 0.0;  ///< File duration (0 if unknown)
+
+  static constexpr int PROBE_TIMEOUT_MS =
+      10000; ///< Time limit for probing the file duration
+};
+
+/**
+ * @brief Creates the video source of a camera
+ * @param camera Camera settings (source backend and related keys)
+ * @param supervisor Process supervisor used by sources that probe their input
+ * @return Newly created source
+ * @throws std::invalid_argument if the camera names an unknown backend
+ */
+std::unique_ptr<VideoSource> makeVideoSource(const CameraConfig &camera,
+                                             ProcessSupervisor *supervisor);
@@ -1,55 +1,630 @@
 #include "CANListener.hpp"
+#include "ArchiveTranscoder.hpp"
 #include "CSVLogger.hpp"
+#include "CanFrameRing.hpp"
+#include "CanTraceWriter.hpp"
+#include "CopyEngine.hpp"
+#include "EventExporter.hpp"
+#include "EventProcessor.hpp"
+#include "ExportThrottle.hpp"
 #include "FileManager.hpp"
+#include "FrameTap.hpp"
+#include "Metrics.hpp"
+#include "MotionDetector.hpp"
+#include "OffloadManager.hpp"
 #include "OverlayRenderer.hpp"
+#include "PipelineRing.hpp"
 #include "PreviewManager.hpp"
+#include "ProcessSupervisor.hpp"
+#include "ProfileSelector.hpp"
+#include "RetentionManager.hpp"
+#include "SignalAccumulator.hpp"
 #include "StorageManager.hpp"
+#include "ThreadProfile.hpp"
+#include "TimeSync.hpp"
+#include "Tracer.hpp"
 #include "TriggerManager.hpp"
 #include "VideoRecorder.hpp"
+#include "VideoSource.hpp"
 #include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <sys/prctl.h>
 #include <sys/stat.h>
 #include <thread>
+#include <vector>
+
+namespace {
+
+/// Metrics and trace file of the event processor: "logs/metrics.prom" ->
+/// "logs/metrics.processor.prom"
+std::string processorPath(const std::string &path) {
+  if (path.empty()) {
+    return path;
+  }
+  const std::filesystem::path p(path);
+  return (p.parent_path() / (p.stem().string() + ".processor" +
+                             p.extension().string()))
+      .string();
+}
+
+/// Delays before the event processor is restarted
+constexpr int PROCESSOR_BACKOFF_MIN_SECONDS = 1;
+constexpr int PROCESSOR_BACKOFF_MAX_SECONDS = 30;
+
+/// Runs `dacl --processor` and restarts it whenever it exits
+void superviseProcessor(ProcessSupervisor *supervisor) {
+  const std::string self =
+      std::filesystem::read_symlink("/proc/self/exe").string();
+  auto &restarts = Metrics::instance().value("dacl_processor_restarts_total");
+  std::chrono::seconds backoff(PROCESSOR_BACKOFF_MIN_SECONDS);
+  while (true) {
+    SpawnOptions options;
+    options.job = "processor";
+    ChildProcess child = supervisor->spawn({self, "--processor"}, options);
+    if (child) {
+      const ProcessResult result = supervisor->wait(child);
+      std::cerr << "Warning: Event processor exited (code "
+                << result.exitCode << ", signal " << result.signal
+                << "), restarting" << std::endl;
+      ++restarts;
+      // One that ran for a while failed on its own, not on startup
+      if (result.wallSeconds > PROCESSOR_BACKOFF_MAX_SECONDS) {
+        backoff = std::chrono::seconds(PROCESSOR_BACKOFF_MIN_SECONDS);
+      }
+    }
+    std::this_thread::sleep_for(backoff);
+    backoff = std::min(backoff * 2,
+                       std::chrono::seconds(PROCESSOR_BACKOFF_MAX_SECONDS));
+  }
+}
+
+/// Staging directory of the pipeline; in the buffer, so that segments are
+/// linked rather than copied, and skipped by the buffer scans
+std::string stagingDir(const Config &config) {
+  return config.bufferDir + "/" + PIPELINE_STAGING_DIR;
+}
+
+/// Signals taken by dedicated threads instead of handlers
+struct SignalSets {
+  sigset_t shutdown; ///< SIGINT/SIGTERM, for the shutdown thread
+  sigset_t trace;    ///< SIGUSR1, for the trace thread
+};
+
+/// Blocks the shutdown (and with tracing, trace) signals in every thread
+/// started afterwards and enables tracing; children get default
+/// dispositions from the supervisor
+SignalSets blockSignals(const Config &config) {
+  SignalSets sets;
+  sigemptyset(&sets.shutdown);
+  sigaddset(&sets.shutdown, SIGINT);
+  sigaddset(&sets.shutdown, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sets.shutdown, nullptr);
+  sigemptyset(&sets.trace);
+  sigaddset(&sets.trace, SIGUSR1);
+  if (config.traceSpans > 0) {
+    Tracer::instance().enable(static_cast<size_t>(config.traceSpans));
+    pthread_sigmask(SIG_BLOCK, &sets.trace, nullptr);
+  }
+  // A muxer that exits early must not take the recorder down with EPIPE
+  std::signal(SIGPIPE, SIG_IGN);
+  return sets;
+}
+
+/// Profile of a role, or the default profile if thread_<role> is not set
+ThreadProfile profileOf(const std::map<std::string, ThreadProfile> &profiles,
+                        const std::string &role) {
+  const auto it = profiles.find(role);
+  return it == profiles.end() ? ThreadProfile() : it->second;
+}
+
+/// Profiles with a built-in profile for role unless thread_<role> is set
+std::map<std::string, ThreadProfile>
+withDefaultProfile(const std::map<std::string, ThreadProfile> &profiles,
+                   const std::string &role, const std::string &spec) {
+  auto result = profiles;
+  if (!result.count(role)) {
+    result[role] = ThreadProfile::parse(spec);
+  }
+  return result;
+}
+
+/// Copy engine settings of the configuration
+CopyOptions copyOptions(const Config &config) {
+  CopyOptions options;
+  options.backend = config.copyEngine;
+  options.inFlightBytes = static_cast<size_t>(config.copyInflightMB) << 20;
+  options.chunkBytes = static_cast<size_t>(config.copyChunkKB) << 10;
+  options.directIo = config.copyDirectIo;
+  return options;
+}
+
+/// Child processes and throttled export I/O, set up alike by the capture
+/// daemon and the event processor
+struct ExportIo {
+  ExportIo(const Config &config,
+           const std::map<std::string, ThreadProfile> &profiles)
+      : throttle(config.exportLatencyTargetMs, config.exportMinMBps,
+                 config.exportMaxMBps,
+                 copyOptions(config).inFlightBytes /
+                     copyOptions(config).chunkBytes,
+                 &supervisor),
+        copyEngine(copyOptions(config), profileOf(profiles, "copy"),
+                   &throttle) {}
+
+  /// Starts the supervisor's watchdog and, if runThrottle is set, the
+  /// throttle's control loop
+  void start(const std::map<std::string, ThreadProfile> &profiles,
+             bool runThrottle) {
+    supervisorThread = startThread(
+        profiles, "supervisor",
+        static_cast<void (ProcessSupervisor::*)()>(&ProcessSupervisor::run),
+        &supervisor);
+    if (runThrottle) {
+      throttleThread = startThread(profiles, "throttle", &ExportThrottle::run,
+                                   &throttle);
+    }
+  }
+
+  /// Terminates the children and joins the threads of start()
+  void stop() {
+    supervisor.terminateAll();
+    throttle.stop();
+    if (supervisorThread.joinable()) {
+      supervisorThread.join();
+    }
+    if (throttleThread.joinable()) {
+      throttleThread.join();
+    }
+  }
+
+  ProcessSupervisor supervisor; ///< Exports, capture and the processor
+  ExportThrottle throttle;      ///< Back-pressure from the recorders
+  CopyEngine copyEngine;        ///< Throttled segment copies
+  std::thread supervisorThread; ///< Runs ProcessSupervisor::run()
+  std::thread throttleThread;   ///< Runs ExportThrottle::run(), if started
+};
+
+/// Stops the export processes and threads, flushes the event log and
+/// writes the final metrics and trace on SIGINT/SIGTERM; the worker threads
+/// loop forever, so the process exits from here
+std::thread startShutdownThread(const SignalSets &signals,
+                                const std::string &process, ExportIo &io,
+                                CSVLogger *csvLogger,
+                                const std::string &metricsFile,
+                                const std::string &traceFile) {
+  return std::thread([=, &io] {
+    int sig = 0;
+    sigwait(&signals.shutdown, &sig);
+    std::cerr << process << " received signal " << sig << ", shutting down"
+              << std::endl;
+    io.stop();
+    if (csvLogger != nullptr) {
+      csvLogger->flush();
+    }
+    if (!metricsFile.empty()) {
+      Metrics::instance().writeTo(metricsFile);
+    }
+    if (Tracer::enabled()) {
+      Tracer::instance().writeTo(traceFile);
+    }
+    std::_Exit(EXIT_SUCCESS);
+  });
+}
+
+/// Writes the trace on SIGUSR1; not started unless tracing is enabled
+std::thread startTraceWriter(const SignalSets &signals,
+                             const std::string &traceFile) {
+  if (!Tracer::enabled()) {
+    return std::thread();
+  }
+  return std::thread([=] {
+    while (true) {
+      int sig = 0;
+      sigwait(&signals.trace, &sig);
+      if (Tracer::instance().writeTo(traceFile)) {
+        std::cerr << "Trace written to " << traceFile << std::endl;
+      } else {
+        std::cerr << "Warning: Cannot write trace to " << traceFile
+                  << std::endl;
+      }
+    }
+  });
+}
+
+/// Writes the metrics file periodically; not started without one
+std::thread
+startMetricsWriter(const std::map<std::string, ThreadProfile> &profiles,
+                   const std::string &metricsFile, int intervalSeconds) {
+  if (metricsFile.empty()) {
+    return std::thread();
+  }
+  return startThread(profiles, "metrics", &Metrics::run, &Metrics::instance(),
+                     metricsFile, intervalSeconds);
+}
+
+/// Archive transcoder of the configuration, or nullptr if archiving is off
+std::unique_ptr<ArchiveTranscoder>
+makeArchiveTranscoder(const Config &config, const SpeedSource &vehicleSpeed,
+                      ProcessSupervisor *supervisor,
+                      const BusyCheck &exportsBusy) {
+  if (config.archiveAfterDays <= 0) {
+    return nullptr;
+  }
+  ArchiveSettings settings;
+  settings.afterDays = config.archiveAfterDays;
+  settings.bitrate = config.archiveBitrate;
+  settings.height = config.archiveHeight;
+  settings.encoder = config.archiveEncoder;
+  return std::make_unique<ArchiveTranscoder>(config.eventDir, settings,
+                                             vehicleSpeed, supervisor,
+                                             exportsBusy);
+}
+
+/// Offload manager of the configuration, or nullptr if offloading is off
+std::unique_ptr<OffloadManager>
+makeOffloadManager(const Config &config, ExportThrottle *throttle,
+                   const BusyCheck &exportsBusy) {
+  if (config.offloadUrl.empty()) {
+    return nullptr;
+  }
+  OffloadSettings settings;
+  settings.url = config.offloadUrl;
+  settings.concurrency = config.offloadConcurrency;
+  settings.maxKBps = config.offloadMaxKBps;
+  return std::make_unique<OffloadManager>(
+      config.eventDir, settings, parseCriticalWarnings(config.criticalWarnings),
+      throttle, exportsBusy);
+}
+
+/// Re-encoding runs at idle CPU and I/O priority unless thread_archive says
+/// otherwise; its ffmpeg jobs inherit the profile
+std::thread
+startArchiveThread(const std::map<std::string, ThreadProfile> &profiles,
+                   ArchiveTranscoder *archiveTranscoder) {
+  if (archiveTranscoder == nullptr) {
+    return std::thread();
+  }
+  return startThread(withDefaultProfile(
+                         profiles, "archive",
+                         ArchiveTranscoder::DEFAULT_THREAD_PROFILE),
+                     "archive", &ArchiveTranscoder::run, archiveTranscoder);
+}
+
+/// Uploads run at low CPU and idle I/O priority unless thread_offload says
+/// otherwise; the chunk workers inherit the profile
+std::thread
+startOffloadThread(const std::map<std::string, ThreadProfile> &profiles,
+                   OffloadManager *offloadManager) {
+  if (offloadManager == nullptr) {
+    return std::thread();
+  }
+  return startThread(withDefaultProfile(profiles, "offload",
+                                        OffloadManager::DEFAULT_THREAD_PROFILE),
+                     "offload", &OffloadManager::run, offloadManager);
+}
+
+/**
+ * @brief Event processor of pipeline=split (`dacl --processor`)
+ *
+ * Started by the capture daemon; runs the exports, archiving and offloading
+ * for the events the daemon publishes, and exits with the daemon.
+ */
+int runProcessor(const Config &config,
+                 const std::map<std::string, ThreadProfile> &profiles) {
+  // Ends with the daemon even if the daemon is killed
+  ::prctl(PR_SET_PDEATHSIG, SIGTERM);
+  std::filesystem::create_directories(config.eventDir);
+  std::filesystem::create_directories("logs");
+
+  const SignalSets signals = blockSignals(config);
+  const std::string metricsFile = processorPath(config.metricsFile);
+  const std::string traceFile = processorPath(config.traceFile);
+
+  ExportIo exportIo(config, profiles);
+  FileManager fileManager(config.bufferDir, config.eventDir,
+                          &exportIo.supervisor, &exportIo.copyEngine,
+                          &exportIo.throttle);
+  CSVLogger csvLogger("logs/events.csv", "logs/events.idx");
+  OverlayRenderer overlayRenderer; // Vehicle state comes with the events
+  EventExporter eventExporter(&fileManager, &csvLogger, &overlayRenderer,
+                              config.canIface, config.eventBundle);
+  PipelineReader pipelineReader(config.pipelineShm);
+  EventProcessor eventProcessor(&pipelineReader, &eventExporter,
+                                stagingDir(config), &exportIo.throttle);
+  const BusyCheck exportsBusy = [&eventProcessor] {
+    return eventProcessor.busy();
+  };
+  auto archiveTranscoder = makeArchiveTranscoder(
+      config, [&eventProcessor] { return eventProcessor.vehicleSpeed(); },
+      &exportIo.supervisor, exportsBusy);
+  auto offloadManager =
+      makeOffloadManager(config, &exportIo.throttle, exportsBusy);
+
+  // ffmpeg exports run in the events thread and inherit its profile
+  std::thread eventsThread = startThread(profiles, "events",
+                                         &EventProcessor::run, &eventProcessor);
+  exportIo.start(profiles, true);
+  std::thread shutdownThread =
+      startShutdownThread(signals, "Event processor", exportIo, &csvLogger,
+                          metricsFile, traceFile);
+  std::thread traceThread = startTraceWriter(signals, traceFile);
+  std::thread metricsThread = startMetricsWriter(
+      profiles, metricsFile, config.metricsIntervalSeconds);
+  std::thread archiveThread =
+      startArchiveThread(profiles, archiveTranscoder.get());
+  std::thread offloadThread =
+      startOffloadThread(profiles, offloadManager.get());
+
+  eventsThread.join();
+  if (metricsThread.joinable())
+    metricsThread.join();
+  if (traceThread.joinable())
+    traceThread.join();
+  if (archiveThread.joinable())
+    archiveThread.join();
+  if (offloadThread.joinable())
+    offloadThread.join();
+  shutdownThread.join();
+
+  return 0;
+}
+
+} // namespace
 
 int main(int argc, char *argv[]) {
-  bool enablePreview = (argc > 1 && std::string(argv[1]) == "--preview");
+  const std::string mode = argc > 1 ? argv[1] : "";
+  bool enablePreview = (mode == "--preview");
 
   Config config("configs/config.ini");
+  const auto profiles = parseThreadProfiles(config.threadProfiles);
+  if (mode == "--processor") {
+    return runProcessor(config, profiles);
+  }
   auto idToWarning = parseCANWarnings(config.warningIds);
+  const bool split = (config.pipeline == "split");
 
   std::filesystem::create_directories(config.bufferDir);
+  for (const auto &camera : config.cameras) {
+    std::filesystem::create_directories(camera.bufferDir);
+  }
   std::filesystem::create_directories(config.eventDir);
   std::filesystem::create_directories("logs");
 
-  CANListener canListener(config.canIface, idToWarning);
-  VideoRecorder videoRecorder(config.bufferDir, config.segmentSeconds,
-                              config.bufferMinutes, &canListener);
-  OverlayRenderer overlayRenderer(&canListener); // Pass CANListener instance
-  FileManager fileManager(config.bufferDir, config.eventDir);
-  CSVLogger csvLogger("logs/events.csv");
+  const SignalSets signals = blockSignals(config);
+
+  ExportIo exportIo(config, profiles);
+  ProcessSupervisor &processSupervisor = exportIo.supervisor;
+  ExportThrottle &exportThrottle = exportIo.throttle;
+  CopyEngine &copyEngine = exportIo.copyEngine;
+  SignalAccumulator signalAccumulator;
+  TimeSync timeSync;
+  // With pipeline=split the CAN history lives in the pipeline's shared
+  // memory, where the event processor reads it
+  std::unique_ptr<PipelineWriter> pipeline;
+  std::unique_ptr<CanFrameRing> localCanFrames;
+  if (split) {
+    pipeline = std::make_unique<PipelineWriter>(
+        config.pipelineShm, static_cast<size_t>(config.canRingFrames),
+        stagingDir(config), &exportThrottle);
+  } else {
+    localCanFrames = std::make_unique<CanFrameRing>(
+        static_cast<size_t>(config.canRingFrames));
+  }
+  CanFrameRing *canFrames =
+      split ? pipeline->canFrames() : localCanFrames.get();
+  CANListener canListener(config.canIface, idToWarning, &signalAccumulator,
+                          &timeSync, canFrames);
+  // One source, tap, profile selector and recorder per camera
+  std::vector<std::unique_ptr<VideoSource>> videoSources;
+  std::vector<std::unique_ptr<FrameTapWriter>> frameTaps;
+  std::vector<std::unique_ptr<ProfileSelector>> profileSelectors;
+  std::vector<std::unique_ptr<VideoRecorder>> videoRecorders;
+  std::vector<VideoRecorder *> recorders;
+  for (const auto &camera : config.cameras) {
+    videoSources.push_back(makeVideoSource(camera, &processSupervisor));
+    CaptureSettings captureSettings;
+    captureSettings.width = camera.width;
+    captureSettings.height = camera.height;
+    captureSettings.framerate = camera.framerate;
+    captureSettings.bitrate = camera.bitrate;
+    // The camera's settings are the highway profile; the others lower the
+    // frame rate and bitrate at the same resolution
+    std::unique_ptr<ProfileSelector> profileSelector;
+    if (config.recordingProfiles) {
+      CaptureSettings parked = captureSettings;
+      parked.framerate = config.parkedFramerate;
+      parked.bitrate = config.parkedBitrate;
+      CaptureSettings urban = captureSettings;
+      urban.framerate = config.urbanFramerate;
+      urban.bitrate = config.urbanBitrate;
+      profileSelector = std::make_unique<ProfileSelector>(
+          parked, urban, captureSettings, config.parkedAfterMinutes * 60,
+          config.highwaySpeedKmh, &canListener);
+    }
+    std::unique_ptr<FrameTapWriter> frameTap;
+    if (!camera.frameTap.empty()) {
+      frameTap = std::make_unique<FrameTapWriter>(
+          camera.frameTap, config.tapWidth, config.tapHeight);
+    }
+    // Signal summaries are rolled per segment, so only the first camera's
+    // manifest carries them
+    videoRecorders.push_back(std::make_unique<VideoRecorder>(
+        camera.bufferDir, config.segmentSeconds, config.bufferMinutes,
+        &canListener, videoSources.back().get(), &processSupervisor,
+        &copyEngine, captureSettings, frameTap.get(), config.tapFramerate,
+        videoRecorders.empty() ? &signalAccumulator : nullptr, &exportThrottle,
+        profileSelector.get(), camera.name, &timeSync));
+    recorders.push_back(videoRecorders.back().get());
+    frameTaps.push_back(std::move(frameTap));
+    profileSelectors.push_back(std::move(profileSelector));
+  }
+  // Motion detection and preview watch the first camera
+  const std::string &frameTapName = config.cameras.front().frameTap;
+  std::unique_ptr<MotionDetector> motionDetector;
+  if (config.motionDetection) {
+    motionDetector = std::make_unique<MotionDetector>(
+        frameTapName, profileSelectors.front().get(), config.motionThreshold,
+        config.motionMinBlocks);
+  }
+  // Exports run here, or in the event processor with pipeline=split
+  std::unique_ptr<OverlayRenderer> overlayRenderer;
+  std::unique_ptr<FileManager> fileManager;
+  std::unique_ptr<CSVLogger> csvLogger;
+  std::unique_ptr<EventExporter> eventExporter;
+  if (!split) {
+    overlayRenderer = std::make_unique<OverlayRenderer>(&canListener);
+    fileManager = std::make_unique<FileManager>(
+        config.bufferDir, config.eventDir, &processSupervisor, &copyEngine,
+        &exportThrottle);
+    csvLogger =
+        std::make_unique<CSVLogger>("logs/events.csv", "logs/events.idx");
+    eventExporter = std::make_unique<EventExporter>(
+        fileManager.get(), csvLogger.get(), overlayRenderer.get(),
+        config.canIface, config.eventBundle);
+  }
   TriggerManager triggerManager(
-      &videoRecorder, &fileManager, &csvLogger, &overlayRenderer, &canListener,
-      config.buttonPin, config.pretriggerMinutes, config.posttriggerMinutes);
-  StorageManager storageManager(config.bufferDir, config.bufferMinutes + 2);
+      recorders, eventExporter.get(), &canListener, config.buttonPin,
+      config.pretriggerMinutes, config.posttriggerMinutes,
+      motionDetector.get(), config.motionPretriggerMinutes,
+      config.motionPosttriggerMinutes, canFrames, pipeline.get());
+  const PinCheck isPinned = [&recorders](const std::string &path) {
+    return std::any_of(recorders.begin(), recorders.end(),
+                       [&path](const VideoRecorder *recorder) {
+                         return recorder->isPinned(path);
+                       });
+  };
+  const SegmentEvictor evictSegment = [&recorders](const std::string &path) {
+    return std::any_of(recorders.begin(), recorders.end(),
+                       [&path](VideoRecorder *recorder) {
+                         return recorder->evictSegment(path);
+                       });
+  };
+  static constexpr uint64_t BYTES_PER_MB = 1024ULL * 1024ULL;
+  RetentionManager retentionManager(
+      config.bufferDir, config.eventDir, config.bufferBudgetMB * BYTES_PER_MB,
+      config.eventBudgetMB * BYTES_PER_MB, config.minFreeMB * BYTES_PER_MB,
+      config.pretriggerMinutes * 60 + config.segmentSeconds,
+      parseCriticalWarnings(config.criticalWarnings), isPinned, evictSegment);
+  StorageManager storageManager(config.bufferDir, config.bufferMinutes + 2,
+                                &retentionManager, isPinned);
+  std::unique_ptr<CanTraceWriter> canTraceWriter;
+  if (!config.canTraceDir.empty()) {
+    canTraceWriter = std::make_unique<CanTraceWriter>(
+        config.canTraceDir, canFrames, config.canIface,
+        config.canTraceRotateMinutes, config.canTraceKeepDays);
+  }
+  // With pipeline=split the event processor archives and offloads
+  const BusyCheck exportsBusy = [&triggerManager] {
+    return triggerManager.capturing();
+  };
+  std::unique_ptr<ArchiveTranscoder> archiveTranscoder;
+  std::unique_ptr<OffloadManager> offloadManager;
+  if (!split) {
+    archiveTranscoder = makeArchiveTranscoder(
+        config, [&canListener] { return canListener.getVehicleSpeed(); },
+        &processSupervisor, exportsBusy);
+    offloadManager = makeOffloadManager(config, &exportThrottle, exportsBusy);
+  }
+
+  // Each thread applies its role's profile (thread_<role>) before running;
+  // ffmpeg exports run in the trigger thread and inherit its profile
+  std::thread canThread =
+      startThread(profiles, "can", &CANListener::run, &canListener);
+  // Each camera runs as role video_<name>, so thread_video_<name> can spread
+  // recorders across cores; without it the thread_video profile applies
+  std::vector<std::thread> videoThreads;
+  auto videoProfiles = profiles;
+  for (VideoRecorder *recorder : recorders) {
+    const std::string role = "video_" + recorder->camera();
+    if (!videoProfiles.count(role) && profiles.count("video")) {
+      videoProfiles[role] = profiles.at("video");
+    }
+    videoThreads.push_back(
+        startThread(videoProfiles, role, &VideoRecorder::run, recorder));
+  }
+  std::thread triggerThread =
+      startThread(profiles, "trigger", &TriggerManager::run, &triggerManager);
+  std::thread storageThread =
+      startThread(profiles, "storage", &StorageManager::run, &storageManager);
 
-  std::thread videoThread(&VideoRecorder::run, &videoRecorder);
-  std::thread triggerThread(&TriggerManager::run, &triggerManager);
-  std::thread canThread(&CANListener::run, &canListener);
-  std::thread storageThread(&StorageManager::run, &storageManager);
+  // With pipeline=split the recorders' pressure goes to the processor's
+  // throttle, forwarded by the pipeline thread
+  exportIo.start(profiles, !split);
+  std::thread pipelineThread;
+  std::thread processorThread;
+  if (split) {
+    pipelineThread = startThread(profiles, "pipeline", &PipelineWriter::run,
+                                 pipeline.get(), &canListener);
+    processorThread = startThread(profiles, "processor", superviseProcessor,
+                                  &processSupervisor);
+  }
 
+  std::thread shutdownThread =
+      startShutdownThread(signals, "Capture daemon", exportIo,
+                          csvLogger.get(), config.metricsFile,
+                          config.traceFile);
+  std::thread traceThread = startTraceWriter(signals, config.traceFile);
+  std::thread metricsThread = startMetricsWriter(
+      profiles, config.metricsFile, config.metricsIntervalSeconds);
+
+  std::thread canTraceThread;
+  if (canTraceWriter) {
+    canTraceThread = startThread(profiles, "cantrace", &CanTraceWriter::run,
+                                 canTraceWriter.get());
+  }
+
+  std::thread motionThread;
+  if (motionDetector) {
+    motionThread = startThread(profiles, "motion", &MotionDetector::run,
+                               motionDetector.get());
+  }
+
+  std::thread archiveThread =
+      startArchiveThread(profiles, archiveTranscoder.get());
+  std::thread offloadThread =
+      startOffloadThread(profiles, offloadManager.get());
+
+  std::unique_ptr<PreviewManager> previewManager;
   std::thread previewThread;
-  if (enablePreview) {
-    PreviewManager previewManager(config.bufferDir);
-    previewThread = std::thread(&PreviewManager::run, &previewManager);
+  if (enablePreview && frameTapName.empty()) {
+    std::cerr << "Warning: --preview needs frame_tap to be set" << std::endl;
+  } else if (enablePreview) {
+    previewManager = std::make_unique<PreviewManager>(frameTapName);
+    previewThread = startThread(profiles, "preview", &PreviewManager::run,
+                                previewManager.get());
   }
 
-  videoThread.join();
+  for (auto &videoThread : videoThreads) {
+    videoThread.join();
+  }
   triggerThread.join();
   canThread.join();
   storageThread.join();
-  if (enablePreview)
+  if (previewThread.joinable())
     previewThread.join();
+  if (metricsThread.joinable())
+    metricsThread.join();
+  if (traceThread.joinable())
+    traceThread.join();
+  if (canTraceThread.joinable())
+    canTraceThread.join();
+  if (motionThread.joinable())
+    motionThread.join();
+  if (archiveThread.joinable())
+    archiveThread.join();
+  if (offloadThread.joinable())
+    offloadThread.join();
+  if (pipelineThread.joinable())
+    pipelineThread.join();
+  if (processorThread.joinable())
+    processorThread.join();
+  shutdownThread.join();
 
   return 0;
-}
\ No newline at end of file
+}
@@ -1,5 +1,7 @@
 #include "utils.hpp"
 #include "CANListener.hpp"
+#include <array>
+#include <chrono>
 #include <ctime>
 #include <fstream>
 #include <iostream>
@@ -7,6 +9,74 @@
 #include <sstream>
 #include <stdexcept>
 
+namespace {
+
+/// Applies a camera_<name> spec ("source=testpattern,width=1280,...")
+void applyCameraSpec(const std::string &spec, CameraConfig &camera) {
+  std::stringstream ss(spec);
+  std::string token;
+  while (std::getline(ss, token, ',')) {
+    token.erase(0, token.find_first_not_of(" \t"));
+    token.erase(token.find_last_not_of(" \t\r") + 1);
+    if (token.empty()) {
+      continue;
+    }
+    const auto eq = token.find('=');
+    if (eq == std::string::npos) {
+      throw std::invalid_argument("camera_" + camera.name +
+                                  ": expected key=value in '" + token + "'");
+    }
+    const std::string key = token.substr(0, eq);
+    const std::string value = token.substr(eq + 1);
+    if (key == "source") {
+      camera.videoSource = value;
+    } else if (key == "index") {
+      camera.cameraIndex = std::stoi(value);
+    } else if (key == "pattern") {
+      camera.testPattern = value;
+    } else if (key == "file") {
+      camera.replayFile = value;
+    } else if (key == "speed") {
+      camera.replaySpeed = std::stod(value);
+    } else if (key == "width") {
+      camera.width = std::stoi(value);
+    } else if (key == "height") {
+      camera.height = std::stoi(value);
+    } else if (key == "framerate") {
+      camera.framerate = std::stoi(value);
+    } else if (key == "bitrate") {
+      camera.bitrate = std::stoi(value);
+    } else if (key == "tap") {
+      camera.frameTap = value;
+    } else {
+      throw std::invalid_argument("camera_" + camera.name + ": unknown key '" +
+                                  key + "'");
+    }
+  }
+  if (camera.videoSource != "libcamera" &&
+      camera.videoSource != "testpattern" && camera.videoSource != "file") {
+    throw std::invalid_argument("camera_" + camera.name +
+                                ": source must be libcamera, testpattern or "
+                                "file");
+  }
+  if (camera.videoSource == "file" && camera.replayFile.empty()) {
+    throw std::invalid_argument("camera_" + camera.name +
+                                ": file is required for file source");
+  }
+  if (camera.cameraIndex < 0 || !(camera.replaySpeed > 0.0) ||
+      camera.width <= 0 || camera.height <= 0 || camera.framerate <= 0 ||
+      camera.bitrate <= 0 || camera.testPattern.empty()) {
+    throw std::invalid_argument("camera_" + camera.name +
+                                ": invalid capture setting");
+  }
+  if (!camera.frameTap.empty() && camera.frameTap[0] != '/') {
+    throw std::invalid_argument("camera_" + camera.name +
+                                ": tap must start with '/'");
+  }
+}
+
+} // namespace
+
 Config::Config(const std::string &filename) {
   // Default configuration values
   static constexpr int DEFAULT_SEGMENT_SECONDS = 60;
@@ -14,9 +84,63 @@ Config::Config(const std::string &filename) {
   static constexpr int DEFAULT_PRETRIGGER_MINUTES = 5;
   static constexpr int DEFAULT_POSTTRIGGER_MINUTES = 5;
   static constexpr int DEFAULT_BUTTON_PIN = 0;
+  static constexpr int DEFAULT_BUFFER_BUDGET_MB = 0;
+  static constexpr int DEFAULT_EVENT_BUDGET_MB = 0;
+  static constexpr int DEFAULT_MIN_FREE_MB = 256;
+  static constexpr int DEFAULT_COPY_INFLIGHT_MB = 8;
+  static constexpr int DEFAULT_COPY_CHUNK_KB = 512;
+  static constexpr bool DEFAULT_COPY_DIRECT_IO = false;
+  static constexpr int DEFAULT_EXPORT_LATENCY_TARGET_MS = 50;
+  static constexpr int DEFAULT_EXPORT_MIN_MBPS = 1;
+  static constexpr int DEFAULT_EXPORT_MAX_MBPS = 40;
+  static constexpr int DEFAULT_CAMERA_INDEX = 0;
+  static constexpr double DEFAULT_REPLAY_SPEED = 1.0;
+  static constexpr int DEFAULT_VIDEO_WIDTH = 1920;
+  static constexpr int DEFAULT_VIDEO_HEIGHT = 1080;
+  static constexpr int DEFAULT_VIDEO_FRAMERATE = 30;
+  static constexpr int DEFAULT_VIDEO_BITRATE = 8000000;
+  static constexpr bool DEFAULT_RECORDING_PROFILES = false;
+  static constexpr int DEFAULT_PARKED_AFTER_MINUTES = 5;
+  static constexpr int DEFAULT_PARKED_FRAMERATE = 5;
+  static constexpr int DEFAULT_PARKED_BITRATE = 1000000;
+  static constexpr int DEFAULT_URBAN_FRAMERATE = 30;
+  static constexpr int DEFAULT_URBAN_BITRATE = 5000000;
+  static constexpr int DEFAULT_HIGHWAY_SPEED_KMH = 80;
+  static constexpr int DEFAULT_TAP_WIDTH = 640;
+  static constexpr int DEFAULT_TAP_HEIGHT = 360;
+  static constexpr int DEFAULT_TAP_FRAMERATE = 10;
+  static constexpr bool DEFAULT_MOTION_DETECTION = false;
+  static constexpr int DEFAULT_MOTION_THRESHOLD = 12;
+  static constexpr int DEFAULT_MOTION_MIN_BLOCKS = 4;
+  static constexpr int DEFAULT_MOTION_PRETRIGGER_MINUTES = 1;
+  static constexpr int DEFAULT_MOTION_POSTTRIGGER_MINUTES = 1;
+  static constexpr bool DEFAULT_EVENT_BUNDLE = true;
+  static constexpr int DEFAULT_CAN_RING_FRAMES = 262144;
+  static constexpr int MIN_CAN_RING_FRAMES = 1024;
+  static constexpr int DEFAULT_CAN_TRACE_ROTATE_MINUTES = 10;
+  static constexpr int DEFAULT_CAN_TRACE_KEEP_DAYS = 30;
+  static constexpr int DEFAULT_ARCHIVE_AFTER_DAYS = 0;
+  static constexpr int DEFAULT_ARCHIVE_BITRATE = 1500000;
+  static constexpr int DEFAULT_ARCHIVE_HEIGHT = 0;
+  static constexpr int DEFAULT_OFFLOAD_CONCURRENCY = 2;
+  static constexpr int MAX_OFFLOAD_CONCURRENCY = 16;
+  static constexpr int DEFAULT_OFFLOAD_MAX_KBPS = 1024;
+  static constexpr int DEFAULT_METRICS_INTERVAL_SECONDS = 10;
+  static constexpr int DEFAULT_TRACE_SPANS = 0;
   static constexpr const char *DEFAULT_BUFFER_DIR = "/tmp/dacl_buffer";
   static constexpr const char *DEFAULT_EVENT_DIR = "/tmp/dacl_events";
   static constexpr const char *DEFAULT_CAN_IFACE = "can0";
+  static constexpr const char *DEFAULT_CRITICAL_WARNINGS = "ECALL,ESC";
+  static constexpr const char *DEFAULT_COPY_ENGINE = "auto";
+  static constexpr const char *DEFAULT_VIDEO_SOURCE = "libcamera";
+  static constexpr const char *DEFAULT_TEST_PATTERN = "testsrc2";
+  static constexpr const char *DEFAULT_FRAME_TAP = "/dacl_frames";
+  static constexpr const char *DEFAULT_METRICS_FILE = "logs/metrics.prom";
+  static constexpr const char *DEFAULT_TRACE_FILE = "logs/trace.json";
+  static constexpr const char *DEFAULT_PIPELINE = "single";
+  static constexpr const char *DEFAULT_PIPELINE_SHM = "/dacl_pipeline";
+  static constexpr const char *DEFAULT_CAMERAS = "front";
+  static constexpr const char *DEFAULT_ARCHIVE_ENCODER = "libx264";
 
   // Initialize with defaults
   segmentSeconds = DEFAULT_SEGMENT_SECONDS;
@@ -28,6 +152,60 @@ Config::Config(const std::string &filename) {
   canIface = DEFAULT_CAN_IFACE;
   warningIds = "";
   buttonPin = DEFAULT_BUTTON_PIN;
+  bufferBudgetMB = DEFAULT_BUFFER_BUDGET_MB;
+  eventBudgetMB = DEFAULT_EVENT_BUDGET_MB;
+  minFreeMB = DEFAULT_MIN_FREE_MB;
+  criticalWarnings = DEFAULT_CRITICAL_WARNINGS;
+  copyEngine = DEFAULT_COPY_ENGINE;
+  copyInflightMB = DEFAULT_COPY_INFLIGHT_MB;
+  copyChunkKB = DEFAULT_COPY_CHUNK_KB;
+  copyDirectIo = DEFAULT_COPY_DIRECT_IO;
+  exportLatencyTargetMs = DEFAULT_EXPORT_LATENCY_TARGET_MS;
+  exportMinMBps = DEFAULT_EXPORT_MIN_MBPS;
+  exportMaxMBps = DEFAULT_EXPORT_MAX_MBPS;
+  videoSource = DEFAULT_VIDEO_SOURCE;
+  cameraIndex = DEFAULT_CAMERA_INDEX;
+  testPattern = DEFAULT_TEST_PATTERN;
+  replayFile = "";
+  replaySpeed = DEFAULT_REPLAY_SPEED;
+  videoWidth = DEFAULT_VIDEO_WIDTH;
+  videoHeight = DEFAULT_VIDEO_HEIGHT;
+  videoFramerate = DEFAULT_VIDEO_FRAMERATE;
+  videoBitrate = DEFAULT_VIDEO_BITRATE;
+  recordingProfiles = DEFAULT_RECORDING_PROFILES;
+  parkedAfterMinutes = DEFAULT_PARKED_AFTER_MINUTES;
+  parkedFramerate = DEFAULT_PARKED_FRAMERATE;
+  parkedBitrate = DEFAULT_PARKED_BITRATE;
+  urbanFramerate = DEFAULT_URBAN_FRAMERATE;
+  urbanBitrate = DEFAULT_URBAN_BITRATE;
+  highwaySpeedKmh = DEFAULT_HIGHWAY_SPEED_KMH;
+  frameTap = DEFAULT_FRAME_TAP;
+  tapWidth = DEFAULT_TAP_WIDTH;
+  tapHeight = DEFAULT_TAP_HEIGHT;
+  tapFramerate = DEFAULT_TAP_FRAMERATE;
+  motionDetection = DEFAULT_MOTION_DETECTION;
+  motionThreshold = DEFAULT_MOTION_THRESHOLD;
+  motionMinBlocks = DEFAULT_MOTION_MIN_BLOCKS;
+  motionPretriggerMinutes = DEFAULT_MOTION_PRETRIGGER_MINUTES;
+  motionPosttriggerMinutes = DEFAULT_MOTION_POSTTRIGGER_MINUTES;
+  eventBundle = DEFAULT_EVENT_BUNDLE;
+  canRingFrames = DEFAULT_CAN_RING_FRAMES;
+  canTraceDir = "";
+  canTraceRotateMinutes = DEFAULT_CAN_TRACE_ROTATE_MINUTES;
+  canTraceKeepDays = DEFAULT_CAN_TRACE_KEEP_DAYS;
+  archiveAfterDays = DEFAULT_ARCHIVE_AFTER_DAYS;
+  archiveBitrate = DEFAULT_ARCHIVE_BITRATE;
+  archiveHeight = DEFAULT_ARCHIVE_HEIGHT;
+  archiveEncoder = DEFAULT_ARCHIVE_ENCODER;
+  offloadUrl = "";
+  offloadConcurrency = DEFAULT_OFFLOAD_CONCURRENCY;
+  offloadMaxKBps = DEFAULT_OFFLOAD_MAX_KBPS;
+  metricsFile = DEFAULT_METRICS_FILE;
+  metricsIntervalSeconds = DEFAULT_METRICS_INTERVAL_SECONDS;
+  traceSpans = DEFAULT_TRACE_SPANS;
+  traceFile = DEFAULT_TRACE_FILE;
+  pipeline = DEFAULT_PIPELINE;
+  pipelineShm = DEFAULT_PIPELINE_SHM;
 
   // Input validation
   if (filename.empty()) {
@@ -114,6 +292,456 @@ Config::Config(const std::string &filename) {
       }
     }
 
+    if (kv.count("buffer_budget_mb")) {
+      bufferBudgetMB = std::stoi(kv["buffer_budget_mb"]);
+      if (bufferBudgetMB < 0) {
+        throw std::invalid_argument("buffer_budget_mb cannot be negative");
+      }
+    }
+
+    if (kv.count("event_budget_mb")) {
+      eventBudgetMB = std::stoi(kv["event_budget_mb"]);
+      if (eventBudgetMB < 0) {
+        throw std::invalid_argument("event_budget_mb cannot be negative");
+      }
+    }
+
+    if (kv.count("min_free_mb")) {
+      minFreeMB = std::stoi(kv["min_free_mb"]);
+      if (minFreeMB < 0) {
+        throw std::invalid_argument("min_free_mb cannot be negative");
+      }
+    }
+
+    if (kv.count("critical_warnings")) {
+      criticalWarnings = kv["critical_warnings"];
+    }
+
+    if (kv.count("copy_engine")) {
+      copyEngine = kv["copy_engine"];
+      if (copyEngine != "auto" && copyEngine != "uring" &&
+          copyEngine != "threads") {
+        throw std::invalid_argument("copy_engine must be auto, uring or "
+                                    "threads");
+      }
+    }
+
+    if (kv.count("copy_chunk_kb")) {
+      copyChunkKB = std::stoi(kv["copy_chunk_kb"]);
+      if (copyChunkKB <= 0 || copyChunkKB % 4 != 0) {
+        throw std::invalid_argument(
+            "copy_chunk_kb must be a positive multiple of 4");
+      }
+    }
+
+    if (kv.count("copy_inflight_mb")) {
+      copyInflightMB = std::stoi(kv["copy_inflight_mb"]);
+      if (copyInflightMB <= 0) {
+        throw std::invalid_argument("copy_inflight_mb must be positive");
+      }
+    }
+    if (copyInflightMB * 1024 < copyChunkKB) {
+      throw std::invalid_argument(
+          "copy_inflight_mb must hold at least one copy_chunk_kb chunk");
+    }
+
+    if (kv.count("copy_direct_io")) {
+      copyDirectIo = std::stoi(kv["copy_direct_io"]) != 0;
+    }
+
+    if (kv.count("export_latency_target_ms")) {
+      exportLatencyTargetMs = std::stoi(kv["export_latency_target_ms"]);
+      if (exportLatencyTargetMs <= 0) {
+        throw std::invalid_argument(
+            "export_latency_target_ms must be positive");
+      }
+    }
+
+    if (kv.count("export_min_mbps")) {
+      exportMinMBps = std::stoi(kv["export_min_mbps"]);
+      if (exportMinMBps <= 0) {
+        throw std::invalid_argument("export_min_mbps must be positive");
+      }
+    }
+
+    if (kv.count("export_max_mbps")) {
+      exportMaxMBps = std::stoi(kv["export_max_mbps"]);
+      if (exportMaxMBps <= 0) {
+        throw std::invalid_argument("export_max_mbps must be positive");
+      }
+    }
+    if (exportMinMBps > exportMaxMBps) {
+      throw std::invalid_argument(
+          "export_min_mbps cannot exceed export_max_mbps");
+    }
+
+    if (kv.count("video_source")) {
+      videoSource = kv["video_source"];
+      if (videoSource != "libcamera" && videoSource != "testpattern" &&
+          videoSource != "file") {
+        throw std::invalid_argument(
+            "video_source must be libcamera, testpattern or file");
+      }
+    }
+
+    if (kv.count("camera_index")) {
+      cameraIndex = std::stoi(kv["camera_index"]);
+      if (cameraIndex < 0) {
+        throw std::invalid_argument("camera_index cannot be negative");
+      }
+    }
+
+    if (kv.count("test_pattern")) {
+      testPattern = kv["test_pattern"];
+      if (testPattern.empty()) {
+        throw std::invalid_argument("test_pattern cannot be empty");
+      }
+    }
+
+    if (kv.count("replay_file")) {
+      replayFile = kv["replay_file"];
+    }
+    if (videoSource == "file" && replayFile.empty()) {
+      throw std::invalid_argument("replay_file is required for file source");
+    }
+
+    if (kv.count("replay_speed")) {
+      replaySpeed = std::stod(kv["replay_speed"]);
+      if (!(replaySpeed > 0.0)) {
+        throw std::invalid_argument("replay_speed must be positive");
+      }
+    }
+
+    if (kv.count("video_width")) {
+      videoWidth = std::stoi(kv["video_width"]);
+      if (videoWidth <= 0) {
+        throw std::invalid_argument("video_width must be positive");
+      }
+    }
+
+    if (kv.count("video_height")) {
+      videoHeight = std::stoi(kv["video_height"]);
+      if (videoHeight <= 0) {
+        throw std::invalid_argument("video_height must be positive");
+      }
+    }
+
+    if (kv.count("video_framerate")) {
+      videoFramerate = std::stoi(kv["video_framerate"]);
+      if (videoFramerate <= 0) {
+        throw std::invalid_argument("video_framerate must be positive");
+      }
+    }
+
+    if (kv.count("video_bitrate")) {
+      videoBitrate = std::stoi(kv["video_bitrate"]);
+      if (videoBitrate <= 0) {
+        throw std::invalid_argument("video_bitrate must be positive");
+      }
+    }
+
+    if (kv.count("recording_profiles")) {
+      recordingProfiles = std::stoi(kv["recording_profiles"]) != 0;
+    }
+
+    if (kv.count("parked_after_minutes")) {
+      parkedAfterMinutes = std::stoi(kv["parked_after_minutes"]);
+      if (parkedAfterMinutes <= 0) {
+        throw std::invalid_argument("parked_after_minutes must be positive");
+      }
+    }
+
+    if (kv.count("parked_framerate")) {
+      parkedFramerate = std::stoi(kv["parked_framerate"]);
+      if (parkedFramerate <= 0) {
+        throw std::invalid_argument("parked_framerate must be positive");
+      }
+    }
+
+    if (kv.count("parked_bitrate")) {
+      parkedBitrate = std::stoi(kv["parked_bitrate"]);
+      if (parkedBitrate <= 0) {
+        throw std::invalid_argument("parked_bitrate must be positive");
+      }
+    }
+
+    if (kv.count("urban_framerate")) {
+      urbanFramerate = std::stoi(kv["urban_framerate"]);
+      if (urbanFramerate <= 0) {
+        throw std::invalid_argument("urban_framerate must be positive");
+      }
+    }
+
+    if (kv.count("urban_bitrate")) {
+      urbanBitrate = std::stoi(kv["urban_bitrate"]);
+      if (urbanBitrate <= 0) {
+        throw std::invalid_argument("urban_bitrate must be positive");
+      }
+    }
+
+    if (kv.count("highway_speed_kmh")) {
+      highwaySpeedKmh = std::stoi(kv["highway_speed_kmh"]);
+      if (highwaySpeedKmh <= 0) {
+        throw std::invalid_argument("highway_speed_kmh must be positive");
+      }
+    }
+
+    if (kv.count("frame_tap")) {
+      frameTap = kv["frame_tap"];
+      if (!frameTap.empty() && frameTap[0] != '/') {
+        throw std::invalid_argument("frame_tap must start with '/'");
+      }
+    }
+
+    if (kv.count("tap_width")) {
+      tapWidth = std::stoi(kv["tap_width"]);
+      if (tapWidth <= 0 || tapWidth % 2 != 0) {
+        throw std::invalid_argument("tap_width must be positive and even");
+      }
+    }
+
+    if (kv.count("tap_height")) {
+      tapHeight = std::stoi(kv["tap_height"]);
+      if (tapHeight <= 0 || tapHeight % 2 != 0) {
+        throw std::invalid_argument("tap_height must be positive and even");
+      }
+    }
+
+    if (kv.count("tap_framerate")) {
+      tapFramerate = std::stoi(kv["tap_framerate"]);
+      if (tapFramerate <= 0) {
+        throw std::invalid_argument("tap_framerate must be positive");
+      }
+    }
+
+    // cameras=<name>,... with optional camera_<name>=<spec> overrides; a
+    // single camera records straight into buffer_dir
+    std::vector<std::string> names;
+    {
+      std::stringstream ss(kv.count("cameras") ? kv["cameras"]
+                                               : DEFAULT_CAMERAS);
+      std::string name;
+      while (std::getline(ss, name, ',')) {
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t\r") + 1);
+        if (name.empty() ||
+            name.find_first_not_of("abcdefghijklmnopqrstuvwxyz0123456789") !=
+                std::string::npos) {
+          throw std::invalid_argument(
+              "cameras must list lower-case alphanumeric names");
+        }
+        if (name == "index") {
+          throw std::invalid_argument(
+              "Camera name 'index' clashes with camera_index");
+        }
+        for (const auto &other : names) {
+          if (other == name) {
+            throw std::invalid_argument("Duplicate camera name: " + name);
+          }
+        }
+        names.push_back(name);
+      }
+    }
+    if (names.empty()) {
+      throw std::invalid_argument("cameras cannot be empty");
+    }
+    for (const auto &name : names) {
+      CameraConfig camera;
+      camera.name = name;
+      camera.bufferDir =
+          names.size() == 1 ? bufferDir : bufferDir + "/" + name;
+      camera.videoSource = videoSource;
+      camera.cameraIndex = cameraIndex;
+      camera.testPattern = testPattern;
+      camera.replayFile = replayFile;
+      camera.replaySpeed = replaySpeed;
+      camera.width = videoWidth;
+      camera.height = videoHeight;
+      camera.framerate = videoFramerate;
+      camera.bitrate = videoBitrate;
+      // Only one writer may own a tap, so other cameras need tap=
+      camera.frameTap = cameras.empty() ? frameTap : "";
+      applyCameraSpec(kv.count("camera_" + name) ? kv["camera_" + name] : "",
+                      camera);
+      for (const auto &other : cameras) {
+        if (!camera.frameTap.empty() && camera.frameTap == other.frameTap) {
+          throw std::invalid_argument("Cameras " + other.name + " and " +
+                                      name + " share frame tap " +
+                                      camera.frameTap);
+        }
+      }
+      cameras.push_back(camera);
+    }
+
+    if (kv.count("motion_detection")) {
+      motionDetection = std::stoi(kv["motion_detection"]) != 0;
+    }
+    if (motionDetection &&
+        (!recordingProfiles || cameras.front().frameTap.empty())) {
+      throw std::invalid_argument("motion_detection needs recording_profiles "
+                                  "and a frame tap on the first camera");
+    }
+
+    if (kv.count("motion_threshold")) {
+      motionThreshold = std::stoi(kv["motion_threshold"]);
+      if (motionThreshold <= 0 || motionThreshold > 255) {
+        throw std::invalid_argument("motion_threshold must be 1-255");
+      }
+    }
+
+    if (kv.count("motion_min_blocks")) {
+      motionMinBlocks = std::stoi(kv["motion_min_blocks"]);
+      if (motionMinBlocks <= 0) {
+        throw std::invalid_argument("motion_min_blocks must be positive");
+      }
+    }
+
+    if (kv.count("motion_pretrigger_minutes")) {
+      motionPretriggerMinutes = std::stoi(kv["motion_pretrigger_minutes"]);
+      if (motionPretriggerMinutes < 0) {
+        throw std::invalid_argument(
+            "motion_pretrigger_minutes cannot be negative");
+      }
+    }
+
+    if (kv.count("motion_posttrigger_minutes")) {
+      motionPosttriggerMinutes = std::stoi(kv["motion_posttrigger_minutes"]);
+      if (motionPosttriggerMinutes < 0) {
+        throw std::invalid_argument(
+            "motion_posttrigger_minutes cannot be negative");
+      }
+    }
+
+    if (kv.count("event_bundle")) {
+      eventBundle = std::stoi(kv["event_bundle"]) != 0;
+    }
+
+    if (kv.count("can_ring_frames")) {
+      canRingFrames = std::stoi(kv["can_ring_frames"]);
+      if (canRingFrames < MIN_CAN_RING_FRAMES) {
+        throw std::invalid_argument("can_ring_frames must be at least 1024");
+      }
+    }
+
+    if (kv.count("can_trace_dir")) {
+      canTraceDir = kv["can_trace_dir"];
+    }
+
+    if (kv.count("can_trace_rotate_minutes")) {
+      canTraceRotateMinutes = std::stoi(kv["can_trace_rotate_minutes"]);
+      if (canTraceRotateMinutes <= 0) {
+        throw std::invalid_argument(
+            "can_trace_rotate_minutes must be positive");
+      }
+    }
+
+    if (kv.count("can_trace_keep_days")) {
+      canTraceKeepDays = std::stoi(kv["can_trace_keep_days"]);
+      if (canTraceKeepDays < 0) {
+        throw std::invalid_argument("can_trace_keep_days cannot be negative");
+      }
+    }
+
+    if (kv.count("archive_after_days")) {
+      archiveAfterDays = std::stoi(kv["archive_after_days"]);
+      if (archiveAfterDays < 0) {
+        throw std::invalid_argument("archive_after_days cannot be negative");
+      }
+    }
+
+    if (kv.count("archive_bitrate")) {
+      archiveBitrate = std::stoi(kv["archive_bitrate"]);
+      if (archiveBitrate <= 0) {
+        throw std::invalid_argument("archive_bitrate must be positive");
+      }
+    }
+
+    if (kv.count("archive_height")) {
+      archiveHeight = std::stoi(kv["archive_height"]);
+      if (archiveHeight < 0 || archiveHeight % 2 != 0) {
+        throw std::invalid_argument(
+            "archive_height must be even and not negative");
+      }
+    }
+
+    if (kv.count("archive_encoder")) {
+      archiveEncoder = kv["archive_encoder"];
+      if (archiveEncoder.empty()) {
+        throw std::invalid_argument("archive_encoder cannot be empty");
+      }
+    }
+
+    if (kv.count("offload_url")) {
+      offloadUrl = kv["offload_url"];
+      if (!offloadUrl.empty() && offloadUrl.rfind("http://", 0) != 0) {
+        throw std::invalid_argument("offload_url must start with http://");
+      }
+    }
+
+    if (kv.count("offload_concurrency")) {
+      offloadConcurrency = std::stoi(kv["offload_concurrency"]);
+      if (offloadConcurrency <= 0 ||
+          offloadConcurrency > MAX_OFFLOAD_CONCURRENCY) {
+        throw std::invalid_argument("offload_concurrency must be 1-16");
+      }
+    }
+
+    if (kv.count("offload_max_kbps")) {
+      offloadMaxKBps = std::stoi(kv["offload_max_kbps"]);
+      if (offloadMaxKBps < 0) {
+        throw std::invalid_argument("offload_max_kbps cannot be negative");
+      }
+    }
+
+    // thread_<role>=<spec>, validated when the profiles are parsed
+    static const std::string THREAD_PREFIX = "thread_";
+    for (const auto &entry : kv) {
+      if (entry.first.rfind(THREAD_PREFIX, 0) == 0) {
+        threadProfiles[entry.first.substr(THREAD_PREFIX.size())] =
+            entry.second;
+      }
+    }
+
+    if (kv.count("metrics_file")) {
+      metricsFile = kv["metrics_file"];
+    }
+
+    if (kv.count("metrics_interval_seconds")) {
+      metricsIntervalSeconds = std::stoi(kv["metrics_interval_seconds"]);
+      if (metricsIntervalSeconds <= 0) {
+        throw std::invalid_argument(
+            "metrics_interval_seconds must be positive");
+      }
+    }
+
+    if (kv.count("trace_spans")) {
+      traceSpans = std::stoi(kv["trace_spans"]);
+      if (traceSpans < 0) {
+        throw std::invalid_argument("trace_spans cannot be negative");
+      }
+    }
+
+    if (kv.count("trace_file")) {
+      traceFile = kv["trace_file"];
+      if (traceFile.empty()) {
+        throw std::invalid_argument("trace_file cannot be empty");
+      }
+    }
+
+    if (kv.count("pipeline")) {
+      pipeline = kv["pipeline"];
+      if (pipeline != "single" && pipeline != "split") {
+        throw std::invalid_argument("pipeline must be single or split");
+      }
+    }
+
+    if (kv.count("pipeline_shm")) {
+      pipelineShm = kv["pipeline_shm"];
+      if (pipelineShm.empty() || pipelineShm[0] != '/') {
+        throw std::invalid_argument("pipeline_shm must start with '/'");
+      }
+    }
+
   } catch (const std::invalid_argument &e) {
     throw std::runtime_error("Configuration parsing error: " +
                              std::string(e.what()));
@@ -128,11 +756,11 @@ std::string currentTimestamp(const CANListener *canListener) {
   char buf[TIMESTAMP_BUFFER_SIZE];
 
   if (canListener != nullptr) {
-    // Use CAN-based timestamp if available
-    std::snprintf(buf, sizeof(buf), "%04d%02d%02d_%02d%02d%02d",
-                  canListener->getYear(), canListener->getMonth(),
-                  canListener->getDay(), canListener->getHour(),
-                  canListener->getMinute(), canListener->getSecond());
+    // Use CAN-based timestamp if available, from one consistent snapshot
+    const VehicleState state = canListener->getVehicleState();
+    std::snprintf(buf, sizeof(buf), "%04d%02d%02d_%02d%02d%02d", state.year,
+                  state.month, state.day, state.hour, state.minute,
+                  state.second);
   } else {
     // Fall back to system time
     const auto now = std::time(nullptr);
@@ -247,4 +875,46 @@ uint32_t extractSignal(const uint8_t *data, int startBit, int length,
   }
 
   return static_cast<uint32_t>(scaledValue);
-}
\ No newline at end of file
+}
+
+uint32_t crc32(const void *data, size_t length, uint32_t crc) {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < t.size(); ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+
+  const auto *p = static_cast<const uint8_t *>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < length; ++i) {
+    crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+int64_t packedCANTime(const CANListener *canListener) {
+  if (canListener == nullptr) {
+    return 0;
+  }
+  const VehicleState state = canListener->getVehicleState();
+  return ((((static_cast<int64_t>(state.year) * 100 + state.month) * 100 +
+            state.day) *
+               100 +
+           state.hour) *
+              100 +
+          state.minute) *
+             100 +
+         state.second;
+}
+
+int64_t wallClockMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
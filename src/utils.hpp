@@ -6,8 +6,44 @@
 #pragma once
 #include "CANListener.hpp"
 #include <cstdint>
+#include <functional>
 #include <map>
 #include <string>
+#include <vector>
+
+/// Predicate reporting whether an event export is in progress; background
+/// jobs (archiving, offloading) hold back while it returns true
+using BusyCheck = std::function<bool()>;
+
+/// Returns the current vehicle speed in km/h; lets background jobs that wait
+/// for standstill run where no CANListener lives (the event processor)
+using SpeedSource = std::function<int()>;
+
+/// Subdirectory of buffer_dir holding the events staged for the event
+/// processor (pipeline=split); recursive buffer scans skip it
+constexpr const char *PIPELINE_STAGING_DIR = ".pipeline";
+
+/**
+ * @struct CameraConfig
+ * @brief Source and capture settings of one camera
+ *
+ * Defaults come from the global video_* and frame tap keys; a
+ * `camera_<name>=key=value,...` line overrides them for one camera.
+ */
+struct CameraConfig {
+  std::string name;        ///< Camera name, e.g. "front" or "cabin"
+  std::string bufferDir;   ///< Segment buffer of this camera
+  std::string videoSource; ///< Source backend: libcamera, testpattern, file
+  int cameraIndex = 0;     ///< libcamera camera index
+  std::string testPattern; ///< lavfi pattern for the testpattern backend
+  std::string replayFile;  ///< Video file for the file backend
+  double replaySpeed = 1.0; ///< Replay speed factor for the file backend
+  int width = 0;           ///< Capture width in pixels
+  int height = 0;          ///< Capture height in pixels
+  int framerate = 0;       ///< Capture frame rate in frames per second
+  int bitrate = 0;         ///< Encoder bitrate in bits per second
+  std::string frameTap;    ///< Shared-memory name of the tap ("" = off)
+};
 
 /**
  * @struct Config
@@ -19,6 +55,13 @@
  * - Directory paths for buffer and event storage
  * - CAN interface configuration
  * - GPIO pin assignments
+ * - Storage retention budgets and priorities
+ * - Copy engine used for event export and its back-pressure limits
+ * - Video source backend and capture settings
+ * - Speed-dependent recording profiles and parked-mode motion detection
+ * - Cameras recorded side by side, each with its own source and buffer
+ * - Shared-memory frame tap
+ * - Thread scheduling profiles and metrics export
  */
 struct Config {
   int segmentSeconds;     ///< Duration of each video segment in seconds
@@ -30,6 +73,63 @@ struct Config {
   std::string canIface;   ///< CAN interface name (e.g., "can0")
   std::string warningIds; ///< CAN ID to warning type mappings
   int buttonPin;          ///< GPIO pin number for manual trigger button
+  int bufferBudgetMB;     ///< Byte budget for the buffer in MB (0 = none)
+  int eventBudgetMB;      ///< Byte budget for saved events in MB (0 = none)
+  int minFreeMB;          ///< Free space to keep on each filesystem in MB
+  std::string criticalWarnings; ///< Warning tokens with Critical priority
+  std::string copyEngine;  ///< Copy backend: auto, uring or threads
+  int copyInflightMB;      ///< Bytes in flight during copies in MB
+  int copyChunkKB;         ///< Size of one copy read/write in KB
+  bool copyDirectIo;       ///< Copy with O_DIRECT
+  int exportLatencyTargetMs; ///< Recorder write latency that throttles export
+  int exportMinMBps;       ///< Lowest export bandwidth in MB/s
+  int exportMaxMBps;       ///< Highest export bandwidth in MB/s
+  std::string videoSource; ///< Source backend: libcamera, testpattern, file
+  int cameraIndex;         ///< libcamera camera index
+  std::string testPattern; ///< lavfi pattern for the testpattern backend
+  std::string replayFile;  ///< Video file for the file backend
+  double replaySpeed;      ///< Replay speed factor for the file backend
+  int videoWidth;          ///< Capture width in pixels
+  int videoHeight;         ///< Capture height in pixels
+  int videoFramerate;      ///< Capture frame rate in frames per second
+  int videoBitrate;        ///< Encoder bitrate in bits per second
+  bool recordingProfiles;  ///< Switch capture settings with vehicle speed
+  int parkedAfterMinutes;  ///< Minutes at speed 0 until parked
+  int parkedFramerate;     ///< Frame rate while parked
+  int parkedBitrate;       ///< Bitrate while parked in bits per second
+  int urbanFramerate;      ///< Frame rate below highway speed
+  int urbanBitrate;        ///< Bitrate below highway speed in bits per second
+  int highwaySpeedKmh;     ///< Speed from which video_* settings are used
+  std::string frameTap;    ///< Shared-memory name of the tap ("" = off)
+  int tapWidth;            ///< Frame tap width in pixels
+  int tapHeight;           ///< Frame tap height in pixels
+  int tapFramerate;        ///< Frames per second published to the tap
+  bool motionDetection;    ///< Detect motion in tap frames while parked
+  int motionThreshold;     ///< Mean block difference counted as change
+  int motionMinBlocks;     ///< Changed blocks that count as motion
+  int motionPretriggerMinutes;  ///< Pre-trigger duration of MOTION events
+  int motionPosttriggerMinutes; ///< Post-trigger duration of MOTION events
+  bool eventBundle;        ///< Write a single-file bundle per event
+  int canRingFrames;       ///< Raw CAN frames kept in memory for bundles
+  std::string canTraceDir; ///< Directory of continuous CAN logs ("" = off)
+  int canTraceRotateMinutes; ///< Minutes per CAN log file
+  int canTraceKeepDays;    ///< Days CAN logs are kept (0 = forever)
+  int archiveAfterDays;    ///< Age of event videos to re-encode (0 = off)
+  int archiveBitrate;      ///< Bitrate of re-encoded videos in bits/s
+  int archiveHeight;       ///< Height of re-encoded videos (0 = unchanged)
+  std::string archiveEncoder; ///< ffmpeg encoder of re-encoded videos
+  std::string offloadUrl;  ///< Event upload endpoint ("" = off)
+  int offloadConcurrency;  ///< Chunks uploaded at once
+  int offloadMaxKBps;      ///< Upload bandwidth in KB/s (0 = unlimited)
+  std::vector<CameraConfig> cameras; ///< Cameras to record (at least one)
+  std::map<std::string, std::string>
+      threadProfiles;      ///< ThreadProfile spec per role (thread_<role>)
+  std::string metricsFile; ///< Metrics snapshot file ("" = off)
+  int metricsIntervalSeconds; ///< Seconds between metrics snapshots
+  int traceSpans;          ///< Trace spans kept per thread (0 = off)
+  std::string traceFile;   ///< Chrome trace JSON written on SIGUSR1
+  std::string pipeline;    ///< Process layout: single or split
+  std::string pipelineShm; ///< Shared-memory name of the pipeline ring
 
   /**
    * @brief Constructs Config by loading parameters from INI file
@@ -79,4 +179,28 @@ std::map<int, std::string> parseCANWarnings(const std::string &warningsString);
  */
 uint32_t extractSignal(const uint8_t *data, int startBit, int length,
                        bool isLittleEndian, double factor = 1.0,
-                       double offset = 0.0);
\ No newline at end of file
+                       double offset = 0.0);
+
+/**
+ * @brief Computes the CRC-32 (IEEE 802.3) checksum of a byte range
+ * @param data Pointer to the bytes to checksum
+ * @param length Number of bytes
+ * @param crc Running checksum to continue from (0 for a new checksum)
+ * @return Updated checksum
+ *
+ * @note Used to detect torn or corrupted records in on-disk formats.
+ */
+uint32_t crc32(const void *data, size_t length, uint32_t crc = 0);
+
+/**
+ * @brief Packs the CAN clock of a listener into a single integer
+ * @param canListener CAN listener providing date/time (can be nullptr)
+ * @return Time as YYYYMMDDhhmmss, or 0 if canListener is nullptr
+ */
+int64_t packedCANTime(const CANListener *canListener);
+
+/**
+ * @brief Returns the current system (wall-clock) time in microseconds
+ * @return Microseconds since the Unix epoch
+ */
+int64_t wallClockMicros();
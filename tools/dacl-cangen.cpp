@@ -0,0 +1,365 @@
+/**
+ * @file dacl-cangen.cpp
+ * @brief Synthetic vehicle CAN traffic for soak and load tests
+ *
+ * Usage:
+ *   dacl-cangen [--config configs/config.ini] [--iface vcan0]
+ *               [--bitrate 500000] [--load PERCENT]
+ *               [--warnings-per-minute N] [--burst-every S]
+ *               [--burst-frames N] [--storm-every S] [--storm-warnings N]
+ *               [--duration S] [--stats FILE] [--seed N]
+ *
+ * Sends, on a (virtual) CAN interface, what DaCL decodes: vehicle speed
+ * (0x1A1, every 20 ms, following a drive cycle with stops), odometer, trip
+ * and the CAN clock (every second), plus filler frames up to --load percent
+ * of --bitrate, counting 125 bits per 8-byte frame. On top of that:
+ * - warning frames of the configured warning_ids at random times, on
+ *   average --warnings-per-minute
+ * - every --burst-every seconds, --burst-frames filler frames back to back
+ * - every --storm-every seconds, a trigger storm of --storm-warnings
+ *   warning frames 50 ms apart
+ *
+ * Every second the counters are written to --stats as "name value" lines
+ * (the format of metrics_file): frames, warnings, bursts, storms, send
+ * errors (ENOBUFS on a full queue) and the time of the last warning.
+ *
+ * Example: 60% load on vcan0 with a storm every 10 minutes, for an hour
+ *   sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+ *   dacl-cangen --load 60 --storm-every 600 --duration 3600
+ */
+
+#include "utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::string config = "configs/config.ini";
+  std::string iface = "vcan0";
+  int bitrate = 500000;
+  double load = 40.0;
+  double warningsPerMinute = 1.0;
+  double burstEvery = 0.0;
+  int burstFrames = 500;
+  double stormEvery = 0.0;
+  int stormWarnings = 20;
+  double duration = 0.0;
+  std::string stats;
+  unsigned seed = 1;
+};
+
+/// Bits of an 8-byte standard frame on the wire, stuffing included
+constexpr double BITS_PER_FRAME = 125.0;
+/// Period of the pacing loop
+constexpr int64_t TICK_US = 1000;
+/// Spacing of the warning frames of a storm
+constexpr int64_t STORM_SPACING_US = 50000;
+
+void usage() {
+  std::cerr << "Usage: dacl-cangen [--config FILE] [--iface IFACE]"
+               " [--bitrate BPS] [--load PERCENT]\n"
+               "                   [--warnings-per-minute N]"
+               " [--burst-every S] [--burst-frames N]\n"
+               "                   [--storm-every S] [--storm-warnings N]"
+               " [--duration S]\n"
+               "                   [--stats FILE] [--seed N]\n";
+}
+
+Options parseArgs(int argc, char *argv[]) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+    if (arg == "--config") {
+      o.config = value();
+    } else if (arg == "--iface") {
+      o.iface = value();
+    } else if (arg == "--bitrate") {
+      o.bitrate = std::stoi(value());
+    } else if (arg == "--load") {
+      o.load = std::stod(value());
+    } else if (arg == "--warnings-per-minute") {
+      o.warningsPerMinute = std::stod(value());
+    } else if (arg == "--burst-every") {
+      o.burstEvery = std::stod(value());
+    } else if (arg == "--burst-frames") {
+      o.burstFrames = std::stoi(value());
+    } else if (arg == "--storm-every") {
+      o.stormEvery = std::stod(value());
+    } else if (arg == "--storm-warnings") {
+      o.stormWarnings = std::stoi(value());
+    } else if (arg == "--duration") {
+      o.duration = std::stod(value());
+    } else if (arg == "--stats") {
+      o.stats = value();
+    } else if (arg == "--seed") {
+      o.seed = static_cast<unsigned>(std::stoul(value()));
+    } else {
+      throw std::invalid_argument("Unknown option: " + arg);
+    }
+  }
+  if (o.bitrate <= 0 || o.load < 0 || o.load > 100 ||
+      o.warningsPerMinute < 0 || o.burstEvery < 0 || o.burstFrames < 0 ||
+      o.stormEvery < 0 || o.stormWarnings < 0 || o.duration < 0) {
+    throw std::invalid_argument("Rates, counts and durations must not be "
+                                "negative; --load is 0-100");
+  }
+  return o;
+}
+
+int64_t monotonicMicros() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/// Stores value little-endian from bit startBit, as extractSignal() reads it
+void putSignal(uint8_t *data, int startBit, int length, uint64_t value) {
+  for (int bit = 0; bit < length; ++bit) {
+    const int at = startBit + bit;
+    if ((value >> bit) & 1) {
+      data[at / 8] |= static_cast<uint8_t>(1 << (at % 8));
+    } else {
+      data[at / 8] &= static_cast<uint8_t>(~(1 << (at % 8)));
+    }
+  }
+}
+
+/// Counters of the run, written to --stats
+struct Stats {
+  long long frames = 0;
+  long long warnings = 0;
+  long long bursts = 0;
+  long long storms = 0;
+  long long sendErrors = 0;
+  long long lastWarningUs = 0;
+
+  void write(const std::string &path) const {
+    if (path.empty()) {
+      return;
+    }
+    const std::string tmpPath = path + ".tmp";
+    {
+      std::ofstream out(tmpPath, std::ios::trunc);
+      out << "cangen_frames_total " << frames << "\n"
+          << "cangen_warnings_total " << warnings << "\n"
+          << "cangen_bursts_total " << bursts << "\n"
+          << "cangen_storms_total " << storms << "\n"
+          << "cangen_send_errors_total " << sendErrors << "\n"
+          << "cangen_last_warning_us " << lastWarningUs << "\n";
+    }
+    std::rename(tmpPath.c_str(), path.c_str());
+  }
+};
+
+class Sender {
+public:
+  Sender(const std::string &iface, Stats &stats) : stats_(stats) {
+    fd_ = ::socket(PF_CAN, SOCK_RAW | SOCK_CLOEXEC, CAN_RAW);
+    if (fd_ < 0) {
+      throw std::runtime_error(std::string("CAN socket: ") +
+                               std::strerror(errno));
+    }
+    ifreq ifr{};
+    std::strncpy(ifr.ifr_name, iface.c_str(), IFNAMSIZ - 1);
+    sockaddr_can addr{};
+    addr.can_family = AF_CAN;
+    if (::ioctl(fd_, SIOCGIFINDEX, &ifr) < 0 ||
+        (addr.can_ifindex = ifr.ifr_ifindex,
+         ::bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) <
+             0)) {
+      const std::string error = std::strerror(errno);
+      ::close(fd_);
+      throw std::runtime_error("Cannot bind to " + iface + ": " + error);
+    }
+  }
+  ~Sender() { ::close(fd_); }
+  Sender(const Sender &) = delete;
+  Sender &operator=(const Sender &) = delete;
+
+  void send(uint32_t id, const uint8_t *data) {
+    can_frame frame{};
+    frame.can_id = id;
+    frame.can_dlc = 8;
+    std::memcpy(frame.data, data, 8);
+    if (::write(fd_, &frame, sizeof(frame)) == sizeof(frame)) {
+      ++stats_.frames;
+    } else {
+      ++stats_.sendErrors; // Queue full: the frame is lost, as on a bus
+    }
+  }
+
+private:
+  int fd_ = -1;
+  Stats &stats_;
+};
+
+/// Vehicle speed of a repeating 10-minute drive cycle with two stops
+double cycleSpeed(double seconds) {
+  const double t = std::fmod(seconds, 600.0);
+  if (t < 60.0 || (t >= 300.0 && t < 330.0)) {
+    return 0.0; // Standing
+  }
+  if (t < 300.0) {
+    return 50.0 + 20.0 * std::sin(t / 15.0); // Urban
+  }
+  return 115.0 + 15.0 * std::sin(t / 40.0); // Highway
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options o;
+  std::vector<uint32_t> warningIds;
+  try {
+    o = parseArgs(argc, argv);
+    const Config config(o.config);
+    for (const auto &entry : parseCANWarnings(config.warningIds)) {
+      warningIds.push_back(static_cast<uint32_t>(entry.first));
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    usage();
+    return 2;
+  }
+  if (warningIds.empty() &&
+      (o.warningsPerMinute > 0 || (o.stormEvery > 0 && o.stormWarnings > 0))) {
+    std::cerr << "Error: No warning_ids configured" << std::endl;
+    return 2;
+  }
+
+  Stats stats;
+  try {
+    Sender sender(o.iface, stats);
+    std::mt19937 rng(o.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    static constexpr uint32_t FILLER_IDS[] = {0x0C4, 0x130, 0x1F5,
+                                              0x3C0, 0x520, 0x5E0};
+    const double framesPerSecond = o.load / 100.0 * o.bitrate / BITS_PER_FRAME;
+    // Signal frames: 50 speed + 3 per second
+    const double fillerPerSecond = std::max(0.0, framesPerSecond - 53.0);
+    const double warningChancePerTick =
+        o.warningsPerMinute / 60.0 * TICK_US / 1e6;
+
+    uint8_t data[8] = {};
+    double fillerDue = 0.0;
+    double odometerKm = 48213.0;
+    double tripKm = 0.0;
+    long long fillerCount = 0;
+    const int64_t startUs = monotonicMicros();
+    int64_t nextSpeedUs = startUs;
+    int64_t nextSecondUs = startUs;
+    const int64_t burstUs = static_cast<int64_t>(o.burstEvery * 1e6);
+    const int64_t stormUs = static_cast<int64_t>(o.stormEvery * 1e6);
+    int64_t nextBurstUs = burstUs > 0 ? startUs + burstUs : INT64_MAX;
+    int64_t nextStormUs = stormUs > 0 ? startUs + stormUs : INT64_MAX;
+    int stormLeft = 0;
+    int64_t nextStormWarningUs = INT64_MAX;
+    auto sendWarning = [&](int64_t nowUs) {
+      std::memset(data, 0, sizeof(data));
+      data[0] = static_cast<uint8_t>(stats.warnings);
+      sender.send(warningIds[rng() % warningIds.size()], data);
+      ++stats.warnings;
+      stats.lastWarningUs = nowUs;
+    };
+
+    for (int64_t tickUs = startUs;; tickUs += TICK_US) {
+      timespec deadline{static_cast<time_t>(tickUs / 1000000),
+                        static_cast<long>(tickUs % 1000000) * 1000};
+      ::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+      const int64_t nowUs = monotonicMicros();
+      const double elapsed = (nowUs - startUs) / 1e6;
+      if (o.duration > 0 && elapsed >= o.duration) {
+        break;
+      }
+
+      const double speed = cycleSpeed(elapsed);
+      if (nowUs >= nextSpeedUs) {
+        std::memset(data, 0, sizeof(data));
+        putSignal(data, 16, 16, static_cast<uint64_t>(speed * 64.0));
+        sender.send(0x1A1, data); // ESC_V_VEH
+        nextSpeedUs += 20000;
+      }
+      if (nowUs >= nextSecondUs) {
+        odometerKm += speed / 3600.0;
+        tripKm += speed / 3600.0;
+        std::memset(data, 0, sizeof(data));
+        putSignal(data, 0, 32, static_cast<uint64_t>(odometerKm * 1000.0));
+        sender.send(0x19D, data); // IC_Kilometerstand_2
+        std::memset(data, 0, sizeof(data));
+        putSignal(data, 32, 17, static_cast<uint64_t>(tripKm * 10.0));
+        sender.send(0x3F3, data); // IC_BORD_COMP_TRIP_A
+        const std::time_t now = std::time(nullptr);
+        std::tm tm{};
+        localtime_r(&now, &tm);
+        std::memset(data, 0, sizeof(data));
+        putSignal(data, 0, 8, static_cast<uint64_t>(tm.tm_hour));
+        putSignal(data, 8, 8, static_cast<uint64_t>(tm.tm_min));
+        putSignal(data, 16, 8, static_cast<uint64_t>(tm.tm_sec));
+        putSignal(data, 24, 8, static_cast<uint64_t>(tm.tm_mday));
+        putSignal(data, 36, 4, static_cast<uint64_t>(tm.tm_mon + 1));
+        putSignal(data, 40, 16, static_cast<uint64_t>(tm.tm_year + 1900));
+        sender.send(0x2F8, data); // IC_UHRZEIT_DATUM
+        nextSecondUs += 1000000;
+        stats.write(o.stats);
+      }
+
+      fillerDue += fillerPerSecond * TICK_US / 1e6;
+      int fillers = static_cast<int>(fillerDue);
+      fillerDue -= fillers;
+      if (nowUs >= nextBurstUs) {
+        fillers += o.burstFrames;
+        ++stats.bursts;
+        nextBurstUs += burstUs;
+      }
+      for (int i = 0; i < fillers; ++i, ++fillerCount) {
+        std::memset(data, static_cast<int>(fillerCount & 0xFF), sizeof(data));
+        sender.send(FILLER_IDS[fillerCount % 6], data);
+      }
+
+      if (warningChancePerTick > 0 && uniform(rng) < warningChancePerTick) {
+        sendWarning(nowUs);
+      }
+      if (nowUs >= nextStormUs) {
+        stormLeft = o.stormWarnings;
+        nextStormWarningUs = nowUs;
+        ++stats.storms;
+        nextStormUs += stormUs;
+      }
+      if (stormLeft > 0 && nowUs >= nextStormWarningUs) {
+        sendWarning(nowUs);
+        --stormLeft;
+        nextStormWarningUs += STORM_SPACING_US;
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  stats.write(o.stats);
+  std::cerr << stats.frames << " frames, " << stats.warnings << " warnings, "
+            << stats.sendErrors << " send errors" << std::endl;
+  return 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file dacl-extract.cpp
+ * @brief Lists and extracts the components of an event bundle
+ *
+ * Usage:
+ *   dacl-extract BUNDLE                      list the components
+ *   dacl-extract BUNDLE --out DIR [NAME...]  extract all or the named ones
+ *   dacl-extract BUNDLE --cat NAME           write one component to stdout
+ *
+ * Components keep their names below DIR, e.g. DIR/front/pretrigger_0.mp4;
+ * can.log is a candump log that canplayer can replay.
+ *
+ * Example: the CAN slice and metadata of one event
+ *   dacl-extract 20240915_143012_ESC.dacl --out /tmp/esc can.log event.ini
+ */
+
+#include "EventBundle.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::string bundle;
+  std::string outDir;
+  std::string catName;
+  std::vector<std::string> names;
+};
+
+void usage() {
+  std::cerr << "Usage: dacl-extract BUNDLE\n"
+               "       dacl-extract BUNDLE --out DIR [NAME...]\n"
+               "       dacl-extract BUNDLE --cat NAME\n";
+}
+
+Options parseArgs(int argc, char *argv[]) {
+  Options o;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+    if (arg == "--out") {
+      o.outDir = value();
+    } else if (arg == "--cat") {
+      o.catName = value();
+    } else if (!arg.empty() && arg[0] == '-') {
+      throw std::invalid_argument("Unknown option: " + arg);
+    } else if (o.bundle.empty()) {
+      o.bundle = arg;
+    } else {
+      o.names.push_back(arg);
+    }
+  }
+  if (o.bundle.empty()) {
+    throw std::invalid_argument("Missing bundle");
+  }
+  if (!o.names.empty() && o.outDir.empty()) {
+    throw std::invalid_argument("Component names need --out");
+  }
+  return o;
+}
+
+const char *kindName(uint32_t kind) {
+  switch (static_cast<BundleKind>(kind)) {
+  case BundleKind::Metadata:
+    return "metadata";
+  case BundleKind::Video:
+    return "video";
+  case BundleKind::FrameIndex:
+    return "frame-index";
+  case BundleKind::CanLog:
+    return "can-log";
+  case BundleKind::Signals:
+    return "signals";
+  case BundleKind::Overlay:
+    return "overlay";
+  }
+  return "unknown";
+}
+
+size_t findComponent(const EventBundleReader &bundle, const std::string &name) {
+  const size_t i = bundle.find(name);
+  if (i == bundle.size()) {
+    throw std::runtime_error("No component " + name);
+  }
+  return i;
+}
+
+void extract(const EventBundleReader &bundle, size_t i,
+             const std::filesystem::path &outDir) {
+  const std::string name = bundle.name(i);
+  // Names come from the bundle; keep them below the output directory
+  const std::filesystem::path relative =
+      std::filesystem::path(name).lexically_normal();
+  if (relative.empty() || relative.is_absolute() ||
+      *relative.begin() == "..") {
+    throw std::runtime_error("Refusing to extract " + name);
+  }
+  const std::filesystem::path target = outDir / relative;
+  std::filesystem::create_directories(target.parent_path());
+  std::ofstream out(target, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(bundle.data(i)),
+            static_cast<std::streamsize>(bundle.entry(i).size));
+  if (!out) {
+    throw std::runtime_error("Cannot write " + target.string());
+  }
+  std::cout << target.string() << "\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options o;
+  try {
+    o = parseArgs(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    usage();
+    return 2;
+  }
+
+  try {
+    EventBundleReader bundle(o.bundle);
+    if (!o.catName.empty()) {
+      const size_t i = findComponent(bundle, o.catName);
+      std::cout.write(reinterpret_cast<const char *>(bundle.data(i)),
+                      static_cast<std::streamsize>(bundle.entry(i).size));
+    } else if (!o.outDir.empty()) {
+      if (o.names.empty()) {
+        for (size_t i = 0; i < bundle.size(); ++i) {
+          extract(bundle, i, o.outDir);
+        }
+      }
+      for (const auto &name : o.names) {
+        extract(bundle, findComponent(bundle, name), o.outDir);
+      }
+    } else {
+      for (size_t i = 0; i < bundle.size(); ++i) {
+        const BundleEntry &e = bundle.entry(i);
+        std::cout << std::left << std::setw(12) << kindName(e.kind)
+                  << std::right << std::setw(12) << e.size << "  "
+                  << bundle.name(i) << "\n";
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
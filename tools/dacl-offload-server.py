@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Stand-in offload endpoint for testing DaCL event uploads.
+
+Usage:
+  dacl-offload-server.py [--port 8080] [--root offload] [--fail-every N]
+
+Implements the protocol of OffloadManager below the URL prefix /dacl:
+  POST /dacl/chunks/missing        digests in, missing digests out
+  PUT  /dacl/chunks/<sha256>       stores a chunk after checking its digest
+  PUT  /dacl/events/<event>/<file> assembles a file from its chunk list
+  POST /dacl/events/<event>/complete  records the event's file list
+
+Chunks are kept in ROOT/chunks, assembled files in ROOT/events/<event>.
+--fail-every N answers every Nth chunk upload with 503, to exercise
+resumption. Point DaCL at it with offload_url=http://<host>:<port>/dacl
+"""
+
+import argparse
+import hashlib
+import os
+import re
+import threading
+import urllib.parse
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+PREFIX = "/dacl"
+DIGEST = re.compile(r"^[0-9a-f]{64}$")
+
+
+def safe_name(name):
+    return name not in ("", ".", "..") and "/" not in name
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    counter_lock = threading.Lock()
+    chunk_puts = 0
+
+    def reply(self, status, body=b""):
+        self.send_response(status)
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("Connection", "close")
+        self.end_headers()
+        self.wfile.write(body)
+        self.close_connection = True
+
+    def read_body(self):
+        return self.rfile.read(int(self.headers.get("Content-Length", 0)))
+
+    def parts(self):
+        path = urllib.parse.urlsplit(self.path).path
+        if not path.startswith(PREFIX + "/"):
+            return None
+        return [urllib.parse.unquote(p) for p in
+                path[len(PREFIX) + 1:].split("/")]
+
+    def chunk_path(self, digest):
+        return os.path.join(self.server.root, "chunks", digest)
+
+    def event_dir(self, event):
+        return os.path.join(self.server.root, "events", event)
+
+    def do_POST(self):
+        parts = self.parts()
+        body = self.read_body()
+        if parts == ["chunks", "missing"]:
+            digests = body.decode().split()
+            missing = [d for d in digests if DIGEST.match(d) and
+                       not os.path.exists(self.chunk_path(d))]
+            self.reply(200, "".join(d + "\n" for d in missing).encode())
+        elif parts and len(parts) == 3 and parts[0] == "events" and \
+                parts[2] == "complete" and safe_name(parts[1]):
+            directory = self.event_dir(parts[1])
+            os.makedirs(directory, exist_ok=True)
+            with open(os.path.join(directory, "COMPLETE"), "wb") as f:
+                f.write(body)
+            self.reply(201)
+        else:
+            self.reply(404)
+
+    def do_PUT(self):
+        parts = self.parts()
+        body = self.read_body()
+        if parts and len(parts) == 2 and parts[0] == "chunks" and \
+                DIGEST.match(parts[1]):
+            with Handler.counter_lock:
+                Handler.chunk_puts += 1
+                fail = self.server.fail_every and \
+                    Handler.chunk_puts % self.server.fail_every == 0
+            if fail:
+                self.reply(503)
+            elif hashlib.sha256(body).hexdigest() != parts[1]:
+                self.reply(400, b"digest mismatch\n")
+            else:
+                tmp = "%s.%d.tmp" % (self.chunk_path(parts[1]),
+                                     threading.get_ident())
+                with open(tmp, "wb") as f:
+                    f.write(body)
+                os.replace(tmp, self.chunk_path(parts[1]))
+                self.reply(201)
+        elif parts and len(parts) == 3 and parts[0] == "events" and \
+                safe_name(parts[1]) and safe_name(parts[2]):
+            lines = body.decode().split("\n")
+            size = int(lines[0].split()[1])
+            digests = [d for d in lines[1:] if d]
+            if any(not os.path.exists(self.chunk_path(d)) for d in digests):
+                self.reply(409, b"missing chunks\n")
+                return
+            directory = self.event_dir(parts[1])
+            os.makedirs(directory, exist_ok=True)
+            target = os.path.join(directory, parts[2])
+            with open(target + ".tmp", "wb") as out:
+                for d in digests:
+                    with open(self.chunk_path(d), "rb") as chunk:
+                        out.write(chunk.read())
+            if os.path.getsize(target + ".tmp") != size:
+                os.remove(target + ".tmp")
+                self.reply(400, b"size mismatch\n")
+                return
+            os.replace(target + ".tmp", target)
+            self.reply(201)
+        else:
+            self.reply(404)
+
+    def log_message(self, fmt, *args):
+        print("%s %s" % (self.address_string(), fmt % args), flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--root", default="offload")
+    parser.add_argument("--fail-every", type=int, default=0)
+    args = parser.parse_args()
+
+    os.makedirs(os.path.join(args.root, "chunks"), exist_ok=True)
+    os.makedirs(os.path.join(args.root, "events"), exist_ok=True)
+    server = ThreadingHTTPServer(("", args.port), Handler)
+    server.root = args.root
+    server.fail_every = args.fail_every
+    print("Serving %s on port %d" % (args.root, args.port), flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
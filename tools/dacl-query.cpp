@@ -0,0 +1,156 @@
+/**
+ * @file dacl-query.cpp
+ * @brief Command-line queries over the binary event index
+ *
+ * Usage:
+ *   dacl-query [--index logs/events.idx] [--csv logs/events.csv]
+ *              [--from TIME] [--to TIME] [--type TEXT] [--trigger TEXT]
+ *              [--min-speed KMH] [--max-speed KMH] [--count]
+ *
+ * TIME is YYYYMMDD or YYYYMMDD_HHMMSS. --type and --trigger match a
+ * substring of the warning type and trigger source. Matching events are
+ * printed as their original CSV lines, read directly at the offsets stored
+ * in the index; without the CSV file the index fields are printed instead.
+ *
+ * Example: all ESC events above 80 km/h in September 2024
+ *   dacl-query --from 20240901 --to 20240930_235959 --type ESC --min-speed 81
+ */
+
+#include "EventIndex.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+struct Query {
+  std::string indexFile = "logs/events.idx";
+  std::string csvFile = "logs/events.csv";
+  int64_t from = 0;
+  int64_t to = std::numeric_limits<int64_t>::max();
+  std::string type;
+  std::string trigger;
+  int minSpeed = std::numeric_limits<int>::min();
+  int maxSpeed = std::numeric_limits<int>::max();
+  bool countOnly = false;
+};
+
+void usage() {
+  std::cerr << "Usage: dacl-query [--index FILE] [--csv FILE] [--from TIME]"
+               " [--to TIME]\n"
+               "                  [--type TEXT] [--trigger TEXT]"
+               " [--min-speed KMH]\n"
+               "                  [--max-speed KMH] [--count]\n"
+               "TIME is YYYYMMDD or YYYYMMDD_HHMMSS\n";
+}
+
+int64_t parseTime(const std::string &value, bool endOfDay) {
+  int64_t packed = packTimestamp(value);
+  if (packed < 0) {
+    throw std::invalid_argument("Invalid time: " + value);
+  }
+  // A bare date as upper bound covers the whole day
+  if (endOfDay && value.size() == 8) {
+    packed += 235959;
+  }
+  return packed;
+}
+
+Query parseArgs(int argc, char *argv[]) {
+  Query q;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("Missing value for " + arg);
+      }
+      return argv[++i];
+    };
+    if (arg == "--index") {
+      q.indexFile = value();
+    } else if (arg == "--csv") {
+      q.csvFile = value();
+    } else if (arg == "--from") {
+      q.from = parseTime(value(), false);
+    } else if (arg == "--to") {
+      q.to = parseTime(value(), true);
+    } else if (arg == "--type") {
+      q.type = value();
+    } else if (arg == "--trigger") {
+      q.trigger = value();
+    } else if (arg == "--min-speed") {
+      q.minSpeed = std::stoi(value());
+    } else if (arg == "--max-speed") {
+      q.maxSpeed = std::stoi(value());
+    } else if (arg == "--count") {
+      q.countOnly = true;
+    } else {
+      throw std::invalid_argument("Unknown option: " + arg);
+    }
+  }
+  return q;
+}
+
+bool matches(const EventRecord &r, const Query &q) {
+  return r.speed >= q.minSpeed && r.speed <= q.maxSpeed &&
+         recordText(r.warning, sizeof(r.warning)).find(q.type) !=
+             std::string::npos &&
+         recordText(r.trigger, sizeof(r.trigger)).find(q.trigger) !=
+             std::string::npos;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Query q;
+  try {
+    q = parseArgs(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    usage();
+    return 2;
+  }
+
+  try {
+    EventIndexReader index(q.indexFile);
+    const int csvFd = ::open(q.csvFile.c_str(), O_RDONLY | O_CLOEXEC);
+    size_t count = 0;
+    std::string line;
+    for (const EventRecord *r : index.range(q.from, q.to)) {
+      if (!matches(*r, q)) {
+        continue;
+      }
+      ++count;
+      if (q.countOnly) {
+        continue;
+      }
+      line.resize(r->csvLength);
+      if (csvFd >= 0 &&
+          ::pread(csvFd, &line[0], line.size(),
+                  static_cast<off_t>(r->csvOffset)) ==
+              static_cast<ssize_t>(line.size())) {
+        std::cout << line;
+      } else {
+        std::cout << r->time << ","
+                  << recordText(r->trigger, sizeof(r->trigger)) << ","
+                  << recordText(r->warning, sizeof(r->warning)) << ","
+                  << r->speed << "\n";
+      }
+    }
+    if (csvFd >= 0) {
+      ::close(csvFd);
+    }
+    if (q.countOnly) {
+      std::cout << count << std::endl;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
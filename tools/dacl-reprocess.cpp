@@ -0,0 +1,324 @@
+/**
+ * @file dacl-reprocess.cpp
+ * @brief Re-runs CAN decoding and triggering over recorded CAN traces
+ *
+ * Usage:
+ *   dacl-reprocess [--config configs/config.ini] [--warnings "ID,Name;..."]
+ *                  [--pre MIN] [--post MIN] [--threads N]
+ *                  [--manifest FILE]... [--out DIR] [TRACE...]
+ *
+ * TRACE is a candump log: the files written to can_trace_dir, can.log of an
+ * event bundle or the output of candump -l. Without TRACE, every can_*.log
+ * in can_trace_dir is read. Files are replayed in the order of their first
+ * frame and must not overlap in time.
+ *
+ * The warning mapping (warning_ids, or --warnings to try a new one) and the
+ * trigger rule of the live system are applied; each resulting event is
+ * printed as "timestamp,trigger,warning,speed,trigger_us" with the
+ * recorded segments covering its pre/post-trigger window. The segments are
+ * found through the segment manifests, as dacl-search does. With --out,
+ * the segments are linked (or copied) into DIR under the names of exported
+ * events, and the event list is written to DIR/events.csv.
+ *
+ * The traces are cut into slices that --threads workers (default: all
+ * cores) decode independently; the result does not depend on the number
+ * of threads. Throughput is reported in frames per second.
+ *
+ * Example: what a new mapping of 0x4A2 would have raised last month
+ *   dacl-reprocess --warnings "0x4A2,WarningMsg_LKA" --out /tmp/lka
+ */
+
+#include "CanFrameRing.hpp"
+#include "SegmentSearch.hpp"
+#include "TraceReplay.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/// Slices handed to each worker, so uneven slices still balance
+constexpr size_t SLICES_PER_THREAD = 8;
+/// Smallest slice worth a hand-off
+constexpr size_t MIN_SLICE_BYTES = 1 << 20;
+
+void usage() {
+  std::cerr << "Usage: dacl-reprocess [--config FILE] [--warnings SPEC]"
+               " [--pre MIN] [--post MIN]\n"
+               "                      [--threads N] [--manifest FILE]..."
+               " [--out DIR] [TRACE...]\n"
+               "SPEC is \"ID,Name;ID,Name\" as warning_ids\n";
+}
+
+/// A trace file mapped read-only
+class MappedTrace {
+public:
+  explicit MappedTrace(const std::string &path) : path_(path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st {};
+    if (fd < 0 || ::fstat(fd, &st) != 0) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      throw std::runtime_error("Cannot open " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+      data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+      throw std::runtime_error("Cannot map " + path);
+    }
+    if (data_ != nullptr) {
+      ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+  }
+  ~MappedTrace() {
+    if (data_ != nullptr && data_ != MAP_FAILED) {
+      ::munmap(data_, size_);
+    }
+  }
+  MappedTrace(const MappedTrace &) = delete;
+  MappedTrace &operator=(const MappedTrace &) = delete;
+
+  const std::string &path() const { return path_; }
+  TraceSlice text() const {
+    const char *begin = static_cast<const char *>(data_);
+    return {begin, begin + size_};
+  }
+  size_t size() const { return size_; }
+
+  /// Receive time of the first frame, for ordering the files
+  int64_t firstUs() const {
+    const TraceSlice all = text();
+    CanFrameRecord frame;
+    for (const char *cursor = all.begin; cursor < all.end;) {
+      if (parseCandump(cursor, all.end, frame)) {
+        return frame.rxUs;
+      }
+    }
+    return 0;
+  }
+
+private:
+  const std::string path_;
+  void *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+/// The segments recorded within [fromUs, toUs]
+std::vector<SegmentInfo> segmentsIn(const std::vector<std::string> &manifests,
+                                    int64_t fromUs, int64_t toUs) {
+  SegmentQuery query;
+  query.fromUs = fromUs;
+  query.toUs = toUs;
+  return searchSegments(manifests, query);
+}
+
+/// Links a segment into DIR, copying it if linking is not possible
+void exportSegment(const std::string &from, const std::string &to) {
+  std::error_code ec;
+  std::filesystem::create_hard_link(from, to, ec);
+  if (ec) {
+    std::filesystem::copy_file(
+        from, to, std::filesystem::copy_options::overwrite_existing);
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string configFile = "configs/config.ini";
+  std::string warnings;
+  std::string outDir;
+  int preMin = -1;
+  int postMin = -1;
+  unsigned threads = std::max(1U, std::thread::hardware_concurrency());
+  std::vector<std::string> manifests;
+  std::vector<std::string> tracePaths;
+  std::map<int, std::string> idToWarning;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      auto value = [&]() -> std::string {
+        if (i + 1 >= argc) {
+          throw std::invalid_argument("Missing value for " + arg);
+        }
+        return argv[++i];
+      };
+      if (arg == "--config") {
+        configFile = value();
+      } else if (arg == "--warnings") {
+        warnings = value();
+      } else if (arg == "--pre") {
+        preMin = std::stoi(value());
+      } else if (arg == "--post") {
+        postMin = std::stoi(value());
+      } else if (arg == "--threads") {
+        const int n = std::stoi(value());
+        if (n <= 0) {
+          throw std::invalid_argument("--threads must be positive");
+        }
+        threads = static_cast<unsigned>(n);
+      } else if (arg == "--manifest") {
+        manifests.push_back(value());
+      } else if (arg == "--out") {
+        outDir = value();
+      } else if (!arg.empty() && arg[0] == '-') {
+        throw std::invalid_argument("Unknown option: " + arg);
+      } else {
+        tracePaths.push_back(arg);
+      }
+    }
+
+    const Config config(configFile);
+    idToWarning =
+        parseCANWarnings(warnings.empty() ? config.warningIds : warnings);
+    if (preMin < 0) {
+      preMin = config.pretriggerMinutes;
+    }
+    if (postMin < 0) {
+      postMin = config.posttriggerMinutes;
+    }
+    if (manifests.empty()) {
+      for (const auto &camera : config.cameras) {
+        manifests.push_back(camera.bufferDir + "/segments.manifest");
+      }
+      manifests.push_back(config.eventDir + "/segments.manifest");
+    }
+    if (tracePaths.empty() && !config.canTraceDir.empty()) {
+      std::error_code ec;
+      for (const auto &entry :
+           std::filesystem::directory_iterator(config.canTraceDir, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, 4, "can_") == 0 &&
+            entry.path().extension() == ".log") {
+          tracePaths.push_back(entry.path().string());
+        }
+      }
+    }
+    if (tracePaths.empty()) {
+      throw std::invalid_argument("No CAN traces given and none in "
+                                  "can_trace_dir");
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    usage();
+    return 2;
+  }
+
+  try {
+    std::vector<std::unique_ptr<MappedTrace>> traces;
+    size_t totalBytes = 0;
+    for (const auto &path : tracePaths) {
+      traces.push_back(std::make_unique<MappedTrace>(path));
+      totalBytes += traces.back()->size();
+    }
+    std::vector<std::pair<int64_t, const MappedTrace *>> ordered;
+    for (const auto &trace : traces) {
+      ordered.emplace_back(trace->firstUs(), trace.get());
+    }
+    std::stable_sort(ordered.begin(), ordered.end(),
+                     [](const auto &a, const auto &b) {
+                       return a.first < b.first;
+                     });
+
+    // Time ranges of roughly equal size, many more than threads
+    const size_t sliceBytes = std::max(
+        MIN_SLICE_BYTES, totalBytes / (threads * SLICES_PER_THREAD) + 1);
+    std::vector<TraceSlice> slices;
+    for (const auto &entry : ordered) {
+      TraceReplay::split(entry.second->text(), sliceBytes, slices);
+    }
+
+    const TraceReplay replay(idToWarning, postMin);
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<TracePartition> partitions =
+        replay.decodeAll(slices, threads);
+    const std::vector<ReplayEvent> events = replay.merge(partitions);
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    uint64_t frames = 0;
+    uint64_t decoded = 0;
+    uint64_t malformed = 0;
+    for (const auto &partition : partitions) {
+      frames += partition.frames;
+      decoded += partition.decoded;
+      malformed += partition.malformed;
+    }
+
+    std::ofstream csv;
+    if (!outDir.empty()) {
+      std::filesystem::create_directories(outDir);
+      csv.open(outDir + "/events.csv");
+      if (!csv) {
+        throw std::runtime_error("Cannot write " + outDir + "/events.csv");
+      }
+      csv << "Timestamp,TriggerType,WarningType,Speed,TriggerUs,"
+             "PreTriggerFiles,PostTriggerFiles\n";
+    }
+    for (const auto &event : events) {
+      std::cout << event.timestamp << ",CAN," << event.warning << ","
+                << event.speed << "," << event.triggerUs << "\n";
+      const int64_t preUs = static_cast<int64_t>(preMin) * 60 * 1000000;
+      const int64_t postUs = static_cast<int64_t>(postMin) * 60 * 1000000;
+      std::string preFiles;
+      std::string postFiles;
+      size_t preIndex = 0;
+      size_t postIndex = 0;
+      for (const auto &segment : segmentsIn(
+               manifests, event.triggerUs - preUs, event.triggerUs + postUs)) {
+        // The segment holding the trigger belongs to the pre-trigger part
+        const bool pre = segment.startUs <= event.triggerUs;
+        std::cout << "  " << (pre ? "pre  " : "post ") << segment.path
+                  << "\n";
+        if (outDir.empty()) {
+          continue;
+        }
+        const std::string name =
+            event.timestamp + "_" + event.warning +
+            (pre ? "_pretrigger_" + std::to_string(preIndex++)
+                 : "_posttrigger_" + std::to_string(postIndex++)) +
+            ".mp4";
+        exportSegment(segment.path, outDir + "/" + name);
+        std::string &list = pre ? preFiles : postFiles;
+        list += (list.empty() ? "" : ";") + name;
+      }
+      if (csv.is_open()) {
+        csv << event.timestamp << ",CAN," << event.warning << ","
+            << event.speed << "," << event.triggerUs << "," << preFiles
+            << "," << postFiles << "\n";
+      }
+    }
+
+    std::cerr << events.size() << " events from " << frames << " frames ("
+              << decoded << " decoded, " << malformed << " malformed lines) in "
+              << traces.size() << " traces\n"
+              << std::fixed << std::setprecision(2) << seconds << " s on "
+              << threads << " threads, " << std::setprecision(0)
+              << frames / std::max(seconds, 1e-9) << " frames/s, "
+              << std::setprecision(1)
+              << totalBytes / std::max(seconds, 1e-9) / (1 << 20) << " MB/s"
+              << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
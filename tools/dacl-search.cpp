@@ -0,0 +1,183 @@
+/**
+ * @file dacl-search.cpp
+ * @brief Command-line search of recorded segments by CAN signal summaries
+ *
+ * Usage:
+ *   dacl-search [--config configs/config.ini] [--manifest FILE]...
+ *               [--from TIME] [--to TIME] [--at TIME] [--speed-above KMH]
+ *               [--speed-below KMH] [--warning TEXT]
+ *
+ * Without --manifest, the buffer journal of every configured camera and the
+ * event journal of event_dir are searched. TIME is local time as YYYYMMDD or
+ * YYYYMMDD_HHMMSS, optionally with fractional seconds (.250).
+ *
+ * --at finds the segments recorded at one instant and, from their frame
+ * index sidecars, the frame shown at that instant: its presentation time,
+ * byte range and the keyframe decoding has to start from.
+ *
+ * Examples: every segment where the speed exceeded 120 km/h, and the frame
+ * recorded at 12:03:41.250
+ *   dacl-search --speed-above 121
+ *   dacl-search --at 20240915_120341.250
+ */
+
+#include "FrameIndex.hpp"
+#include "SegmentSearch.hpp"
+#include "utils.hpp"
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+void usage() {
+  std::cerr << "Usage: dacl-search [--config FILE] [--manifest FILE]..."
+               " [--from TIME] [--to TIME]\n"
+               "                   [--at TIME] [--speed-above KMH]"
+               " [--speed-below KMH]\n"
+               "                   [--warning TEXT]\n"
+               "TIME is local time as YYYYMMDD or YYYYMMDD_HHMMSS[.fff]\n";
+}
+
+/// Converts YYYYMMDD[_HHMMSS[.fff]] local time to microseconds since the
+/// epoch
+int64_t parseTime(const std::string &text, bool endOfDay) {
+  std::string value = text;
+  int64_t fractionUs = 0;
+  const size_t dot = text.find('.');
+  if (dot != std::string::npos) {
+    value = text.substr(0, dot);
+    const std::string digits = text.substr(dot + 1);
+    if (digits.empty() || digits.size() > 6 ||
+        digits.find_first_not_of("0123456789") != std::string::npos) {
+      throw std::invalid_argument("Invalid time: " + text);
+    }
+    fractionUs = std::stoll(digits + std::string(6 - digits.size(), '0'));
+  }
+  std::tm tm{};
+  const char *end = strptime(value.c_str(), "%Y%m%d_%H%M%S", &tm);
+  if (end == nullptr || *end != '\0') {
+    tm = std::tm{};
+    end = strptime(value.c_str(), "%Y%m%d", &tm);
+    if (end == nullptr || *end != '\0' || fractionUs != 0) {
+      throw std::invalid_argument("Invalid time: " + text);
+    }
+    if (endOfDay) {
+      tm.tm_hour = 23;
+      tm.tm_min = 59;
+      tm.tm_sec = 59;
+    }
+  }
+  tm.tm_isdst = -1;
+  return static_cast<int64_t>(std::mktime(&tm)) * 1000000 + fractionUs;
+}
+
+std::string formatTime(int64_t us) {
+  const std::time_t t = static_cast<std::time_t>(us / 1000000);
+  std::tm tm{};
+  localtime_r(&t, &tm);
+  char buf[32];
+  std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+  return buf;
+}
+
+void print(const SegmentInfo &info) {
+  const SegmentSummary &s = info.summary;
+  std::cout << formatTime(info.startUs) << "  "
+            << (info.endUs - info.startUs) / 1000000 << "s  ";
+  if (s.speedSamples > 0) {
+    std::cout << "speed " << s.minSpeed << "/" << std::fixed
+              << std::setprecision(0) << s.meanSpeed() << "/" << s.maxSpeed
+              << " km/h  ";
+  }
+  if (s.odometerEnd > 0) {
+    std::cout << "odo " << s.odometerStart << "-" << s.odometerEnd << " km  ";
+  }
+  for (const auto &warning : s.warnings) {
+    std::cout << warning.first << "x" << warning.second << " ";
+  }
+  std::cout << info.path << "\n";
+}
+
+/// Prints the frame of a segment shown at atUs, from its sidecar
+void printFrame(const SegmentInfo &info, int64_t atUs) {
+  try {
+    const FrameIndex index(info.path);
+    const size_t frame = index.findSystemTime(atUs);
+    if (frame == index.size()) {
+      std::cout << "  no frame at this time\n";
+      return;
+    }
+    const FrameRecord &r = index[frame];
+    const FrameRecord &key = index[index.keyframeBefore(frame)];
+    std::cout << "  frame " << frame << "  pts " << r.ptsUs / 1000
+              << " ms  bytes " << r.offset << "+" << r.size << "  keyframe pts "
+              << key.ptsUs / 1000 << " ms at byte " << key.offset << "\n";
+  } catch (const std::exception &e) {
+    std::cout << "  " << e.what() << "\n";
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string configFile = "configs/config.ini";
+  std::vector<std::string> manifests;
+  SegmentQuery query;
+  int64_t atUs = -1;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      auto value = [&]() -> std::string {
+        if (i + 1 >= argc) {
+          throw std::invalid_argument("Missing value for " + arg);
+        }
+        return argv[++i];
+      };
+      if (arg == "--config") {
+        configFile = value();
+      } else if (arg == "--manifest") {
+        manifests.push_back(value());
+      } else if (arg == "--from") {
+        query.fromUs = parseTime(value(), false);
+      } else if (arg == "--to") {
+        query.toUs = parseTime(value(), true);
+      } else if (arg == "--at") {
+        atUs = parseTime(value(), false);
+        query.fromUs = query.toUs = atUs;
+      } else if (arg == "--speed-above") {
+        query.speedAbove = std::stoi(value());
+      } else if (arg == "--speed-below") {
+        query.speedBelow = std::stoi(value());
+      } else if (arg == "--warning") {
+        query.warning = value();
+      } else {
+        throw std::invalid_argument("Unknown option: " + arg);
+      }
+    }
+    if (manifests.empty()) {
+      const Config config(configFile);
+      for (const auto &camera : config.cameras) {
+        manifests.push_back(camera.bufferDir + "/segments.manifest");
+      }
+      manifests.push_back(config.eventDir + "/segments.manifest");
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    usage();
+    return 2;
+  }
+
+  const auto segments = searchSegments(manifests, query);
+  for (const auto &info : segments) {
+    print(info);
+    if (atUs >= 0) {
+      printFrame(info, atUs);
+    }
+  }
+  std::cerr << segments.size() << " matching segments" << std::endl;
+  return 0;
+}
@@ -0,0 +1,343 @@
+#!/usr/bin/env python3
+"""Soak test of the DaCL daemon under synthetic CAN load and trigger storms.
+
+Usage:
+  dacl-soak.py [--config configs/soak.ini] [--out DIR] [--duration MIN]
+
+Runs the real dacl binary for duration_minutes with the settings of
+base_config overridden by [Dacl] (typically video_source=testpattern), in a
+run directory of its own: DIR/configs/config.ini, the buffer, events, CAN
+trace and metrics all live below DIR. dacl-cangen meanwhile loads the CAN
+interface with vehicle signals, filler traffic, random warnings, bursts and
+trigger storms; console storms are typed into dacl's stdin.
+
+Every sample_seconds the metrics file, dacl-cangen's counters and dacl's
+RSS and open file descriptors are appended to DIR/timeline.csv. At the end
+the run is judged against [Thresholds]: frame gaps, dropped frames, CAN
+loss, trigger latency, export backlog, RSS growth (a least-squares slope
+after warmup_minutes) and fd growth. DIR/report.txt lists each check as
+PASS or FAIL; the exit code is 0 if all passed, 1 otherwise, 2 if the run
+could not be set up.
+
+The CAN interface must exist, e.g. as root:
+  ip link add dev vcan0 type vcan && ip link set up vcan0
+"""
+
+import argparse
+import configparser
+import csv
+import os
+import re
+import signal
+import subprocess
+import sys
+import time
+
+# Run-directory paths forced into the dacl configuration
+RUN_PATHS = {
+    "buffer_dir": "buffer",
+    "event_dir": "events",
+    "can_trace_dir": "can",
+    "metrics_file": "metrics.prom",
+}
+# Timeline columns besides the per-camera sums
+TIMELINE_METRICS = [
+    "dacl_can_frames_total",
+    "dacl_can_rx_dropped_total",
+    "dacl_can_warnings_total",
+    "dacl_can_warnings_coalesced_total",
+    "dacl_trigger_events_total",
+    "dacl_trigger_latency_max_us",
+    "dacl_capture_backlog_permille",
+    "dacl_copy_inflight_bytes",
+    "dacl_export_paused_ms_total",
+]
+SHUTDOWN_TIMEOUT_S = 60
+
+
+def read_metrics(path):
+    """Parses "name value" lines; labelled info lines are skipped."""
+    values = {}
+    try:
+        with open(path) as f:
+            for line in f:
+                parts = line.split()
+                if len(parts) == 2 and "{" not in parts[0]:
+                    try:
+                        values[parts[0]] = int(parts[1])
+                    except ValueError:
+                        pass
+    except OSError:
+        pass
+    return values
+
+
+def camera_sum(metrics, suffix, combine=sum):
+    found = [v for k, v in metrics.items()
+             if k.startswith("dacl_camera_") and k.endswith("_" + suffix)]
+    return combine(found) if found else 0
+
+
+def process_status(pid):
+    """RSS in kB and open file descriptors of a live process."""
+    rss = 0
+    try:
+        with open("/proc/%d/status" % pid) as f:
+            for line in f:
+                if line.startswith("VmRSS:"):
+                    rss = int(line.split()[1])
+        fds = len(os.listdir("/proc/%d/fd" % pid))
+    except OSError:
+        return None
+    return rss, fds
+
+
+def write_config(base_path, overrides, out_path):
+    """Copies base_path with overridden keys replaced or appended."""
+    pending = dict(overrides)
+    lines = []
+    with open(base_path) as f:
+        for line in f:
+            match = re.match(r"^\s*([A-Za-z0-9_]+)\s*=", line)
+            if match and match.group(1) in pending:
+                key = match.group(1)
+                lines.append("%s=%s\n" % (key, pending.pop(key)))
+            else:
+                lines.append(line)
+    if pending:
+        lines.append("\n[Soak]\n")
+        lines.extend("%s=%s\n" % item for item in pending.items())
+    os.makedirs(os.path.dirname(out_path), exist_ok=True)
+    with open(out_path, "w") as f:
+        f.writelines(lines)
+
+
+def slope_per_hour(points):
+    """Least-squares slope of (seconds, value) points, per hour."""
+    if len(points) < 2:
+        return 0.0
+    n = len(points)
+    mean_t = sum(t for t, _ in points) / n
+    mean_v = sum(v for _, v in points) / n
+    var = sum((t - mean_t) ** 2 for t, _ in points)
+    if var == 0:
+        return 0.0
+    cov = sum((t - mean_t) * (v - mean_v) for t, v in points)
+    return cov / var * 3600.0
+
+
+def judge(samples, final, sent, hours, warmup_s, thresholds):
+    """Returns (name, value, limit) checks and informational lines."""
+    after = [s for s in samples if s["elapsed"] >= warmup_s] or samples
+    received = final.get("dacl_can_frames_total", 0)
+    values = {
+        "max_frame_gap_ms":
+            camera_sum(final, "frame_gap_max_us", max) / 1000.0,
+        "max_frame_gaps_per_hour":
+            camera_sum(final, "frame_gaps_total") / hours,
+        "max_dropped_frames_per_hour":
+            camera_sum(final, "dropped_frames_total") / hours,
+        "max_can_loss_permille":
+            max(0, sent - received) * 1000.0 / sent if sent else 0.0,
+        "max_can_rx_dropped": final.get("dacl_can_rx_dropped_total", 0),
+        "max_trigger_latency_ms":
+            final.get("dacl_trigger_latency_max_us", 0) / 1000.0,
+        "max_capture_backlog_permille":
+            max([s["dacl_capture_backlog_permille"] for s in samples] or [0]),
+        "max_export_paused_seconds_per_hour":
+            final.get("dacl_export_paused_ms_total", 0) / 1000.0 / hours,
+        "max_rss_growth_mb_per_hour":
+            slope_per_hour([(s["elapsed"], s["rss_kb"] / 1024.0)
+                            for s in after]),
+        "max_fd_growth":
+            max(s["fds"] for s in after) - after[0]["fds"] if after else 0,
+    }
+    checks = [(name, values[name], float(limit))
+              for name, limit in thresholds.items() if name in values]
+    info = [
+        "CAN frames sent %d, received %d" % (sent, received),
+        "CAN warnings %d, coalesced %d, trigger events %d" % (
+            final.get("dacl_can_warnings_total", 0),
+            final.get("dacl_can_warnings_coalesced_total", 0),
+            final.get("dacl_trigger_events_total", 0)),
+        "Video frames %d in %d segments, %d capture failures" % (
+            camera_sum(final, "frames_total"),
+            camera_sum(final, "segments_total"),
+            camera_sum(final, "capture_failures_total")),
+    ]
+    if after:
+        info.append("RSS %.1f -> %.1f MB, fds %d -> %d after warm-up" % (
+            after[0]["rss_kb"] / 1024.0, after[-1]["rss_kb"] / 1024.0,
+            after[0]["fds"], after[-1]["fds"]))
+    return checks, info
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--config", default="configs/soak.ini")
+    parser.add_argument("--out",
+                        default=time.strftime("soak_%Y%m%d_%H%M%S"))
+    parser.add_argument("--duration", type=float,
+                        help="minutes, overrides duration_minutes")
+    args = parser.parse_args()
+
+    ini = configparser.ConfigParser(interpolation=None)
+    ini.optionxform = str
+    if not ini.read(args.config):
+        print("Error: Cannot read %s" % args.config, file=sys.stderr)
+        return 2
+    soak = ini["Soak"]
+    duration_s = 60.0 * (args.duration if args.duration is not None
+                         else soak.getfloat("duration_minutes"))
+    warmup_s = 60.0 * soak.getfloat("warmup_minutes", 0)
+    sample_s = soak.getfloat("sample_seconds", 5)
+    storm_s = 60.0 * soak.getfloat("console_storm_every_minutes", 0)
+    storm_triggers = soak.getint("console_storm_triggers", 5)
+
+    run_dir = os.path.abspath(args.out)
+    overrides = dict(ini["Dacl"]) if ini.has_section("Dacl") else {}
+    overrides["can_iface"] = soak.get("can_iface", "vcan0")
+    overrides.setdefault("metrics_interval_seconds", "1")
+    for key, path in RUN_PATHS.items():
+        overrides[key] = os.path.join(run_dir, path)
+    dacl_config = os.path.join(run_dir, "configs", "config.ini")
+    try:
+        os.makedirs(run_dir)
+        write_config(soak.get("base_config", "configs/config.ini"),
+                     overrides, dacl_config)
+    except OSError as e:
+        print("Error: %s" % e, file=sys.stderr)
+        return 2
+    metrics_path = overrides["metrics_file"]
+    stats_path = os.path.join(run_dir, "cangen.prom")
+
+    cangen_cmd = [
+        os.path.abspath(soak.get("cangen", "tools/dacl-cangen")),
+        "--config", dacl_config,
+        "--iface", overrides["can_iface"],
+        "--bitrate", soak.get("can_bitrate", "500000"),
+        "--load", soak.get("can_load_percent", "40"),
+        "--warnings-per-minute", soak.get("warnings_per_minute", "1"),
+        "--burst-every", soak.get("burst_every_seconds", "0"),
+        "--burst-frames", soak.get("burst_frames", "500"),
+        "--storm-every",
+        str(60.0 * soak.getfloat("storm_every_minutes", 0)),
+        "--storm-warnings", soak.get("storm_warnings", "20"),
+        "--duration", str(duration_s),
+        "--stats", stats_path,
+    ]
+    dacl_log = open(os.path.join(run_dir, "dacl.log"), "w")
+    cangen_log = open(os.path.join(run_dir, "cangen.log"), "w")
+    try:
+        dacl = subprocess.Popen(
+            [os.path.abspath(soak.get("dacl", "./dacl"))], cwd=run_dir,
+            stdin=subprocess.PIPE, stdout=dacl_log, stderr=subprocess.STDOUT)
+    except OSError as e:
+        print("Error: Cannot start dacl: %s" % e, file=sys.stderr)
+        return 2
+    time.sleep(2)  # CAN socket bound before the first frame
+    try:
+        cangen = subprocess.Popen(cangen_cmd, stdout=cangen_log,
+                                  stderr=subprocess.STDOUT)
+    except OSError as e:
+        print("Error: Cannot start dacl-cangen: %s" % e, file=sys.stderr)
+        dacl.kill()
+        return 2
+
+    samples = []
+    failures = []
+    start = time.monotonic()
+    next_storm = storm_s if storm_s > 0 else float("inf")
+    columns = (["elapsed", "rss_kb", "fds", "cangen_frames_total",
+                "frames", "dropped_frames", "frame_gaps", "frame_gap_max_us"]
+               + TIMELINE_METRICS)
+    with open(os.path.join(run_dir, "timeline.csv"), "w", newline="") as f:
+        timeline = csv.DictWriter(f, fieldnames=columns,
+                                  extrasaction="ignore")
+        timeline.writeheader()
+        while True:
+            time.sleep(sample_s)
+            elapsed = time.monotonic() - start
+            if dacl.poll() is not None:
+                failures.append("dacl exited with code %d after %.0f s" %
+                                (dacl.returncode, elapsed))
+                break
+            if elapsed >= next_storm:
+                try:
+                    dacl.stdin.write(b"t" * storm_triggers)
+                    dacl.stdin.flush()
+                except OSError:
+                    pass
+                next_storm += storm_s
+            status = process_status(dacl.pid)
+            if status is None:
+                continue
+            metrics = read_metrics(metrics_path)
+            sample = {name: metrics.get(name, 0)
+                      for name in TIMELINE_METRICS}
+            sample.update(
+                elapsed=round(elapsed, 1), rss_kb=status[0], fds=status[1],
+                cangen_frames_total=read_metrics(stats_path).get(
+                    "cangen_frames_total", 0),
+                frames=camera_sum(metrics, "frames_total"),
+                dropped_frames=camera_sum(metrics, "dropped_frames_total"),
+                frame_gaps=camera_sum(metrics, "frame_gaps_total"),
+                frame_gap_max_us=camera_sum(metrics, "frame_gap_max_us",
+                                            max))
+            samples.append(sample)
+            timeline.writerow(sample)
+            f.flush()
+            if cangen.poll() is not None:
+                break
+
+    if cangen.poll() is None:
+        cangen.terminate()
+    cangen.wait()
+    if cangen.returncode != 0:
+        failures.append("dacl-cangen exited with code %d (see cangen.log)" %
+                        cangen.returncode)
+    time.sleep(3)  # Last frames received and counted in the metrics file
+    final = read_metrics(metrics_path)
+    if dacl.poll() is None:
+        dacl.send_signal(signal.SIGINT)
+        try:
+            dacl.wait(SHUTDOWN_TIMEOUT_S)
+        except subprocess.TimeoutExpired:
+            dacl.kill()
+            dacl.wait()
+            failures.append("dacl did not shut down within %d s" %
+                            SHUTDOWN_TIMEOUT_S)
+
+    cangen_stats = read_metrics(stats_path)
+    hours = max(time.monotonic() - start, 1.0) / 3600.0
+    thresholds = dict(ini["Thresholds"]) if ini.has_section(
+        "Thresholds") else {}
+    checks, info = judge(samples, final,
+                         cangen_stats.get("cangen_frames_total", 0), hours,
+                         warmup_s, thresholds)
+    if cangen_stats.get("cangen_send_errors_total", 0):
+        info.append("dacl-cangen could not send %d frames (queue full)" %
+                    cangen_stats["cangen_send_errors_total"])
+    unknown = sorted(set(thresholds) - {name for name, _, _ in checks})
+    if unknown:
+        failures.append("Unknown thresholds: %s" % ", ".join(unknown))
+
+    passed = not failures and all(v <= limit for _, v, limit in checks)
+    lines = ["DaCL soak run %s" % run_dir,
+             "Duration %.2f h, %d samples" % (hours, len(samples)), ""]
+    for name, value, limit in checks:
+        lines.append("%-36s %12.2f %12.2f  %s" % (
+            name, value, limit, "PASS" if value <= limit else "FAIL"))
+    lines.append("")
+    lines.extend(info)
+    lines.extend("FAIL: " + failure for failure in failures)
+    lines.extend(["", "Result: %s" % ("PASS" if passed else "FAIL")])
+    report = "\n".join(lines) + "\n"
+    with open(os.path.join(run_dir, "report.txt"), "w") as f:
+        f.write(report)
+    sys.stdout.write(report)
+    return 0 if passed else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())